@@ -0,0 +1,295 @@
+// ata.cpp
+#include "ata.h"
+#include "io.h"
+#include "memory.h"
+
+// Регистры командного блока относительно IO_BASE
+static const int REG_DATA = 0;
+static const int REG_ERROR = 1;
+static const int REG_COUNT = 2;
+static const int REG_LBA_LOW = 3;
+static const int REG_LBA_MID = 4;
+static const int REG_LBA_HIGH = 5;
+static const int REG_DRIVE = 6;
+static const int REG_STATUS = 7;
+static const int REG_COMMAND = 7;
+
+static const unsigned char STATUS_ERR = 0x01;
+static const unsigned char STATUS_DRQ = 0x08;
+static const unsigned char STATUS_DF = 0x20;
+static const unsigned char STATUS_BSY = 0x80;
+
+static const unsigned char CMD_READ_PIO = 0x20;
+static const unsigned char CMD_WRITE_PIO = 0x30;
+static const unsigned char CMD_READ_DMA = 0xC8;
+static const unsigned char CMD_WRITE_DMA = 0xCA;
+static const unsigned char CMD_FLUSH_CACHE = 0xE7;
+static const unsigned char CMD_IDENTIFY = 0xEC;
+
+// Регистры bus master относительно busMasterBase
+static const int BM_COMMAND = 0;
+static const int BM_STATUS = 2;
+static const int BM_PRD = 4;
+
+static const unsigned char BM_START = 0x01;
+static const unsigned char BM_READ = 0x08;          // Направление: с диска в память
+static const unsigned char BM_ACTIVE = 0x01;
+static const unsigned char BM_ERROR = 0x02;
+static const unsigned char BM_INTERRUPT = 0x04;
+
+static const int TIMEOUT = 10000000;
+
+// Ожидание снятия BSY; false - ошибка устройства или тайм-аут
+bool AtaDisk::waitReady() {
+    for (int i = 0; i < TIMEOUT; i++) {
+        unsigned char status = inb(IO_BASE + REG_STATUS);
+        if (!(status & STATUS_BSY)) {
+            return !(status & (STATUS_ERR | STATUS_DF));
+        }
+    }
+    return false;
+}
+
+// Ожидание готовности очередного сектора (DRQ)
+bool AtaDisk::waitData() {
+    for (int i = 0; i < TIMEOUT; i++) {
+        unsigned char status = inb(IO_BASE + REG_STATUS);
+        if (status & STATUS_BSY) {
+            continue;
+        }
+        if (status & (STATUS_ERR | STATUS_DF)) {
+            return false;
+        }
+        if (status & STATUS_DRQ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Выбор диска и адреса; чтение альтернативного статуса дает задержку 400 нс
+void AtaDisk::selectSector(unsigned int sector, int count) {
+    outb(IO_BASE + REG_DRIVE, 0xE0 | ((sector >> 24) & 0x0F));
+    for (int i = 0; i < 4; i++) {
+        inb(CONTROL_BASE);
+    }
+    outb(IO_BASE + REG_COUNT, count == MAX_SECTORS ? 0 : count);
+    outb(IO_BASE + REG_LBA_LOW, sector & 0xFF);
+    outb(IO_BASE + REG_LBA_MID, (sector >> 8) & 0xFF);
+    outb(IO_BASE + REG_LBA_HIGH, (sector >> 16) & 0xFF);
+}
+
+bool AtaDisk::initialize() {
+    present = false;
+    dmaEnabled = false;
+    sectorCount = 0;
+    model[0] = '\0';
+
+    // Прерывания канала отключаем: завершение команд опрашивается
+    outb(CONTROL_BASE, 0x02);
+
+    outb(IO_BASE + REG_DRIVE, 0xA0);
+    for (int i = 0; i < 4; i++) {
+        inb(CONTROL_BASE);
+    }
+    outb(IO_BASE + REG_COUNT, 0);
+    outb(IO_BASE + REG_LBA_LOW, 0);
+    outb(IO_BASE + REG_LBA_MID, 0);
+    outb(IO_BASE + REG_LBA_HIGH, 0);
+    outb(IO_BASE + REG_COMMAND, CMD_IDENTIFY);
+
+    // Нулевой статус или "плавающая" шина - устройства нет
+    unsigned char status = inb(IO_BASE + REG_STATUS);
+    if (status == 0 || status == 0xFF) {
+        return false;
+    }
+    for (int i = 0; i < TIMEOUT && (inb(IO_BASE + REG_STATUS) & STATUS_BSY); i++) {
+    }
+
+    // ATAPI и SATA отвечают сигнатурой в регистрах LBA
+    if (inb(IO_BASE + REG_LBA_MID) != 0 || inb(IO_BASE + REG_LBA_HIGH) != 0) {
+        return false;
+    }
+    if (!waitData()) {
+        return false;
+    }
+
+    unsigned short identify[256];
+    insw(IO_BASE + REG_DATA, identify, 256);
+
+    // Без LBA диск не поддерживаем
+    if (!(identify[49] & 0x0200)) {
+        return false;
+    }
+    sectorCount = identify[60] | ((unsigned int)identify[61] << 16);
+
+    // Модель хранится парами байт в обратном порядке
+    for (int i = 0; i < 20; i++) {
+        model[i * 2] = identify[27 + i] >> 8;
+        model[i * 2 + 1] = identify[27 + i] & 0xFF;
+    }
+    model[40] = '\0';
+    for (int i = 39; i >= 0 && model[i] == ' '; i--) {
+        model[i] = '\0';
+    }
+
+    present = true;
+    if (identify[49] & 0x0100) {
+        dmaEnabled = setupDma();
+    }
+    return true;
+}
+
+// Поиск контроллера IDE с bus master и подготовка таблицы PRD
+bool AtaDisk::setupDma() {
+    PciDevice controller;
+    if (!pciFindClass(0x01, 0x01, controller) || !(controller.progIf & 0x80)) {
+        return false;
+    }
+
+    unsigned int bar4 = pciRead(controller, 0x20);
+    if (!(bar4 & 0x01)) {
+        return false;
+    }
+    busMasterBase = bar4 & 0xFFFC;
+
+    // Страница выровнена, поэтому таблица не пересекает границу 64 КБ
+    prdTable = (Prd*)pageAllocator.allocPage();
+    if (!prdTable) {
+        return false;
+    }
+
+    pciEnableBusMaster(controller);
+    return true;
+}
+
+// Программный ввод-вывод: по сектору после каждого DRQ
+bool AtaDisk::transferPio(unsigned int sector, int count, void* buffer, bool write) {
+    if (!waitReady()) {
+        return false;
+    }
+
+    selectSector(sector, count);
+    outb(IO_BASE + REG_COMMAND, write ? CMD_WRITE_PIO : CMD_READ_PIO);
+
+    unsigned short* data = (unsigned short*)buffer;
+    for (int i = 0; i < count; i++) {
+        if (!waitData()) {
+            return false;
+        }
+        if (write) {
+            outsw(IO_BASE + REG_DATA, data, SECTOR_SIZE / 2);
+        } else {
+            insw(IO_BASE + REG_DATA, data, SECTOR_SIZE / 2);
+        }
+        data += SECTOR_SIZE / 2;
+    }
+    return waitReady();
+}
+
+// Передача через bus master. Память отображена один к одному, поэтому
+// адрес буфера совпадает с физическим. Элемент PRD не может пересекать
+// границу 64 КБ, так что буфер режется по этим границам.
+bool AtaDisk::transferDma(unsigned int sector, int count, void* buffer, bool write) {
+    unsigned int address = (unsigned int)buffer;
+    unsigned int remaining = count * SECTOR_SIZE;
+    int entries = 0;
+    while (remaining > 0) {
+        if (entries == MAX_PRD) {
+            return false;
+        }
+        unsigned int boundary = (address & ~0xFFFFu) + 0x10000;
+        unsigned int length = boundary - address;
+        if (length > remaining) {
+            length = remaining;
+        }
+        prdTable[entries].address = address;
+        prdTable[entries].byteCount = length & 0xFFFF;
+        prdTable[entries].flags = 0;
+        entries++;
+        address += length;
+        remaining -= length;
+    }
+    prdTable[entries - 1].flags = 0x8000;
+
+    if (!waitReady()) {
+        return false;
+    }
+
+    outb(busMasterBase + BM_COMMAND, 0);
+    outl(busMasterBase + BM_PRD, (unsigned int)prdTable);
+    outb(busMasterBase + BM_COMMAND, write ? 0 : BM_READ);
+    outb(busMasterBase + BM_STATUS, inb(busMasterBase + BM_STATUS) | BM_ERROR | BM_INTERRUPT);
+
+    selectSector(sector, count);
+    outb(IO_BASE + REG_COMMAND, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+    outb(busMasterBase + BM_COMMAND, (write ? 0 : BM_READ) | BM_START);
+
+    // Передача закончена, когда контроллер снял ACTIVE, а диск - BSY
+    bool done = false;
+    for (int i = 0; i < TIMEOUT && !done; i++) {
+        unsigned char bmStatus = inb(busMasterBase + BM_STATUS);
+        if (bmStatus & BM_ERROR) {
+            break;
+        }
+        done = !(bmStatus & BM_ACTIVE) && !(inb(IO_BASE + REG_STATUS) & STATUS_BSY);
+    }
+
+    outb(busMasterBase + BM_COMMAND, 0);
+    unsigned char bmStatus = inb(busMasterBase + BM_STATUS);
+    outb(busMasterBase + BM_STATUS, bmStatus | BM_ERROR | BM_INTERRUPT);
+    unsigned char status = inb(IO_BASE + REG_STATUS);
+    return done && !(bmStatus & BM_ERROR) && !(status & (STATUS_ERR | STATUS_DF));
+}
+
+bool AtaDisk::read(unsigned int sector, int count, void* buffer) {
+    if (!present || count < 0 || sector + count > sectorCount) {
+        return false;
+    }
+
+    char* data = (char*)buffer;
+    while (count > 0) {
+        int chunk = count < MAX_SECTORS ? count : MAX_SECTORS;
+        // DMA требует четного адреса буфера
+        bool ok = (dmaEnabled && !((unsigned int)data & 1))
+            ? transferDma(sector, chunk, data, false)
+            : transferPio(sector, chunk, data, false);
+        if (!ok) {
+            return false;
+        }
+        sector += chunk;
+        count -= chunk;
+        data += chunk * SECTOR_SIZE;
+    }
+    return true;
+}
+
+bool AtaDisk::write(unsigned int sector, int count, const void* buffer) {
+    if (!present || count < 0 || sector + count > sectorCount) {
+        return false;
+    }
+
+    char* data = (char*)buffer;
+    while (count > 0) {
+        int chunk = count < MAX_SECTORS ? count : MAX_SECTORS;
+        bool ok = (dmaEnabled && !((unsigned int)data & 1))
+            ? transferDma(sector, chunk, data, true)
+            : transferPio(sector, chunk, data, true);
+        if (!ok) {
+            return false;
+        }
+        sector += chunk;
+        count -= chunk;
+        data += chunk * SECTOR_SIZE;
+    }
+    return true;
+}
+
+bool AtaDisk::flush() {
+    if (!present || !waitReady()) {
+        return false;
+    }
+    outb(IO_BASE + REG_DRIVE, 0xE0);
+    outb(IO_BASE + REG_COMMAND, CMD_FLUSH_CACHE);
+    return waitReady();
+}
\ No newline at end of file
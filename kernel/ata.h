@@ -0,0 +1,56 @@
+// ata.h
+#ifndef ATA_H
+#define ATA_H
+
+#include "blockdev.h"
+#include "pci.h"
+
+// Диск ATA на первичном канале IDE (ведущее устройство, адресация LBA28).
+// Если у контроллера есть bus master, передача идет через DMA,
+// иначе - программным вводом-выводом (PIO). Прерывания отключены,
+// завершение команд опрашивается.
+class AtaDisk : public BlockDevice {
+private:
+    static const unsigned short IO_BASE = 0x1F0;
+    static const unsigned short CONTROL_BASE = 0x3F6;
+    static const int MAX_SECTORS = 256;         // За одну команду LBA28
+    static const int MAX_PRD = 4;
+
+    // Элемент таблицы дескрипторов DMA (Physical Region Descriptor)
+    struct Prd {
+        unsigned int address;
+        unsigned short byteCount;           // 0 - 64 КБ
+        unsigned short flags;               // 0x8000 - последний элемент
+    };
+
+    bool present;
+    bool dmaEnabled;
+    unsigned short busMasterBase;
+    unsigned int sectorCount;
+    char model[41];
+    Prd* prdTable;                          // Не пересекает границу 64 КБ
+
+    bool waitReady();
+    bool waitData();
+    void selectSector(unsigned int sector, int count);
+    bool transferPio(unsigned int sector, int count, void* buffer, bool write);
+    bool transferDma(unsigned int sector, int count, void* buffer, bool write);
+    bool setupDma();
+
+public:
+    // Поиск и идентификация диска; false - диска нет
+    bool initialize();
+
+    bool read(unsigned int sector, int count, void* buffer) override;
+    bool write(unsigned int sector, int count, const void* buffer) override;
+    bool flush() override;
+    unsigned int getSectorCount() override { return sectorCount; }
+    const char* getModel() override { return model; }
+
+    bool isPresent() const { return present; }
+    bool usesDma() const { return dmaEnabled; }
+};
+
+extern AtaDisk ataDisk;
+
+#endif
\ No newline at end of file
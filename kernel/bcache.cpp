@@ -0,0 +1,431 @@
+// bcache.cpp
+#include "bcache.h"
+#include "memory.h"
+#include "io.h"
+#include "clock.h"
+#include "stream.h"
+
+void BufferCache::initialize() {
+    for (int i = 0; i < HASH_SIZE; i++) {
+        hashTable[i] = -1;
+    }
+    for (int q = 0; q < 4; q++) {
+        lists[q].head = -1;
+        lists[q].tail = -1;
+        lists[q].count = 0;
+    }
+    for (int i = ENTRY_COUNT - 1; i >= 0; i--) {
+        entries[i].data = 0;
+        entries[i].dirty = false;
+        entries[i].prev = -1;
+        entries[i].next = -1;
+        pushFront(i, QUEUE_FREE);
+    }
+
+    // Буферы нарезаются из отдельных страниц: смежность не нужна
+    const int perPage = PageAllocator::PAGE_SIZE / BlockDevice::SECTOR_SIZE;
+    freeFrames = 0;
+    while (freeFrames < BUFFER_COUNT) {
+        char* page = (char*)pageAllocator.allocPage();
+        if (!page) {
+            break;
+        }
+        for (int i = 0; i < perPage; i++) {
+            frames[freeFrames++] = page + i * BlockDevice::SECTOR_SIZE;
+        }
+    }
+    capacity = freeFrames;
+
+    staging = (char*)pageAllocator.allocContiguous(WRITE_BATCH * BlockDevice::SECTOR_SIZE / PageAllocator::PAGE_SIZE);
+    ring.initialize();
+    readCheck = 0;
+    checkContext = 0;
+    lastDevice = 0;
+    lastSector = 0;
+    streak = 0;
+    now = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+unsigned int BufferCache::hash(BlockDevice* device, unsigned int sector) {
+    return ((sector * 2654435761u) ^ ((unsigned int)device >> 4)) & (HASH_SIZE - 1);
+}
+
+int BufferCache::find(BlockDevice* device, unsigned int sector) {
+    for (int e = hashTable[hash(device, sector)]; e != -1; e = entries[e].hashNext) {
+        if (entries[e].sector == sector && entries[e].device == device) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+void BufferCache::hashInsert(int entry) {
+    unsigned int bucket = hash(entries[entry].device, entries[entry].sector);
+    entries[entry].hashNext = hashTable[bucket];
+    hashTable[bucket] = entry;
+}
+
+void BufferCache::hashRemove(int entry) {
+    int* link = &hashTable[hash(entries[entry].device, entries[entry].sector)];
+    while (*link != entry) {
+        link = &entries[*link].hashNext;
+    }
+    *link = entries[entry].hashNext;
+}
+
+// Удаление записи из ее очереди
+void BufferCache::unlink(int entry) {
+    Entry& e = entries[entry];
+    List& list = lists[e.queue];
+    if (e.prev == -1) {
+        list.head = e.next;
+    } else {
+        entries[e.prev].next = e.next;
+    }
+    if (e.next == -1) {
+        list.tail = e.prev;
+    } else {
+        entries[e.next].prev = e.prev;
+    }
+    list.count--;
+}
+
+void BufferCache::pushFront(int entry, Queue queue) {
+    Entry& e = entries[entry];
+    List& list = lists[queue];
+    e.queue = queue;
+    e.prev = -1;
+    e.next = list.head;
+    if (list.head == -1) {
+        list.tail = entry;
+    } else {
+        entries[list.head].prev = entry;
+    }
+    list.head = entry;
+    list.count++;
+}
+
+// Запись забывается полностью, буфер возвращается в список свободных
+void BufferCache::freeEntry(int entry) {
+    unlink(entry);
+    hashRemove(entry);
+    if (entries[entry].data) {
+        frames[freeFrames++] = entries[entry].data;
+        entries[entry].data = 0;
+    }
+    entries[entry].dirty = false;
+    pushFront(entry, QUEUE_FREE);
+}
+
+bool BufferCache::writeEntry(int entry) {
+    Entry& e = entries[entry];
+    if (!e.device->write(e.sector, 1, e.data)) {
+        return false;
+    }
+    e.dirty = false;
+    stats.writeBacks++;
+    return true;
+}
+
+// Свободный буфер; при необходимости вытесняется хвост A1in (оставляя
+// призрак) или, если A1in не переполнена, хвост Am
+char* BufferCache::takeFrame() {
+    if (freeFrames > 0) {
+        return frames[--freeFrames];
+    }
+
+    bool fromA1in = lists[QUEUE_A1IN].count > capacity / 4 || lists[QUEUE_AM].count == 0;
+    int victim = lists[fromA1in ? QUEUE_A1IN : QUEUE_AM].tail;
+    if (victim == -1 || (entries[victim].dirty && !writeEntry(victim))) {
+        return 0;
+    }
+
+    char* frame = entries[victim].data;
+    entries[victim].data = 0;
+    stats.evictions++;
+
+    if (fromA1in) {
+        unlink(victim);
+        pushFront(victim, QUEUE_A1OUT);
+        if (lists[QUEUE_A1OUT].count > capacity / 2) {
+            freeEntry(lists[QUEUE_A1OUT].tail);
+        }
+    } else {
+        freeEntry(victim);
+    }
+    return frame;
+}
+
+// Новая запись с готовым буфером. Сектор из A1out (к нему уже
+// обращались) сразу попадает в Am, остальные - в A1in.
+int BufferCache::install(BlockDevice* device, unsigned int sector, char* frame) {
+    int entry = find(device, sector);
+    if (entry != -1) {
+        stats.ghostHits++;
+        unlink(entry);
+        entries[entry].data = frame;
+        pushFront(entry, QUEUE_AM);
+        return entry;
+    }
+
+    // Призраков не больше половины емкости, поэтому свободная запись есть
+    entry = lists[QUEUE_FREE].head;
+    unlink(entry);
+    Entry& e = entries[entry];
+    e.device = device;
+    e.sector = sector;
+    e.data = frame;
+    e.dirty = false;
+    hashInsert(entry);
+    pushFront(entry, QUEUE_A1IN);
+    return entry;
+}
+
+bool BufferCache::accept(BlockDevice* device, unsigned int sector, const char* data) {
+    if (readCheck && !readCheck(checkContext, device, sector, data)) {
+        stats.rejected++;
+        return false;
+    }
+    return true;
+}
+
+// Чтение сектора вместе со следующими одной командой. Соседние секторы,
+// которых еще нет в кэше, добавляются в A1in. Какие соседи новые,
+// решается до чтения: вытеснение при установке может записать и забыть
+// грязный сектор, и его копия, прочитанная раньше, уже устарела.
+bool BufferCache::readAhead(BlockDevice* device, unsigned int sector, char* frame) {
+    unsigned int total = device->getSectorCount();
+    int count = (total - sector < (unsigned int)READ_AHEAD) ? total - sector : READ_AHEAD;
+    if (!staging || count <= 1) {
+        return false;
+    }
+    unsigned int absent = 0;            // READ_AHEAD не больше 32
+    for (int i = 1; i < count; i++) {
+        if (find(device, sector + i) == -1) {
+            absent |= 1u << i;
+        }
+    }
+    if (!device->read(sector, count, staging)) {
+        return false;
+    }
+
+    memcpy(frame, staging, BlockDevice::SECTOR_SIZE);
+    for (int i = 1; i < count; i++) {
+        if (!(absent & (1u << i)) || find(device, sector + i) != -1) {
+            continue;
+        }
+        char* extra = takeFrame();
+        if (!extra) {
+            break;
+        }
+        memcpy(extra, staging + i * BlockDevice::SECTOR_SIZE, BlockDevice::SECTOR_SIZE);
+        if (!accept(device, sector + i, extra)) {
+            frames[freeFrames++] = extra;
+            continue;
+        }
+        install(device, sector + i, extra);
+        stats.readAhead++;
+    }
+    return true;
+}
+
+char* BufferCache::get(BlockDevice* device, unsigned int sector, Access access) {
+    bool sequential = (device == lastDevice && sector == lastSector + 1);
+    streak = sequential ? streak + 1 : 0;
+    lastDevice = device;
+    lastSector = sector;
+
+    int entry = find(device, sector);
+    if (entry != -1 && entries[entry].data) {
+        stats.hits++;
+        if (entries[entry].queue == QUEUE_AM) {
+            unlink(entry);
+            pushFront(entry, QUEUE_AM);
+        }
+    } else {
+        stats.misses++;
+        char* frame = takeFrame();
+        if (!frame) {
+            return 0;
+        }
+
+        // Буфер занимается до чтения соседей, поэтому их вытеснение его не затронет
+        if (access != ACCESS_OVERWRITE) {
+            bool done = streak >= 2 && readAhead(device, sector, frame);
+            if ((!done && !device->read(sector, 1, frame)) || !accept(device, sector, frame)) {
+                frames[freeFrames++] = frame;
+                return 0;
+            }
+        }
+        entry = install(device, sector, frame);
+    }
+
+    Entry& e = entries[entry];
+    if (access != ACCESS_READ && !e.dirty) {
+        e.dirty = true;
+        e.dirtySince = now;
+    }
+    return e.data;
+}
+
+void BufferCache::discard(BlockDevice* device, unsigned int sector, int count) {
+    for (int i = 0; i < count; i++) {
+        int entry = find(device, sector + i);
+        if (entry != -1) {
+            freeEntry(entry);
+        }
+    }
+}
+
+// Каждый сектор читается в свой буфер, соседние запросы кольцо сливает
+// в одну команду. Как и в readAhead, новые секторы выбираются до чтения
+// и после него устанавливаются, только если их все еще нет.
+int BufferCache::queueRead(BlockDevice* device, unsigned int sector, int count) {
+    for (int i = 0; i < count; i++) {
+        if (find(device, sector + i) != -1) {
+            continue;
+        }
+        char* frame = takeFrame();
+        if (!frame) {
+            return i;
+        }
+        if (!ring.prepare(sector + i, 1, frame, false, sector + i)) {
+            frames[freeFrames++] = frame;
+            return i;
+        }
+    }
+    return count;
+}
+
+int BufferCache::submitReads(BlockDevice* device) {
+    ring.submit(device);
+    int loaded = 0;
+    IoRing::Completion completion;
+    while (ring.reap(completion)) {
+        char* frame = (char*)completion.buffer;
+        if (completion.ok && find(device, completion.tag) == -1 && accept(device, completion.tag, frame)) {
+            install(device, completion.tag, frame);
+            stats.readAhead++;
+            loaded++;
+        } else {
+            frames[freeFrames++] = frame;
+        }
+    }
+    return loaded;
+}
+
+bool BufferCache::writeBack(BlockDevice* device, unsigned int maxAge, unsigned int first, unsigned int end) {
+    now = clockSeconds();
+
+    // Подходящие грязные буферы собираются и сортируются по номеру сектора
+    int count = 0;
+    for (int q = QUEUE_A1IN; q <= QUEUE_AM; q++) {
+        for (int e = lists[q].head; e != -1; e = entries[e].next) {
+            if (!entries[e].dirty || entries[e].device != device ||
+                entries[e].sector < first || entries[e].sector >= end) {
+                continue;
+            }
+            if (clockElapsed(entries[e].dirtySince, now) >= maxAge) {
+                order[count++] = e;
+            }
+        }
+    }
+
+    for (int gap = count / 2; gap > 0; gap /= 2) {
+        for (int i = gap; i < count; i++) {
+            int value = order[i];
+            int j = i;
+            for (; j >= gap && entries[order[j - gap]].sector > entries[value].sector; j -= gap) {
+                order[j] = order[j - gap];
+            }
+            order[j] = value;
+        }
+    }
+
+    bool ok = true;
+    if (!staging) {
+        for (int i = 0; i < count; i++) {
+            ok = writeEntry(order[i]) && ok;
+        }
+        return ok;
+    }
+
+    // Подряд идущие секторы копируются в промежуточный буфер и становятся
+    // одним запросом; устройство с очередью выполняет запросы пакета разом
+    int i = 0;
+    while (i < count) {
+        int first = i;
+        int requests = 0;
+        int used = 0;
+        while (i < count && requests < MAX_BATCH && used < WRITE_BATCH) {
+            int run = 1;
+            while (i + run < count && used + run < WRITE_BATCH &&
+                   entries[order[i + run]].sector == entries[order[i]].sector + run) {
+                run++;
+            }
+
+            char* buffer = staging + used * BlockDevice::SECTOR_SIZE;
+            for (int k = 0; k < run; k++) {
+                memcpy(buffer + k * BlockDevice::SECTOR_SIZE, entries[order[i + k]].data, BlockDevice::SECTOR_SIZE);
+            }
+            BlockRequest& request = batch[requests++];
+            request.sector = entries[order[i]].sector;
+            request.count = run;
+            request.buffer = buffer;
+            request.write = true;
+            used += run;
+            i += run;
+        }
+
+        device->submit(batch, requests);
+        for (int r = 0; r < requests; r++) {
+            if (batch[r].done) {
+                for (int k = 0; k < batch[r].count; k++) {
+                    entries[order[first + k]].dirty = false;
+                }
+                stats.writeBacks += batch[r].count;
+            } else {
+                ok = false;
+            }
+            first += batch[r].count;
+        }
+    }
+    return ok;
+}
+
+int BufferCache::getDirtyCount() const {
+    int count = 0;
+    for (int q = QUEUE_A1IN; q <= QUEUE_AM; q++) {
+        for (int e = lists[q].head; e != -1; e = entries[e].next) {
+            count += entries[e].dirty;
+        }
+    }
+    return count;
+}
+
+
+void BufferCache::printStats(OutputStream& out) {
+    out.writeCounter("  Buffers:      ", capacity);
+    out.writeCounter("  In A1in:      ", lists[QUEUE_A1IN].count);
+    out.writeCounter("  In Am:        ", lists[QUEUE_AM].count);
+    out.writeCounter("  Ghosts:       ", lists[QUEUE_A1OUT].count);
+    out.writeCounter("  Dirty:        ", getDirtyCount());
+    out.writeCounter("  Hits:         ", stats.hits);
+    out.writeCounter("  Misses:       ", stats.misses);
+    out.writeCounter("  Ghost hits:   ", stats.ghostHits);
+    out.writeCounter("  Evictions:    ", stats.evictions);
+    out.writeCounter("  Read ahead:   ", stats.readAhead);
+    out.writeCounter("  Written back: ", stats.writeBacks);
+    out.writeCounter("  Rejected:     ", stats.rejected);
+
+    // Без 64-битного деления: при больших счетчиках точность не важна
+    unsigned int total = stats.hits + stats.misses;
+    unsigned int rate = 0;
+    if (total >= 100000) {
+        rate = stats.hits / (total / 100);
+    } else if (total > 0) {
+        rate = stats.hits * 100 / total;
+    }
+    out.writeCounter("  Hit rate, %:  ", rate);
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+// bcache.h
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "blockdev.h"
+#include "ioring.h"
+
+class OutputStream;
+
+// Кэш секторов блочных устройств, ключ - (устройство, номер сектора).
+//
+// Замещение по алгоритму 2Q: впервые прочитанный сектор попадает в
+// очередь A1in (FIFO), вытесненный из нее оставляет "призрак" в A1out,
+// и только повторное обращение переводит сектор в основную очередь Am
+// (LRU). Однократный проход по большому файлу вытесняет лишь A1in
+// и не трогает часто используемые секторы.
+//
+// Запись отложенная: измененный буфер помечается грязным и уходит на
+// диск при вытеснении, при writeBack (по возрасту) или flush. При
+// последовательных промахах соседние секторы читаются одной командой.
+class BufferCache {
+public:
+    static const int BUFFER_COUNT = 8192;           // 4 МБ данных
+    static const int READ_AHEAD = 32;               // Секторов за одно упреждающее чтение
+    static const int WRITE_BATCH = 256;             // Секторов в одном пакете записи
+    static const int MAX_BATCH = 64;                // Запросов в одном пакете записи
+
+    // Как будет использован буфер
+    enum Access {
+        ACCESS_READ,            // Только чтение
+        ACCESS_WRITE,           // Частичная запись: сначала прочитать, потом пометить грязным
+        ACCESS_OVERWRITE        // Сектор перезаписывается целиком, читать с диска не нужно
+    };
+
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        unsigned int ghostHits;         // Промахи по секторам из A1out
+        unsigned int evictions;
+        unsigned int readAhead;         // Секторов прочитано заранее
+        unsigned int writeBacks;        // Секторов записано на диск
+        unsigned int rejected;          // Прочитанных секторов, не прошедших проверку
+    };
+
+    // Проверка сектора, прочитанного с устройства, до его установки в
+    // кэш; false - содержимое отвергнуто, как при ошибке чтения
+    typedef bool (*ReadCheck)(void* context, BlockDevice* device, unsigned int sector, const char* data);
+
+private:
+    static const int GHOST_COUNT = BUFFER_COUNT / 2;
+    static const int ENTRY_COUNT = BUFFER_COUNT + GHOST_COUNT;
+    static const int HASH_SIZE = 16384;             // Степень двойки
+    static const int A1IN_TARGET = BUFFER_COUNT / 4;
+
+    enum Queue {
+        QUEUE_FREE,
+        QUEUE_A1IN,
+        QUEUE_AM,
+        QUEUE_A1OUT
+    };
+
+    struct List {
+        int head;               // Самая свежая запись
+        int tail;
+        int count;
+    };
+
+    struct Entry {
+        BlockDevice* device;
+        unsigned int sector;
+        char* data;             // 0 у призраков
+        int hashNext;
+        int prev;
+        int next;
+        unsigned int dirtySince;
+        unsigned char queue;
+        bool dirty;
+    };
+
+    Entry entries[ENTRY_COUNT];
+    int hashTable[HASH_SIZE];
+    List lists[4];
+    char* frames[BUFFER_COUNT];     // Свободные буферы данных
+    int freeFrames;
+    int capacity;                   // Сколько буферов удалось выделить
+
+    // Обнаружение последовательного чтения
+    BlockDevice* lastDevice;
+    unsigned int lastSector;
+    int streak;
+    char* staging;                  // WRITE_BATCH секторов подряд
+    BlockRequest batch[MAX_BATCH];
+    IoRing ring;                    // Пакетное чтение для queueRead
+    ReadCheck readCheck;
+    void* checkContext;
+
+    Stats stats;
+    unsigned int now;               // Время последнего writeBack по RTC
+    int order[BUFFER_COUNT];        // Грязные буферы для записи по порядку секторов
+
+    static unsigned int hash(BlockDevice* device, unsigned int sector);
+    int find(BlockDevice* device, unsigned int sector);
+    void hashInsert(int entry);
+    void hashRemove(int entry);
+    void unlink(int entry);
+    void pushFront(int entry, Queue queue);
+    bool writeEntry(int entry);
+    void freeEntry(int entry);
+    char* takeFrame();
+    int install(BlockDevice* device, unsigned int sector, char* frame);
+    bool readAhead(BlockDevice* device, unsigned int sector, char* frame);
+    bool accept(BlockDevice* device, unsigned int sector, const char* data);
+
+public:
+    void initialize();
+    void setReadCheck(ReadCheck check, void* context) { readCheck = check; checkContext = context; }
+
+    // Буфер сектора; указатель действителен до следующего обращения к кэшу.
+    // 0 - ошибка чтения.
+    char* get(BlockDevice* device, unsigned int sector, Access access);
+
+    // Сброс кэша для освобожденных секторов: их содержимое больше не нужно
+    void discard(BlockDevice* device, unsigned int sector, int count);
+
+    // Запись грязных буферов устройства из секторов [first, end),
+    // измененных не менее maxAge секунд назад (0 - всех). Соседние
+    // секторы пишутся одним запросом, запросы отдаются устройству пакетом.
+    bool writeBack(BlockDevice* device, unsigned int maxAge, unsigned int first, unsigned int end);
+    bool flush(BlockDevice* device) { return writeBack(device, 0, 0, 0xFFFFFFFF); }
+
+    // Упреждающее чтение разрозненных участков одним пакетом: queueRead
+    // занимает буферы под отсутствующие секторы участка и ставит их в
+    // кольцо; возвращает, сколько секторов участка обработано (меньше
+    // count - кольцо заполнено или буферов нет). submitReads отдает все поставленные устройству и добавляет
+    // прочитанные секторы в A1in. Между вызовами - одно устройство.
+    int queueRead(BlockDevice* device, unsigned int sector, int count);
+    int submitReads(BlockDevice* device);
+
+    const Stats& getStats() const { return stats; }
+    int getCapacity() const { return capacity; }
+    int getDirtyCount() const;
+    void printStats(OutputStream& out);
+    void printRingStats(OutputStream& out) { ring.printStats(out); }
+};
+
+extern BufferCache bufferCache;
+
+#endif
\ No newline at end of file
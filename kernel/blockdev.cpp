@@ -0,0 +1,35 @@
+// blockdev.cpp
+#include "blockdev.h"
+
+// Устройства нет: любые операции завершаются ошибкой
+bool BlockDevice::read(unsigned int, int, void*) {
+    return false;
+}
+
+bool BlockDevice::write(unsigned int, int, const void*) {
+    return false;
+}
+
+bool BlockDevice::submit(BlockRequest* requests, int count) {
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        BlockRequest& request = requests[i];
+        request.done = request.write
+            ? write(request.sector, request.count, request.buffer)
+            : read(request.sector, request.count, request.buffer);
+        ok = ok && request.done;
+    }
+    return ok;
+}
+
+bool BlockDevice::flush() {
+    return true;
+}
+
+unsigned int BlockDevice::getSectorCount() {
+    return 0;
+}
+
+const char* BlockDevice::getModel() {
+    return "Unknown";
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+// blockdev.h
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+// Один запрос из пакета: count секторов подряд из буфера или в буфер
+struct BlockRequest {
+    unsigned int sector;
+    int count;
+    void* buffer;
+    bool write;
+    bool done;              // Заполняет устройство: запрос выполнен успешно
+};
+
+// Блочное устройство: чтение и запись секторов по 512 байт.
+// Базовая реализация - устройство, которого нет.
+class BlockDevice {
+public:
+    static const int SECTOR_SIZE = 512;
+
+    virtual bool read(unsigned int sector, int count, void* buffer);
+    virtual bool write(unsigned int sector, int count, const void* buffer);
+
+    // Пакет независимых запросов. Устройство с очередью команд выполняет
+    // их одновременно и в любом порядке; по умолчанию - по одному.
+    // false - хотя бы один запрос не выполнен.
+    virtual bool submit(BlockRequest* requests, int count);
+
+    // Сброс кэша записи устройства на носитель
+    virtual bool flush();
+
+    virtual unsigned int getSectorCount();
+    virtual const char* getModel();
+};
+
+#endif
\ No newline at end of file
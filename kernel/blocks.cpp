@@ -0,0 +1,220 @@
+// blocks.cpp
+#include "blocks.h"
+#include "memory.h"
+#include "io.h"
+
+void BlockPool::initialize() {
+    groupCount = 0;
+    freeBlocks = 0;
+    limit = MAX_BLOCKS;
+    withMemory = true;
+    memset(shares, 0, sizeof(shares));
+    sharedBlocks = 0;
+}
+
+// Подключение новой группы блоков из смежных страниц
+bool BlockPool::addGroup() {
+    if (groupCount == MAX_GROUPS || groupCount * BLOCKS_PER_GROUP >= limit) {
+        return false;
+    }
+
+    char* memory = 0;
+    if (withMemory) {
+        memory = (char*)pageAllocator.allocContiguous(GROUP_PAGES);
+        if (!memory) {
+            return false;
+        }
+    }
+
+    groups[groupCount] = memory;
+    for (int i = 0; i < BLOCKS_PER_GROUP / 32; i++) {
+        bitmap[groupCount][i] = 0;
+    }
+    groupCount++;
+    freeBlocks += BLOCKS_PER_GROUP;
+
+    // Хвост группы за пределом пула навсегда помечается занятым
+    int end = groupCount * BLOCKS_PER_GROUP;
+    if (end > limit) {
+        mark(limit, end - limit, true);
+    }
+    return true;
+}
+
+void BlockPool::mark(int start, int count, bool used) {
+    for (int block = start; block < start + count; block++) {
+        unsigned int& word = bitmap[block / BLOCKS_PER_GROUP][(block % BLOCKS_PER_GROUP) / 32];
+        if (used) {
+            word |= 1u << (block % 32);
+        } else {
+            word &= ~(1u << (block % 32));
+        }
+    }
+    freeBlocks += used ? -count : count;
+}
+
+// Первый свободный участок длиной не меньше count в группе; если такого
+// нет - самый длинный. Возвращает номер первого блока или -1.
+int BlockPool::findRun(int group, int count, int& length) {
+    int bestStart = -1;
+    int bestLength = 0;
+    int runStart = 0;
+    int runLength = 0;
+
+    for (int i = 0; i < BLOCKS_PER_GROUP; i++) {
+        // Полностью занятые слова пропускаем целиком
+        if (i % 32 == 0 && bitmap[group][i / 32] == 0xFFFFFFFF) {
+            runLength = 0;
+            i += 31;
+            continue;
+        }
+
+        if (bitmap[group][i / 32] & (1u << (i % 32))) {
+            runLength = 0;
+            continue;
+        }
+
+        if (runLength++ == 0) {
+            runStart = i;
+        }
+        if (runLength > bestLength) {
+            bestStart = runStart;
+            bestLength = runLength;
+            if (bestLength == count) {
+                break;
+            }
+        }
+    }
+
+    length = bestLength;
+    return bestStart == -1 ? -1 : group * BLOCKS_PER_GROUP + bestStart;
+}
+
+// Выделение блоков
+int BlockPool::allocate(int count, int hint, int& allocated) {
+    allocated = 0;
+    if (count <= 0) {
+        return -1;
+    }
+
+    // Продолжаем экстент на месте, если следующие блоки той же группы свободны
+    if (hint > 0 && hint < groupCount * BLOCKS_PER_GROUP && hint % BLOCKS_PER_GROUP != 0) {
+        int groupEnd = (hint / BLOCKS_PER_GROUP + 1) * BLOCKS_PER_GROUP;
+        int length = 0;
+        while (length < count && hint + length < groupEnd && !isUsed(hint + length)) {
+            length++;
+        }
+        if (length > 0) {
+            mark(hint, length, true);
+            allocated = length;
+            return hint;
+        }
+    }
+
+    // Ищем участок нужной длины, запоминая самый длинный из найденных
+    int bestStart = -1;
+    int bestLength = 0;
+    for (int group = 0; group < groupCount; group++) {
+        int length;
+        int start = findRun(group, count, length);
+        if (length >= count) {
+            mark(start, count, true);
+            allocated = count;
+            return start;
+        }
+        if (length > bestLength) {
+            bestStart = start;
+            bestLength = length;
+        }
+    }
+
+    // Подходящего участка нет: новая группа, иначе - что нашлось
+    if (addGroup()) {
+        int start = (groupCount - 1) * BLOCKS_PER_GROUP;
+        allocated = count < BLOCKS_PER_GROUP ? count : BLOCKS_PER_GROUP;
+        mark(start, allocated, true);
+        return start;
+    }
+
+    if (bestStart != -1) {
+        mark(bestStart, bestLength, true);
+        allocated = bestLength;
+    }
+    return bestStart;
+}
+
+// Освобождение блоков: общий блок только теряет одну ссылку
+void BlockPool::release(int start, int count) {
+    if (sharedBlocks == 0) {
+        mark(start, count, false);
+        return;
+    }
+    for (int block = start; block < start + count; block++) {
+        if (shares[block] == 0) {
+            mark(block, 1, false);
+        } else if (--shares[block] == 0) {
+            sharedBlocks--;
+        }
+    }
+}
+
+bool BlockPool::share(int start, int count) {
+    for (int block = start; block < start + count; block++) {
+        if (shares[block] == MAX_SHARES) {
+            return false;
+        }
+    }
+    for (int block = start; block < start + count; block++) {
+        if (shares[block]++ == 0) {
+            sharedBlocks++;
+        }
+    }
+    return true;
+}
+
+bool BlockPool::reserve(int start, int count) {
+    if (start < 0 || count < 0 || start + count > limit) {
+        return false;
+    }
+    while (groupCount * BLOCKS_PER_GROUP < start + count) {
+        if (!addGroup()) {
+            return false;
+        }
+    }
+    for (int block = start; block < start + count; block++) {
+        if (isUsed(block) && shares[block] == MAX_SHARES) {
+            return false;
+        }
+    }
+    for (int block = start; block < start + count; block++) {
+        if (!isUsed(block)) {
+            mark(block, 1, true);
+        } else if (shares[block]++ == 0) {
+            sharedBlocks++;
+        }
+    }
+    return true;
+}
+
+void BlockPool::detachMemory() {
+    for (int group = 0; group < groupCount; group++) {
+        if (groups[group]) {
+            pageAllocator.freeContiguous(groups[group], GROUP_PAGES);
+        }
+    }
+    groupCount = 0;
+    freeBlocks = 0;
+    withMemory = false;
+}
+
+void BlockPool::setLimit(int blocks) {
+    int end = groupCount * BLOCKS_PER_GROUP;
+    if (blocks < end) {
+        for (int block = blocks; block < limit && block < end; block++) {
+            if (!isUsed(block)) {
+                mark(block, 1, true);
+            }
+        }
+    }
+    limit = blocks;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+// blocks.h
+#ifndef BLOCKS_H
+#define BLOCKS_H
+
+// Пул блоков данных файловой системы. Блоки нумеруются подряд, память
+// под них берется группами смежных страниц, поэтому соседние номера
+// внутри одной группы лежат в памяти подряд.
+//
+// Блок может быть общим для дерева файлов и снимков: shares считает
+// ссылки сверх первой, release снимает одну ссылку, а свободным блок
+// становится только вместе с последней.
+class BlockPool {
+public:
+    static const int BLOCK_SIZE = 512;
+    static const int BLOCKS_PER_GROUP = 1024;   // 512 КБ на группу
+    static const int MAX_GROUPS = 256;
+    static const int MAX_BLOCKS = MAX_GROUPS * BLOCKS_PER_GROUP;
+    static const int MAX_SHARES = 0xFFFF;       // Лишних ссылок на один блок
+
+private:
+    static const unsigned int GROUP_PAGES = BLOCKS_PER_GROUP * BLOCK_SIZE / 4096;
+
+    char* groups[MAX_GROUPS];                           // Память групп
+    unsigned int bitmap[MAX_GROUPS][BLOCKS_PER_GROUP / 32];   // 1 - блок занят
+    int groupCount;
+    int freeBlocks;
+    int limit;                  // Блоки с этого номера не выдаются
+    bool withMemory;            // false - содержимое блоков хранится не здесь
+    unsigned short shares[MAX_BLOCKS];
+    int sharedBlocks;           // Блоков с лишними ссылками
+
+    void mark(int start, int count, bool used);
+    int findRun(int group, int count, int& length);
+    bool addGroup();
+
+public:
+    void initialize();
+
+    // Выделение до count смежных блоков, по возможности начиная с hint
+    // (продолжение последнего экстента файла). Возвращает первый блок
+    // или -1, в allocated - сколько блоков выделено.
+    int allocate(int count, int hint, int& allocated);
+    void release(int start, int count);
+
+    // Еще одна ссылка на каждый из занятых блоков участка. false - у
+    // какого-то блока уже MAX_SHARES лишних ссылок, участок не меняется.
+    bool share(int start, int count);
+
+    // Занятие заданных блоков (при загрузке с диска); группы
+    // добавляются по мере надобности. Уже занятый блок получает еще
+    // одну ссылку: на него ссылаются экстенты нескольких копий файла.
+    bool reserve(int start, int count);
+
+    // Ограничение пула размером области данных диска (предел только уменьшается)
+    void setLimit(int blocks);
+
+    // Переход к учету блоков без памяти (содержимое на диске). Вызывается,
+    // пока в пуле нет занятых блоков; address() после этого недоступен.
+    void detachMemory();
+
+    bool isUsed(int block) const {
+        return block / BLOCKS_PER_GROUP < groupCount &&
+            (bitmap[block / BLOCKS_PER_GROUP][(block % BLOCKS_PER_GROUP) / 32] & (1u << (block % 32)));
+    }
+
+    bool isShared(int block) const { return shares[block] != 0; }
+    int getShares(int block) const { return shares[block]; }
+    bool hasShared() const { return sharedBlocks != 0; }
+
+    char* address(int block) const {
+        return groups[block / BLOCKS_PER_GROUP] + (block % BLOCKS_PER_GROUP) * BLOCK_SIZE;
+    }
+
+    int getFreeBlocks() const { return freeBlocks; }
+};
+
+extern BlockPool blockPool;
+
+#endif
\ No newline at end of file
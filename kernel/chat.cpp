@@ -2,6 +2,7 @@
 #include "chat.h"
 #include "terminal.h"
 #include "io.h"
+#include "thread.h"
 
 ChatBot::ChatBot(Terminal* term) {
     terminal = term;
@@ -43,6 +44,11 @@ const char* ChatBot::getSmartResponse(const char* message) {
 }
 
 void ChatBot::run() {
+    scheduler.waitForeground();
+    if (scheduler.interruptRequested()) {
+        return;
+    }
+    
     // Упрощенная версия для отладки
     terminal->clear();
     terminal->writeLineColored("=== OmarOS Chat Bot ===", terminal->makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
@@ -59,8 +65,8 @@ void ChatBot::run() {
         // Чтение сообщения
         terminal->readLine(message, sizeof(message));
         
-        // Проверка на выход
-        if (strcmp(message, "exit") == 0) {
+        // Проверка на выход (exit или Ctrl+C)
+        if (strcmp(message, "exit") == 0 || scheduler.interruptRequested()) {
             exitChat = true;
             break;
         }
@@ -0,0 +1,45 @@
+// clock.cpp
+#include "clock.h"
+#include "io.h"
+
+static const unsigned short CMOS_ADDRESS = 0x70;
+static const unsigned short CMOS_DATA = 0x71;
+static const unsigned int SECONDS_PER_DAY = 86400;
+
+static unsigned char readRegister(unsigned char reg) {
+    outb(CMOS_ADDRESS, reg);
+    return inb(CMOS_DATA);
+}
+
+static unsigned int fromBcd(unsigned char value) {
+    return (value & 0x0F) + (value >> 4) * 10;
+}
+
+unsigned int clockSeconds() {
+    // Ждем окончания обновления, иначе можно прочитать половину старого времени
+    while (readRegister(0x0A) & 0x80) {
+    }
+
+    unsigned char seconds = readRegister(0x00);
+    unsigned char minutes = readRegister(0x02);
+    unsigned char hours = readRegister(0x04);
+
+    bool binary = readRegister(0x0B) & 0x04;
+    bool pm = hours & 0x80;
+    hours &= 0x7F;
+    if (!binary) {
+        seconds = fromBcd(seconds);
+        minutes = fromBcd(minutes);
+        hours = fromBcd(hours);
+    }
+
+    // 12-часовой формат: 12 AM - это 0 часов
+    if (!(readRegister(0x0B) & 0x02)) {
+        hours = (hours % 12) + (pm ? 12 : 0);
+    }
+    return (hours * 60 + minutes) * 60 + seconds;
+}
+
+unsigned int clockElapsed(unsigned int since, unsigned int now) {
+    return (now >= since) ? now - since : now + SECONDS_PER_DAY - since;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+// clock.h
+#ifndef CLOCK_H
+#define CLOCK_H
+
+// Секунды с полуночи по часам реального времени (CMOS RTC).
+// Таймера в системе нет, поэтому интервалы в секундах меряются по RTC.
+unsigned int clockSeconds();
+
+// Секунды от since до now (с учетом перехода через полночь)
+unsigned int clockElapsed(unsigned int since, unsigned int now);
+
+#endif
\ No newline at end of file
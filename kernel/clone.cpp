@@ -0,0 +1,242 @@
+// clone.cpp
+#include "filesystem.h"
+#include "io.h"
+#include "terminal.h"
+#include "thread.h"
+
+// Каталог и имя, под которыми появится копия или перемещенная запись.
+// Возвращает каталог, -1 - ошибка (уже выведена).
+int FileSystem::resolveTarget(int source, const char* path, const char*& name) {
+    int target = findEntry(path);
+    int parent = target;
+    if (target == -1) {
+        parent = resolveParent(path, name);
+        if (parent == -1) {
+            terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(path);
+            return -1;
+        }
+    } else if (files[target].isDirectory) {
+        name = names[source];
+    }
+    
+    if ((target != -1 && !files[target].isDirectory) || lookup(parent, name, strlen(name)) != -1) {
+        terminal.writeLineColored("Error: File or directory already exists.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+    if (files[parent].isArchived) {
+        terminal.writeLineColored("Error: Read-only file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+    if (!isValidFileName(name)) {
+        terminal.writeLineColored("Error: Invalid file name.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+    return parent;
+}
+
+// Лежит ли запись index в поддереве каталога dir (или это он сам)
+bool FileSystem::isInside(int index, int dir) {
+    while (index != dir && index != ROOT) {
+        index = files[index].parent;
+    }
+    return index == dir;
+}
+
+// Содержимое копии: свои экстенты на блоки источника, блоки получают
+// по ссылке. Файл из архива копируется побайтно: его содержимое лежит
+// не в блоках. false - нет места в таблице экстентов или у блоков
+// слишком много ссылок; копия тогда остается пустой.
+bool FileSystem::cloneContent(int source, int copy) {
+    const File& from = files[source];
+    if (from.isArchived) {
+        return writeData(makeHandle(copy), 0, archiveData[source], from.size);
+    }
+    
+    // Ссылки на блоки добавляются, только когда все экстенты заняты
+    bool complete = true;
+    int* link = &files[copy].firstExtent;
+    for (int e = from.firstExtent; e != -1; e = extents[e].next) {
+        int clone = allocExtent(extents[e].start, extents[e].count, -1);
+        if (clone == -1) {
+            complete = false;
+            break;
+        }
+        *link = clone;
+        link = &extents[clone].next;
+    }
+    for (int e = files[copy].firstExtent; e != -1 && complete; e = extents[e].next) {
+        if (!blockPool.share(extents[e].start, extents[e].count)) {
+            for (int f = files[copy].firstExtent; f != e; f = extents[f].next) {
+                blockPool.release(extents[f].start, extents[f].count);
+            }
+            complete = false;
+        }
+    }
+    if (!complete) {
+        while (files[copy].firstExtent != -1) {
+            int freed = files[copy].firstExtent;
+            files[copy].firstExtent = extents[freed].next;
+            extents[freed].count = 0;
+            extents[freed].next = freeExtents;
+            freeExtents = freed;
+        }
+        return false;
+    }
+    
+    files[copy].size = from.size;
+    files[copy].isCompressed = from.isCompressed;
+    touchFile(copy);
+    markStale(copy);
+    return true;
+}
+
+// Копия одной записи (каталог - без содержимого), -1 - ошибка (выведена)
+int FileSystem::copyEntry(int source, int parent, const char* name) {
+    int copy = createEntry(parent, name, files[source].isDirectory, false);
+    if (copy == -1) {
+        terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+    if (!files[source].isDirectory && !cloneContent(source, copy)) {
+        destroyEntry(copy);
+        terminal.writeColored("Error: Cannot copy file: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(names[source]);
+        return -1;
+    }
+    return copy;
+}
+
+// Каталог копируется обходом в прямом порядке без стека: к каталогу
+// источника и его копии возвращаются по ссылкам на родителей. Копия
+// не может оказаться внутри источника, поэтому обход ее не встретит.
+// При ошибке уже скопированное остается.
+bool FileSystem::copyPath(const char* from, const char* to, bool recursive) {
+    char fromRest[MAX_PATH_LENGTH];
+    char toRest[MAX_PATH_LENGTH];
+    bool fromHost = hostPath(from, fromRest);
+    bool toHost = hostPath(to, toRest);
+    if (fromHost || toHost) {
+        return copyHost(from, fromRest, fromHost, to, toRest, toHost, recursive);
+    }
+    
+    int source = findEntry(from);
+    if (source == -1) {
+        terminal.writeColored("Error: File or directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(from);
+        return false;
+    }
+    if (files[source].isDirectory && !recursive) {
+        terminal.writeColored("Error: Is a directory (use -r): ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(from);
+        return false;
+    }
+    
+    const char* name;
+    int parent = resolveTarget(source, to, name);
+    if (parent == -1) {
+        return false;
+    }
+    if (files[source].isDirectory && isInside(parent, source)) {
+        terminal.writeLineColored("Error: Cannot copy a directory into itself.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    int copy = copyEntry(source, parent, name);
+    if (copy == -1) {
+        return false;
+    }
+    
+    int dir = source;
+    int dirCopy = copy;
+    int child = files[source].isDirectory ? files[source].firstChild : -1;
+    while (child != -1 || dir != source) {
+        if (child == -1) {
+            child = files[dir].nextSibling;
+            dir = files[dir].parent;
+            dirCopy = files[dirCopy].parent;
+            continue;
+        }
+        if (!checkpoint()) {
+            terminal.writeLineColored("Error: Copy interrupted.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+        int made = copyEntry(child, dirCopy, names[child]);
+        if (made == -1) {
+            return false;
+        }
+        if (files[child].isDirectory) {
+            dir = child;
+            dirCopy = made;
+            child = files[child].firstChild;
+        } else {
+            child = files[child].nextSibling;
+        }
+    }
+    
+    terminal.writeColored("Copied: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(to);
+    return true;
+}
+
+// Запись переносится целиком: номер и поколение те же, поэтому открытые
+// дескрипторы остаются действительными. Меняется только ее хеш в
+// индексе имен: хеши потомков зависят от номера каталога, а не от пути.
+bool FileSystem::movePath(const char* from, const char* to) {
+    char fromRest[MAX_PATH_LENGTH];
+    char toRest[MAX_PATH_LENGTH];
+    bool fromHost = hostPath(from, fromRest);
+    bool toHost = hostPath(to, toRest);
+    if (fromHost || toHost) {
+        return moveHost(from, fromRest, fromHost, to, toRest, toHost);
+    }
+    
+    int source = findEntry(from);
+    if (source == -1) {
+        terminal.writeColored("Error: File or directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(from);
+        return false;
+    }
+    if (source == ROOT || files[source].isSystemFile) {
+        terminal.writeColored("Error: Cannot move system file: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(from);
+        return false;
+    }
+    
+    const char* target;
+    int parent = resolveTarget(source, to, target);
+    if (parent == -1) {
+        return false;
+    }
+    if (files[source].isDirectory && isInside(parent, source)) {
+        terminal.writeLineColored("Error: Cannot move a directory into itself.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    // Новое имя может быть самим старым именем
+    char name[MAX_NAME_LENGTH + 1];
+    strcpy(name, target);
+    
+    // Новое имя добавляется в дерево автодополнения до любых изменений
+    char key[CompletionTrie::MAX_WORD_LENGTH];
+    nameKey(parent, name, key);
+    if (!nameTrie.insert(key)) {
+        terminal.writeLineColored("Error: Not enough memory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    nameKey(files[source].parent, names[source], key);
+    nameTrie.remove(key);
+    indexRemove(source);
+    unlinkEntry(source);
+    strcpy(names[source], name);
+    files[source].nameHash = dentryHash(parent, name, strlen(name));
+    linkEntry(source, parent);
+    indexInsert(source);
+    
+    // Текущий каталог мог переехать вместе с перемещенным
+    updateCurrentPath();
+    
+    terminal.writeColored("Moved: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(to);
+    return true;
+}
\ No newline at end of file
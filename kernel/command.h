@@ -0,0 +1,96 @@
+// command.h
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include "io.h"
+
+class InputStream;
+class OutputStream;
+
+// Структура для хранения аргументов команды
+struct CommandArgs {
+    int argc;               // Количество аргументов
+    char* argv[16];         // Массив указателей на аргументы
+    InputStream* input;     // Ввод из канала или файла, 0 - ввода нет
+    OutputStream* output;   // Терминал, канал или файл
+};
+
+typedef void (*CommandHandler)(CommandArgs& args);
+
+// Описание команды оболочки: все, что нужно для вызова, справки и автодополнения
+struct Command {
+    const char* name;
+    CommandHandler handler;
+    const char* usage;          // Синтаксис, например "cd <directory>"
+    const char* description;
+    int minArgs;                // Минимальное число аргументов после имени
+    int maxArgs;                // Максимальное число аргументов (-1 - без ограничения)
+};
+
+// Хеш FNV-1a с затравкой, вычисляется и при компиляции, и во время работы
+constexpr unsigned int commandHash(const char* str, unsigned int seed) {
+    unsigned int hash = 2166136261u ^ seed;
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+// Размер таблицы - степень двойки, не меньше учетверенного числа команд
+constexpr int perfectHashSize(int count) {
+    int size = 1;
+    while (size < count * 4) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Таблица идеального хеширования: каждое имя команды попадает в свою ячейку
+template <int SIZE>
+struct PerfectHash {
+    unsigned int seed;          // 0 - подобрать затравку не удалось
+    signed char slots[SIZE];    // Индекс команды или -1
+};
+
+// Подбор затравки без коллизий на этапе компиляции
+template <int SIZE, int N>
+constexpr PerfectHash<SIZE> buildPerfectHash(const Command (&commands)[N]) {
+    PerfectHash<SIZE> table = {};
+
+    for (unsigned int seed = 1; seed < 100000; seed++) {
+        bool collision = false;
+        for (int i = 0; i < SIZE; i++) {
+            table.slots[i] = -1;
+        }
+
+        for (int i = 0; i < N && !collision; i++) {
+            unsigned int slot = commandHash(commands[i].name, seed) & (SIZE - 1);
+            if (table.slots[slot] != -1) {
+                collision = true;
+            } else {
+                table.slots[slot] = (signed char)i;
+            }
+        }
+
+        if (!collision) {
+            table.seed = seed;
+            return table;
+        }
+    }
+
+    table.seed = 0;
+    return table;
+}
+
+// Поиск команды: одно вычисление хеша и одно сравнение строк
+template <int SIZE>
+int lookupCommand(const PerfectHash<SIZE>& table, const Command* commands, const char* name) {
+    int index = table.slots[commandHash(name, table.seed) & (SIZE - 1)];
+    if (index < 0 || strcmp(commands[index].name, name) != 0) {
+        return -1;
+    }
+    return index;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,285 @@
+// compress.cpp
+#include "filesystem.h"
+#include "io.h"
+#include "terminal.h"
+#include "blocks.h"
+#include "memory.h"
+#include "bcache.h"
+#include "lz4.h"
+
+// Буферы фрагмента: распакованного и сжатого
+bool FileSystem::allocChunkBuffers() {
+    if (chunkData) {
+        return true;
+    }
+    chunkData = (char*)pageAllocator.allocPage();
+    chunkStored = (char*)pageAllocator.allocPage();
+    if (!chunkData || !chunkStored) {
+        if (chunkData) {
+            pageAllocator.freePage(chunkData);
+        }
+        if (chunkStored) {
+            pageAllocator.freePage(chunkStored);
+        }
+        chunkData = 0;
+        chunkStored = 0;
+        return false;
+    }
+    return true;
+}
+
+// Чтение байт из блоков файла как есть, без распаковки. Возвращает
+// число прочитанных байт: меньше length - конец блоков или ошибка диска.
+int FileSystem::readStored(const Extent* table, int firstExtent, int offset, char* buffer, int length) {
+    int done = 0;
+    for (int e = firstExtent; e != -1 && done < length; e = table[e].next) {
+        int extentSize = table[e].count * BlockPool::BLOCK_SIZE;
+        if (offset >= extentSize) {
+            offset -= extentSize;
+            continue;
+        }
+        
+        while (offset < extentSize && done < length) {
+            const char* data;
+            int available;
+            if (!device) {
+                data = blockPool.address(table[e].start) + offset;
+                available = (extentSize - offset < length - done) ? extentSize - offset : length - done;
+                int verified = verifyResident(table[e].start + offset / BlockPool::BLOCK_SIZE, offset % BlockPool::BLOCK_SIZE, available);
+                if (verified < available) {
+                    memcpy(buffer + done, data, verified);
+                    return done + verified;
+                }
+            } else {
+                int block = table[e].start + offset / BlockPool::BLOCK_SIZE;
+                data = bufferCache.get(device, superblock.dataStart + block, BufferCache::ACCESS_READ);
+                if (!data) {
+                    return done;
+                }
+                data += offset % BlockPool::BLOCK_SIZE;
+                available = BlockPool::BLOCK_SIZE - offset % BlockPool::BLOCK_SIZE;
+            }
+            if (available > length - done) {
+                available = length - done;
+            }
+            memcpy(buffer + done, data, available);
+            done += available;
+            offset += available;
+        }
+        offset = 0;
+    }
+    return done;
+}
+
+// Распаковка фрагмента chunk в chunkData. Таблица экстентов - дерева
+// или снимка. Возвращает длину фрагмента, -1 - данные повреждены.
+int FileSystem::unpackChunk(const Extent* table, const File& file, int chunk) {
+    if (!allocChunkBuffers()) {
+        return -1;
+    }
+    int length = file.size - chunk * DISKFS_CHUNK_SIZE;
+    if (length > DISKFS_CHUNK_SIZE) {
+        length = DISKFS_CHUNK_SIZE;
+    }
+    if (length <= 0) {
+        return -1;
+    }
+    
+    unsigned int range[2];
+    int entry = sizeof(DiskCompressedHeader) + chunk * sizeof(unsigned int);
+    if (readStored(table, file.firstExtent, entry, (char*)range, sizeof(range)) != (int)sizeof(range) ||
+        range[1] <= range[0] || range[1] - range[0] > (unsigned int)length) {
+        return -1;
+    }
+    
+    // Фрагмент длиной с содержимое хранится без сжатия
+    int stored = range[1] - range[0];
+    if (stored == length) {
+        return readStored(table, file.firstExtent, range[0], chunkData, length) == length ? length : -1;
+    }
+    if (readStored(table, file.firstExtent, range[0], chunkStored, stored) != stored) {
+        return -1;
+    }
+    return lz4Decompress(chunkStored, stored, chunkData, length) == length ? length : -1;
+}
+
+// Новое содержимое пишется в новые блоки, старые освобождаются только
+// после успешной записи: при нехватке места файл остается прежним
+bool FileSystem::replaceContent(int file, const char* data, int length) {
+    File& entry = files[file];
+    int oldExtents = entry.firstExtent;
+    int oldSize = entry.size;
+    entry.firstExtent = -1;
+    entry.size = 0;
+    
+    if (!writeData(makeHandle(file), 0, data, length)) {
+        releaseBlocks(file, 0);
+        entry.firstExtent = oldExtents;
+        entry.size = oldSize;
+        touchFile(file);
+        return false;
+    }
+    
+    int newExtents = entry.firstExtent;
+    entry.firstExtent = oldExtents;
+    releaseBlocks(file, 0);
+    entry.firstExtent = newExtents;
+    touchFile(file);
+    return true;
+}
+
+// Распаковка сжатого файла целиком (перед записью в него)
+bool FileSystem::expandFile(int file) {
+    int size = files[file].size;
+    unsigned int pages = (size + PageAllocator::PAGE_SIZE - 1) / PageAllocator::PAGE_SIZE;
+    char* content = (char*)pageAllocator.allocContiguous(pages ? pages : 1);
+    if (!content) {
+        return false;
+    }
+    
+    bool expanded = readData(makeHandle(file), 0, content, size) == size;
+    if (expanded) {
+        files[file].isCompressed = false;
+        expanded = replaceContent(file, content, size);
+        files[file].isCompressed = !expanded;
+    }
+    chunkFile = -1;
+    pageAllocator.freeContiguous(content, pages ? pages : 1);
+    return expanded;
+}
+
+// Поиск файла для сжатия или распаковки; -1 - файл изменять нельзя
+int FileSystem::findPlainFile(const char* path) {
+    int index = findEntry(path);
+    if (index == -1) {
+        terminal.writeColored("Error: File not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return -1;
+    }
+    if (files[index].isDirectory) {
+        terminal.writeColored("Error: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeColored(path, terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLineColored(" is a directory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+    if (files[index].isArchived) {
+        terminal.writeLineColored("Error: Read-only file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+    if (files[index].isSystemFile) {
+        terminal.writeColored("Error: Cannot modify system file: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return -1;
+    }
+    return index;
+}
+
+// Файл сжимается по фрагментам в смежные страницы и заменяет прежнее
+// содержимое. Фрагмент, который не сжимается, хранится как есть.
+bool FileSystem::compressFile(const char* path) {
+    int index = findPlainFile(path);
+    if (index == -1) {
+        return false;
+    }
+    if (files[index].isCompressed) {
+        terminal.writeColored("Already compressed: ", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return true;
+    }
+    
+    int size = files[index].size;
+    int chunks = (size + DISKFS_CHUNK_SIZE - 1) / DISKFS_CHUNK_SIZE;
+    int headerSize = sizeof(DiskCompressedHeader) + (chunks + 1) * sizeof(unsigned int);
+    
+    // Места хватит, даже если не сожмется ни один фрагмент
+    unsigned int pages = (headerSize + size + PageAllocator::PAGE_SIZE - 1) / PageAllocator::PAGE_SIZE;
+    char* stream = (char*)pageAllocator.allocContiguous(pages);
+    if (!stream || !allocChunkBuffers()) {
+        if (stream) {
+            pageAllocator.freeContiguous(stream, pages);
+        }
+        terminal.writeLineColored("Error: Not enough memory to compress file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    chunkFile = -1;
+    
+    DiskCompressedHeader* header = (DiskCompressedHeader*)stream;
+    header->magic = DISKFS_COMPRESSED_MAGIC;
+    header->chunks = chunks;
+    unsigned int* offsets = (unsigned int*)(stream + sizeof(DiskCompressedHeader));
+    
+    int handle = makeHandle(index);
+    int position = headerSize;
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        int length = size - chunk * DISKFS_CHUNK_SIZE;
+        if (length > DISKFS_CHUNK_SIZE) {
+            length = DISKFS_CHUNK_SIZE;
+        }
+        if (readData(handle, chunk * DISKFS_CHUNK_SIZE, chunkData, length) != length) {
+            pageAllocator.freeContiguous(stream, pages);
+            terminal.writeLineColored("Error: Cannot read disk.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+        
+        int packed = lz4Compress(chunkData, length, stream + position, length - 1);
+        if (packed == 0) {
+            memcpy(stream + position, chunkData, length);
+            packed = length;
+        }
+        offsets[chunk] = position;
+        position += packed;
+    }
+    offsets[chunks] = position;
+    
+    // Сжатие, которое не экономит ни одного блока, не нужно
+    int plainBlocks = (size + BlockPool::BLOCK_SIZE - 1) / BlockPool::BLOCK_SIZE;
+    int packedBlocks = (position + BlockPool::BLOCK_SIZE - 1) / BlockPool::BLOCK_SIZE;
+    if (packedBlocks >= plainBlocks) {
+        pageAllocator.freeContiguous(stream, pages);
+        terminal.writeColored("File does not compress: ", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return false;
+    }
+    
+    bool replaced = replaceContent(index, stream, position);
+    pageAllocator.freeContiguous(stream, pages);
+    if (!replaced) {
+        terminal.writeLineColored("Error: Not enough space to compress file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    files[index].isCompressed = true;
+    files[index].size = size;
+    touchFile(index);
+    
+    char number[16];
+    terminal.writeColored("Compressed: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.write(path);
+    terminal.write(" (");
+    itoa(size, number, 10);
+    terminal.write(number);
+    terminal.write(" -> ");
+    itoa(packedBlocks * BlockPool::BLOCK_SIZE, number, 10);
+    terminal.write(number);
+    terminal.writeLine(" bytes)");
+    return true;
+}
+
+bool FileSystem::decompressFile(const char* path) {
+    int index = findPlainFile(path);
+    if (index == -1) {
+        return false;
+    }
+    if (!files[index].isCompressed) {
+        terminal.writeColored("Not compressed: ", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return true;
+    }
+    
+    if (!expandFile(index)) {
+        terminal.writeLineColored("Error: Not enough space to decompress file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    terminal.writeColored("Decompressed: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(path);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+// crc32c.cpp
+#include "crc32c.h"
+
+static const unsigned int POLYNOMIAL = 0x82F63B78;     // 0x1EDC6F41 в отраженной записи
+static const unsigned int LANE = 168;                  // Три полосы покрывают 504 байта блока в 512
+
+static unsigned int tables[8][256];
+static unsigned int laneShift[4][256];     // Умножение на x^(8 * LANE) по байтам
+static bool hardware;
+
+// Произведение многочленов по модулю полинома. Запись отраженная:
+// коэффициент при x^0 - старший бит.
+static unsigned int multiply(unsigned int a, unsigned int b) {
+    unsigned int product = 0;
+    for (unsigned int bit = 1u << 31; bit; bit >>= 1) {
+        if (a & bit) {
+            product ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+    }
+    return product;
+}
+
+void crc32cInitialize() {
+    for (unsigned int n = 0; n < 256; n++) {
+        unsigned int crc = n;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+        }
+        tables[0][n] = crc;
+    }
+    for (unsigned int n = 0; n < 256; n++) {
+        for (int k = 1; k < 8; k++) {
+            tables[k][n] = (tables[k - 1][n] >> 8) ^ tables[0][tables[k - 1][n] & 0xFF];
+        }
+    }
+
+    // x^(8 * LANE) возведением в квадрат: x, x^2, x^4, ...
+    unsigned int power = 1u << 30;
+    unsigned int factor = 1u << 31;
+    for (unsigned int bits = 8 * LANE; bits; bits >>= 1) {
+        if (bits & 1) {
+            factor = multiply(power, factor);
+        }
+        power = multiply(power, power);
+    }
+    for (int k = 0; k < 4; k++) {
+        for (unsigned int n = 0; n < 256; n++) {
+            laneShift[k][n] = multiply(factor, n << (8 * k));
+        }
+    }
+
+    // SSE4.2: CPUID.1:ECX, бит 20
+    unsigned int eax, ebx, ecx, edx;
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    hardware = (ecx & (1u << 20)) != 0;
+}
+
+bool crc32cHardware() {
+    return hardware;
+}
+
+// Без SSE4.2: по восемь байт, каждый байт - через свою таблицу
+static unsigned int softwareUpdate(unsigned int crc, const unsigned char* p, unsigned int length) {
+    for (; length >= 8; p += 8, length -= 8) {
+        unsigned int low = *(const unsigned int*)p ^ crc;
+        unsigned int high = *(const unsigned int*)(p + 4);
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^
+              tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24] ^
+              tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^
+              tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+    }
+    for (; length; p++, length--) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *p) & 0xFF];
+    }
+    return crc;
+}
+
+static inline unsigned int crcWord(unsigned int crc, unsigned int word) {
+    asm("crc32l %1, %0" : "+r"(crc) : "rm"(word));
+    return crc;
+}
+
+static inline unsigned int crcByte(unsigned int crc, unsigned char byte) {
+    asm("crc32b %1, %0" : "+r"(crc) : "qm"(byte));
+    return crc;
+}
+
+static inline unsigned int shiftLane(unsigned int crc) {
+    return laneShift[0][crc & 0xFF] ^ laneShift[1][(crc >> 8) & 0xFF] ^
+           laneShift[2][(crc >> 16) & 0xFF] ^ laneShift[3][crc >> 24];
+}
+
+// Полосы a, b, c подряд: сумма b и c считается с нуля, потом сумма
+// всего участка - ((a * x^L) ^ b) * x^L ^ c, где L - длина полосы в битах
+static unsigned int hardwareUpdate(unsigned int crc, const unsigned char* p, unsigned int length) {
+    for (; length >= 3 * LANE; p += 3 * LANE, length -= 3 * LANE) {
+        const unsigned int* a = (const unsigned int*)p;
+        const unsigned int* b = (const unsigned int*)(p + LANE);
+        const unsigned int* c = (const unsigned int*)(p + 2 * LANE);
+        unsigned int crcB = 0;
+        unsigned int crcC = 0;
+        for (unsigned int i = 0; i < LANE / 4; i++) {
+            crc = crcWord(crc, a[i]);
+            crcB = crcWord(crcB, b[i]);
+            crcC = crcWord(crcC, c[i]);
+        }
+        crc = shiftLane(shiftLane(crc) ^ crcB) ^ crcC;
+    }
+    for (; length >= 4; p += 4, length -= 4) {
+        crc = crcWord(crc, *(const unsigned int*)p);
+    }
+    for (; length; p++, length--) {
+        crc = crcByte(crc, *p);
+    }
+    return crc;
+}
+
+unsigned int crc32c(unsigned int crc, const void* data, unsigned int length) {
+    const unsigned char* p = (const unsigned char*)data;
+    crc = hardware ? hardwareUpdate(~crc, p, length) : softwareUpdate(~crc, p, length);
+    return ~crc;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+// crc32c.h
+#ifndef CRC32C_H
+#define CRC32C_H
+
+// Контрольная сумма CRC32C (полином Кастаньоли, как в iSCSI и ext4).
+// На процессорах с SSE4.2 считается командой crc32: участок делится на
+// три полосы, которые считаются вперемешку (задержка команды - три
+// такта, а новая может начинаться каждый такт), и их суммы потом
+// сдвигаются и складываются. Без SSE4.2 - таблицы slicing-by-8: восемь
+// байт за шаг по восьми таблицам.
+
+// Выбор реализации по CPUID и построение таблиц; вызывается до первого crc32c
+void crc32cInitialize();
+bool crc32cHardware();
+
+// Продолжение суммы crc на length байт; начальное значение - 0.
+// crc32c(0, "123456789", 9) == 0xE3069283.
+unsigned int crc32c(unsigned int crc, const void* data, unsigned int length);
+
+#endif
\ No newline at end of file
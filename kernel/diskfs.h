@@ -0,0 +1,183 @@
+// diskfs.h
+#ifndef DISKFS_H
+#define DISKFS_H
+
+// Формат файловой системы OmarOS на диске. Заголовок используется и
+// ядром, и утилитой tools/mkfs, поэтому не зависит от остального ядра.
+//
+// Все числа - little-endian, единица размещения - сектор 512 байт.
+// Таблицы повторяют таблицы FileSystem один к одному: инод N - запись N,
+// экстент N - экстент N, блок данных N - блок N пула BlockPool.
+//
+//   сектор 0                 суперблок
+//   inodeStart               таблица инодов, 8 инодов на сектор
+//   extentStart              таблица экстентов, 32 экстента на сектор
+//   bitmapStart              карта занятости блоков данных, 1 бит на блок
+//   journalStart             журнал метаданных (с версии 2)
+//   dataStart                блоки данных
+//
+// Инод 0 - корневой каталог. Каталоги хранят связи дерева прямо в инодах
+// (первый потомок, соседи), содержимое файла - цепочка экстентов.
+// Экстент не пересекает границу группы из DISKFS_GROUP_BLOCKS блоков.
+// Экстенты разных файлов могут указывать на одни и те же блоки: так
+// хранятся копии (cp), пока ни в одну из них не писали.
+//
+// Журнал. Измененные секторы метаданных (инодов, экстентов, карты блоков)
+// сначала дописываются в журнал одной транзакцией, и только потом пишутся
+// на свои места. Транзакция - описатель, копии секторов и запись фиксации
+// подряд, одной последовательной записью:
+//
+//   описатель    DiskJournalRecord: номер, число секторов, битовая карта
+//                секторов относительно inodeStart (по возрастанию)
+//   копии        count секторов в порядке битовой карты
+//   фиксация     DiskJournalRecord с тем же номером и контрольной суммой
+//
+// Первый сектор журнала - DiskJournalHeader с номером ожидаемой транзакции.
+// Транзакции идут со второго сектора подряд с номерами sequence,
+// sequence + 1, ...; при монтировании неповрежденные транзакции
+// переписываются на места. Когда журнал заполнен, все метаданные пишутся
+// на места и заголовок получает следующий номер - старые записи
+// перестают совпадать по номеру.
+//
+// Сжатый файл (флаг DISKFS_COMPRESSED) хранит в своих блоках не
+// содержимое, а DiskCompressedHeader, таблицу из chunks + 1 смещений
+// и фрагменты подряд. Фрагмент - DISKFS_CHUNK_SIZE байт содержимого
+// (последний короче), сжатый LZ4; фрагмент, который не сжимается,
+// хранится как есть, и его длина равна длине содержимого. Поле size
+// инода - размер содержимого.
+
+static const unsigned int DISKFS_MAGIC = 0x53464D4F;    // "OMFS"
+static const unsigned int DISKFS_VERSION = 2;
+static const unsigned int DISKFS_VERSION_NO_JOURNAL = 1;   // Читается, журнала нет
+static const int DISKFS_SECTOR_SIZE = 512;
+static const int DISKFS_INODE_COUNT = 16384;
+static const int DISKFS_EXTENT_COUNT = 32768;
+static const int DISKFS_MAX_BLOCKS = 262144;
+static const int DISKFS_GROUP_BLOCKS = 1024;
+static const int DISKFS_NAME_LENGTH = 32;               // С завершающим нулем
+static const int DISKFS_JOURNAL_SECTORS = 4096;         // 2 МБ
+static const unsigned int DISKFS_JOURNAL_MAGIC = 0x4C4E524A;    // "JRNL"
+static const unsigned int DISKFS_RECORD_DESCRIPTOR = 1;
+static const unsigned int DISKFS_RECORD_COMMIT = 2;
+static const int DISKFS_JOURNAL_MAP_WORDS = 120;        // До 3840 секторов метаданных
+
+// Флаги инода
+static const unsigned int DISKFS_USED = 0x01;
+static const unsigned int DISKFS_DIRECTORY = 0x02;
+static const unsigned int DISKFS_SYSTEM = 0x04;
+static const unsigned int DISKFS_COMPRESSED = 0x08;
+
+static const int DISKFS_CHUNK_SIZE = 4096;
+static const unsigned int DISKFS_COMPRESSED_MAGIC = 0x46345A4C;     // "LZ4F"
+
+struct DiskSuperblock {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int totalSectors;
+    unsigned int inodeCount;
+    unsigned int inodeStart;
+    unsigned int inodeSectors;
+    unsigned int extentCount;
+    unsigned int extentStart;
+    unsigned int extentSectors;
+    unsigned int bitmapStart;
+    unsigned int bitmapSectors;
+    unsigned int dataStart;
+    unsigned int dataBlocks;
+    unsigned int journalStart;
+    unsigned int journalSectors;            // 0 - журнала нет
+    unsigned int reserved[113];
+};
+
+struct DiskInode {
+    char name[DISKFS_NAME_LENGTH];
+    int parent;
+    int firstChild;
+    int prevSibling;            // У первого потомка - последний потомок
+    int nextSibling;
+    int size;
+    int firstExtent;            // -1 - содержимого нет
+    unsigned int flags;
+    unsigned int reserved;
+};
+
+struct DiskExtent {
+    int start;                  // Номер блока данных
+    int count;
+    int next;                   // Следующий экстент файла, -1 - последний
+    unsigned int reserved;
+};
+
+// Начало сжатого файла; за ним unsigned int offsets[chunks + 1] -
+// смещения фрагментов от начала файла, последнее - конец данных
+struct DiskCompressedHeader {
+    unsigned int magic;
+    unsigned int chunks;
+};
+
+struct DiskJournalHeader {
+    unsigned int magic;
+    unsigned int sequence;                  // Номер первой транзакции в журнале
+    unsigned int reserved[126];
+};
+
+// Описатель и запись фиксации транзакции
+struct DiskJournalRecord {
+    unsigned int magic;
+    unsigned int type;
+    unsigned int sequence;
+    unsigned int count;                     // Секторов в транзакции
+    unsigned int checksum;                  // Только у фиксации: сумма описателя и копий
+    unsigned int reserved[3];
+    unsigned int map[DISKFS_JOURNAL_MAP_WORDS];
+};
+
+static_assert(sizeof(DiskSuperblock) == DISKFS_SECTOR_SIZE, "superblock must fill one sector");
+static_assert(sizeof(DiskJournalHeader) == DISKFS_SECTOR_SIZE, "journal header must fill one sector");
+static_assert(sizeof(DiskJournalRecord) == DISKFS_SECTOR_SIZE, "journal record must fill one sector");
+static_assert(sizeof(DiskInode) == 64, "inode size is part of the format");
+static_assert(sizeof(DiskExtent) == 16, "extent size is part of the format");
+
+static const int DISKFS_INODES_PER_SECTOR = DISKFS_SECTOR_SIZE / sizeof(DiskInode);
+static const int DISKFS_EXTENTS_PER_SECTOR = DISKFS_SECTOR_SIZE / sizeof(DiskExtent);
+static const int DISKFS_BITS_PER_SECTOR = DISKFS_SECTOR_SIZE * 8;
+
+// Все секторы метаданных помещаются в битовую карту описателя, а самая
+// большая транзакция - в журнал
+static const int DISKFS_METADATA_SECTORS = DISKFS_INODE_COUNT / DISKFS_INODES_PER_SECTOR +
+                                           DISKFS_EXTENT_COUNT / DISKFS_EXTENTS_PER_SECTOR +
+                                           DISKFS_MAX_BLOCKS / DISKFS_BITS_PER_SECTOR;
+static_assert(DISKFS_METADATA_SECTORS <= DISKFS_JOURNAL_MAP_WORDS * 32, "metadata must fit the journal map");
+static_assert(DISKFS_METADATA_SECTORS + 3 <= DISKFS_JOURNAL_SECTORS, "largest transaction must fit the journal");
+
+// Разметка диска из totalSectors секторов; false - диск слишком мал
+inline bool diskfsLayout(unsigned int totalSectors, DiskSuperblock& super) {
+    super.magic = DISKFS_MAGIC;
+    super.version = DISKFS_VERSION;
+    super.totalSectors = totalSectors;
+    super.inodeCount = DISKFS_INODE_COUNT;
+    super.inodeStart = 8;
+    super.inodeSectors = DISKFS_INODE_COUNT / DISKFS_INODES_PER_SECTOR;
+    super.extentCount = DISKFS_EXTENT_COUNT;
+    super.extentStart = super.inodeStart + super.inodeSectors;
+    super.extentSectors = DISKFS_EXTENT_COUNT / DISKFS_EXTENTS_PER_SECTOR;
+    super.bitmapStart = super.extentStart + super.extentSectors;
+    for (int i = 0; i < 113; i++) {
+        super.reserved[i] = 0;
+    }
+
+    // Карта рассчитана на наибольший пул, данные выравниваются на 4 КБ
+    super.bitmapSectors = DISKFS_MAX_BLOCKS / DISKFS_BITS_PER_SECTOR;
+    super.journalStart = super.bitmapStart + super.bitmapSectors;
+    super.journalSectors = DISKFS_JOURNAL_SECTORS;
+    super.dataStart = (super.journalStart + super.journalSectors + 7) & ~7u;
+    if (totalSectors <= super.dataStart + DISKFS_GROUP_BLOCKS) {
+        return false;
+    }
+
+    unsigned int blocks = totalSectors - super.dataStart;
+    super.dataBlocks = blocks < (unsigned int)DISKFS_MAX_BLOCKS ? blocks : DISKFS_MAX_BLOCKS;
+    return true;
+}
+
+#endif
\ No newline at end of file
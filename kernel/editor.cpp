@@ -3,6 +3,11 @@
 #include "terminal.h"
 #include "filesystem.h"
 #include "io.h"
+#include "keyboard.h"
+#include "thread.h"
+#include "mmap.h"
+#include "memory.h"
+#include "fd.h"
 
 // Конструктор
 Editor::Editor(Terminal* term, FileSystem* filesystem) {
@@ -15,8 +20,15 @@ Editor::Editor(Terminal* term, FileSystem* filesystem) {
 
 // Запуск редактора для файла
 void Editor::edit(const char* file) {
+    // Фоновое задание ждет, пока его не выведут на передний план
+    scheduler.waitForeground();
+    if (scheduler.interruptRequested()) {
+        return;
+    }
+    
     // Сохраняем имя файла
-    strcpy(filename, file);
+    strncpy(filename, file, sizeof(filename) - 1);
+    filename[sizeof(filename) - 1] = '\0';
     
     // Очищаем буфер
     for (int i = 0; i < MAX_LINES; i++) {
@@ -27,27 +39,40 @@ void Editor::edit(const char* file) {
     cursorLine = 0;
     cursorPos = 0;
     
-    // Загружаем содержимое файла, если он существует
+    // Загружаем содержимое файла, если он существует. Строки разбираются
+    // прямо из отображения файла: страницы заполняются, только пока
+    // строки помещаются в буфер.
     int fileIndex = fs->findFile(file);
-    if (fileIndex != -1) {
-        // Разбиваем содержимое файла на строки
-        const char* content = fs->getFileContent(fileIndex);
+    FileMapping mapping;
+    if (fileIndex != -1 && mapping.map(fs, fileIndex, 0, fs->getFileSize(fileIndex), false)) {
         int line = 0;
         int pos = 0;
         
-        for (int i = 0; content[i] != '\0' && line < MAX_LINES; i++) {
-            if (content[i] == '\n') {
-                buffer[line][pos] = '\0';
-                line++;
-                pos = 0;
-                if (line >= MAX_LINES) break;
-            } else if (pos < MAX_LINE_LENGTH - 1) {
-                buffer[line][pos++] = content[i];
-                buffer[line][pos] = '\0';
+        for (int offset = 0; line < MAX_LINES && offset < mapping.getLength();) {
+            int length = PageAllocator::PAGE_SIZE - offset % PageAllocator::PAGE_SIZE;
+            if (length > mapping.getLength() - offset) {
+                length = mapping.getLength() - offset;
+            }
+            const char* content = mapping.data(offset, length);
+            if (!content) {
+                break;
+            }
+            offset += length;
+            
+            for (int i = 0; i < length && line < MAX_LINES; i++) {
+                if (content[i] == '\n') {
+                    buffer[line][pos] = '\0';
+                    line++;
+                    pos = 0;
+                } else if (pos < MAX_LINE_LENGTH - 1) {
+                    buffer[line][pos++] = content[i];
+                    buffer[line][pos] = '\0';
+                }
             }
         }
         
-        lineCount = line + 1;
+        lineCount = (line < MAX_LINES) ? line + 1 : MAX_LINES;
+        mapping.unmap();
     }
     
     // Очищаем экран и отображаем буфер
@@ -61,20 +86,17 @@ void Editor::edit(const char* file) {
     bool exitEditor = false;
     
     while (!exitEditor) {
-        // Ждем нажатия клавиши
-        while ((inb(0x64) & 1) == 0);
+        // Ждем нажатия клавиши (отпускания пропускаются)
+        KeyEvent event = keyboard.waitKeyPress();
         
-        // Читаем скан-код
-        unsigned char scancode = inb(0x60);
-        
-        // ESC - выход из редактора
-        if (scancode == 0x01) {
+        // ESC или Ctrl+C - выход из редактора
+        if (event.key == KEY_ESCAPE || Keyboard::isInterruptKey(event)) {
             exitEditor = true;
             break;
         }
         
         // Обрабатываем нажатие клавиши
-        handleKeypress(scancode);
+        handleKeypress(event);
     }
     
     // Возвращаемся в обычный режим
@@ -134,16 +156,16 @@ void Editor::displayStatusLine() {
 }
 
 // Обработка нажатия клавиши
-void Editor::handleKeypress(unsigned char scancode) {
+void Editor::handleKeypress(const KeyEvent& event) {
     // F2 - сохранение файла
-    if (scancode == 0x3C) {
+    if (event.key == KEY_F2) {
         saveFile();
         displayBuffer();
         return;
     }
     
     // Стрелка вверх
-    if (scancode == 0x48 && cursorLine > 0) {
+    if (event.key == KEY_UP && cursorLine > 0) {
         cursorLine--;
         if (cursorPos > strlen(buffer[cursorLine])) {
             cursorPos = strlen(buffer[cursorLine]);
@@ -153,7 +175,7 @@ void Editor::handleKeypress(unsigned char scancode) {
     }
     
     // Стрелка вниз
-    if (scancode == 0x50 && cursorLine < lineCount - 1) {
+    if (event.key == KEY_DOWN && cursorLine < lineCount - 1) {
         cursorLine++;
         if (cursorPos > strlen(buffer[cursorLine])) {
             cursorPos = strlen(buffer[cursorLine]);
@@ -163,21 +185,21 @@ void Editor::handleKeypress(unsigned char scancode) {
     }
     
     // Стрелка влево
-    if (scancode == 0x4B && cursorPos > 0) {
+    if (event.key == KEY_LEFT && cursorPos > 0) {
         cursorPos--;
         displayBuffer();
         return;
     }
     
     // Стрелка вправо
-    if (scancode == 0x4D && cursorPos < strlen(buffer[cursorLine])) {
+    if (event.key == KEY_RIGHT && cursorPos < strlen(buffer[cursorLine])) {
         cursorPos++;
         displayBuffer();
         return;
     }
     
     // Enter - новая строка
-    if (scancode == 0x1C) {
+    if (event.key == KEY_ENTER) {
         // Проверяем, не превышен ли лимит строк
         if (lineCount >= MAX_LINES) {
             return;
@@ -206,7 +228,7 @@ void Editor::handleKeypress(unsigned char scancode) {
     }
     
     // Backspace - удаление символа слева от курсора
-    if (scancode == 0x0E) {
+    if (event.key == KEY_BACKSPACE) {
         if (cursorPos > 0) {
             // Удаляем символ и сдвигаем текст
             for (int i = cursorPos - 1; i < strlen(buffer[cursorLine]); i++) {
@@ -232,7 +254,7 @@ void Editor::handleKeypress(unsigned char scancode) {
     }
     
     // Delete - удаление символа справа от курсора
-    if (scancode == 0x53) {
+    if (event.key == KEY_DELETE) {
         if (cursorPos < strlen(buffer[cursorLine])) {
             // Удаляем символ и сдвигаем текст
             for (int i = cursorPos; i < strlen(buffer[cursorLine]); i++) {
@@ -254,17 +276,16 @@ void Editor::handleKeypress(unsigned char scancode) {
         return;
     }
     
-    // Обычный символ
-    static const char scanToASCII[] = {
-        0, 0, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', 0,
-        0, 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', 0,
-        0, 'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`',
-        0, '\\', 'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/', 0,
-        '*', 0, ' '
-    };
-    
-    if (scancode < sizeof(scanToASCII) && scanToASCII[scancode]) {
-        insertChar(scanToASCII[scancode]);
+    // Home и End - начало и конец строки
+    if (event.key == KEY_HOME || event.key == KEY_END) {
+        cursorPos = (event.key == KEY_HOME) ? 0 : strlen(buffer[cursorLine]);
+        displayBuffer();
+        return;
+    }
+    
+    // Обычный символ (с учетом Shift и CapsLock)
+    if (event.ascii && !(event.modifiers & (MOD_CTRL | MOD_ALT))) {
+        insertChar(event.ascii);
         displayBuffer();
     }
 }
@@ -326,10 +347,37 @@ void Editor::saveFile() {
         }
     }
     
-    // Сохраняем файл
-    fs->writeFile(filename, content);
+    // Сохраняем файл: общее начало со старым содержимым не переписывается,
+    // поэтому правка в конце файла не трогает блоки перед ней
+    int length = strlen(content);
+    bool saved = false;
+    int fd = fileTable.open(filename, FileTable::OPEN_READ | FileTable::OPEN_WRITE | FileTable::OPEN_CREATE);
+    if (fd != -1) {
+        char old[512];
+        int from = 0;
+        int count;
+        int wanted = (length < (int)sizeof(old)) ? length : sizeof(old);
+        while (wanted > 0 && (count = fileTable.read(fd, old, wanted)) > 0) {
+            int same = 0;
+            while (same < count && old[same] == content[from + same]) {
+                same++;
+            }
+            from += same;
+            if (same < count) {
+                break;
+            }
+            wanted = (length - from < (int)sizeof(old)) ? length - from : sizeof(old);
+        }
+        saved = fileTable.pwrite(fd, content + from, length - from, from) != -1 &&
+                (fileTable.size(fd) == length || fileTable.truncate(fd, length));
+        fileTable.close(fd);
+    }
     
     // Отображаем сообщение о сохранении
     terminal->setCursor(0, terminal->getHeight() - 1);
-    terminal->writeColored("File saved successfully!", terminal->makeColor(VGA_COLOR_BLACK, VGA_COLOR_LIGHT_GREEN));
+    if (saved) {
+        terminal->writeColored("File saved successfully!", terminal->makeColor(VGA_COLOR_BLACK, VGA_COLOR_LIGHT_GREEN));
+    } else {
+        terminal->writeColored("Error: File was not saved!", terminal->makeColor(VGA_COLOR_BLACK, VGA_COLOR_LIGHT_RED));
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 class FileSystem;
 class Terminal;
+struct KeyEvent;
 
 class Editor {
 private:
@@ -14,13 +15,13 @@ private:
     int lineCount;
     int cursorLine;
     int cursorPos;
-    char filename[32];
+    char filename[256];
     Terminal* terminal;
     FileSystem* fs;
     
     void displayBuffer();
     void displayStatusLine();
-    void handleKeypress(unsigned char scancode);
+    void handleKeypress(const KeyEvent& event);
     void insertChar(char c);
     void deleteLine();
     void saveFile();
@@ -0,0 +1,156 @@
+// fd.cpp
+#include "fd.h"
+#include "filesystem.h"
+#include "terminal.h"
+
+extern Terminal terminal;
+
+void FileTable::initialize(FileSystem* fileSystem) {
+    fs = fileSystem;
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        openFiles[i].file = -1;
+    }
+    for (int t = 0; t < Scheduler::MAX_THREADS; t++) {
+        for (int i = 0; i < MAX_DESCRIPTORS; i++) {
+            descriptors[t][i] = -1;
+        }
+    }
+}
+
+// Открытый файл по номеру дескриптора текущего потока с проверкой режима
+FileTable::OpenFile* FileTable::lookup(int fd, int access) {
+    if (fd < 0 || fd >= MAX_DESCRIPTORS) {
+        return 0;
+    }
+    int slot = descriptors[scheduler.currentThread()][fd];
+    if (slot == -1 || (openFiles[slot].flags & access) != access) {
+        return 0;
+    }
+    return &openFiles[slot];
+}
+
+int FileTable::open(const char* path, int flags) {
+    if (!(flags & (OPEN_READ | OPEN_WRITE))) {
+        flags |= OPEN_READ;
+    }
+
+    // Свободные номер дескриптора и запись таблицы ищутся до открытия,
+    // чтобы не создать файл зря
+    signed char* table = descriptors[scheduler.currentThread()];
+    int fd = 0;
+    while (fd < MAX_DESCRIPTORS && table[fd] != -1) {
+        fd++;
+    }
+    int slot = 0;
+    while (slot < MAX_OPEN_FILES && openFiles[slot].file != -1) {
+        slot++;
+    }
+    if (fd == MAX_DESCRIPTORS || slot == MAX_OPEN_FILES) {
+        terminal.writeLineColored("Error: Too many open files.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return -1;
+    }
+
+    bool write = flags & OPEN_WRITE;
+    int file = fs->openFile(path, write, write && (flags & OPEN_CREATE));
+    if (file == -1) {
+        return -1;
+    }
+    if (write && (flags & OPEN_TRUNCATE) && !fs->truncateFile(file, 0)) {
+        return -1;
+    }
+
+    openFiles[slot].file = file;
+    openFiles[slot].offset = 0;
+    openFiles[slot].flags = flags;
+    table[fd] = slot;
+    return fd;
+}
+
+bool FileTable::close(int fd) {
+    if (!lookup(fd, 0)) {
+        return false;
+    }
+    signed char* table = descriptors[scheduler.currentThread()];
+    openFiles[table[fd]].file = -1;
+    table[fd] = -1;
+    return true;
+}
+
+void FileTable::closeAll(int thread) {
+    for (int i = 0; i < MAX_DESCRIPTORS; i++) {
+        if (descriptors[thread][i] != -1) {
+            openFiles[descriptors[thread][i]].file = -1;
+            descriptors[thread][i] = -1;
+        }
+    }
+}
+
+int FileTable::read(int fd, char* buffer, int length) {
+    OpenFile* entry = lookup(fd, OPEN_READ);
+    if (!entry || length < 0) {
+        return -1;
+    }
+    int done = fs->readData(entry->file, entry->offset, buffer, length);
+    entry->offset += done;
+    return done;
+}
+
+int FileTable::write(int fd, const char* data, int length) {
+    OpenFile* entry = lookup(fd, OPEN_WRITE);
+    if (!entry || length < 0) {
+        return -1;
+    }
+    if (entry->flags & OPEN_APPEND) {
+        entry->offset = fs->getFileSize(entry->file);
+    }
+    if (!fs->writeData(entry->file, entry->offset, data, length)) {
+        return -1;
+    }
+    entry->offset += length;
+    return length;
+}
+
+int FileTable::pread(int fd, char* buffer, int length, int offset) {
+    OpenFile* entry = lookup(fd, OPEN_READ);
+    if (!entry || length < 0 || offset < 0) {
+        return -1;
+    }
+    return fs->readData(entry->file, offset, buffer, length);
+}
+
+int FileTable::pwrite(int fd, const char* data, int length, int offset) {
+    OpenFile* entry = lookup(fd, OPEN_WRITE);
+    if (!entry || length < 0 || !fs->writeData(entry->file, offset, data, length)) {
+        return -1;
+    }
+    return length;
+}
+
+int FileTable::seek(int fd, int offset, SeekOrigin origin) {
+    OpenFile* entry = lookup(fd, 0);
+    if (!entry) {
+        return -1;
+    }
+    int base = 0;
+    if (origin == SEEK_FROM_CURRENT) {
+        base = entry->offset;
+    } else if (origin == SEEK_FROM_END) {
+        base = fs->getFileSize(entry->file);
+    }
+    // Позиция не должна переполнять int ни в одну сторону
+    if (offset > 0x7FFFFFFF - base || base + offset < 0) {
+        return -1;
+    }
+    entry->offset = base + offset;
+    return entry->offset;
+}
+
+bool FileTable::truncate(int fd, int size) {
+    OpenFile* entry = lookup(fd, OPEN_WRITE);
+    return entry && fs->truncateFile(entry->file, size);
+}
+
+int FileTable::size(int fd) {
+    OpenFile* entry = lookup(fd, 0);
+    return entry ? fs->getFileSize(entry->file) : -1;
+}
\ No newline at end of file
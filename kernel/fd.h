@@ -0,0 +1,77 @@
+// fd.h
+#ifndef FD_H
+#define FD_H
+
+#include "thread.h"
+
+class FileSystem;
+
+// Таблица дескрипторов файлов. Открытый файл хранит дескриптор записи
+// из FileSystem::findFile, режим и текущее смещение; у каждого потока
+// свои номера дескрипторов. Чтение и запись идут через readData и
+// writeData и затрагивают только свои байты, файл целиком не
+// переписывается.
+class FileTable {
+public:
+    static const int MAX_DESCRIPTORS = 16;      // На поток
+
+    enum OpenFlags {
+        OPEN_READ = 1 << 0,
+        OPEN_WRITE = 1 << 1,
+        OPEN_CREATE = 1 << 2,       // Создать отсутствующий файл
+        OPEN_TRUNCATE = 1 << 3,     // Очистить при открытии
+        OPEN_APPEND = 1 << 4        // write всегда пишет в конец
+    };
+
+    enum SeekOrigin {
+        SEEK_FROM_START,
+        SEEK_FROM_CURRENT,
+        SEEK_FROM_END
+    };
+
+private:
+    static const int MAX_OPEN_FILES = 64;
+
+    struct OpenFile {
+        int file;                   // Дескриптор FileSystem, -1 - свободно
+        int offset;
+        int flags;
+    };
+
+    FileSystem* fs;
+    OpenFile openFiles[MAX_OPEN_FILES];
+    signed char descriptors[Scheduler::MAX_THREADS][MAX_DESCRIPTORS];     // Номер в openFiles или -1
+
+    OpenFile* lookup(int fd, int access);
+
+public:
+    void initialize(FileSystem* fileSystem);
+
+    // Открытие по пути, возвращает номер дескриптора или -1. Ошибки
+    // (нет файла, каталог, только чтение) выводятся на экран.
+    int open(const char* path, int flags);
+    bool close(int fd);
+
+    // Дескрипторы завершившегося потока
+    void closeAll(int thread);
+
+    // Чтение и запись с текущего смещения, смещение сдвигается.
+    // Возвращают число байт (чтение в конце файла - 0) или -1.
+    int read(int fd, char* buffer, int length);
+    int write(int fd, const char* data, int length);
+
+    // Позиционные чтение и запись: смещение дескриптора не меняется,
+    // OPEN_APPEND на pwrite не действует
+    int pread(int fd, char* buffer, int length, int offset);
+    int pwrite(int fd, const char* data, int length, int offset);
+
+    // Новое смещение или -1; за конец файла переходить можно,
+    // пропуск заполнится нулями при записи
+    int seek(int fd, int offset, SeekOrigin origin);
+    bool truncate(int fd, int size);
+    int size(int fd);
+};
+
+extern FileTable fileTable;
+
+#endif
\ No newline at end of file
@@ -2,149 +2,570 @@
 #include "filesystem.h"
 #include "io.h"
 #include "terminal.h"
+#include "stream.h"
+#include "blocks.h"
+#include "memory.h"
+#include "bcache.h"
+#include "clock.h"
+#include "tar.h"
+#include "journal.h"
+#include "thread.h"
 
-// Инициализация файловой системы
-void FileSystem::initialize() {
-    // Устанавливаем корневой каталог
-    strcpy(currentPath, "/");
+// Хеш FNV-1a имени, затравкой служит номер родительского каталога
+unsigned int FileSystem::dentryHash(int parent, const char* name, int length) {
+    unsigned int hash = 2166136261u ^ (unsigned int)parent;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 16);
+}
+
+// Поиск записи в каталоге по индексу имен. Имя сравнивается только
+// при совпадении полного хеша.
+int FileSystem::lookup(int dir, const char* name, int length) {
+    unsigned int hash = dentryHash(dir, name, length);
+    for (unsigned int slot = hash & (INDEX_SIZE - 1); nameIndex[slot].file != -1;
+         slot = (slot + 1) & (INDEX_SIZE - 1)) {
+        int file = nameIndex[slot].file;
+        if (nameIndex[slot].hash == hash && files[file].parent == dir &&
+            strncmp(names[file], name, length) == 0 && names[file][length] == '\0') {
+            return file;
+        }
+    }
+    return -1;
+}
+
+// Добавление записи в индекс имен
+void FileSystem::indexInsert(int file) {
+    unsigned int slot = files[file].nameHash & (INDEX_SIZE - 1);
+    while (nameIndex[slot].file != -1) {
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+    nameIndex[slot].hash = files[file].nameHash;
+    nameIndex[slot].file = file;
+}
+
+// Удаление из индекса со сдвигом следующих ячеек назад, без "надгробий"
+void FileSystem::indexRemove(int file) {
+    unsigned int slot = files[file].nameHash & (INDEX_SIZE - 1);
+    while (nameIndex[slot].file != file) {
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
     
-    // Создаем несколько тестовых файлов и каталогов
-    fileCount = 6;
+    unsigned int next = slot;
+    while (true) {
+        next = (next + 1) & (INDEX_SIZE - 1);
+        if (nameIndex[next].file == -1) {
+            break;
+        }
+        
+        // Ячейку можно сдвинуть, если ее исходная позиция не лежит в (slot, next]
+        unsigned int home = nameIndex[next].hash & (INDEX_SIZE - 1);
+        bool between = (slot <= next) ? (slot < home && home <= next) : (slot < home || home <= next);
+        if (between) {
+            continue;
+        }
+        
+        nameIndex[slot] = nameIndex[next];
+        slot = next;
+    }
+    nameIndex[slot].file = -1;
+}
+
+// Создание записи в каталоге parent. Имя сразу попадает в дерево
+// автодополнения: без памяти под его узлы запись не создается.
+int FileSystem::createEntry(int parent, const char* name, bool isDirectory, bool isSystemFile) {
+    char key[CompletionTrie::MAX_WORD_LENGTH];
+    nameKey(parent, name, key);
+    if (freeList == -1 || !nameTrie.insert(key)) {
+        return -1;
+    }
     
-    strcpy(files[0].name, "bin");
-    files[0].isDirectory = true;
-    files[0].size = 0;
-    files[0].isSystemFile = true;
+    int index = freeList;
+    freeList = files[index].nextSibling;
     
-    strcpy(files[1].name, "home");
-    files[1].isDirectory = true;
-    files[1].size = 0;
-    files[1].isSystemFile = true;
+    File& file = files[index];
+    strcpy(names[index], name);
+    file.nameHash = dentryHash(parent, name, strlen(name));
+    file.used = true;
+    file.isDirectory = isDirectory;
+    file.isSystemFile = isSystemFile;
+    file.isArchived = false;
+    file.isCompressed = false;
+    file.firstExtent = -1;
+    file.size = 0;
+    file.firstChild = -1;
+    linkEntry(index, parent);
     
-    strcpy(files[2].name, "etc");
-    files[2].isDirectory = true;
-    files[2].size = 0;
-    files[2].isSystemFile = true;
+    indexInsert(index);
+    return index;
+}
+
+// Новая запись добавляется в конец каталога, чтобы ls сохранял порядок создания
+void FileSystem::linkEntry(int index, int parent) {
+    File& file = files[index];
+    file.parent = parent;
+    file.nextSibling = -1;
     
-    strcpy(files[3].name, "readme.txt");
-    files[3].isDirectory = false;
-    strcpy(files[3].content, "Welcome to OmarOS!\n\nThis is a simple operating system built with C++ and Assembly.\nIt provides basic shell commands and file operations.\n\nType 'help' to see available commands.");
-    files[3].size = strlen(files[3].content);
-    files[3].isSystemFile = true;
+    int first = files[parent].firstChild;
+    if (first == -1) {
+        files[parent].firstChild = index;
+        file.prevSibling = index;
+        touchFile(parent);
+    } else {
+        int last = files[first].prevSibling;
+        files[last].nextSibling = index;
+        file.prevSibling = last;
+        files[first].prevSibling = index;
+        touchFile(first);
+        touchFile(last);
+    }
+    touchFile(index);
+}
+
+// Исключение записи из списка ее каталога
+void FileSystem::unlinkEntry(int index) {
+    File& file = files[index];
+    File& parent = files[file.parent];
     
-    strcpy(files[4].name, "kernel.sys");
-    files[4].isDirectory = false;
-    strcpy(files[4].content, "This is a binary file and cannot be displayed properly.");
-    files[4].size = strlen(files[4].content);
-    files[4].isSystemFile = true;
+    int first = parent.firstChild;
+    if (index == first) {
+        parent.firstChild = file.nextSibling;
+        touchFile(file.parent);
+    } else {
+        files[file.prevSibling].nextSibling = file.nextSibling;
+        touchFile(file.prevSibling);
+    }
+    if (file.nextSibling != -1) {
+        files[file.nextSibling].prevSibling = file.prevSibling;
+        touchFile(file.nextSibling);
+    } else if (index != first) {
+        files[first].prevSibling = file.prevSibling;
+        touchFile(first);
+    }
+    touchFile(index);
+}
+
+// Удаление записи из каталога и хеш-таблицы за O(1): запись
+// освобождается на месте, остальные записи не сдвигаются
+void FileSystem::destroyEntry(int index) {
+    File& file = files[index];
+    unlinkEntry(index);
     
-    strcpy(files[5].name, "version");
-    files[5].isDirectory = false;
-    strcpy(files[5].content, "OmarOS v0.3\nBuild date: 2023-08-05\nAuthor: Omar");
-    files[5].size = strlen(files[5].content);
-    files[5].isSystemFile = true;
+    if (indexDocuments[index] != -1) {
+        textIndex.removeDocument(indexDocuments[index]);
+        indexDocuments[index] = -1;
+    }
+    indexStale[index / 32] &= ~(1u << (index % 32));
+    indexRemove(index);
+    char key[CompletionTrie::MAX_WORD_LENGTH];
+    nameKey(file.parent, names[index], key);
+    nameTrie.remove(key);
+    releaseBlocks(index, 0);
+    generations[index]++;
+    file.used = false;
+    file.nextSibling = freeList;
+    freeList = index;
 }
 
-// Смена текущего каталога
-void FileSystem::changeDirectory(const char* path) {
-    // Переход в корневой каталог
-    if (strcmp(path, "/") == 0) {
-        strcpy(currentPath, "/");
-        return;
+static_assert(BlockPool::MAX_BLOCKS == DISKFS_MAX_BLOCKS && BlockPool::BLOCK_SIZE == DISKFS_SECTOR_SIZE &&
+              BlockPool::BLOCKS_PER_GROUP == DISKFS_GROUP_BLOCKS, "block pool must match the disk format");
+
+static inline void setBit(unsigned int* map, int bit) {
+    map[bit / 32] |= 1u << (bit % 32);
+}
+
+static inline bool testBit(const unsigned int* map, int bit) {
+    return map[bit / 32] & (1u << (bit % 32));
+}
+
+// Пустое дерево из одного корня
+void FileSystem::resetTables() {
+    // Все записи, кроме корня, свободны
+    changes++;
+    freeList = -1;
+    for (int i = MAX_FILES - 1; i > ROOT; i--) {
+        files[i].used = false;
+        generations[i] = 0;
+        files[i].nextSibling = freeList;
+        freeList = i;
     }
+    for (int i = 0; i < INDEX_SIZE; i++) {
+        nameIndex[i].file = -1;
+    }
+    freeExtents = -1;
+    for (int i = MAX_EXTENTS - 1; i >= 0; i--) {
+        extents[i].next = freeExtents;
+        freeExtents = i;
+    }
+    nameTrie.clear();
+    resetIndex();
     
-    // Переход на уровень выше
-    if (strcmp(path, "..") == 0) {
-        // Находим последний слеш
-        int len = strlen(currentPath);
-        if (len <= 1) return; // Уже в корне
-        
-        int lastSlash = len - 1;
-        while (lastSlash > 0 && currentPath[lastSlash] != '/') {
-            lastSlash--;
+    // Корневой каталог - сам себе родитель, поэтому "/.." остается в корне
+    names[ROOT][0] = '\0';
+    generations[ROOT] = 0;
+    files[ROOT].nameHash = 0;
+    files[ROOT].used = true;
+    files[ROOT].isDirectory = true;
+    files[ROOT].isSystemFile = true;
+    files[ROOT].isArchived = false;
+    files[ROOT].isCompressed = false;
+    files[ROOT].size = 0;
+    files[ROOT].firstExtent = -1;
+    files[ROOT].parent = ROOT;
+    files[ROOT].firstChild = -1;
+    files[ROOT].prevSibling = ROOT;
+    files[ROOT].nextSibling = -1;
+    
+    currentDir = ROOT;
+    strcpy(currentPath, "/");
+}
+
+// Индекс имен и дерево автодополнения заново по таблице записей
+void FileSystem::buildNameIndex() {
+    for (int i = 0; i < INDEX_SIZE; i++) {
+        nameIndex[i].file = -1;
+    }
+    nameTrie.clear();
+    char key[CompletionTrie::MAX_WORD_LENGTH];
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (files[i].used && i != ROOT) {
+            files[i].nameHash = dentryHash(files[i].parent, names[i], strlen(names[i]));
+            indexInsert(i);
+            nameKey(files[i].parent, names[i], key);
+            nameTrie.insert(key);
         }
-        
-        // Если это не корневой каталог, обрезаем путь
-        if (lastSlash > 0) {
-            currentPath[lastSlash] = '\0';
-        } else {
-            // Если это корневой каталог, оставляем только "/"
-            currentPath[1] = '\0';
+    }
+}
+
+// Ключ каталога - номер записи по 7 бит в двух ненулевых байтах: слово
+// дерева остается обычной строкой
+void FileSystem::nameKey(int parent, const char* name, char* key) {
+    key[0] = (char)((parent >> 7) + 1);
+    key[1] = (char)((parent & 0x7F) + 1);
+    strcpy(key + COMPLETION_KEY_LENGTH, name);
+}
+
+int FileSystem::completionKey(const char* path, int length, char* key) {
+    int nameStart = length;
+    while (nameStart > 0 && path[nameStart - 1] != '/') {
+        nameStart--;
+    }
+    if (length - nameStart > MAX_NAME_LENGTH) {
+        return -1;
+    }
+
+    int dir = currentDir;
+    if (nameStart > 0) {
+        char dirPath[MAX_PATH_LENGTH];
+        if (nameStart >= MAX_PATH_LENGTH) {
+            return -1;
+        }
+        memcpy(dirPath, path, nameStart);
+        dirPath[nameStart] = '\0';
+        dir = findEntry(dirPath);
+        if (dir == -1 || !files[dir].isDirectory) {
+            return -1;
         }
-        return;
     }
+
+    char name[MAX_NAME_LENGTH + 1];
+    memcpy(name, path + nameStart, length - nameStart);
+    name[length - nameStart] = '\0';
+    nameKey(dir, name, key);
+    return COMPLETION_KEY_LENGTH + length - nameStart;
+}
+
+// Инициализация файловой системы в памяти
+void FileSystem::initialize() {
+    device = 0;
+    archiveCount = 0;
+    snapshotCount = 0;
+    chunkData = 0;
+    chunkStored = 0;
+    chunkFile = -1;
+    host = 0;
+    hostMount = -1;
+    changes = 0;
+    nameTrie.initialize();
+    textIndex.initialize();
+    for (int i = 0; i < MAX_FILES; i++) {
+        indexDocuments[i] = -1;
+    }
+    memset(summedBlocks, 0, sizeof(summedBlocks));
+    clearDirty();
+    createDefaultTree();
+}
+
+// Дерево без диска: стандартные каталоги и файлы подключенных архивов
+void FileSystem::createDefaultTree() {
+    resetTables();
+    createEntry(ROOT, "bin", true, true);
+    createEntry(ROOT, "home", true, true);
+    createEntry(ROOT, "etc", true, true);
     
-    // Проверяем, существует ли указанный каталог
-    for (int i = 0; i < fileCount; i++) {
-        if (strcmp(files[i].name, path) == 0 && files[i].isDirectory) {
-            // Добавляем каталог к текущему пути
-            int len = strlen(currentPath);
+    for (int i = 0; i < archiveCount; i++) {
+        loadArchive(archives[i]);
+    }
+}
+
+// Записи архива, которых на диске быть не должно, при записи на диск
+// пропускаются: соседи по каталогу ссылаются друг на друга в обход них
+int FileSystem::storedSibling(int index) {
+    while (index != -1 && files[index].isArchived) {
+        index = files[index].nextSibling;
+    }
+    return index;
+}
+
+// Предыдущая запись каталога на диске. Ссылки prevSibling замкнуты
+// в кольцо (у первой записи - последняя), поэтому у первой записи
+// на диске это последняя запись на диске.
+int FileSystem::storedPrev(int index) {
+    if (index == ROOT) {
+        return ROOT;
+    }
+    int prev = index;
+    do {
+        prev = files[prev].prevSibling;
+    } while (files[prev].isArchived && prev != index);
+    return prev;
+}
+
+int FileSystem::attachArchive(const char* data, unsigned int size) {
+    if (archiveCount == MAX_ARCHIVES) {
+        return -1;
+    }
+    archives[archiveCount].data = data;
+    archives[archiveCount].size = size;
+    return loadArchive(archives[archiveCount++]);
+}
+
+// Записи архива становятся записями дерева с флагом isArchived; файлы
+// ссылаются на свое содержимое в архиве, блоки под них не выделяются
+int FileSystem::loadArchive(const Archive& archive) {
+    TarReader reader(archive.data, archive.size);
+    TarEntry entry;
+    int count = 0;
+    while (reader.next(entry)) {
+        if (!entry.isDirectory && entry.size > 0x7FFFFFFF) {
+            continue;
+        }
+        
+        int dir = ROOT;
+        char* component = entry.path;
+        while (dir != -1) {
+            char* end = component;
+            while (*end && *end != '/') {
+                end++;
+            }
+            bool last = (*end == '\0');
+            *end = '\0';
+            if (!isValidFileName(component)) {
+                break;
+            }
             
-            // Если текущий путь не заканчивается на "/", добавляем его
-            if (currentPath[len - 1] != '/') {
-                currentPath[len] = '/';
-                len++;
+            int existing = lookup(dir, component, end - component);
+            if (!last || entry.isDirectory) {
+                // Каталог: общий с уже существующим или новый из архива
+                if (existing == -1) {
+                    existing = createEntry(dir, component, true, true);
+                    if (existing != -1) {
+                        files[existing].isArchived = true;
+                    }
+                } else if (!files[existing].isDirectory) {
+                    existing = -1;
+                }
+                dir = existing;
+                if (last) {
+                    break;
+                }
+                component = end + 1;
+                continue;
             }
             
-            // Добавляем имя каталога
-            strcpy(currentPath + len, path);
-            return;
+            if (existing == -1) {
+                int index = createEntry(dir, component, false, true);
+                if (index != -1) {
+                    files[index].isArchived = true;
+                    files[index].size = entry.size;
+                    archiveData[index] = entry.data;
+                    markStale(index);
+                    count++;
+                }
+            }
+            break;
         }
     }
+    return reader.isDamaged() ? -1 : count;
+}
+
+// Полный путь записи по ссылкам на родителей (буфер MAX_PATH_LENGTH)
+void FileSystem::buildPath(int index, char* path) {
+    // Каждый компонент занимает в пути не меньше двух символов
+    int chain[MAX_PATH_LENGTH / 2];
+    int depth = 0;
+    for (int dir = index; dir != ROOT && depth < MAX_PATH_LENGTH / 2; dir = files[dir].parent) {
+        chain[depth++] = dir;
+    }
     
-    // Каталог не найден
-    terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
-    terminal.writeLine(path);
+    strcpy(path, "/");
+    int len = 1;
+    for (int i = depth - 1; i >= 0; i--) {
+        int nameLen = strlen(names[chain[i]]);
+        if (len + nameLen + 1 >= MAX_PATH_LENGTH) {
+            break;
+        }
+        strcpy(path + len, names[chain[i]]);
+        len += nameLen;
+        if (i > 0) {
+            path[len++] = '/';
+            path[len] = '\0';
+        }
+    }
 }
 
-// Вывод списка файлов в текущем каталоге
-void FileSystem::listDirectory() {
+void FileSystem::updateCurrentPath() {
+    buildPath(currentDir, currentPath);
+}
+
+// Смена текущего каталога
+void FileSystem::changeDirectory(const char* path) {
+    int index = findEntry(path);
+    if (index == -1 || !files[index].isDirectory) {
+        terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    
+    currentDir = index;
+    updateCurrentPath();
+}
+
+// Вывод записей каталога dir из таблиц дерева или снимка
+void FileSystem::listEntries(const File* table, const char (*nameTable)[MAX_NAME_LENGTH + 1], const Extent* extentTable,
+                             int dir, OutputStream& out) {
     unsigned char dirColor = terminal.makeColor(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
     unsigned char fileColor = terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     unsigned char sysFileColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
     unsigned char sizeColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
     
-    for (int i = 0; i < fileCount; i++) {
-        if (files[i].isDirectory) {
-            terminal.writeColored("[DIR]  ", dirColor);
-            if (files[i].isSystemFile) {
-                terminal.writeColored(files[i].name, sysFileColor);
-                terminal.writeColored(" (system)", sysFileColor);
+    for (int i = table[dir].firstChild; i != -1; i = table[i].nextSibling) {
+        if (table[i].isDirectory) {
+            out.writeColored("[DIR]  ", dirColor);
+            if (table[i].isSystemFile) {
+                out.writeColored(nameTable[i], sysFileColor);
+                out.writeColored(" (system)", sysFileColor);
             } else {
-                terminal.writeColored(files[i].name, dirColor);
+                out.writeColored(nameTable[i], dirColor);
             }
-            terminal.writeLine("");
+            out.writeLine("");
         } else {
-            terminal.writeColored("[FILE] ", fileColor);
+            out.writeColored("[FILE] ", fileColor);
             
-            if (files[i].isSystemFile) {
-                terminal.writeColored(files[i].name, sysFileColor);
-                terminal.writeColored(" (system)", sysFileColor);
+            if (table[i].isSystemFile) {
+                out.writeColored(nameTable[i], sysFileColor);
+                out.writeColored(" (system)", sysFileColor);
             } else {
-                terminal.writeColored(files[i].name, fileColor);
+                out.writeColored(nameTable[i], fileColor);
             }
             
             // Выводим размер файла
             char sizeStr[16];
-            itoa(files[i].size, sizeStr, 10);
-            terminal.writeColored("  (", sizeColor);
-            terminal.writeColored(sizeStr, sizeColor);
-            terminal.writeColored(" bytes)", sizeColor);
-            terminal.writeLine("");
+            itoa(table[i].size, sizeStr, 10);
+            out.writeColored("  (", sizeColor);
+            out.writeColored(sizeStr, sizeColor);
+            if (table[i].isCompressed) {
+                // Для сжатого файла - еще и место, которое он занимает
+                int blocks = 0;
+                for (int e = table[i].firstExtent; e != -1; e = extentTable[e].next) {
+                    blocks += extentTable[e].count;
+                }
+                itoa(blocks * BlockPool::BLOCK_SIZE, sizeStr, 10);
+                out.writeColored(" bytes, ", sizeColor);
+                out.writeColored(sizeStr, sizeColor);
+                out.writeColored(" stored)", sizeColor);
+            } else {
+                out.writeColored(" bytes)", sizeColor);
+            }
+            out.writeLine("");
         }
     }
 }
 
+// Вывод списка файлов каталога (0 - текущего)
+void FileSystem::listDirectory(const char* path, OutputStream& out) {
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(path ? path : ".", rest)) {
+        listHost(rest, path ? path : ".", out);
+        return;
+    }
+    
+    int dir = path ? findEntry(path) : currentDir;
+    if (dir == -1 || !files[dir].isDirectory) {
+        terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    
+    listEntries(files, names, extents, dir, out);
+}
+
 // Получение текущего пути
 const char* FileSystem::getCurrentPath() {
     return currentPath;
 }
 
+// Разделение пути на каталог и последний компонент
+int FileSystem::resolveParent(const char* path, const char*& leaf) {
+    const char* slash = 0;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') {
+            slash = p;
+        }
+    }
+    
+    if (!slash) {
+        leaf = path;
+        return currentDir;
+    }
+    
+    leaf = slash + 1;
+    if (slash == path) {
+        return ROOT;
+    }
+    
+    char dirPath[MAX_PATH_LENGTH];
+    int length = slash - path;
+    if (length >= MAX_PATH_LENGTH) {
+        return -1;
+    }
+    strncpy(dirPath, path, length);
+    dirPath[length] = '\0';
+    
+    int dir = findEntry(dirPath);
+    return (dir != -1 && files[dir].isDirectory) ? dir : -1;
+}
+
 // Создание нового каталога
-void FileSystem::createDirectory(const char* name) {
-    // Проверяем, не превышен ли лимит файлов
-    if (fileCount >= MAX_FILES) {
-        terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+void FileSystem::createDirectory(const char* path) {
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(path, rest)) {
+        createHost(rest, path, true);
+        return;
+    }
+    
+    const char* name;
+    int parent = resolveParent(path, name);
+    if (parent == -1) {
+        terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    
+    if (files[parent].isArchived) {
+        terminal.writeLineColored("Error: Read-only file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         return;
     }
     
@@ -155,27 +576,39 @@ void FileSystem::createDirectory(const char* name) {
     }
     
     // Проверяем, не существует ли уже файл с таким именем
-    if (findFile(name) != -1) {
+    if (lookup(parent, name, strlen(name)) != -1) {
         terminal.writeLineColored("Error: File or directory already exists.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         return;
     }
     
     // Создаем новый каталог
-    strcpy(files[fileCount].name, name);
-    files[fileCount].isDirectory = true;
-    files[fileCount].size = 0;
-    files[fileCount].isSystemFile = false;
-    fileCount++;
+    if (createEntry(parent, name, true, false) == -1) {
+        terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
     
     terminal.writeColored("Directory created: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
-    terminal.writeLine(name);
+    terminal.writeLine(path);
 }
 
 // Создание нового файла
-void FileSystem::createFile(const char* name) {
-    // Проверяем, не превышен ли лимит файлов
-    if (fileCount >= MAX_FILES) {
-        terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+void FileSystem::createFile(const char* path) {
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(path, rest)) {
+        createHost(rest, path, false);
+        return;
+    }
+    
+    const char* name;
+    int parent = resolveParent(path, name);
+    if (parent == -1) {
+        terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    
+    if (files[parent].isArchived) {
+        terminal.writeLineColored("Error: Read-only file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         return;
     }
     
@@ -186,27 +619,31 @@ void FileSystem::createFile(const char* name) {
     }
     
     // Проверяем, не существует ли уже файл с таким именем
-    if (findFile(name) != -1) {
+    if (lookup(parent, name, strlen(name)) != -1) {
         terminal.writeLineColored("Error: File or directory already exists.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         return;
     }
     
     // Создаем новый файл
-    strcpy(files[fileCount].name, name);
-    files[fileCount].isDirectory = false;
-    files[fileCount].content[0] = '\0';
-    files[fileCount].size = 0;
-    files[fileCount].isSystemFile = false;
-    fileCount++;
+    if (createEntry(parent, name, false, false) == -1) {
+        terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
     
     terminal.writeColored("File created: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
-    terminal.writeLine(name);
+    terminal.writeLine(path);
 }
 
 // Удаление файла или каталога
 void FileSystem::remove(const char* path) {
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(path, rest)) {
+        removeHost(rest, path);
+        return;
+    }
+    
     // Находим файл
-    int index = findFile(path);
+    int index = findEntry(path);
     
     if (index == -1) {
         terminal.writeColored("Error: File or directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
@@ -220,25 +657,37 @@ void FileSystem::remove(const char* path) {
         terminal.writeLine(path);
         return;
     }
-    // Удаляем файл, сдвигая все последующие
-    for (int i = index; i < fileCount - 1; i++) {
-        strcpy(files[i].name, files[i+1].name);
-        files[i].isDirectory = files[i+1].isDirectory;
-        strcpy(files[i].content, files[i+1].content);
-        files[i].size = files[i+1].size;
-        files[i].isSystemFile = files[i+1].isSystemFile;
+    
+    // Каталог удаляется только пустым
+    if (files[index].isDirectory && files[index].firstChild != -1) {
+        terminal.writeColored("Error: Directory not empty: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    
+    // Текущий каталог удалять нельзя
+    if (index == currentDir) {
+        terminal.writeColored("Error: Cannot remove current directory: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
     }
     
-    fileCount--;
+    destroyEntry(index);
     
     terminal.writeColored("Removed: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
     terminal.writeLine(path);
 }
 
 // Чтение содержимого файла
-void FileSystem::readFile(const char* name) {
+void FileSystem::readFile(const char* name, OutputStream& out) {
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(name, rest)) {
+        readHost(rest, name, out);
+        return;
+    }
+    
     // Находим файл
-    int index = findFile(name);
+    int index = findEntry(name);
     
     if (index == -1) {
         terminal.writeColored("Error: File not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
@@ -254,83 +703,711 @@ void FileSystem::readFile(const char* name) {
         return;
     }
     
-    // Выводим содержимое файла
-    terminal.writeLineColored("--- File content ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
-    terminal.writeLine(files[index].content);
-    terminal.writeLineColored("--- End of file ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    // Рамку выводим только на экран, в канал и файл идет чистое содержимое
+    if (out.isInteractive()) {
+        out.writeLineColored("--- File content ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    }
+    
+    // Содержимое в памяти передается по ссылке, по экстенту за раз;
+    // с диска - копией, по блоку за раз
+    int handle = makeHandle(index);
+    bool resident = isResident(handle);
+    FileInputStream input(this, handle);
+    const char* data;
+    int length;
+    while (!scheduler.checkpoint() && (length = input.read(data)) > 0) {
+        if (resident) {
+            out.writeRef(data, length);
+        } else {
+            out.write(data, length);
+        }
+    }
+    
+    if (out.isInteractive()) {
+        out.writeLine("");
+        out.writeLineColored("--- End of file ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    }
 }
 
-// Запись в файл
+// Запись в файл; файл сразу переиндексируется
 void FileSystem::writeFile(const char* name, const char* content) {
-    // Находим файл
-    int index = findFile(name);
+    if (storeFile(name, content, strlen(content), false)) {
+        int index = findEntry(name);
+        if (index != -1 && !indexFile(index)) {
+            markStale(index);
+        }
+        terminal.writeColored("File updated: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+    }
+}
+
+// Запись или дозапись данных в файл без сообщения об успехе
+bool FileSystem::storeFile(const char* name, const char* data, int length, bool append) {
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(name, rest)) {
+        return storeHost(rest, name, data, length, append);
+    }
+    
+    int handle = openFile(name, true, true);
+    if (handle == -1) {
+        return false;
+    }
+    
+    // Записываем содержимое
+    int offset = append ? getFileSize(handle) : 0;
+    if (!append) {
+        truncateFile(handle, 0);
+    }
+    if (!writeData(handle, offset, data, length)) {
+        terminal.writeLineColored("Error: Not enough memory for file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    return true;
+}
+
+// Дескриптор файла по пути с проверками для чтения или записи
+int FileSystem::openFile(const char* name, bool write, bool create) {
+    // Иначе файл создался бы в дереве под точкой подключения
+    char rest[MAX_PATH_LENGTH];
+    if (hostPath(name, rest)) {
+        terminal.writeColored("Error: Host files must be copied into the tree first: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return -1;
+    }
+    
+    int index = findEntry(name);
     
     if (index == -1) {
+        if (!create) {
+            terminal.writeColored("Error: File not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(name);
+            return -1;
+        }
+        
         // Если файл не существует, создаем его
-        if (fileCount >= MAX_FILES) {
-            terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
-            return;
+        const char* leaf;
+        int parent = resolveParent(name, leaf);
+        if (parent == -1) {
+            terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(name);
+            return -1;
+        }
+        
+        if (files[parent].isArchived) {
+            terminal.writeLineColored("Error: Read-only file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return -1;
         }
         
-        if (!isValidFileName(name)) {
+        if (!isValidFileName(leaf)) {
             terminal.writeLineColored("Error: Invalid file name.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
-            return;
+            return -1;
         }
         
-        index = fileCount++;
-        strcpy(files[index].name, name);
-        files[index].isDirectory = false;
-        files[index].isSystemFile = false;
+        index = createEntry(parent, leaf, false, false);
+        if (index == -1) {
+            terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return -1;
+        }
     } else if (files[index].isDirectory) {
         terminal.writeColored("Error: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         terminal.writeColored(name, terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         terminal.writeLineColored(" is a directory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
-        return;
-    } else if (files[index].isSystemFile) {
+        return -1;
+    } else if (write && files[index].isSystemFile) {
         terminal.writeColored("Error: Cannot modify system file: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
         terminal.writeLine(name);
-        return;
+        return -1;
+    }
+    return makeHandle(index);
+}
+
+// Получение размера файла
+int FileSystem::getFileSize(int handle) {
+    int fileIndex = resolve(handle);
+    if (fileIndex == -1 || files[fileIndex].isDirectory) {
+        return 0;
+    }
+    
+    return files[fileIndex].size;
+}
+
+// Выделение блоков, чтобы в файл поместилось size байт. Новые блоки
+// по возможности продолжают последний экстент.
+bool FileSystem::reserveBlocks(int file, int size) {
+    int needed = (size + BlockPool::BLOCK_SIZE - 1) / BlockPool::BLOCK_SIZE;
+    int have = 0;
+    int last = -1;
+    for (int e = files[file].firstExtent; e != -1; e = extents[e].next) {
+        have += extents[e].count;
+        last = e;
     }
     
-    // Проверяем размер содержимого
-    int contentSize = strlen(content);
-    if (contentSize >= MAX_FILE_SIZE) {
-        terminal.writeLineColored("Error: Content too large for file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    while (have < needed) {
+        int hint = (last == -1) ? -1 : extents[last].start + extents[last].count;
+        int allocated;
+        int start = blockPool.allocate(needed - have, hint, allocated);
+        if (start == -1) {
+            return false;
+        }
+        forgetSums(start, allocated);
+        touchBitmap(start, allocated);
+        
+        // Экстент не переходит границу группы: в памяти группы не смежны
+        if (last != -1 && start == hint && hint % BlockPool::BLOCKS_PER_GROUP != 0) {
+            extents[last].count += allocated;
+            touchExtent(last);
+        } else {
+            if (freeExtents == -1) {
+                blockPool.release(start, allocated);
+                return false;
+            }
+            
+            int e = freeExtents;
+            freeExtents = extents[e].next;
+            extents[e].start = start;
+            extents[e].count = allocated;
+            extents[e].next = -1;
+            touchExtent(e);
+            if (last == -1) {
+                files[file].firstExtent = e;
+                touchFile(file);
+            } else {
+                extents[last].next = e;
+                touchExtent(last);
+            }
+            last = e;
+        }
+        have += allocated;
+    }
+    return true;
+}
+
+// Возврат участка блоков в пул. Блоки, на которые ссылаются снимки,
+// остаются занятыми, и их буферы в кэше сохраняются.
+void FileSystem::dropBlocks(int start, int count) {
+    // Общие блоки проверяются до возврата: он может снять последнюю
+    // лишнюю ссылку, и блок останется занятым при пустом счетчике
+    bool shared = blockPool.hasShared();
+    blockPool.release(start, count);
+    touchBitmap(start, count);
+    if (!device) {
+        return;
+    }
+    if (!shared) {
+        bufferCache.discard(device, superblock.dataStart + start, count);
         return;
     }
+    for (int block = start; block < start + count;) {
+        if (blockPool.isUsed(block)) {
+            block++;
+            continue;
+        }
+        int run = block;
+        while (block < start + count && !blockPool.isUsed(block)) {
+            block++;
+        }
+        bufferCache.discard(device, superblock.dataStart + run, block - run);
+    }
+}
+
+// Копирование содержимого count смежных блоков вместе с их суммами
+bool FileSystem::copyBlocks(int from, int to, int count) {
+    if (!device) {
+        memcpy(blockPool.address(to), blockPool.address(from), count * BlockPool::BLOCK_SIZE);
+        copySums(from, to, count);
+        return true;
+    }
     
-    // Записываем содержимое
-    strcpy(files[index].content, content);
-    files[index].size = contentSize;
+    // Буфер источника может быть вытеснен при получении буфера приемника
+    char block[BlockPool::BLOCK_SIZE];
+    for (int i = 0; i < count; i++) {
+        const char* source = bufferCache.get(device, superblock.dataStart + from + i, BufferCache::ACCESS_READ);
+        if (!source) {
+            return false;
+        }
+        memcpy(block, source, BlockPool::BLOCK_SIZE);
+        char* target = bufferCache.get(device, superblock.dataStart + to + i, BufferCache::ACCESS_OVERWRITE);
+        if (!target) {
+            return false;
+        }
+        memcpy(target, block, BlockPool::BLOCK_SIZE);
+    }
+    copySums(from, to, count);
+    return true;
+}
+
+// Свободный экстент, -1 - таблица заполнена
+int FileSystem::allocExtent(int start, int count, int next) {
+    if (freeExtents == -1) {
+        return -1;
+    }
+    int e = freeExtents;
+    freeExtents = extents[e].next;
+    extents[e].start = start;
+    extents[e].count = count;
+    extents[e].next = next;
+    touchExtent(e);
+    return e;
+}
+
+// Copy-on-write перед записью в байты [from, to): общие со снимками
+// блоки этого участка заменяются копиями. Экстент делится так, что
+// копируется только задетая часть; при любой ошибке файл остается
+// целым, часть блоков просто остается общей.
+bool FileSystem::unshareBlocks(int file, int from, int to) {
+    int first = from / BlockPool::BLOCK_SIZE;
+    int last = (to + BlockPool::BLOCK_SIZE - 1) / BlockPool::BLOCK_SIZE;
     
-    terminal.writeColored("File updated: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
-    terminal.writeLine(name);
+    int base = 0;   // Номер блока файла в начале экстента
+    for (int e = files[file].firstExtent; e != -1 && base < last; e = extents[e].next) {
+        Extent& extent = extents[e];
+        int a = (first > base) ? first - base : 0;
+        int b = (last - base < extent.count) ? last - base : extent.count;
+        base += extent.count;
+        
+        bool shared = false;
+        for (int i = a; i < b && !shared; i++) {
+            shared = blockPool.isShared(extent.start + i);
+        }
+        if (!shared) {
+            continue;
+        }
+        
+        // Хвост и начало экстента, которые не задеты, отделяются
+        if (b < extent.count) {
+            int tail = allocExtent(extent.start + b, extent.count - b, extent.next);
+            if (tail == -1) {
+                return false;
+            }
+            extent.next = tail;
+            extent.count = b;
+            touchExtent(e);
+        }
+        if (a > 0) {
+            int middle = allocExtent(extent.start + a, b - a, extent.next);
+            if (middle == -1) {
+                return false;
+            }
+            extent.next = middle;
+            extent.count = a;
+            touchExtent(e);
+            e = middle;
+        }
+        
+        // Задетая часть переезжает в новые блоки, возможно несколькими участками
+        int remaining = b - a;
+        int hint = -1;
+        while (true) {
+            Extent& part = extents[e];
+            int allocated;
+            int start = blockPool.allocate(part.count, hint, allocated);
+            if (start == -1) {
+                return false;
+            }
+            forgetSums(start, allocated);
+            if (allocated < part.count) {
+                int rest = allocExtent(part.start + allocated, part.count - allocated, part.next);
+                if (rest == -1) {
+                    blockPool.release(start, allocated);
+                    return false;
+                }
+                part.next = rest;
+                part.count = allocated;
+            }
+            if (!copyBlocks(part.start, start, allocated)) {
+                blockPool.release(start, allocated);
+                return false;
+            }
+            touchBitmap(start, allocated);
+            dropBlocks(part.start, allocated);
+            part.start = start;
+            touchExtent(e);
+            hint = start + allocated;
+            remaining -= allocated;
+            if (remaining == 0) {
+                break;
+            }
+            e = part.next;
+        }
+    }
+    return true;
+}
+
+// Освобождение блоков за пределами первых size байт
+void FileSystem::releaseBlocks(int file, int size) {
+    int keep = (size + BlockPool::BLOCK_SIZE - 1) / BlockPool::BLOCK_SIZE;
+    
+    int previous = -1;
+    int* link = &files[file].firstExtent;
+    while (*link != -1) {
+        Extent& extent = extents[*link];
+        if (keep >= extent.count) {
+            keep -= extent.count;
+            previous = *link;
+            link = &extent.next;
+            continue;
+        }
+        
+        dropBlocks(extent.start + keep, extent.count - keep);
+        extent.count = keep;
+        if (keep == 0) {
+            // Экстент целиком возвращается в список свободных
+            int e = *link;
+            *link = extent.next;
+            extent.next = freeExtents;
+            freeExtents = e;
+            if (previous == -1) {
+                touchFile(file);
+            } else {
+                touchExtent(previous);
+            }
+        } else {
+            touchExtent(*link);
+            previous = *link;
+            link = &extent.next;
+        }
+        keep = 0;
+    }
 }
 
-// Получение содержимого файла
-const char* FileSystem::getFileContent(int fileIndex) {
-    if (fileIndex < 0 || fileIndex >= fileCount || files[fileIndex].isDirectory) {
-        return "";
+// Адрес байта offset и число байт, доступных по этому адресу подряд:
+// в памяти - до конца экстента, на диске - до конца буфера кэша,
+// в архиве - до конца файла. В block - номер блока пула с этим байтом
+// (-1 для архива).
+char* FileSystem::locate(int file, int offset, int& available, int& block, BufferCache::Access access) {
+    if (files[file].isArchived) {
+        available = files[file].size - offset;
+        block = -1;
+        return (char*)archiveData[file] + offset;
     }
     
-    return files[fileIndex].content;
+    for (int e = files[file].firstExtent; e != -1; e = extents[e].next) {
+        int extentSize = extents[e].count * BlockPool::BLOCK_SIZE;
+        if (offset >= extentSize) {
+            offset -= extentSize;
+            continue;
+        }
+        
+        block = extents[e].start + offset / BlockPool::BLOCK_SIZE;
+        if (!device) {
+            available = extentSize - offset;
+            return blockPool.address(extents[e].start) + offset;
+        }
+        
+        char* buffer = bufferCache.get(device, superblock.dataStart + block, access);
+        available = buffer ? BlockPool::BLOCK_SIZE - offset % BlockPool::BLOCK_SIZE : 0;
+        return buffer ? buffer + offset % BlockPool::BLOCK_SIZE : 0;
+    }
+    available = 0;
+    block = -1;
+    return 0;
 }
 
-// Поиск файла по имени
-int FileSystem::findFile(const char* name) {
-    for (int i = 0; i < fileCount; i++) {
-        if (strcmp(files[i].name, name) == 0) {
-            return i;
+// Упреждающее чтение участка с диска: отсутствующие в кэше блоки всех
+// экстентов участка уходят устройству одним пакетом. Возвращает конец
+// прочитанного участка (кольцо кэша вмещает не весь участок).
+int FileSystem::prefetch(int file, int offset, int length) {
+    int end = (offset + length < files[file].size) ? offset + length : files[file].size;
+    if (end <= offset) {
+        return offset;
+    }
+    int first = offset / BlockPool::BLOCK_SIZE;
+    int last = (end - 1) / BlockPool::BLOCK_SIZE;
+    int covered = offset;
+    int block = 0;                  // Номер в файле первого блока экстента
+    for (int e = files[file].firstExtent; e != -1 && block <= last; e = extents[e].next) {
+        int from = (first > block) ? first : block;
+        int to = (last + 1 < block + extents[e].count) ? last + 1 : block + extents[e].count;
+        if (from < to) {
+            int done = bufferCache.queueRead(device, superblock.dataStart + extents[e].start + (from - block), to - from);
+            covered = (from + done) * BlockPool::BLOCK_SIZE;
+            if (done < to - from) {
+                break;
+            }
         }
+        block += extents[e].count;
     }
-    return -1;
+    bufferCache.submitReads(device);
+    return (covered < end) ? covered : end;
+}
+
+// Чтение по смещению, возвращает число прочитанных байт
+int FileSystem::readData(int file, int offset, char* buffer, int length) {
+    // С диска участок больше блока читается пакетами, а не по блоку
+    int index = resolve(file);
+    bool batched = device && index != -1 && offset >= 0 && !files[index].isArchived && !files[index].isCompressed;
+    int prefetched = offset;
+    
+    int done = 0;
+    const char* data;
+    int chunk;
+    while (done < length) {
+        if (batched && offset + done >= prefetched && length - done > BlockPool::BLOCK_SIZE) {
+            prefetched = prefetch(index, offset + done, length - done);
+            batched = prefetched > offset + done;
+        }
+        if ((chunk = contiguous(file, offset + done, length - done, data)) <= 0) {
+            break;
+        }
+        if (chunk > length - done) {
+            chunk = length - done;
+        }
+        memcpy(buffer + done, data, chunk);
+        done += chunk;
+    }
+    return done;
+}
+
+// Запись по смещению с ростом файла
+bool FileSystem::writeData(int handle, int offset, const char* data, int length) {
+    int fileIndex = resolve(handle);
+    if (fileIndex == -1 || files[fileIndex].isDirectory || files[fileIndex].isArchived || offset < 0 || length < 0) {
+        return false;
+    }
+    // Конец записи должен помещаться в int
+    if (length > 0x7FFFFFFF - offset) {
+        return false;
+    }
+    
+    if (files[fileIndex].isCompressed && !expandFile(fileIndex)) {
+        return false;
+    }
+    
+    File& file = files[fileIndex];
+    int end = offset + length;
+    if (end > file.size && !reserveBlocks(fileIndex, end)) {
+        releaseBlocks(fileIndex, file.size);
+        return false;
+    }
+    
+    // Пропуск между концом файла и offset заполняется нулями
+    int pos = (file.size < offset) ? file.size : offset;
+    if (blockPool.hasShared() && !unshareBlocks(fileIndex, pos, end)) {
+        return false;
+    }
+    while (pos < end) {
+        // Блок, который перезаписывается целиком или лежит за концом
+        // файла, не нужно читать с диска
+        int blockStart = pos - pos % BlockPool::BLOCK_SIZE;
+        bool overwrite = (pos == blockStart && end - pos >= BlockPool::BLOCK_SIZE) || blockStart >= file.size;
+        
+        int available;
+        int block;
+        char* target = locate(fileIndex, pos, available, block, overwrite ? BufferCache::ACCESS_OVERWRITE : BufferCache::ACCESS_WRITE);
+        if (!target) {
+            return false;
+        }
+        int chunk = (available < end - pos) ? available : end - pos;
+        
+        if (pos < offset) {
+            if (chunk > offset - pos) {
+                chunk = offset - pos;
+            }
+            memset(target, 0, chunk);
+        } else if (data) {
+            memcpy(target, data + (pos - offset), chunk);
+        } else {
+            memset(target, 0, chunk);
+        }
+        
+        // Суммы всех задетых блоков пересчитываются целиком
+        const char* blockData = target - pos % BlockPool::BLOCK_SIZE;
+        for (int i = 0; i * BlockPool::BLOCK_SIZE < pos % BlockPool::BLOCK_SIZE + chunk; i++) {
+            sealBlock(block + i, blockData + i * BlockPool::BLOCK_SIZE);
+        }
+        pos += chunk;
+    }
+    
+    if (end > file.size) {
+        file.size = end;
+        touchFile(fileIndex);
+    }
+    markStale(fileIndex);
+    return true;
+}
+
+// Изменение размера файла: лишние блоки освобождаются, новые байты - нули
+bool FileSystem::truncateFile(int handle, int size) {
+    int fileIndex = resolve(handle);
+    if (fileIndex == -1 || files[fileIndex].isDirectory || files[fileIndex].isArchived || size < 0) {
+        return false;
+    }
+    
+    if (size > files[fileIndex].size) {
+        return writeData(handle, files[fileIndex].size, 0, size - files[fileIndex].size);
+    }
+    
+    // Сжатый файл, от которого ничего не остается, распаковывать незачем
+    if (files[fileIndex].isCompressed) {
+        if (size == 0) {
+            files[fileIndex].isCompressed = false;
+        } else if (!expandFile(fileIndex)) {
+            return false;
+        }
+    }
+    
+    releaseBlocks(fileIndex, size);
+    files[fileIndex].size = size;
+    touchFile(fileIndex);
+    markStale(fileIndex);
+    return true;
+}
+
+// Непрерывный участок содержимого
+int FileSystem::getContiguous(int handle, int offset, const char*& data) {
+    return contiguous(handle, offset, 0x7FFFFFFF, data);
+}
+
+// Участок не длиннее limit: без диска каждый выданный блок сверяется с
+// суммой, и короткое чтение не проверяет весь экстент
+int FileSystem::contiguous(int handle, int offset, int limit, const char*& data) {
+    int fileIndex = resolve(handle);
+    if (fileIndex == -1 || files[fileIndex].isDirectory || offset < 0 || offset >= files[fileIndex].size) {
+        return 0;
+    }
+    
+    // Сжатый файл - по фрагменту, распакованному в буфер
+    int remaining = files[fileIndex].size - offset;
+    if (files[fileIndex].isCompressed) {
+        int chunk = offset / DISKFS_CHUNK_SIZE;
+        if (chunkFile != handle || chunkIndex != chunk) {
+            chunkFile = -1;
+            if (unpackChunk(extents, files[fileIndex], chunk) < 0) {
+                return 0;
+            }
+            chunkFile = handle;
+            chunkIndex = chunk;
+        }
+        data = chunkData + offset % DISKFS_CHUNK_SIZE;
+        int available = DISKFS_CHUNK_SIZE - offset % DISKFS_CHUNK_SIZE;
+        return (available < remaining) ? available : remaining;
+    }
+    
+    int available;
+    int block;
+    data = locate(fileIndex, offset, available, block, BufferCache::ACCESS_READ);
+    int length = (available < remaining) ? available : remaining;
+    if (!device && block != -1 && data) {
+        length = verifyResident(block, offset % BlockPool::BLOCK_SIZE, (length < limit) ? length : limit);
+    }
+    return length;
+}
+
+bool FileSystem::isResident(int handle) {
+    int fileIndex = resolve(handle);
+    return fileIndex != -1 && !files[fileIndex].isCompressed && (!device || files[fileIndex].isArchived);
+}
+
+bool FileSystem::detachContent(const char* path, Pipe& pipe) {
+    int index = findEntry(path);
+    if (index == -1 || files[index].isDirectory || !isResident(makeHandle(index))) {
+        return true;
+    }
+    
+    bool copied = true;
+    if (files[index].isArchived) {
+        copied = pipe.copyRefs(archiveData[index], files[index].size);
+    } else {
+        // Экстент не пересекает границу группы и лежит в памяти подряд
+        for (int e = files[index].firstExtent; e != -1 && copied; e = extents[e].next) {
+            copied = pipe.copyRefs(blockPool.address(extents[e].start), extents[e].count * BlockPool::BLOCK_SIZE);
+        }
+    }
+    if (!copied) {
+        terminal.writeLineColored("Error: Not enough memory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    }
+    return copied;
+}
+
+int FileInputStream::read(const char*& data) {
+    int length = fs->getContiguous(file, offset, data);
+    
+    // Буфер кэша может быть вытеснен следующим же обращением к диску,
+    // фрагмент сжатого файла длиннее блока копируется по частям
+    if (length > 0 && !fs->isResident(file)) {
+        if (length > (int)sizeof(chunk)) {
+            length = sizeof(chunk);
+        }
+        memcpy(chunk, data, length);
+        data = chunk;
+    }
+    offset += length;
+    return length;
+}
+
+// Проверка, является ли запись каталогом
+bool FileSystem::isDirectory(int handle) {
+    int fileIndex = resolve(handle);
+    return fileIndex != -1 && files[fileIndex].isDirectory;
+}
+
+// Поиск записи по пути: по одному обращению к хеш-таблице на компонент
+int FileSystem::findEntry(const char* path) {
+    int index = (*path == '/') ? ROOT : currentDir;
+    
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+        if (*path == '\0') {
+            break;
+        }
+        
+        const char* component = path;
+        while (*path && *path != '/') {
+            path++;
+        }
+        int length = path - component;
+        
+        // Внутри файла искать нечего
+        if (!files[index].isDirectory) {
+            return -1;
+        }
+        
+        if (length == 1 && component[0] == '.') {
+            continue;
+        }
+        if (length == 2 && component[0] == '.' && component[1] == '.') {
+            index = files[index].parent;
+            continue;
+        }
+        
+        index = lookup(index, component, length);
+        if (index == -1) {
+            return -1;
+        }
+    }
+    return index;
+}
+
+// Дескриптор для вызывающих: запись плюс поколение
+int FileSystem::findFile(const char* path) {
+    int index = findEntry(path);
+    return (index == -1) ? -1 : makeHandle(index);
+}
+
+// Номер записи по дескриптору, -1 - дескриптор устарел
+int FileSystem::resolve(int handle) {
+    if (handle < 0) {
+        return -1;
+    }
+    int index = handle & (MAX_FILES - 1);
+    if (!files[index].used || generations[index] != (unsigned int)handle >> INDEX_BITS) {
+        return -1;
+    }
+    return index;
 }
 
 // Проверка корректности имени файла
 bool FileSystem::isValidFileName(const char* name) {
     // Проверяем длину имени
     int len = strlen(name);
-    if (len == 0 || len > 31) {
+    if (len == 0 || len > MAX_NAME_LENGTH) {
+        return false;
+    }
+    
+    // "." и ".." зарезервированы для навигации
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
         return false;
     }
     
@@ -348,11 +1425,402 @@ bool FileSystem::isValidFileName(const char* name) {
     return true;
 }
 
-// Поиск файлов и директорий для автодополнения
-void FileSystem::findMatches(const char* prefix, int prefixLen, char matches[][32], int& matchCount, int maxMatches) {
-    for (int i = 0; i < fileCount && matchCount < maxMatches; i++) {
-        if (strncmp(prefix, files[i].name, prefixLen) == 0) {
-            strcpy(matches[matchCount++], files[i].name);
+
+// Учет изменений для sync. Без диска отметки просто накапливаются.
+void FileSystem::clearDirty() {
+    memset(dirtyInodes, 0, sizeof(dirtyInodes));
+    memset(dirtyExtents, 0, sizeof(dirtyExtents));
+    memset(dirtyBitmap, 0, sizeof(dirtyBitmap));
+}
+
+// Связи вокруг записи архива хранят на диске ее соседи и родитель.
+// В каталоге из архива все записи из архива, на диске хранить нечего.
+void FileSystem::touchFile(int index) {
+    changes++;
+    if (files[index].isArchived) {
+        int parent = files[index].parent;
+        if (files[parent].isArchived) {
+            return;
+        }
+        setBit(dirtyInodes, parent);
+        for (int i = files[parent].firstChild; i != -1; i = files[i].nextSibling) {
+            if (!files[i].isArchived) {
+                setBit(dirtyInodes, i);
+            }
+        }
+        return;
+    }
+    setBit(dirtyInodes, index);
+}
+
+void FileSystem::touchExtent(int extent) {
+    setBit(dirtyExtents, extent);
+}
+
+// Выделение или освобождение блоков меняет секторы карты блоков
+// Точка прерывания долгого обхода дерева или блоков (Scheduler::
+// checkpoint). false - поток прерван, или пока работали другие потоки,
+// дерево изменилось, и продолжать обход по старым ссылкам нельзя.
+bool FileSystem::checkpoint() {
+    unsigned int seen = changes;
+    return !scheduler.checkpoint() && changes == seen;
+}
+
+void FileSystem::touchBitmap(int start, int count) {
+    changes++;
+    for (int sector = start / DISKFS_BITS_PER_SECTOR; sector <= (start + count - 1) / DISKFS_BITS_PER_SECTOR; sector++) {
+        setBit(dirtyBitmap, sector);
+    }
+}
+
+// Монтирование файловой системы с диска
+bool FileSystem::mount(BlockDevice* disk) {
+    char* buffer = (char*)pageAllocator.allocPage();
+    if (!buffer) {
+        terminal.writeLineColored("Error: Not enough memory to mount disk.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    if (!disk->read(0, 1, buffer)) {
+        pageAllocator.freePage(buffer);
+        terminal.writeLineColored("Error: Cannot read disk.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    memcpy(&superblock, buffer, sizeof(superblock));
+    
+    if (superblock.magic != DISKFS_MAGIC ||
+        (superblock.version != DISKFS_VERSION && superblock.version != DISKFS_VERSION_NO_JOURNAL)) {
+        pageAllocator.freePage(buffer);
+        terminal.writeLineColored("Disk is not formatted, files are kept in memory only.", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    // Таблицы на диске должны совпадать с таблицами в памяти
+    if (superblock.inodeCount != MAX_FILES || superblock.extentCount != MAX_EXTENTS ||
+        superblock.dataBlocks > (unsigned int)BlockPool::MAX_BLOCKS ||
+        superblock.bitmapSectors * DISKFS_BITS_PER_SECTOR < superblock.dataBlocks ||
+        superblock.dataStart + superblock.dataBlocks > disk->getSectorCount()) {
+        pageAllocator.freePage(buffer);
+        terminal.writeLineColored("Error: Unsupported disk layout.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    // Дерево в памяти заменяется содержимым диска, снимки ссылаются на
+    // блоки в памяти и пропадают вместе с ним
+    while (snapshotCount > 0) {
+        destroySnapshot(snapshotCount - 1);
+    }
+    chunkFile = -1;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (files[i].used) {
+            releaseBlocks(i, 0);
+        }
+    }
+    resetTables();
+    
+    // Содержимое файлов остается на диске и читается через кэш, пул
+    // только учитывает занятые блоки
+    blockPool.detachMemory();
+    blockPool.setLimit(superblock.dataBlocks);
+    device = disk;
+    memset(summedBlocks, 0, sizeof(summedBlocks));
+    bufferCache.setReadCheck(checkSector, this);
+    
+    // Сначала повтор журнала, потом чтение таблиц
+    bool loaded = journal.open(disk, superblock) && loadDisk(buffer);
+    pageAllocator.freePage(buffer);
+    if (!loaded) {
+        journal.close();
+        terminal.writeLineColored("Error: File system on disk is damaged.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        blockPool.initialize();
+        device = 0;
+        createDefaultTree();
+        clearDirty();
+        return false;
+    }
+    lastWriteBack = clockSeconds();
+    lastCommit = lastWriteBack;
+    
+    // Архивы поверх дерева с диска; сами записи архива на диск не попадают
+    for (int i = 0; i < archiveCount; i++) {
+        loadArchive(archives[i]);
+    }
+    clearDirty();
+    return true;
+}
+
+// Чтение таблиц, проверка ссылок и занятие блоков файлов в пуле.
+// До занятия блоков все проверки уже пройдены, поэтому при ошибке
+// достаточно вернуть занятые блоки.
+bool FileSystem::loadDisk(char* buffer) {
+    const int batch = PageAllocator::PAGE_SIZE / DISKFS_SECTOR_SIZE;
+    
+    for (unsigned int sector = 0; sector < superblock.inodeSectors; sector += batch) {
+        if (!device->read(superblock.inodeStart + sector, batch, buffer)) {
+            return false;
+        }
+        const DiskInode* inodes = (const DiskInode*)buffer;
+        for (int j = 0; j < batch * DISKFS_INODES_PER_SECTOR; j++) {
+            int index = sector * DISKFS_INODES_PER_SECTOR + j;
+            const DiskInode& inode = inodes[j];
+            File& file = files[index];
+            if (!(inode.flags & DISKFS_USED)) {
+                file.used = false;
+                continue;
+            }
+            
+            if (inode.parent < 0 || inode.parent >= MAX_FILES ||
+                inode.firstChild < -1 || inode.firstChild >= MAX_FILES ||
+                inode.prevSibling < -1 || inode.prevSibling >= MAX_FILES ||
+                inode.nextSibling < -1 || inode.nextSibling >= MAX_FILES ||
+                inode.firstExtent < -1 || inode.firstExtent >= MAX_EXTENTS ||
+                inode.size < 0 || inode.name[DISKFS_NAME_LENGTH - 1] != '\0') {
+                return false;
+            }
+            
+            file.used = true;
+            file.isArchived = false;
+            file.isDirectory = inode.flags & DISKFS_DIRECTORY;
+            file.isSystemFile = inode.flags & DISKFS_SYSTEM;
+            file.isCompressed = inode.flags & DISKFS_COMPRESSED;
+            file.parent = inode.parent;
+            file.firstChild = inode.firstChild;
+            file.prevSibling = inode.prevSibling;
+            file.nextSibling = inode.nextSibling;
+            file.size = inode.size;
+            file.firstExtent = inode.firstExtent;
+            memcpy(names[index], inode.name, DISKFS_NAME_LENGTH);
+        }
+    }
+    
+    for (unsigned int sector = 0; sector < superblock.extentSectors; sector += batch) {
+        if (!device->read(superblock.extentStart + sector, batch, buffer)) {
+            return false;
+        }
+        const DiskExtent* table = (const DiskExtent*)buffer;
+        for (int j = 0; j < batch * DISKFS_EXTENTS_PER_SECTOR; j++) {
+            Extent& extent = extents[sector * DISKFS_EXTENTS_PER_SECTOR + j];
+            extent.start = table[j].start;
+            extent.count = table[j].count;
+            extent.next = table[j].next;
+        }
+    }
+    
+    if (!files[ROOT].used || !files[ROOT].isDirectory) {
+        return false;
+    }
+    files[ROOT].parent = ROOT;
+    names[ROOT][0] = '\0';
+    
+    // Цепочки экстентов: в пределах диска, внутри одной группы, без общих
+    // экстентов. Занятые экстенты отмечаются в буфере.
+    unsigned int* seen = (unsigned int*)buffer;
+    memset(seen, 0, MAX_EXTENTS / 8);
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!files[i].used) {
+            continue;
+        }
+        if (i != ROOT && (!files[files[i].parent].used || !files[files[i].parent].isDirectory ||
+                          !isValidFileName(names[i]))) {
+            return false;
+        }
+        
+        int blocks = 0;
+        for (int e = files[i].firstExtent; e != -1; e = extents[e].next) {
+            if (e < 0 || e >= MAX_EXTENTS || testBit(seen, e)) {
+                return false;
+            }
+            const Extent& extent = extents[e];
+            if (extent.count <= 0 || extent.start < 0 ||
+                extent.start + extent.count > (int)superblock.dataBlocks ||
+                extent.start / DISKFS_GROUP_BLOCKS != (extent.start + extent.count - 1) / DISKFS_GROUP_BLOCKS) {
+                return false;
+            }
+            setBit(seen, e);
+            blocks += extent.count;
+        }
+        if ((files[i].size > blocks * BlockPool::BLOCK_SIZE && !files[i].isCompressed) ||
+            (files[i].isDirectory && (files[i].firstExtent != -1 || files[i].isCompressed))) {
+            return false;
+        }
+    }
+    
+    // Списки свободных записей и экстентов, индекс имен
+    freeList = -1;
+    for (int i = MAX_FILES - 1; i > ROOT; i--) {
+        if (!files[i].used) {
+            files[i].nextSibling = freeList;
+            freeList = i;
+        }
+    }
+    freeExtents = -1;
+    for (int e = MAX_EXTENTS - 1; e >= 0; e--) {
+        if (!testBit(seen, e)) {
+            extents[e].count = 0;
+            extents[e].next = freeExtents;
+            freeExtents = e;
+        }
+    }
+    
+    buildNameIndex();
+    
+    int failed = -1;
+    for (int e = 0; e < MAX_EXTENTS && failed == -1; e++) {
+        if (testBit(seen, e) && !blockPool.reserve(extents[e].start, extents[e].count)) {
+            failed = e;
+        }
+    }
+    if (failed != -1) {
+        for (int e = 0; e < failed; e++) {
+            if (testBit(seen, e)) {
+                blockPool.release(extents[e].start, extents[e].count);
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+// Место для нового содержимого сектора метаданных: копия в транзакции
+// журнала или, без журнала, буфер кэша
+char* FileSystem::metadataSector(unsigned int sector) {
+    if (journal.isEnabled()) {
+        return journal.add(sector);
+    }
+    return bufferCache.get(device, sector, BufferCache::ACCESS_OVERWRITE);
+}
+
+// Перенос измененных секторов таблицы инодов или экстентов
+bool FileSystem::storeTable(unsigned int start, int sectors, const unsigned int* dirty, int perSector, bool extentTable) {
+    for (int sector = 0; sector < sectors; sector++) {
+        bool changed = false;
+        for (int i = 0; i < perSector && !changed; i++) {
+            changed = testBit(dirty, sector * perSector + i);
+        }
+        if (!changed) {
+            continue;
+        }
+        
+        char* target = metadataSector(start + sector);
+        if (!target) {
+            return false;
+        }
+        memset(target, 0, DISKFS_SECTOR_SIZE);
+        for (int i = 0; i < perSector; i++) {
+            int index = sector * perSector + i;
+            if (extentTable) {
+                DiskExtent& extent = ((DiskExtent*)target)[i];
+                extent.start = extents[index].start;
+                extent.count = extents[index].count;
+                extent.next = extents[index].next;
+                continue;
+            }
+            
+            DiskInode& inode = ((DiskInode*)target)[i];
+            const File& file = files[index];
+            if (!file.used || file.isArchived) {
+                continue;
+            }
+            strcpy(inode.name, names[index]);
+            inode.parent = file.parent;
+            inode.firstChild = storedSibling(file.firstChild);
+            inode.prevSibling = storedPrev(index);
+            inode.nextSibling = storedSibling(file.nextSibling);
+            inode.size = file.size;
+            inode.firstExtent = file.firstExtent;
+            inode.flags = DISKFS_USED | (file.isDirectory ? DISKFS_DIRECTORY : 0) | (file.isSystemFile ? DISKFS_SYSTEM : 0) |
+                          (file.isCompressed ? DISKFS_COMPRESSED : 0);
         }
     }
+    return true;
+}
+
+// Все измененные метаданные по возрастанию номеров секторов (так их
+// принимает журнал): иноды, экстенты, карта блоков
+bool FileSystem::storeMetadata() {
+    if (!storeTable(superblock.inodeStart, superblock.inodeSectors, dirtyInodes, DISKFS_INODES_PER_SECTOR, false) ||
+        !storeTable(superblock.extentStart, superblock.extentSectors, dirtyExtents, DISKFS_EXTENTS_PER_SECTOR, true)) {
+        return false;
+    }
+    
+    for (unsigned int sector = 0; sector < superblock.bitmapSectors; sector++) {
+        if (!testBit(dirtyBitmap, sector)) {
+            continue;
+        }
+        unsigned int* target = (unsigned int*)metadataSector(superblock.bitmapStart + sector);
+        if (!target) {
+            return false;
+        }
+        memset(target, 0, DISKFS_SECTOR_SIZE);
+        for (int i = 0; i < DISKFS_BITS_PER_SECTOR; i++) {
+            int bit = sector * DISKFS_BITS_PER_SECTOR + i;
+            if (bit < (int)superblock.dataBlocks && blockPool.isUsed(bit)) {
+                setBit(target, i);
+            }
+        }
+    }
+    return true;
+}
+
+// Транзакция журнала из всех накопленных изменений метаданных. Данные
+// уходят на диск раньше нее, поэтому после сбоя таблицы не ссылаются
+// на незаписанные блоки. Без журнала метаданные просто остаются в кэше.
+// Отметки изменений снимаются только после успеха: транзакция, которая
+// не дошла до диска, соберется заново при следующей попытке.
+bool FileSystem::commit() {
+    lastCommit = clockSeconds();
+    if (!journal.isEnabled()) {
+        if (!storeMetadata()) {
+            return false;
+        }
+        clearDirty();
+        return true;
+    }
+    
+    journal.begin();
+    if (!storeMetadata()) {
+        return false;
+    }
+    if (journal.getCount() > 0 &&
+        !(bufferCache.writeBack(device, 0, superblock.dataStart, superblock.totalSectors) &&
+          device->flush() &&
+          journal.commit())) {
+        return false;
+    }
+    clearDirty();
+    return true;
+}
+
+// Запись на диск: сначала данные, затем метаданные, чтобы таблицы
+// не ссылались на незаписанные блоки
+bool FileSystem::sync() {
+    if (!device) {
+        return true;
+    }
+    
+    return commit() &&
+           bufferCache.writeBack(device, 0, superblock.dataStart, superblock.totalSectors) &&
+           bufferCache.writeBack(device, 0, 0, superblock.dataStart) &&
+           device->flush();
+}
+
+// Отложенная запись: не чаще раза в секунду на диск уходят буферы,
+// измененные больше WRITEBACK_AGE секунд назад
+bool FileSystem::writeBack() {
+    if (!device) {
+        return true;
+    }
+    
+    unsigned int now = clockSeconds();
+    if (now == lastWriteBack) {
+        return true;
+    }
+    lastWriteBack = now;
+    
+    // Изменения за WRITEBACK_AGE секунд уходят в журнал одной транзакцией
+    if (clockElapsed(lastCommit, now) >= WRITEBACK_AGE && !commit()) {
+        return false;
+    }
+    return bufferCache.writeBack(device, WRITEBACK_AGE, superblock.dataStart, superblock.totalSectors) &&
+           bufferCache.writeBack(device, WRITEBACK_AGE, 0, superblock.dataStart);
 }
\ No newline at end of file
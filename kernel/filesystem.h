@@ -2,48 +2,427 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
+#include "trie.h"
+#include "stream.h"
+#include "blocks.h"
+#include "blockdev.h"
+#include "diskfs.h"
+#include "bcache.h"
+#include "journal.h"
+#include "textindex.h"
+
 class Terminal;
+class Virtio9p;
+class HostInputStream;
 extern Terminal terminal;
 
 class FileSystem {
 private:
     static const int MAX_PATH_LENGTH = 256;
-    static const int MAX_FILES = 64;
-    static const int MAX_FILE_SIZE = 4096;
-    static const int SYSTEM_FILES = 6; // Количество системных файлов, которые нельзя удалять
+    static const int MAX_FILES = 16384;
+    static const int INDEX_BITS = 14;       // MAX_FILES == 1 << INDEX_BITS
+    static const int MAX_EXTENTS = 32768;
+    static const int MAX_NAME_LENGTH = 31;
+    static const int INDEX_SIZE = 32768;    // Степень двойки, вдвое больше MAX_FILES
+    static const int ROOT = 0;              // Корневой каталог всегда занимает запись 0
+    static const unsigned int WRITEBACK_AGE = 5;    // Секунд до отложенной записи
+    static const int MAX_ARCHIVES = 4;
+    static const int MAX_SNAPSHOTS = 8;
     
+    // Горячие метаданные (32 байта): все, что нужно для поиска и обхода
+    // каталогов. Имена и содержимое хранятся отдельно и читаются только
+    // после совпадения хеша.
     struct File {
-        char name[32];
-        bool isDirectory;
-        char content[MAX_FILE_SIZE];
+        unsigned int nameHash;      // dentryHash(parent, name)
+        int parent;
+        int firstChild;
+        int prevSibling;            // У первой записи каталога - последняя запись
+        int nextSibling;            // Для свободных записей - следующая свободная
         int size;
-        bool isSystemFile;
+        int firstExtent;            // Список экстентов содержимого, -1 - файл пуст
+        bool used : 1;
+        bool isDirectory : 1;
+        bool isSystemFile : 1;
+        bool isArchived : 1;        // Из архива: только чтение, на диск не попадает
+        bool isCompressed : 1;      // В блоках сжатые фрагменты (формат в diskfs.h)
+    };
+    
+    // Экстент - участок смежных блоков из пула
+    struct Extent {
+        int start;
+        int count;
+        int next;                   // Следующий экстент файла или свободный
+    };
+    
+    // Ячейка индекса имен с открытой адресацией, file == -1 - пусто
+    struct IndexSlot {
+        unsigned int hash;
+        int file;
     };
     
     char currentPath[MAX_PATH_LENGTH];
+    int currentDir;
     File files[MAX_FILES];
-    int fileCount;
+    char names[MAX_FILES][MAX_NAME_LENGTH + 1];
+    unsigned short generations[MAX_FILES];  // Растет при каждом освобождении записи
+    int freeList;
+    
+    // Растет при любом изменении записей или блоков: долгий обход,
+    // уступавший процессор другим потокам, по нему узнает, что дерево
+    // под ним могло измениться
+    unsigned int changes;
+    
+    // Содержимое файлов из архивов - прямо в памяти модуля загрузчика
+    const char* archiveData[MAX_FILES];
+    
+    // Подключенные архивы: после монтирования диска они подключаются заново
+    struct Archive {
+        const char* data;
+        unsigned int size;
+    };
+    Archive archives[MAX_ARCHIVES];
+    int archiveCount;
+    
+    // Индекс (родитель, имя) -> запись с линейным пробированием:
+    // поиск одного компонента пути не зависит от числа файлов
+    IndexSlot nameIndex[INDEX_SIZE];
+    
+    Extent extents[MAX_EXTENTS];
+    int freeExtents;
+    
+    // Имена файлов для автодополнения, обновляются при создании и удалении.
+    // Слово в дереве - ключ каталога и имя (nameKey), поэтому совпадения
+    // по ключу - только записи одного каталога.
+    CompletionTrie nameTrie;
+    static_assert(MAX_FILES <= CompletionTrie::MAX_WORDS, "every name must fit in the completion trie");
+    
+    // Снимок дерева - копии таблиц записей, имен и экстентов. Блоки
+    // данных общие с деревом (пул считает ссылки), запись в общий блок
+    // сначала копирует его.
+    struct Snapshot {
+        char name[MAX_NAME_LENGTH + 1];
+        char* memory;               // Таблицы в смежных страницах
+        File* files;
+        char (*names)[MAX_NAME_LENGTH + 1];
+        Extent* extents;
+        int freeList;
+        int freeExtents;
+        int fileCount;
+        unsigned int created;       // clockSeconds()
+    };
+    static const unsigned int SNAPSHOT_PAGES = ((sizeof(File) + MAX_NAME_LENGTH + 1) * MAX_FILES +
+                                                sizeof(Extent) * MAX_EXTENTS + 4095) / 4096;
+    Snapshot snapshots[MAX_SNAPSHOTS];
+    int snapshotCount;
+    
+    // Последний распакованный фрагмент сжатого файла и буфер для его
+    // сжатого вида. Страницы выделяются при первом обращении.
+    char* chunkData;
+    char* chunkStored;
+    int chunkFile;              // Дескриптор, -1 - фрагмента нет
+    int chunkIndex;
+    
+    // Полнотекстовый индекс: документ каждого файла (-1 - нет) и файлы,
+    // измененные после индексации
+    TextIndex textIndex;
+    int indexDocuments[MAX_FILES];
+    unsigned int indexStale[MAX_FILES / 32];
+    
+    // Контрольные суммы CRC32C блоков данных. Сумма пересчитывается после
+    // каждой записи в блок и сверяется, когда блок читается с диска. На
+    // диске сумм нет: после монтирования сумма блока запоминается при
+    // первом чтении, новые блоки получают ее при записи.
+    unsigned int blockSums[BlockPool::MAX_BLOCKS];
+    unsigned int summedBlocks[BlockPool::MAX_BLOCKS / 32];
+    
+    // Диск с файловой системой (0 - только память) и метаданные, еще не
+    // перенесенные в кэш: записи, экстенты и секторы карты блоков.
+    // Измененные данные файлов учитывает сам кэш.
+    BlockDevice* device;
+    DiskSuperblock superblock;
+    unsigned int dirtyInodes[MAX_FILES / 32];
+    unsigned int dirtyExtents[MAX_EXTENTS / 32];
+    unsigned int dirtyBitmap[BlockPool::MAX_BLOCKS / DISKFS_BITS_PER_SECTOR / 32];
+    unsigned int lastWriteBack;
+    unsigned int lastCommit;
+    Journal journal;
+    
+    // Каталог хоста (virtio-9p), подключенный к пустому каталогу дерева:
+    // пути в точку подключения и глубже обслуживает хост, а не дерево
+    Virtio9p* host;
+    int hostMount;              // Дескриптор каталога точки подключения
+    
+    // Сторона копирования между хостом и деревом: путь от корня хоста
+    // или путь в дереве
+    struct HostEnd {
+        bool host;
+        char path[MAX_PATH_LENGTH];
+    };
+    static unsigned int dentryHash(int parent, const char* name, int length);
+    int lookup(int dir, const char* name, int length);
+    int findEntry(const char* path);
+    int makeHandle(int index) { return index | (generations[index] << INDEX_BITS); }
+    int resolve(int handle);
+    int resolveParent(const char* path, const char*& leaf);
+    int createEntry(int parent, const char* name, bool isDirectory, bool isSystemFile);
+    void destroyEntry(int index);
+    void linkEntry(int index, int parent);
+    void unlinkEntry(int index);
+    void indexInsert(int file);
+    void indexRemove(int file);
+    bool reserveBlocks(int file, int size);
+    char* locate(int file, int offset, int& available, int& block, BufferCache::Access access);
+    int prefetch(int file, int offset, int length);
+    void releaseBlocks(int file, int size);
+    void dropBlocks(int start, int count);
+    bool copyBlocks(int from, int to, int count);
+    int allocExtent(int start, int count, int next);
+    bool unshareBlocks(int file, int from, int to);
+    bool allocChunkBuffers();
+    int readStored(const Extent* table, int firstExtent, int offset, char* buffer, int length);
+    int contiguous(int file, int offset, int limit, const char*& data);
+    int unpackChunk(const Extent* table, const File& file, int chunk);
+    bool replaceContent(int file, const char* data, int length);
+    bool expandFile(int file);
+    int findPlainFile(const char* path);
+    void buildPath(int index, char* path);
+    void updateCurrentPath();
+    static void listEntries(const File* table, const char (*nameTable)[MAX_NAME_LENGTH + 1], const Extent* extentTable,
+                            int dir, OutputStream& out);
+    void resetTables();
+    void buildNameIndex();
+    static void nameKey(int parent, const char* name, char* key);
+    void createDefaultTree();
+    int loadArchive(const Archive& archive);
+    int storedSibling(int index);
+    int storedPrev(int index);
+    void clearDirty();
+    void touchFile(int index);
+    void touchExtent(int extent);
+    void touchBitmap(int start, int count);
+    bool loadDisk(char* buffer);
+    char* metadataSector(unsigned int sector);
+    bool storeTable(unsigned int start, int sectors, const unsigned int* dirty, int perSector, bool extentTable);
+    bool storeMetadata();
+    bool commit();
+    int findSnapshot(const char* name);
+    int snapshotEntry(const Snapshot& snapshot, const char* path);
+    void destroySnapshot(int index);
+    bool shareTree(const File* table, const Extent* extentTable);
+    void markStale(int index);
+    void resetIndex();
+    bool indexFile(int index);
+    bool compactIndex();
+    bool refreshIndex();
+    bool matchPhrase(int handle, TextIndex::Cursor* cursors, bool* active, const int* lengths, int count);
+    void sealBlock(int block, const char* data);
+    void forgetSums(int start, int count);
+    void copySums(int from, int to, int count);
+    bool checkBlock(int block, const char* data);
+    int verifyResident(int block, int skip, int length);
+    static bool checkSector(void* context, BlockDevice* disk, unsigned int sector, const char* data);
+    
+    // Итоги проверки целостности
+    struct CheckReport {
+        unsigned int files;
+        unsigned int referenced;    // Блоков, на которые есть ссылки
+        unsigned int verified;
+        unsigned int fresh;         // Суммы еще не было, запомнена
+        unsigned int mismatched;
+        unsigned int unreadable;
+        unsigned int leaked;        // Занят в пуле, ссылок нет
+        unsigned int missing;       // Ссылки есть, в пуле свободен
+        unsigned int badShares;
+        unsigned int badExtents;
+        int shown;                  // Выведено сообщений о блоках
+        bool interrupted;           // Ctrl+C или дерево изменилось во время проверки
+    };
+    static void countReferences(const File* table, const Extent* extentTable, int limit,
+                                unsigned char* references, CheckReport& report);
+    bool checkpoint();
+    void reportBlock(int block, const char* problem, CheckReport& report, OutputStream& out);
+    void scrubBlock(int block, const char* data, CheckReport& report, OutputStream& out);
+    bool scrubDisk(const unsigned char* references, CheckReport& report, OutputStream& out);
+    int resolveTarget(int source, const char* path, const char*& name);
+    bool isInside(int index, int dir);
+    bool cloneContent(int source, int copy);
+    int copyEntry(int source, int parent, const char* name);
+    bool hostPath(const char* path, char* rest);
+    void reportHostError(const char* path);
+    void listHost(const char* rest, const char* path, OutputStream& out);
+    void readHost(const char* rest, const char* path, OutputStream& out);
+    bool storeHost(const char* rest, const char* path, const char* data, int length, bool append);
+    void createHost(const char* rest, const char* path, bool isDirectory);
+    void removeHost(const char* rest, const char* path);
+    bool copyHostFile(const HostEnd& from, const HostEnd& to, char* buffer, int size);
+    bool copyHostTree(HostEnd& from, HostEnd& to, bool isDirectory, char* buffer, int size, int depth);
+    bool copyHost(const char* from, const char* fromRest, bool fromHost,
+                  const char* to, const char* toRest, bool toHost, bool recursive);
+    bool moveHost(const char* from, const char* fromRest, bool fromHost,
+                  const char* to, const char* toRest, bool toHost);
 
 public:
     void initialize();
     void changeDirectory(const char* path);
-    void listDirectory();
+    void listDirectory(const char* path, OutputStream& out);
     const char* getCurrentPath();
     
-    // Методы для работы с файлами
-    void createDirectory(const char* name);
-    void createFile(const char* name);
+    // Методы для работы с файлами. Пути могут быть абсолютными или
+    // относительными, с компонентами "." и ".."
+    void createDirectory(const char* path);
+    void createFile(const char* path);
     void remove(const char* path);
-    void readFile(const char* name);
-    void writeFile(const char* name, const char* content);
-    const char* getFileContent(int fileIndex);
+    void readFile(const char* path, OutputStream& out);
+    void writeFile(const char* path, const char* content);
+    bool storeFile(const char* path, const char* data, int length, bool append);
+    
+    // Копирование без копирования содержимого: копия получает свои
+    // экстенты на те же блоки, как снимок, и запись в любой из файлов
+    // сначала копирует задетые блоки. Перемещение только переносит
+    // запись в другой каталог или меняет имя. Если to - существующий
+    // каталог, запись попадает в него под прежним именем. Ошибки
+    // выводятся на экран.
+    bool copyPath(const char* from, const char* to, bool recursive);
+    bool movePath(const char* from, const char* to);
+    
+    // Дескриптор файла по пути (см. ниже) для чтения или записи; при create
+    // отсутствующий файл создается. Ошибки выводятся на экран, тогда -1.
+    int openFile(const char* path, bool write, bool create);
     
-    // Вспомогательные методы
-    int findFile(const char* name);
+    // Методы ниже принимают дескриптор из findFile: номер записи и ее
+    // поколение. После удаления файла дескриптор устаревает, и вызовы
+    // с ним ведут себя как для несуществующего файла, даже если запись
+    // уже занята другим файлом.
+    int getFileSize(int file);
+    bool isDirectory(int file);
+    
+    // Доступ к содержимому по смещению в байтах. Запись за концом файла
+    // дополняет пропуск нулями, data == 0 записывает нули.
+    int readData(int file, int offset, char* buffer, int length);
+    bool writeData(int file, int offset, const char* data, int length);
+    bool truncateFile(int file, int size);
+    
+    // Непрерывный участок содержимого с данного смещения (без копирования),
+    // возвращает его длину, 0 - конец файла. Для файловой системы на диске
+    // это буфер кэша, действительный до следующего обращения к файлам.
+    int getContiguous(int file, int offset, const char*& data);
+    
+    // Вспомогательные методы. findFile возвращает дескриптор или -1.
+    int findFile(const char* path);
     bool isValidFileName(const char* name);
     
-    // Метод для автодополнения
-    void findMatches(const char* prefix, int prefixLen, char matches[][32], int& matchCount, int maxMatches);
+    // Содержимое лежит в памяти по постоянному адресу (файловая система
+    // в памяти или архив): указатель из getContiguous можно хранить
+    bool isResident(int file);
+    
+    // Перед перезаписью файла его содержимое, переданное в канал по
+    // ссылке (cat f > f), копируется в страницы канала. false - не
+    // хватило памяти (сообщение выведено).
+    bool detachContent(const char* path, Pipe& pipe);
+    
+    // Сжатие содержимого файла фрагментами LZ4 и обратно. Сжатый файл
+    // читается как обычный, распаковывается только нужный фрагмент;
+    // запись в сжатый файл сначала распаковывает его целиком.
+    bool compressFile(const char* path);
+    bool decompressFile(const char* path);
+    
+    // Поиск файлов, содержащих все слова запроса (phrase - подряд, как
+    // фраза). Слова - буквы, цифры, '_' и байты UTF-8, регистр ASCII не
+    // важен. Измененные файлы переиндексируются перед поиском.
+    void searchText(const char* const* words, int count, bool phrase, OutputStream& out);
+    void printIndexStats(OutputStream& out);
+    
+    // Проверка целостности: ссылки экстентов дерева и снимков сверяются
+    // с пулом блоков (занятость и счетчики ссылок), содержимое каждого
+    // блока - с его контрольной суммой. Диск сначала синхронизируется,
+    // затем блоки читаются мимо кэша пакетами. Ничего не исправляет;
+    // false - найдены ошибки.
+    bool checkIntegrity(OutputStream& out);
+    
+    // Подключение архива ustar из памяти поверх дерева, только для чтения.
+    // Существующие каталоги объединяются с каталогами архива, файлы с уже
+    // занятыми именами пропускаются. Возвращает число файлов, -1 - архив
+    // поврежден (записи до места повреждения остаются).
+    int attachArchive(const char* data, unsigned int size);
+    
+    // Снимки всего дерева в памяти. Создание копирует только метаданные,
+    // содержимое файлов остается общим до первой записи. Восстановление
+    // заменяет дерево копией снимка, сам снимок сохраняется, поэтому к нему
+    // можно возвращаться много раз. Ошибки выводятся на экран.
+    bool createSnapshot(const char* name);
+    bool restoreSnapshot(const char* name);
+    bool deleteSnapshot(const char* name);
+    void listSnapshots(OutputStream& out);
+    
+    // Просмотр снимка по абсолютному пути внутри него
+    bool listSnapshotDirectory(const char* name, const char* path, OutputStream& out);
+    bool readSnapshotFile(const char* name, const char* path, OutputStream& out);
+    
+    // Дерево имен для автодополнения. completionKey превращает путь
+    // (length байт) в префикс для этого дерева: ключ каталога, куда ведет
+    // все до последнего '/', и начало имени. Возвращает длину префикса,
+    // -1 - каталога нет. У найденных слов первые COMPLETION_KEY_LENGTH
+    // байт - ключ каталога.
+    static const int COMPLETION_KEY_LENGTH = 2;
+    const CompletionTrie& getNameTrie() { return nameTrie; }
+    int completionKey(const char* path, int length, char* key);
+    
+    // Загрузка дерева с диска в формате diskfs.h. Метаданные держатся
+    // в памяти, содержимое файлов читается и пишется через кэш буферов.
+    // sync записывает все изменения сразу, writeBack - только давние.
+    bool mount(BlockDevice* disk);
+    bool sync();
+    bool writeBack();
+    bool isMounted() const { return device != 0; }
+    BlockDevice* getDevice() const { return device; }
+    bool isJournaled() const { return device && journal.isEnabled(); }
+    void printJournalStats(OutputStream& out) { journal.printStats(out); }
+    
+    // Подключение каталога хоста к каталогу path (создается, если его
+    // нет, и должен быть пустым). ls, cat, запись в файл, mkdir, touch,
+    // rm, cp, mv и перенаправление с путями внутри него работают с хостом; файлы хоста не
+    // открываются дескрипторами (openFile), их сначала копируют в дерево.
+    bool mountHost(Virtio9p* share, const char* path);
+    bool getHostMount(char* path);
+    
+    // Перенаправление ввода и вывода оболочки для файлов хоста: файл
+    // открывается один раз и читается или пишется частями. При ошибке
+    // сообщение уже выведено.
+    bool isHostFile(const char* path);
+    bool openHostInput(const char* path, HostInputStream& stream);
+    void closeHostInput(HostInputStream& stream);
+    bool writeHostOutput(const char* path, InputStream& input, bool append);
+};
+
+// Чтение файла кусками: в памяти - по ссылке на экстент или архив,
+// с диска - копией очередного блока
+class FileInputStream : public InputStream {
+private:
+    FileSystem* fs;
+    int file;
+    int offset;
+    char chunk[BlockPool::BLOCK_SIZE];
+
+public:
+    FileInputStream(FileSystem* fs, int file) : fs(fs), file(file), offset(0) {}
+    int read(const char*& data) override;
+};
+
+// Чтение файла хоста кусками через свой буфер; открывает и закрывает
+// поток FileSystem::openHostInput и closeHostInput
+class HostInputStream : public InputStream {
+private:
+    Virtio9p* host;
+    int fid;
+    unsigned int offset;
+    char* buffer;
+    unsigned int pages;
+    
+    friend class FileSystem;
+
+public:
+    HostInputStream() : host(0), fid(-1), offset(0), buffer(0), pages(0) {}
+    int read(const char*& data) override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,317 @@
+// fsck.cpp
+#include "filesystem.h"
+#include "crc32c.h"
+#include "ioring.h"
+#include "memory.h"
+#include "io.h"
+#include "terminal.h"
+
+static inline bool isSummed(const unsigned int* map, int block) {
+    return (map[block / 32] & (1u << (block % 32))) != 0;
+}
+
+void FileSystem::sealBlock(int block, const char* data) {
+    blockSums[block] = crc32c(0, data, BlockPool::BLOCK_SIZE);
+    summedBlocks[block / 32] |= 1u << (block % 32);
+}
+
+// Новые блоки: их прежнее содержимое и сумма не имеют значения
+void FileSystem::forgetSums(int start, int count) {
+    for (int block = start; block < start + count; block++) {
+        summedBlocks[block / 32] &= ~(1u << (block % 32));
+    }
+}
+
+void FileSystem::copySums(int from, int to, int count) {
+    for (int i = 0; i < count; i++) {
+        blockSums[to + i] = blockSums[from + i];
+        if (isSummed(summedBlocks, from + i)) {
+            summedBlocks[(to + i) / 32] |= 1u << ((to + i) % 32);
+        } else {
+            summedBlocks[(to + i) / 32] &= ~(1u << ((to + i) % 32));
+        }
+    }
+}
+
+// Сверка содержимого блока с суммой; если суммы еще нет, она запоминается
+bool FileSystem::checkBlock(int block, const char* data) {
+    unsigned int sum = crc32c(0, data, BlockPool::BLOCK_SIZE);
+    if (!isSummed(summedBlocks, block)) {
+        blockSums[block] = sum;
+        summedBlocks[block / 32] |= 1u << (block % 32);
+        return true;
+    }
+    return blockSums[block] == sum;
+}
+
+static void reportMismatch(int block) {
+    char number[16];
+    itoa(block, number, 10);
+    terminal.writeColored("Error: Checksum mismatch in data block ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    terminal.writeLine(number);
+}
+
+// Проверка секторов, которые кэш читает с диска. Блок данных с неверной
+// суммой в кэш не попадает, и чтение из него завершается ошибкой.
+// Секторы метаданных и свободные блоки не проверяются.
+bool FileSystem::checkSector(void* context, BlockDevice* disk, unsigned int sector, const char* data) {
+    FileSystem* fs = (FileSystem*)context;
+    if (disk != fs->device || sector < fs->superblock.dataStart ||
+        sector - fs->superblock.dataStart >= fs->superblock.dataBlocks) {
+        return true;
+    }
+    int block = sector - fs->superblock.dataStart;
+    if (!blockPool.isUsed(block) || fs->checkBlock(block, data)) {
+        return true;
+    }
+    reportMismatch(block);
+    return false;
+}
+
+// Без диска кэша нет, и блоки пула сверяются при каждом чтении: участок
+// length байт с байта skip блока block, блоки подряд. Возвращает длину
+// участка до первого испорченного блока.
+int FileSystem::verifyResident(int block, int skip, int length) {
+    for (int i = 0; i * BlockPool::BLOCK_SIZE < skip + length; i++) {
+        if (!checkBlock(block + i, blockPool.address(block + i))) {
+            reportMismatch(block + i);
+            int good = i * BlockPool::BLOCK_SIZE - skip;
+            return (good > 0) ? good : 0;
+        }
+    }
+    return length;
+}
+
+// Ссылки на блоки из таблиц дерева или снимка (счетчик до 255). Цепочка
+// с экстентом за пределами пула или длиннее таблицы экстентов
+// повреждена и дальше не обходится.
+void FileSystem::countReferences(const File* table, const Extent* extentTable, int limit,
+                                 unsigned char* references, CheckReport& report) {
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!table[i].used || table[i].isArchived) {
+            continue;
+        }
+        report.files++;
+        int steps = 0;
+        for (int e = table[i].firstExtent; e != -1; e = extentTable[e].next) {
+            if (e < 0 || e >= MAX_EXTENTS || ++steps > MAX_EXTENTS) {
+                report.badExtents++;
+                break;
+            }
+            const Extent& extent = extentTable[e];
+            if (extent.start < 0 || extent.count <= 0 || extent.start + extent.count > limit) {
+                report.badExtents++;
+                break;
+            }
+            for (int block = extent.start; block < extent.start + extent.count; block++) {
+                if (references[block] < 255) {
+                    references[block]++;
+                }
+            }
+        }
+    }
+}
+
+// Сообщение о поврежденном блоке с путем файла дерева, которому он
+// принадлежит; выводятся только первые сообщения
+void FileSystem::reportBlock(int block, const char* problem, CheckReport& report, OutputStream& out) {
+    static const int MAX_SHOWN = 8;
+    if (report.shown++ >= MAX_SHOWN) {
+        return;
+    }
+    
+    int owner = -1;
+    for (int i = 0; i < MAX_FILES && owner == -1; i++) {
+        if (!files[i].used || files[i].isArchived) {
+            continue;
+        }
+        for (int e = files[i].firstExtent; e != -1; e = extents[e].next) {
+            if (block >= extents[e].start && block < extents[e].start + extents[e].count) {
+                owner = i;
+                break;
+            }
+        }
+    }
+    
+    char text[MAX_PATH_LENGTH];
+    out.writeColored(problem, terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    out.write(": block ");
+    itoa(block, text, 10);
+    out.write(text);
+    if (owner == -1) {
+        out.writeLine(" (snapshot)");
+        return;
+    }
+    buildPath(owner, text);
+    out.write(" (");
+    out.write(text);
+    out.writeLine(")");
+}
+
+void FileSystem::scrubBlock(int block, const char* data, CheckReport& report, OutputStream& out) {
+    bool known = isSummed(summedBlocks, block);
+    if (!checkBlock(block, data)) {
+        report.mismatched++;
+        reportBlock(block, "Checksum mismatch", report, out);
+    } else if (known) {
+        report.verified++;
+    } else {
+        report.fresh++;
+    }
+}
+
+// Кольцо и буфер проверки диска создаются при первой проверке
+static IoRing scrubRing;
+static bool scrubRingReady = false;
+
+// Чтение всех блоков с диска мимо кэша: участки подряд занятых блоков
+// ставятся в кольцо до заполнения буфера и уходят устройству одним
+// пакетом. Буфер заполняется по порядку блоков, поэтому слитые кольцом
+// запросы читаются прямо в него.
+bool FileSystem::scrubDisk(const unsigned char* references, CheckReport& report, OutputStream& out) {
+    static const int SCRUB_SECTORS = IoRing::BOUNCE_SECTORS;
+    const unsigned int pages = SCRUB_SECTORS * BlockPool::BLOCK_SIZE / PageAllocator::PAGE_SIZE;
+    char* scratch = (char*)pageAllocator.allocContiguous(pages);
+    if (!scratch) {
+        return false;
+    }
+    if (!scrubRingReady) {
+        scrubRing.initialize();
+        scrubRingReady = true;
+    }
+    
+    int limit = superblock.dataBlocks;
+    int block = 0;
+    while (block < limit) {
+        // Между пакетами кольцо пусто, и другие потоки могут работать с диском
+        if (!checkpoint()) {
+            report.interrupted = true;
+            break;
+        }
+        int used = 0;
+        while (block < limit && used < SCRUB_SECTORS) {
+            if (!references[block]) {
+                block++;
+                continue;
+            }
+            int start = block;
+            while (block < limit && references[block] && block - start < SCRUB_SECTORS - used) {
+                block++;
+            }
+            if (!scrubRing.prepare(superblock.dataStart + start, block - start,
+                                   scratch + used * BlockPool::BLOCK_SIZE, false, start)) {
+                block = start;
+                break;
+            }
+            used += block - start;
+        }
+        
+        scrubRing.submit(device);
+        IoRing::Completion completion;
+        while (scrubRing.reap(completion)) {
+            for (int i = 0; i < completion.count; i++) {
+                if (completion.ok) {
+                    scrubBlock(completion.tag + i, (const char*)completion.buffer + i * BlockPool::BLOCK_SIZE, report, out);
+                } else {
+                    report.unreadable++;
+                    reportBlock(completion.tag + i, "Read error", report, out);
+                }
+            }
+        }
+    }
+    pageAllocator.freeContiguous(scratch, pages);
+    return true;
+}
+
+
+bool FileSystem::checkIntegrity(OutputStream& out) {
+    if (device && !sync()) {
+        terminal.writeLineColored("Error: Disk write failed.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    const unsigned int pages = BlockPool::MAX_BLOCKS / PageAllocator::PAGE_SIZE;
+    unsigned char* references = (unsigned char*)pageAllocator.allocContiguous(pages);
+    if (!references) {
+        terminal.writeLineColored("Error: Not enough memory to check file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    memset(references, 0, BlockPool::MAX_BLOCKS);
+    
+    CheckReport report;
+    memset(&report, 0, sizeof(report));
+    int limit = device ? (int)superblock.dataBlocks : BlockPool::MAX_BLOCKS;
+    countReferences(files, extents, limit, references, report);
+    unsigned int treeFiles = report.files;
+    for (int s = 0; s < snapshotCount; s++) {
+        countReferences(snapshots[s].files, snapshots[s].extents, limit, references, report);
+    }
+    report.files = treeFiles;
+    
+    // Пул против ссылок: каждая ссылка сверх первой - доля в счетчике
+    // пула. Свободные блоки со ссылками не читаются.
+    for (int block = 0; block < limit; block++) {
+        bool used = blockPool.isUsed(block);
+        if (!references[block]) {
+            if (used) {
+                report.leaked++;
+            }
+            continue;
+        }
+        report.referenced++;
+        if (!used) {
+            report.missing++;
+            references[block] = 0;
+        } else if (references[block] < 255 && blockPool.getShares(block) != references[block] - 1) {
+            report.badShares++;
+        }
+    }
+    
+    bool scrubbed = true;
+    if (device) {
+        scrubbed = scrubDisk(references, report, out);
+    } else {
+        for (int block = 0; block < limit; block++) {
+            if (!references[block]) {
+                continue;
+            }
+            if (!checkpoint()) {
+                report.interrupted = true;
+                break;
+            }
+            scrubBlock(block, blockPool.address(block), report, out);
+        }
+    }
+    pageAllocator.freeContiguous(references, pages);
+    if (!scrubbed) {
+        terminal.writeLineColored("Error: Not enough memory to check file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    if (report.interrupted) {
+        terminal.writeLineColored("Error: File system check interrupted.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    out.writeLineColored("File system check:", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    out.writeCounter("  Files:        ", report.files);
+    out.writeCounter("  Snapshots:    ", snapshotCount);
+    out.writeCounter("  Blocks:       ", report.referenced);
+    out.writeCounter("  Verified:     ", report.verified);
+    out.writeCounter("  New sums:     ", report.fresh);
+    out.writeCounter("  Bad sums:     ", report.mismatched);
+    out.writeCounter("  Read errors:  ", report.unreadable);
+    out.writeCounter("  Leaked:       ", report.leaked);
+    out.writeCounter("  Missing:      ", report.missing);
+    out.writeCounter("  Bad shares:   ", report.badShares);
+    out.writeCounter("  Bad extents:  ", report.badExtents);
+    out.writeColored("  CRC32C:       ", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    out.writeLine(crc32cHardware() ? "SSE4.2, 3 lanes" : "slicing-by-8");
+    
+    unsigned int errors = report.mismatched + report.unreadable + report.leaked + report.missing +
+                          report.badShares + report.badExtents;
+    if (errors) {
+        out.writeLineColored("Errors found.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    } else {
+        out.writeLineColored("No errors found.", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    }
+    return errors == 0;
+}
\ No newline at end of file
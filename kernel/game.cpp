@@ -2,6 +2,8 @@
 #include "game.h"
 #include "terminal.h"
 #include "io.h"
+#include "keyboard.h"
+#include "thread.h"
 
 SnakeGame::SnakeGame(Terminal* term) {
     terminal = term;
@@ -122,28 +124,43 @@ bool SnakeGame::checkCollision() {
 }
 
 void SnakeGame::run() {
+    scheduler.waitForeground();
+    
     bool gameOver = false;
     
-    while (!gameOver) {
+    while (!gameOver && !scheduler.interruptRequested()) {
         drawField();
         
-        // Задержка
-        for (volatile int i = 0; i < 5000000; i++) {}
+        // Задержка; во время ожидания работают фоновые задания
+        for (volatile int i = 0; i < 5000000; i++) {
+            if ((i & 0xFFFF) == 0) {
+                scheduler.yield();
+            }
+        }
         
-        // Проверяем нажатие клавиш
-        if (inb(0x64) & 1) {
-            unsigned char scancode = inb(0x60);
+        // Обрабатываем все накопившиеся события, отпускания клавиш игнорируем
+        bool quit = false;
+        KeyEvent event;
+        while (keyboard.poll(event)) {
+            if (!event.pressed) {
+                continue;
+            }
             
             // ESC - выход
-            if (scancode == 0x01) {
+            if (event.key == KEY_ESCAPE) {
+                quit = true;
                 break;
             }
             
             // Стрелки - изменение направления
-            if (scancode == 0x48 && dir != DOWN) dir = UP;       // Вверх
-            if (scancode == 0x50 && dir != UP) dir = DOWN;       // Вниз
-            if (scancode == 0x4B && dir != RIGHT) dir = LEFT;    // Влево
-            if (scancode == 0x4D && dir != LEFT) dir = RIGHT;    // Вправо
+            if (event.key == KEY_UP && dir != DOWN) dir = UP;          // Вверх
+            if (event.key == KEY_DOWN && dir != UP) dir = DOWN;        // Вниз
+            if (event.key == KEY_LEFT && dir != RIGHT) dir = LEFT;     // Влево
+            if (event.key == KEY_RIGHT && dir != LEFT) dir = RIGHT;    // Вправо
+        }
+        
+        if (quit) {
+            break;
         }
         
         moveSnake();
@@ -163,8 +180,7 @@ void SnakeGame::run() {
     terminal->writeLineColored("Press any key to continue...", terminal->makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     
     // Ждем нажатия клавиши
-    while ((inb(0x64) & 1) == 0) {}
-    inb(0x60);
+    keyboard.waitKeyPress();
     
     terminal->clear();
 }
\ No newline at end of file
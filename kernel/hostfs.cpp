@@ -0,0 +1,734 @@
+// hostfs.cpp
+#include "filesystem.h"
+#include "virtio9p.h"
+#include "memory.h"
+#include "io.h"
+#include "terminal.h"
+
+// Буфер для чтения и записи файлов хоста: 2 МБ - несколько сообщений
+// максимального размера, которые стоят в очереди одновременно
+static const unsigned int HOST_BUFFER_PAGES = 512;
+static const unsigned int HOST_BUFFER_MIN_PAGES = 16;
+static const int MAX_HOST_DEPTH = 16;
+
+// Подключение каталога хоста к пустому каталогу дерева (он создается,
+// если его нет). Записи дерева под точкой подключения были бы не видны,
+// поэтому каталог должен оставаться пустым.
+bool FileSystem::mountHost(Virtio9p* share, const char* path) {
+    int index = findEntry(path);
+    if (index == -1) {
+        const char* name;
+        int parent = resolveParent(path, name);
+        if (parent == -1 || files[parent].isArchived || !isValidFileName(name)) {
+            terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(path);
+            return false;
+        }
+        index = createEntry(parent, name, true, false);
+        if (index == -1) {
+            terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+    }
+    if (index == ROOT || !files[index].isDirectory || files[index].firstChild != -1 || files[index].isArchived) {
+        terminal.writeColored("Error: Mount point must be an empty directory: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return false;
+    }
+    host = share;
+    hostMount = makeHandle(index);
+    return true;
+}
+
+bool FileSystem::getHostMount(char* path) {
+    int mount = host ? resolve(hostMount) : -1;
+    if (mount == -1) {
+        return false;
+    }
+    buildPath(mount, path);
+    return true;
+}
+
+// Ведет ли путь в точку подключения или глубже. rest - путь от корня
+// каталога хоста без "." и ".." (не длиннее path); ".." в корне хоста
+// возвращает в дерево.
+bool FileSystem::hostPath(const char* path, char* rest) {
+    int mount = host ? resolve(hostMount) : -1;
+    if (mount == -1) {
+        return false;
+    }
+    int index = (*path == '/') ? ROOT : currentDir;
+    bool inside = index == mount;
+    int length = 0;
+    rest[0] = '\0';
+
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+        if (*path == '\0') {
+            break;
+        }
+        const char* component = path;
+        while (*path && *path != '/') {
+            path++;
+        }
+        int size = path - component;
+        bool parent = size == 2 && component[0] == '.' && component[1] == '.';
+        if (size == 1 && component[0] == '.') {
+            continue;
+        }
+
+        if (!inside) {
+            if (!files[index].isDirectory) {
+                return false;
+            }
+            index = parent ? files[index].parent : lookup(index, component, size);
+            if (index == -1) {
+                return false;
+            }
+            inside = index == mount;
+        } else if (parent && length == 0) {
+            inside = false;
+            index = files[mount].parent;
+        } else if (parent) {
+            while (length > 0 && rest[length - 1] != '/') {
+                length--;
+            }
+            length = length > 0 ? length - 1 : 0;
+            rest[length] = '\0';
+        } else {
+            if (length > 0) {
+                rest[length++] = '/';
+            }
+            memcpy(rest + length, component, size);
+            length += size;
+            rest[length] = '\0';
+        }
+    }
+    return inside;
+}
+
+// Сообщение об ошибке хоста в том же виде, что и для дерева
+void FileSystem::reportHostError(const char* path) {
+    unsigned char color = terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+    switch (host->getLastError()) {
+    case Virtio9p::ERROR_NOT_FOUND:
+        terminal.writeColored("Error: File or directory not found: ", color);
+        break;
+    case Virtio9p::ERROR_EXISTS:
+        terminal.writeColored("Error: File or directory already exists: ", color);
+        break;
+    case Virtio9p::ERROR_NOT_EMPTY:
+        terminal.writeColored("Error: Directory not empty: ", color);
+        break;
+    case Virtio9p::ERROR_NOT_DIRECTORY:
+        terminal.writeColored("Directory not found: ", color);
+        break;
+    case Virtio9p::ERROR_IS_DIRECTORY:
+        terminal.writeColored("Error: Is a directory: ", color);
+        break;
+    default: {
+        char number[16];
+        itoa(host->getLastError(), number, 10);
+        terminal.writeColored("Error: Host I/O error ", color);
+        terminal.writeColored(number, color);
+        terminal.writeColored(": ", color);
+        break;
+    }
+    }
+    terminal.writeLine(path);
+}
+
+// Дописывает к пути компонент (к пустому пути - без '/');
+// false - путь не помещается в limit
+static bool appendName(char* path, const char* name, int length, int limit) {
+    int end = strlen(path);
+    bool slash = end > 0 && path[end - 1] != '/';
+    if (end + slash + length >= limit) {
+        return false;
+    }
+    if (slash) {
+        path[end++] = '/';
+    }
+    memcpy(path + end, name, length);
+    path[end + length] = '\0';
+    return true;
+}
+
+static bool isDotEntry(const Virtio9p::DirectoryEntry& entry) {
+    return (entry.length == 1 && entry.name[0] == '.') ||
+           (entry.length == 2 && entry.name[0] == '.' && entry.name[1] == '.');
+}
+
+// Буфер для содержимого файлов хоста: смежные страницы, если есть,
+// иначе поменьше
+static char* allocHostBuffer(unsigned int& pages) {
+    pages = HOST_BUFFER_PAGES;
+    char* buffer = (char*)pageAllocator.allocContiguous(pages);
+    if (!buffer) {
+        pages = HOST_BUFFER_MIN_PAGES;
+        buffer = (char*)pageAllocator.allocContiguous(pages);
+    }
+    return buffer;
+}
+
+// Каталог хоста в формате listEntries; размер файла - отдельным Tgetattr
+void FileSystem::listHost(const char* rest, const char* path, OutputStream& out) {
+    unsigned char dirColor = terminal.makeColor(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
+    unsigned char fileColor = terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    unsigned char sizeColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+
+    Virtio9p::Attributes attributes;
+    if (!host->getAttributes(rest, attributes) || !attributes.isDirectory) {
+        terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    int fid = host->open(rest, Virtio9p::OPEN_READ);
+    char* buffer = (char*)pageAllocator.allocPage();
+    if (fid == -1 || !buffer) {
+        host->close(fid);
+        if (buffer) {
+            pageAllocator.freePage(buffer);
+        }
+        reportHostError(path);
+        return;
+    }
+
+    unsigned long long cookie = 0;
+    int count;
+    while ((count = host->readDirectory(fid, cookie, buffer, PageAllocator::PAGE_SIZE)) > 0) {
+        const char* cursor = buffer;
+        Virtio9p::DirectoryEntry entry;
+        while (Virtio9p::nextEntry(cursor, buffer + count, entry)) {
+            cookie = entry.cookie;
+            if (isDotEntry(entry)) {
+                continue;
+            }
+            char name[MAX_PATH_LENGTH];
+            int length = entry.length < MAX_PATH_LENGTH ? entry.length : MAX_PATH_LENGTH - 1;
+            memcpy(name, entry.name, length);
+            name[length] = '\0';
+            if (entry.isDirectory) {
+                out.writeColored("[DIR]  ", dirColor);
+                out.writeColored(name, dirColor);
+                out.writeLine("");
+                continue;
+            }
+
+            out.writeColored("[FILE] ", fileColor);
+            out.writeColored(name, fileColor);
+            char child[MAX_PATH_LENGTH];
+            strcpy(child, rest);
+            if (appendName(child, entry.name, entry.length, MAX_PATH_LENGTH) && host->getAttributes(child, attributes)) {
+                // Размеры больше 2 ГБ не помещаются в int: они в килобайтах
+                char sizeStr[16];
+                bool large = attributes.size >= 0x80000000ull;
+                itoa(large ? (int)(attributes.size >> 10) : (int)attributes.size, sizeStr, 10);
+                out.writeColored("  (", sizeColor);
+                out.writeColored(sizeStr, sizeColor);
+                out.writeColored(large ? " KB)" : " bytes)", sizeColor);
+            }
+            out.writeLine("");
+        }
+    }
+    if (count == -1) {
+        reportHostError(path);
+    }
+    pageAllocator.freePage(buffer);
+    host->close(fid);
+}
+
+void FileSystem::readHost(const char* rest, const char* path, OutputStream& out) {
+    int fid = host->open(rest, Virtio9p::OPEN_READ);
+    if (fid == -1) {
+        reportHostError(path);
+        return;
+    }
+    Virtio9p::Attributes attributes;
+    if (host->getAttributes(rest, attributes) && attributes.isDirectory) {
+        host->close(fid);
+        terminal.writeColored("Error: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeColored(path, terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLineColored(" is a directory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+    unsigned int pages;
+    char* buffer = allocHostBuffer(pages);
+    if (!buffer) {
+        host->close(fid);
+        terminal.writeLineColored("Error: Not enough memory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+
+    if (out.isInteractive()) {
+        out.writeLineColored("--- File content ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    }
+    int size = pages * PageAllocator::PAGE_SIZE;
+    unsigned int offset = 0;
+    int count;
+    do {
+        count = host->read(fid, offset, buffer, size);
+        if (count > 0) {
+            out.write(buffer, count);
+            offset += count;
+        }
+    } while (count > 0);
+    if (out.isInteractive()) {
+        out.writeLine("");
+        out.writeLineColored("--- End of file ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    }
+    if (count == -1) {
+        reportHostError(path);
+    }
+
+    pageAllocator.freeContiguous(buffer, pages);
+    host->close(fid);
+}
+
+// Запись идет прямо из data, без промежуточного буфера
+bool FileSystem::storeHost(const char* rest, const char* path, const char* data, int length, bool append) {
+    int fid = host->open(rest, append ? Virtio9p::OPEN_WRITE : Virtio9p::OPEN_TRUNCATE);
+    Virtio9p::Attributes attributes;
+    attributes.size = 0;
+    bool ok = fid != -1 && (!append || host->getAttributes(rest, attributes)) &&
+              host->write(fid, (unsigned int)attributes.size, data, length);
+    if (!ok) {
+        reportHostError(path);
+    }
+    host->close(fid);
+    return ok;
+}
+
+void FileSystem::createHost(const char* rest, const char* path, bool isDirectory) {
+    const char* name = rest;
+    for (const char* p = rest; *p; p++) {
+        if (*p == '/') {
+            name = p + 1;
+        }
+    }
+    if (!isValidFileName(name)) {
+        terminal.writeLineColored(isDirectory ? "Error: Invalid directory name." : "Error: Invalid file name.",
+                                  terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+
+    Virtio9p::Attributes attributes;
+    if (host->getAttributes(rest, attributes)) {
+        terminal.writeLineColored("Error: File or directory already exists.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+    bool ok;
+    if (isDirectory) {
+        ok = host->makeDirectory(rest);
+    } else {
+        int fid = host->open(rest, Virtio9p::OPEN_WRITE);
+        ok = fid != -1;
+        host->close(fid);
+    }
+    if (!ok) {
+        reportHostError(path);
+        return;
+    }
+    terminal.writeColored(isDirectory ? "Directory created: " : "File created: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(path);
+}
+
+void FileSystem::removeHost(const char* rest, const char* path) {
+    if (rest[0] == '\0') {
+        terminal.writeColored("Error: Cannot remove mount point: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return;
+    }
+    Virtio9p::Attributes attributes;
+    if (!host->getAttributes(rest, attributes) || !host->remove(rest, attributes.isDirectory)) {
+        reportHostError(path);
+        return;
+    }
+    terminal.writeColored("Removed: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(path);
+}
+
+// Копирование одного файла через буфер: чтение и запись хоста идут
+// частями по размеру сообщения, все части буфера сразу в очереди.
+// Ошибки выводятся здесь же.
+bool FileSystem::copyHostFile(const HostEnd& from, const HostEnd& to, char* buffer, int size) {
+    int source = from.host ? host->open(from.path, Virtio9p::OPEN_READ) : findFile(from.path);
+    if (source == -1) {
+        reportHostError(from.path);
+        return false;
+    }
+    int target = to.host ? host->open(to.path, Virtio9p::OPEN_TRUNCATE) : openFile(to.path, true, true);
+    if (target == -1) {
+        if (to.host) {
+            reportHostError(to.path);
+        }
+        if (from.host) {
+            host->close(source);
+        }
+        return false;
+    }
+
+    bool ok = true;
+    unsigned int offset = 0;
+    int count;
+    do {
+        count = from.host ? host->read(source, offset, buffer, size) : readData(source, offset, buffer, size);
+        if (count == -1) {
+            reportHostError(from.path);
+            ok = false;
+        } else if (count > 0 && to.host && !host->write(target, offset, buffer, count)) {
+            reportHostError(to.path);
+            ok = false;
+        } else if (count > 0 && !to.host && !writeData(target, offset, buffer, count)) {
+            terminal.writeLineColored("Error: Not enough memory for file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            ok = false;
+        }
+        offset += count;
+    } while (ok && count > 0);
+
+    if (from.host) {
+        host->close(source);
+    }
+    if (to.host) {
+        host->close(target);
+    }
+    return ok;
+}
+
+// Рекурсивное копирование между хостом и деревом (одна из сторон или обе
+// - хост). Пути источника и цели общие для всех уровней: имя дописывается
+// перед спуском и отрезается после, поэтому стек на уровень мал. Имена
+// хоста, недопустимые в дереве, пропускаются с предупреждением. Уже
+// скопированное при ошибке остается.
+bool FileSystem::copyHostTree(HostEnd& from, HostEnd& to, bool isDirectory, char* buffer, int size, int depth) {
+    if (!isDirectory) {
+        return copyHostFile(from, to, buffer, size);
+    }
+    if (depth == MAX_HOST_DEPTH) {
+        terminal.writeLineColored("Error: Directory tree is too deep.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+
+    // Каталог цели
+    if (to.host) {
+        if (!host->makeDirectory(to.path)) {
+            reportHostError(to.path);
+            return false;
+        }
+    } else {
+        const char* name;
+        int parent = resolveParent(to.path, name);
+        if (parent == -1 || createEntry(parent, name, true, false) == -1) {
+            terminal.writeLineColored("Error: Maximum number of files reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+    }
+
+    int fromEnd = strlen(from.path);
+    int toEnd = strlen(to.path);
+    if (!from.host) {
+        int dir = findEntry(from.path);
+        for (int i = files[dir].firstChild; i != -1; i = files[i].nextSibling) {
+            int length = strlen(names[i]);
+            bool ok = appendName(from.path, names[i], length, MAX_PATH_LENGTH) &&
+                      appendName(to.path, names[i], length, MAX_PATH_LENGTH);
+            if (!ok) {
+                terminal.writeLineColored("Error: Path too long.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            }
+            ok = ok && copyHostTree(from, to, files[i].isDirectory, buffer, size, depth + 1);
+            from.path[fromEnd] = '\0';
+            to.path[toEnd] = '\0';
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Порция записей каталога хоста лежит в своей странице на каждом
+    // уровне обхода, fid каталога держится до конца его обхода
+    int fid = host->open(from.path, Virtio9p::OPEN_READ);
+    char* entries = (char*)pageAllocator.allocPage();
+    bool ok = fid != -1 && entries;
+    if (!ok) {
+        reportHostError(from.path);
+    }
+    unsigned long long cookie = 0;
+    int count = 0;
+    while (ok && (count = host->readDirectory(fid, cookie, entries, PageAllocator::PAGE_SIZE)) > 0) {
+        const char* cursor = entries;
+        Virtio9p::DirectoryEntry entry;
+        while (ok && Virtio9p::nextEntry(cursor, entries + count, entry)) {
+            cookie = entry.cookie;
+            if (isDotEntry(entry)) {
+                continue;
+            }
+            ok = appendName(from.path, entry.name, entry.length, MAX_PATH_LENGTH) &&
+                 appendName(to.path, entry.name, entry.length, MAX_PATH_LENGTH);
+            if (!ok) {
+                terminal.writeLineColored("Error: Path too long.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            } else if (!to.host && !isValidFileName(to.path + strlen(to.path) - entry.length)) {
+                terminal.writeColored("Warning: Skipped invalid name: ", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+                terminal.writeLine(to.path);
+            } else {
+                ok = copyHostTree(from, to, entry.isDirectory, buffer, size, depth + 1);
+            }
+            from.path[fromEnd] = '\0';
+            to.path[toEnd] = '\0';
+        }
+    }
+    if (ok && count == -1) {
+        reportHostError(from.path);
+        ok = false;
+    }
+    if (entries) {
+        pageAllocator.freePage(entries);
+    }
+    host->close(fid);
+    return ok;
+}
+
+// cp, когда источник или цель на хосте. Цель выбирается как у copyPath:
+// в существующий каталог - под прежним именем, занятое имя - ошибка.
+bool FileSystem::copyHost(const char* from, const char* fromRest, bool fromHost,
+                          const char* to, const char* toRest, bool toHost, bool recursive) {
+    HostEnd source;
+    HostEnd target;
+    source.host = fromHost;
+    target.host = toHost;
+    strcpy(source.path, fromHost ? fromRest : from);
+
+    // Источник
+    bool isDirectory;
+    const char* name;
+    if (fromHost) {
+        Virtio9p::Attributes attributes;
+        if (!host->getAttributes(fromRest, attributes)) {
+            reportHostError(from);
+            return false;
+        }
+        isDirectory = attributes.isDirectory;
+        name = fromRest;
+        for (const char* p = fromRest; *p; p++) {
+            if (*p == '/') {
+                name = p + 1;
+            }
+        }
+        if (*name == '\0') {
+            name = names[resolve(hostMount)];
+        }
+    } else {
+        int index = findEntry(from);
+        if (index == -1) {
+            terminal.writeColored("Error: File or directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(from);
+            return false;
+        }
+        isDirectory = files[index].isDirectory;
+        name = names[index];
+    }
+    if (isDirectory && !recursive) {
+        terminal.writeColored("Error: Is a directory (use -r): ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(from);
+        return false;
+    }
+
+    // Цель: существующий каталог получает копию под именем источника
+    bool targetIsDirectory = false;
+    bool targetExists;
+    if (toHost) {
+        Virtio9p::Attributes attributes;
+        targetExists = host->getAttributes(toRest, attributes);
+        targetIsDirectory = targetExists && attributes.isDirectory;
+    } else {
+        int index = findEntry(to);
+        targetExists = index != -1;
+        targetIsDirectory = targetExists && files[index].isDirectory;
+    }
+    strcpy(target.path, toHost ? toRest : to);
+    if (targetIsDirectory && !appendName(target.path, name, strlen(name), MAX_PATH_LENGTH)) {
+        terminal.writeLineColored("Error: Path too long.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    if (targetIsDirectory) {
+        Virtio9p::Attributes attributes;
+        targetExists = toHost ? host->getAttributes(target.path, attributes) : findEntry(target.path) != -1;
+    }
+    if (targetExists) {
+        terminal.writeLineColored("Error: File or directory already exists.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+
+    // Имя и каталог новой записи в дереве проверяются заранее
+    if (!toHost) {
+        const char* leaf;
+        int parent = resolveParent(target.path, leaf);
+        if (parent == -1) {
+            terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(to);
+            return false;
+        }
+        if (files[parent].isArchived) {
+            terminal.writeLineColored("Error: Read-only file system.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+        if (!isValidFileName(leaf)) {
+            terminal.writeLineColored("Error: Invalid file name.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+    }
+
+    // Каталог хоста внутрь самого себя
+    int fromLength = strlen(fromRest);
+    if (fromHost && toHost && isDirectory &&
+        (fromLength == 0 || (strncmp(target.path, fromRest, fromLength) == 0 && target.path[fromLength] == '/'))) {
+        terminal.writeLineColored("Error: Cannot copy a directory into itself.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+
+    unsigned int pages;
+    char* buffer = allocHostBuffer(pages);
+    if (!buffer) {
+        terminal.writeLineColored("Error: Not enough memory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    bool ok = copyHostTree(source, target, isDirectory, buffer, pages * PageAllocator::PAGE_SIZE, 0);
+    pageAllocator.freeContiguous(buffer, pages);
+    if (ok) {
+        terminal.writeColored("Copied: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+        terminal.writeLine(to);
+    }
+    return ok;
+}
+
+// mv внутри хоста - переименование на хосте; между хостом и деревом
+// записи не переносятся
+bool FileSystem::moveHost(const char* from, const char* fromRest, bool fromHost,
+                          const char* to, const char* toRest, bool toHost) {
+    if (!fromHost || !toHost) {
+        terminal.writeLineColored("Error: Cannot move between the host share and the tree (use cp).",
+                                  terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    if (fromRest[0] == '\0') {
+        terminal.writeColored("Error: Cannot move mount point: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(from);
+        return false;
+    }
+
+    char target[MAX_PATH_LENGTH];
+    strcpy(target, toRest);
+    Virtio9p::Attributes attributes;
+    if (host->getAttributes(toRest, attributes)) {
+        const char* name = fromRest;
+        for (const char* p = fromRest; *p; p++) {
+            if (*p == '/') {
+                name = p + 1;
+            }
+        }
+        if (!attributes.isDirectory || !appendName(target, name, strlen(name), MAX_PATH_LENGTH) ||
+            host->getAttributes(target, attributes)) {
+            terminal.writeLineColored("Error: File or directory already exists.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+    }
+
+    int fromLength = strlen(fromRest);
+    if (strncmp(target, fromRest, fromLength) == 0 && target[fromLength] == '/') {
+        terminal.writeLineColored("Error: Cannot move a directory into itself.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    if (!host->rename(fromRest, target)) {
+        reportHostError(from);
+        return false;
+    }
+    terminal.writeColored("Moved: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(to);
+    return true;
+}
+
+bool FileSystem::isHostFile(const char* path) {
+    char rest[MAX_PATH_LENGTH];
+    return hostPath(path, rest);
+}
+
+bool FileSystem::openHostInput(const char* path, HostInputStream& stream) {
+    char rest[MAX_PATH_LENGTH];
+    if (!hostPath(path, rest)) {
+        return false;
+    }
+    Virtio9p::Attributes attributes;
+    int fid = host->open(rest, Virtio9p::OPEN_READ);
+    if (fid == -1) {
+        reportHostError(path);
+        return false;
+    }
+    if (!host->getAttributes(rest, attributes) || attributes.isDirectory) {
+        host->close(fid);
+        terminal.writeColored("Error: Cannot read file: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return false;
+    }
+    stream.buffer = allocHostBuffer(stream.pages);
+    if (!stream.buffer) {
+        host->close(fid);
+        terminal.writeLineColored("Error: Not enough memory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    stream.host = host;
+    stream.fid = fid;
+    stream.offset = 0;
+    return true;
+}
+
+void FileSystem::closeHostInput(HostInputStream& stream) {
+    if (stream.fid != -1) {
+        stream.host->close(stream.fid);
+        stream.fid = -1;
+    }
+    if (stream.buffer) {
+        pageAllocator.freeContiguous(stream.buffer, stream.pages);
+        stream.buffer = 0;
+    }
+}
+
+// Ошибка чтения обрывает ввод, как конец файла
+int HostInputStream::read(const char*& data) {
+    if (fid == -1) {
+        return 0;
+    }
+    int count = host->read(fid, offset, buffer, pages * PageAllocator::PAGE_SIZE);
+    if (count == -1) {
+        terminal.writeLineColored("Error: Cannot read host file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        count = 0;
+    }
+    offset += count;
+    data = buffer;
+    return count;
+}
+
+// Каждый кусок ввода пишется прямо из его страницы
+bool FileSystem::writeHostOutput(const char* path, InputStream& input, bool append) {
+    char rest[MAX_PATH_LENGTH];
+    if (!hostPath(path, rest)) {
+        return false;
+    }
+    int fid = host->open(rest, append ? Virtio9p::OPEN_WRITE : Virtio9p::OPEN_TRUNCATE);
+    Virtio9p::Attributes attributes;
+    attributes.size = 0;
+    bool ok = fid != -1 && (!append || host->getAttributes(rest, attributes));
+    unsigned int offset = (unsigned int)attributes.size;
+    const char* data;
+    int length;
+    while (ok && (length = input.read(data)) > 0) {
+        ok = host->write(fid, offset, data, length);
+        offset += length;
+    }
+    if (!ok) {
+        reportHostError(path);
+    }
+    host->close(fid);
+    return ok;
+}
\ No newline at end of file
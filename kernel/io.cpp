@@ -13,6 +13,37 @@ void outb(unsigned short port, unsigned char data) {
     __asm__("outb %0, %1" : : "a" (data), "Nd" (port));
 }
 
+// Чтение и запись слова
+unsigned short inw(unsigned short port) {
+    unsigned short result;
+    __asm__ volatile("inw %1, %0" : "=a" (result) : "Nd" (port));
+    return result;
+}
+
+void outw(unsigned short port, unsigned short data) {
+    __asm__ volatile("outw %0, %1" : : "a" (data), "Nd" (port));
+}
+
+// Чтение и запись двойного слова
+unsigned int inl(unsigned short port) {
+    unsigned int result;
+    __asm__ volatile("inl %1, %0" : "=a" (result) : "Nd" (port));
+    return result;
+}
+
+void outl(unsigned short port, unsigned int data) {
+    __asm__ volatile("outl %0, %1" : : "a" (data), "Nd" (port));
+}
+
+// Блочная пересылка слов
+void insw(unsigned short port, void* buffer, unsigned int count) {
+    __asm__ volatile("rep insw" : "+D" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+void outsw(unsigned short port, const void* buffer, unsigned int count) {
+    __asm__ volatile("rep outsw" : "+S" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
 // Длина строки
 int strlen(const char* str) {
     int len = 0;
@@ -132,4 +163,69 @@ void itoa(int value, char* str, int base) {
         *low++ = *ptr;
         *ptr-- = temp;
     }
+}
+
+// Копирование блока памяти
+extern "C" void* memcpy(void* dest, const void* src, unsigned int n) {
+    // Основную часть копируем по 4 байта, остаток - побайтно
+    unsigned int words = n / 4;
+    unsigned int bytes = n % 4;
+    void* d = dest;
+    asm volatile("rep movsl" : "+D"(d), "+S"(src), "+c"(words) : : "memory");
+    asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(bytes) : : "memory");
+    return dest;
+}
+
+// Заполнение блока памяти
+extern "C" void* memset(void* dest, int value, unsigned int n) {
+    void* d = dest;
+    asm volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(value) : "memory");
+    return dest;
+}
+
+// Поиск байта: сначала до выравнивания, затем по 4 байта за шаг
+extern "C" void* memchr(const void* ptr, int value, unsigned int n) {
+    typedef unsigned int __attribute__((may_alias)) word;
+    const unsigned char* p = (const unsigned char*)ptr;
+    unsigned char c = (unsigned char)value;
+    
+    while (n > 0 && ((unsigned int)p & 3) != 0) {
+        if (*p == c) {
+            return (void*)p;
+        }
+        p++;
+        n--;
+    }
+    
+    // Слово содержит нужный байт, если в (w ^ маска) есть нулевой байт
+    unsigned int mask = c * 0x01010101u;
+    while (n >= 4) {
+        unsigned int w = *(const word*)p ^ mask;
+        if ((w - 0x01010101u) & ~w & 0x80808080u) {
+            break;
+        }
+        p += 4;
+        n -= 4;
+    }
+    
+    while (n > 0) {
+        if (*p == c) {
+            return (void*)p;
+        }
+        p++;
+        n--;
+    }
+    return 0;
+}
+
+// Сравнение блоков памяти
+extern "C" int memcmp(const void* a, const void* b, unsigned int n) {
+    const unsigned char* p1 = (const unsigned char*)a;
+    const unsigned char* p2 = (const unsigned char*)b;
+    for (unsigned int i = 0; i < n; i++) {
+        if (p1[i] != p2[i]) {
+            return p1[i] - p2[i];
+        }
+    }
+    return 0;
 }
\ No newline at end of file
@@ -5,6 +5,14 @@
 // Функции ввода-вывода портов
 unsigned char inb(unsigned short port);
 void outb(unsigned short port, unsigned char data);
+unsigned short inw(unsigned short port);
+void outw(unsigned short port, unsigned short data);
+unsigned int inl(unsigned short port);
+void outl(unsigned short port, unsigned int data);
+
+// Пересылка count слов между портом и памятью (rep insw/outsw)
+void insw(unsigned short port, void* buffer, unsigned int count);
+void outsw(unsigned short port, const void* buffer, unsigned int count);
 
 // Строковые функции
 int strlen(const char* str);
@@ -16,4 +24,10 @@ void strncpy(char* dest, const char* src, int n);  // Добавьте эту с
 char* strstr(const char* haystack, const char* needle);  // Добавьте эту строку
 void itoa(int value, char* str, int base);
 
+// Функции работы с памятью (компилятор тоже может вызывать их сам)
+extern "C" void* memcpy(void* dest, const void* src, unsigned int n);
+extern "C" void* memset(void* dest, int value, unsigned int n);
+extern "C" void* memchr(const void* ptr, int value, unsigned int n);
+extern "C" int memcmp(const void* a, const void* b, unsigned int n);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,169 @@
+// ioring.cpp
+#include "ioring.h"
+#include "memory.h"
+#include "io.h"
+#include "stream.h"
+
+void IoRing::initialize() {
+    submitHead = 0;
+    submitTail = 0;
+    completeHead = 0;
+    completeTail = 0;
+    bounce = (char*)pageAllocator.allocContiguous(BOUNCE_SECTORS * BlockDevice::SECTOR_SIZE / PageAllocator::PAGE_SIZE);
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool IoRing::prepare(unsigned int sector, int count, void* buffer, bool write, unsigned int tag) {
+    if ((submitTail - submitHead) + (completeTail - completeHead) == (unsigned int)RING_SIZE) {
+        return false;
+    }
+    Submission& submission = submissions[submitTail++ & (RING_SIZE - 1)];
+    submission.sector = sector;
+    submission.count = count;
+    submission.buffer = (char*)buffer;
+    submission.write = write;
+    submission.tag = tag;
+    return true;
+}
+
+int IoRing::submit(BlockDevice* device) {
+    int count = submitTail - submitHead;
+    if (count == 0) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        order[i] = (submitHead + i) & (RING_SIZE - 1);
+    }
+    for (int gap = count / 2; gap > 0; gap /= 2) {
+        for (int i = gap; i < count; i++) {
+            int value = order[i];
+            int j = i;
+            for (; j >= gap && submissions[order[j - gap]].sector > submissions[value].sector; j -= gap) {
+                order[j] = order[j - gap];
+            }
+            order[j] = value;
+        }
+    }
+
+    // Слияние: следующий запрос продолжает предыдущий на диске. Буфер,
+    // продолжающий предыдущий в памяти, используется как есть, иначе
+    // вся команда идет через промежуточный буфер.
+    int commands = 0;
+    int used = 0;
+    int i = 0;
+    while (i < count) {
+        const Submission& first = submissions[order[i]];
+        int run = 1;
+        int sectors = first.count;
+        bool direct = true;
+        while (i + run < count) {
+            const Submission& next = submissions[order[i + run]];
+            if (next.write != first.write || next.sector != first.sector + sectors || next.count <= 0) {
+                break;
+            }
+            bool follows = direct && next.buffer == first.buffer + sectors * BlockDevice::SECTOR_SIZE;
+            if (!follows && (!bounce || used + sectors + next.count > BOUNCE_SECTORS)) {
+                break;
+            }
+            direct = follows;
+            sectors += next.count;
+            run++;
+        }
+
+        BlockRequest& request = batch[commands];
+        request.sector = first.sector;
+        request.count = sectors;
+        request.write = first.write;
+        request.buffer = first.buffer;
+        if (!direct) {
+            request.buffer = bounce + used * BlockDevice::SECTOR_SIZE;
+            if (first.write) {
+                char* target = (char*)request.buffer;
+                for (int k = 0; k < run; k++) {
+                    const Submission& part = submissions[order[i + k]];
+                    memcpy(target, part.buffer, part.count * BlockDevice::SECTOR_SIZE);
+                    target += part.count * BlockDevice::SECTOR_SIZE;
+                }
+            }
+            used += sectors;
+            stats.bounced += sectors;
+        }
+        runStart[commands] = i;
+        runLength[commands] = run;
+        runBounced[commands] = !direct;
+        commands++;
+        i += run;
+    }
+
+    device->submit(batch, commands);
+
+    // Прочитанное через промежуточный буфер раздается запросам
+    for (int c = 0; c < commands; c++) {
+        const char* source = (const char*)batch[c].buffer;
+        for (int k = 0; k < runLength[c]; k++) {
+            const Submission& part = submissions[order[runStart[c] + k]];
+            if (runBounced[c] && !part.write && batch[c].done) {
+                memcpy(part.buffer, source, part.count * BlockDevice::SECTOR_SIZE);
+            }
+            source += part.count * BlockDevice::SECTOR_SIZE;
+            partDone[runStart[c] + k] = batch[c].done;
+            partRetry[runStart[c] + k] = !batch[c].done && runLength[c] > 1;
+        }
+    }
+
+    // Запросы невыполненных слитых команд - повторно, каждый отдельно
+    int retries = 0;
+    for (int i = 0; i < count; i++) {
+        if (!partRetry[i]) {
+            continue;
+        }
+        const Submission& part = submissions[order[i]];
+        BlockRequest& request = batch[retries];
+        request.sector = part.sector;
+        request.count = part.count;
+        request.buffer = part.buffer;
+        request.write = part.write;
+        runStart[retries++] = i;
+    }
+    if (retries > 0) {
+        device->submit(batch, retries);
+        for (int r = 0; r < retries; r++) {
+            partDone[runStart[r]] = batch[r].done;
+        }
+    }
+
+    // Завершения - по одному на поставленный запрос, в порядке секторов
+    for (int i = 0; i < count; i++) {
+        const Submission& part = submissions[order[i]];
+        Completion& completion = completions[completeTail++ & (RING_SIZE - 1)];
+        completion.tag = part.tag;
+        completion.buffer = part.buffer;
+        completion.count = part.count;
+        completion.ok = partDone[i];
+        if (!partDone[i]) {
+            stats.failed++;
+        }
+    }
+    submitHead = submitTail;
+    stats.submitted += count;
+    stats.commands += commands;
+    stats.batches++;
+    return count;
+}
+
+bool IoRing::reap(Completion& completion) {
+    if (completeHead == completeTail) {
+        return false;
+    }
+    completion = completions[completeHead++ & (RING_SIZE - 1)];
+    return true;
+}
+
+
+void IoRing::printStats(OutputStream& out) {
+    out.writeCounter("  Batches:      ", stats.batches);
+    out.writeCounter("  Requests:     ", stats.submitted);
+    out.writeCounter("  Commands:     ", stats.commands);
+    out.writeCounter("  Bounced:      ", stats.bounced);
+    out.writeCounter("  Failed:       ", stats.failed);
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+// ioring.h
+#ifndef IORING_H
+#define IORING_H
+
+#include "blockdev.h"
+
+class OutputStream;
+
+// Кольца отправки и завершения для блочного ввода-вывода (по образцу
+// io_uring). Вызывающий ставит запросы в кольцо отправки (prepare),
+// отдает их устройству одним вызовом submit и позже забирает
+// завершения по одному (reap) - по метке, которую сам задал.
+//
+// При отправке запросы сортируются по номеру сектора, а соседние
+// запросы одного направления сливаются в одну команду устройства. Если
+// буферы слитых запросов не лежат подряд, данные идут через
+// промежуточный буфер кольца. Если слитая команда не выполнена, ее
+// запросы повторяются по отдельности: ошибка одного не портит соседей.
+// Запросы пакета независимы: порядок выполнения пересекающихся запросов
+// не определен.
+//
+// Устройство выполняет пакет целиком за время submit (прерываний в
+// ядре нет), поэтому к возврату из submit все завершения уже в кольце.
+class IoRing {
+public:
+    static const int RING_SIZE = 128;           // Степень двойки
+    static const int BOUNCE_SECTORS = 128;      // Промежуточный буфер, 64 КБ
+
+    struct Completion {
+        unsigned int tag;
+        void* buffer;
+        int count;
+        bool ok;
+    };
+
+    struct Stats {
+        unsigned int submitted;         // Запросов из кольца отправки
+        unsigned int commands;          // Запросов к устройству после слияния
+        unsigned int batches;           // Вызовов submit с хотя бы одним запросом
+        unsigned int bounced;           // Секторов через промежуточный буфер
+        unsigned int failed;
+    };
+
+private:
+    struct Submission {
+        unsigned int sector;
+        int count;
+        char* buffer;
+        bool write;
+        unsigned int tag;
+    };
+
+    Submission submissions[RING_SIZE];
+    unsigned int submitHead;            // Первый неотправленный запрос
+    unsigned int submitTail;
+    Completion completions[RING_SIZE];
+    unsigned int completeHead;          // Первое незабранное завершение
+    unsigned int completeTail;
+
+    char* bounce;
+    int order[RING_SIZE];               // Запросы пакета по возрастанию секторов
+    BlockRequest batch[RING_SIZE];
+    int runStart[RING_SIZE];            // Слитые запросы команды: order[start, start + length)
+    int runLength[RING_SIZE];
+    bool runBounced[RING_SIZE];
+    bool partDone[RING_SIZE];           // Итог каждого запроса, по order
+    bool partRetry[RING_SIZE];          // Слитая команда не выполнена
+
+    Stats stats;
+
+public:
+    void initialize();
+
+    // false - места нет: неотправленные запросы и незабранные завершения
+    // вместе занимают не больше RING_SIZE
+    bool prepare(unsigned int sector, int count, void* buffer, bool write, unsigned int tag);
+
+    // Отправка всех поставленных запросов одним пакетом, возвращает их число
+    int submit(BlockDevice* device);
+
+    // Очередное завершение; false - завершений нет
+    bool reap(Completion& completion);
+
+    int getQueued() const { return submitTail - submitHead; }
+    int getCompleted() const { return completeTail - completeHead; }
+    const Stats& getStats() const { return stats; }
+    void printStats(OutputStream& out);
+};
+
+#endif
\ No newline at end of file
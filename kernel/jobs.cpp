@@ -0,0 +1,131 @@
+// jobs.cpp
+#include "jobs.h"
+#include "terminal.h"
+#include "keyboard.h"
+#include "io.h"
+#include "fd.h"
+
+extern Terminal terminal;
+void processCommand(const char* cmd, OutputStream& output);
+
+void JobTable::initialize() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        jobs[i].used = false;
+        jobs[i].running = false;
+    }
+}
+
+// Тело потока задания
+void JobTable::jobMain(void* argument) {
+    Job* job = (Job*)argument;
+    processCommand(job->command, terminal);
+    fileTable.closeAll(scheduler.currentThread());
+    job->running = false;
+}
+
+// Поиск задания по номеру (нумерация с 1)
+JobTable::Job* JobTable::find(int id) {
+    if (id < 1 || id > MAX_JOBS || !jobs[id - 1].used) {
+        return 0;
+    }
+    return &jobs[id - 1];
+}
+
+// Запуск задания
+int JobTable::start(const char* command) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].used) {
+            continue;
+        }
+
+        strncpy(jobs[i].command, command, sizeof(jobs[i].command) - 1);
+        jobs[i].command[sizeof(jobs[i].command) - 1] = '\0';
+        jobs[i].running = true;
+
+        jobs[i].thread = scheduler.createThread(jobMain, &jobs[i]);
+        if (jobs[i].thread == -1) {
+            jobs[i].running = false;
+            return -1;
+        }
+
+        jobs[i].used = true;
+        return i + 1;
+    }
+    return -1;
+}
+
+// Вывод списка заданий
+void JobTable::list(OutputStream& out) {
+    unsigned char runColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+    unsigned char doneColor = terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (!jobs[i].used) {
+            continue;
+        }
+
+        char idStr[16];
+        itoa(i + 1, idStr, 10);
+        out.write("[");
+        out.write(idStr);
+        out.write("] ");
+        if (jobs[i].running) {
+            out.writeColored("Running  ", runColor);
+        } else {
+            out.writeColored("Done     ", doneColor);
+        }
+        out.writeLine(jobs[i].command);
+    }
+}
+
+// Сообщение о завершенных заданиях перед приглашением оболочки
+void JobTable::reportFinished() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (!jobs[i].used || jobs[i].running) {
+            continue;
+        }
+
+        char idStr[16];
+        itoa(i + 1, idStr, 10);
+        terminal.write("[");
+        terminal.write(idStr);
+        terminal.write("] ");
+        terminal.writeColored("Done     ", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        terminal.writeLine(jobs[i].command);
+        jobs[i].used = false;
+    }
+}
+
+// Ожидание задания на переднем плане
+bool JobTable::foreground(int id) {
+    Job* job = find(id);
+    if (!job) {
+        return false;
+    }
+
+    terminal.writeLine(job->command);
+
+    // Пока ждем, продолжаем принимать клавиатуру, чтобы доставить Ctrl+C
+    scheduler.setForeground(job->thread);
+    while (job->running) {
+        keyboard.pump();
+        scheduler.yield();
+    }
+    scheduler.setForeground(scheduler.currentThread());
+
+    job->used = false;
+    return true;
+}
+
+// Запрос прерывания задания
+bool JobTable::kill(int id) {
+    Job* job = find(id);
+    if (!job) {
+        return false;
+    }
+
+    if (job->running) {
+        scheduler.interrupt(job->thread);
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+// jobs.h
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "thread.h"
+
+class OutputStream;
+
+// Фоновые задания оболочки (cmd &), каждое выполняется в своем потоке
+class JobTable {
+public:
+    static const int MAX_JOBS = Scheduler::MAX_THREADS - 2;   // Без оболочки и потока записи кэша
+
+private:
+    struct Job {
+        bool used;
+        bool running;
+        int thread;
+        char command[256];
+    };
+
+    Job jobs[MAX_JOBS];
+
+    static void jobMain(void* argument);
+    Job* find(int id);
+
+public:
+    void initialize();
+
+    // Запуск команды в фоне, возвращает номер задания или -1
+    int start(const char* command);
+
+    void list(OutputStream& out);
+
+    // Сообщение о завершившихся заданиях и освобождение их номеров
+    void reportFinished();
+
+    // Перевод задания на передний план и ожидание его завершения
+    bool foreground(int id);
+
+    // Запрос прерывания задания
+    bool kill(int id);
+};
+
+extern JobTable jobTable;
+
+#endif
\ No newline at end of file
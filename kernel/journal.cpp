@@ -0,0 +1,213 @@
+// journal.cpp
+#include "journal.h"
+#include "bcache.h"
+#include "memory.h"
+#include "io.h"
+#include "stream.h"
+
+// Сумма Флетчера по 32-битным словам: ловит и порчу, и перестановку секторов
+unsigned int Journal::checksum(const char* data, unsigned int length) {
+    const unsigned int* words = (const unsigned int*)data;
+    unsigned int a = 0;
+    unsigned int b = 0;
+    for (unsigned int i = 0; i < length / 4; i++) {
+        a += words[i];
+        b += a;
+    }
+    return a ^ (b << 16 | b >> 16);
+}
+
+bool Journal::open(BlockDevice* disk, const DiskSuperblock& super) {
+    close();
+    device = disk;
+    memset(&stats, 0, sizeof(stats));
+    if (super.version == DISKFS_VERSION_NO_JOURNAL) {
+        return true;
+    }
+
+    // Журнал сразу за картой блоков, метаданные перед ним помещаются в карту описателя
+    metadataStart = super.inodeStart;
+    metadataSectors = super.journalStart - super.inodeStart;
+    if (super.journalStart != super.bitmapStart + super.bitmapSectors ||
+        metadataSectors > (unsigned int)DISKFS_METADATA_SECTORS ||
+        super.journalSectors < (unsigned int)DISKFS_METADATA_SECTORS + 3 ||
+        super.journalStart + super.journalSectors > super.dataStart) {
+        return false;
+    }
+
+    bufferPages = ((metadataSectors + 2) * DISKFS_SECTOR_SIZE + PageAllocator::PAGE_SIZE - 1) / PageAllocator::PAGE_SIZE;
+    buffer = (char*)pageAllocator.allocContiguous(bufferPages);
+    if (!buffer) {
+        return false;
+    }
+
+    start = super.journalStart;
+    size = super.journalSectors;
+    if (!device->read(start, 1, buffer)) {
+        close();
+        return false;
+    }
+    const DiskJournalHeader* header = (const DiskJournalHeader*)buffer;
+    if (header->magic != DISKFS_JOURNAL_MAGIC) {
+        close();
+        return false;
+    }
+    sequence = header->sequence;
+
+    if (!replay() || !reset()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Journal::close() {
+    if (size && buffer) {
+        pageAllocator.freeContiguous(buffer, bufferPages);
+    }
+    buffer = 0;
+    size = 0;
+    count = 0;
+}
+
+// Повтор подряд идущих целых транзакций. Оборванная транзакция (нет
+// фиксации или не сходится сумма) и все после нее пропускаются.
+bool Journal::replay() {
+    unsigned int offset = 1;
+    bool changed = false;
+    while (offset + 2 <= size) {
+        DiskJournalRecord* record = descriptor();
+        if (!device->read(start + offset, 1, buffer)) {
+            return false;
+        }
+        unsigned int n = record->count;
+        if (record->magic != DISKFS_JOURNAL_MAGIC || record->type != DISKFS_RECORD_DESCRIPTOR ||
+            record->sequence != sequence || n > metadataSectors || offset + n + 2 > size) {
+            break;
+        }
+        if (!device->read(start + offset + 1, n + 1, block(0))) {
+            return false;
+        }
+
+        const DiskJournalRecord* commitRecord = (const DiskJournalRecord*)block(n);
+        if (commitRecord->magic != DISKFS_JOURNAL_MAGIC || commitRecord->type != DISKFS_RECORD_COMMIT ||
+            commitRecord->sequence != sequence ||
+            commitRecord->checksum != checksum(buffer, (n + 1) * DISKFS_SECTOR_SIZE)) {
+            break;
+        }
+
+        // Копии идут в порядке битовой карты
+        int index = 0;
+        for (unsigned int bit = 0; bit < metadataSectors && index < (int)n; bit++) {
+            if (record->map[bit / 32] & (1u << (bit % 32))) {
+                if (!device->write(metadataStart + bit, 1, block(index))) {
+                    return false;
+                }
+                index++;
+            }
+        }
+        if (index != (int)n) {
+            break;
+        }
+
+        changed = true;
+        stats.replayed++;
+        sequence++;
+        offset += n + 2;
+    }
+    return !changed || device->flush();
+}
+
+// Пустой журнал: заголовок со следующим номером делает старые
+// транзакции недействительными. Собираемая транзакция (описатель и
+// копии в buffer) не затрагивается: сброс бывает и посреди commit.
+bool Journal::reset() {
+    DiskJournalHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DISKFS_JOURNAL_MAGIC;
+    header.sequence = sequence;
+    if (!device->write(start, 1, &header) || !device->flush()) {
+        return false;
+    }
+    head = 1;
+    return true;
+}
+
+// Все, что уже зафиксировано, пишется на места; журнал больше не нужен
+bool Journal::checkpoint() {
+    stats.checkpoints++;
+    return bufferCache.writeBack(device, 0, metadataStart, metadataStart + metadataSectors) &&
+           device->flush() && reset();
+}
+
+void Journal::begin() {
+    count = 0;
+    if (size) {
+        memset(descriptor(), 0, DISKFS_SECTOR_SIZE);
+    }
+}
+
+char* Journal::add(unsigned int sector) {
+    if (!size || sector < metadataStart || sector >= metadataStart + metadataSectors ||
+        (count > 0 && sector <= sectors[count - 1])) {
+        return 0;
+    }
+    unsigned int bit = sector - metadataStart;
+    descriptor()->map[bit / 32] |= 1u << (bit % 32);
+    sectors[count] = sector;
+    return block(count++);
+}
+
+bool Journal::commit() {
+    if (!size || count == 0) {
+        return true;
+    }
+    if (head + count + 2 > size && !checkpoint()) {
+        return false;
+    }
+
+    // Описатель, копии и фиксация уходят одной записью, затем сброс кэша
+    // устройства: после него транзакция переживет сбой
+    DiskJournalRecord* record = descriptor();
+    record->magic = DISKFS_JOURNAL_MAGIC;
+    record->type = DISKFS_RECORD_DESCRIPTOR;
+    record->sequence = sequence;
+    record->count = count;
+
+    DiskJournalRecord* commitRecord = (DiskJournalRecord*)block(count);
+    memset(commitRecord, 0, DISKFS_SECTOR_SIZE);
+    commitRecord->magic = DISKFS_JOURNAL_MAGIC;
+    commitRecord->type = DISKFS_RECORD_COMMIT;
+    commitRecord->sequence = sequence;
+    commitRecord->count = count;
+    commitRecord->checksum = checksum(buffer, (count + 1) * DISKFS_SECTOR_SIZE);
+
+    if (!device->write(start + head, count + 2, buffer) || !device->flush()) {
+        return false;
+    }
+    head += count + 2;
+    sequence++;
+    stats.commits++;
+    stats.sectors += count;
+
+    // На места секторы уходят через кэш, когда до них дойдет отложенная запись
+    for (int i = 0; i < count; i++) {
+        char* target = bufferCache.get(device, sectors[i], BufferCache::ACCESS_OVERWRITE);
+        if (target) {
+            memcpy(target, block(i), DISKFS_SECTOR_SIZE);
+        } else if (!device->write(sectors[i], 1, block(i))) {
+            return false;
+        }
+    }
+    count = 0;
+    return true;
+}
+
+
+void Journal::printStats(OutputStream& out) {
+    out.writeCounter("  Journal size: ", size);
+    out.writeCounter("  Commits:      ", stats.commits);
+    out.writeCounter("  Sectors:      ", stats.sectors);
+    out.writeCounter("  Checkpoints:  ", stats.checkpoints);
+    out.writeCounter("  Replayed:     ", stats.replayed);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+// journal.h
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "blockdev.h"
+#include "diskfs.h"
+
+class OutputStream;
+
+// Журнал метаданных файловой системы (формат - в diskfs.h).
+//
+// Транзакция собирается в памяти: begin, затем add для каждого
+// измененного сектора метаданных по возрастанию номеров. commit дописывает
+// ее в журнал одной последовательной записью, сбрасывает кэш записи
+// устройства и отдает секторы кэшу буферов грязными: на свои места они
+// уйдут обычной отложенной записью, а при сбое их восстановит повтор
+// журнала.
+class Journal {
+public:
+    struct Stats {
+        unsigned int commits;
+        unsigned int sectors;           // Секторов метаданных в транзакциях
+        unsigned int checkpoints;       // Сколько раз журнал заполнялся
+        unsigned int replayed;          // Транзакций повторено при монтировании
+    };
+
+private:
+    BlockDevice* device;
+    unsigned int start;                 // Заголовок журнала
+    unsigned int size;                  // Секторов в журнале, 0 - журнала нет
+    unsigned int metadataStart;
+    unsigned int metadataSectors;
+    unsigned int sequence;              // Номер следующей транзакции
+    unsigned int head;                  // Смещение следующей транзакции от start
+
+    // Описатель, копии секторов и запись фиксации подряд
+    char* buffer;
+    unsigned int bufferPages;
+    int count;
+    unsigned int sectors[DISKFS_METADATA_SECTORS];
+
+    Stats stats;
+
+    DiskJournalRecord* descriptor() { return (DiskJournalRecord*)buffer; }
+    char* block(int index) { return buffer + (index + 1) * DISKFS_SECTOR_SIZE; }
+    static unsigned int checksum(const char* data, unsigned int length);
+    bool replay();
+    bool reset();
+    bool checkpoint();
+
+public:
+    // Повтор зафиксированных транзакций и подготовка пустого журнала.
+    // На диске без журнала возвращает true, а isEnabled() - false.
+    bool open(BlockDevice* disk, const DiskSuperblock& super);
+    void close();
+    bool isEnabled() const { return size != 0; }
+
+    void begin();
+    // Место под копию сектора; 0 - номер не по возрастанию или вне метаданных
+    char* add(unsigned int sector);
+    int getCount() const { return count; }
+
+    // Запись транзакции. Если в журнале нет места, сначала все метаданные
+    // из кэша пишутся на места, и журнал начинается заново.
+    bool commit();
+
+    const Stats& getStats() const { return stats; }
+    void printStats(OutputStream& out);
+};
+
+#endif
\ No newline at end of file
@@ -1,10 +1,25 @@
 // kernel.cpp
 #include "io.h"
 #include "terminal.h"
+#include "keyboard.h"
 #include "filesystem.h"
 #include "editor.h"
 #include "game.h"
 #include "chat.h"
+#include "command.h"
+#include "stream.h"
+#include "memory.h"
+#include "blocks.h"
+#include "ata.h"
+#include "virtio.h"
+#include "virtio9p.h"
+#include "bcache.h"
+#include "thread.h"
+#include "jobs.h"
+#include "textutils.h"
+#include "mmap.h"
+#include "fd.h"
+#include "crc32c.h"
 
 // Структура Multiboot
 struct multiboot_info {
@@ -38,107 +53,141 @@ struct multiboot_info {
     unsigned char color_info[6];
 };
 
-// Структура для хранения аргументов команды
-struct CommandArgs {
-    int argc;           // Количество аргументов
-    char* argv[16];     // Массив указателей на аргументы
-    char buffer[256];   // Буфер для хранения строк аргументов
+// Модуль, загруженный вместе с ядром (mods_addr)
+struct multiboot_module {
+    unsigned long mod_start;
+    unsigned long mod_end;
+    unsigned long string;
+    unsigned long reserved;
 };
 
 // Глобальные объекты
 Terminal terminal;
+Keyboard keyboard;
+PageAllocator pageAllocator;
+BlockPool blockPool;
+Scheduler scheduler;
+JobTable jobTable;
 FileSystem fs;
+FileTable fileTable;
+AtaDisk ataDisk;
+VirtioBlock virtioDisk;
+Virtio9p hostShare;
+BufferCache bufferCache;
 Editor editor(&terminal, &fs);
 SnakeGame snakeGame(&terminal);
 ChatBot chatBot(&terminal);
 
-// Разбор строки команды на аргументы
-void parseCommand(const char* cmd, CommandArgs* args) {
-    args->argc = 0;
-    
-    // Копируем команду в буфер
-    strcpy(args->buffer, cmd);
-    
-    // Разбиваем на аргументы
-    char* token = args->buffer;
-    char* end = args->buffer + strlen(args->buffer);
-    
-    while (token < end && args->argc < 16) {
+// Информация от загрузчика, нужна команде info
+multiboot_info* bootInfo;
+
+// Разобранная командная строка: конвейер команд и перенаправления
+struct Pipeline {
+    static const int MAX_STAGES = 8;
+    
+    int stageCount;
+    CommandArgs stages[MAX_STAGES];
+    const char* inputFile;      // < файл для первой команды
+    const char* outputFile;     // > или >> файл для последней команды
+    bool append;                // >> - дописывать в конец файла
+    char buffer[512];           // Строки аргументов, разделенные нулями
+};
+
+// Сообщение о синтаксической ошибке
+static bool syntaxError(const char* message) {
+    terminal.writeColored("Syntax error: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    terminal.writeLine(message);
+    return false;
+}
+
+// Разбор строки команды на конвейер из команд с аргументами
+bool parseCommand(const char* cmd, Pipeline* pipeline) {
+    pipeline->stageCount = 1;
+    pipeline->stages[0].argc = 0;
+    pipeline->inputFile = 0;
+    pipeline->outputFile = 0;
+    pipeline->append = false;
+    
+    enum { REDIRECT_NONE, REDIRECT_INPUT, REDIRECT_OUTPUT } redirect = REDIRECT_NONE;
+    char* out = pipeline->buffer;
+    
+    while (*cmd) {
         // Пропускаем пробелы
-        while (*token == ' ' && token < end) {
-            *token++ = '\0';
+        if (*cmd == ' ') {
+            cmd++;
+            continue;
         }
         
-        // Если достигли конца строки, выходим
-        if (token >= end) break;
+        // | - начало следующей команды конвейера
+        if (*cmd == '|') {
+            if (redirect != REDIRECT_NONE) return syntaxError("missing file name before '|'");
+            if (pipeline->stages[pipeline->stageCount - 1].argc == 0) return syntaxError("empty command before '|'");
+            if (pipeline->stageCount == Pipeline::MAX_STAGES) return syntaxError("too many commands in pipeline");
+            
+            pipeline->stages[pipeline->stageCount++].argc = 0;
+            cmd++;
+            continue;
+        }
         
-        // Сохраняем указатель на начало аргумента
-        args->argv[args->argc++] = token;
+        // <, > и >> - перенаправления, за ними ожидается имя файла
+        if (*cmd == '<' || *cmd == '>') {
+            if (redirect != REDIRECT_NONE) return syntaxError("missing file name");
+            
+            if (*cmd == '<') {
+                redirect = REDIRECT_INPUT;
+                cmd++;
+            } else {
+                redirect = REDIRECT_OUTPUT;
+                pipeline->append = (cmd[1] == '>');
+                cmd += pipeline->append ? 2 : 1;
+            }
+            continue;
+        }
         
-        // Ищем конец аргумента
-        while (*token != ' ' && *token != '\0' && token < end) {
-            token++;
+        // Обычное слово
+        char* token = out;
+        while (*cmd && *cmd != ' ' && *cmd != '|' && *cmd != '<' && *cmd != '>') {
+            *out++ = *cmd++;
         }
+        *out++ = '\0';
+        
+        if (redirect == REDIRECT_INPUT) {
+            pipeline->inputFile = token;
+        } else if (redirect == REDIRECT_OUTPUT) {
+            pipeline->outputFile = token;
+        } else {
+            CommandArgs& stage = pipeline->stages[pipeline->stageCount - 1];
+            if (stage.argc < 16) {
+                stage.argv[stage.argc++] = token;
+            }
+        }
+        redirect = REDIRECT_NONE;
     }
-}
-
-// Команда help - вывод справки
-void cmdHelp() {
-    unsigned char titleColor = terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
-    unsigned char cmdColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
-    unsigned char descColor = terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
-    
-    terminal.writeLineColored("Available commands:", titleColor);
-    
-    terminal.writeColored("  help", cmdColor);
-    terminal.writeLineColored("     - Show this help", descColor);
-    
-    terminal.writeColored("  clear", cmdColor);
-    terminal.writeLineColored("    - Clear the screen", descColor);
-    
-    terminal.writeColored("  ls", cmdColor);
-    terminal.writeLineColored("       - List files in current directory", descColor);
-    
-    terminal.writeColored("  cd DIR", cmdColor);
-    terminal.writeLineColored("   - Change to directory DIR", descColor);
-    
-    terminal.writeColored("  mkdir DIR", cmdColor);
-    terminal.writeLineColored(" - Create a new directory", descColor);
-    
-    terminal.writeColored("  touch FILE", cmdColor);
-    terminal.writeLineColored(" - Create a new empty file", descColor);
-    
-    terminal.writeColored("  rm PATH", cmdColor);
-    terminal.writeLineColored("   - Remove a file or directory", descColor);
-    
-    terminal.writeColored("  cat FILE", cmdColor);
-    terminal.writeLineColored("  - Display contents of a file", descColor);
-    
-    terminal.writeColored("  edit FILE", cmdColor);
-    terminal.writeLineColored(" - Edit a file (simple text editor)", descColor);
-    
-    terminal.writeColored("  game", cmdColor);
-    terminal.writeLineColored("     - Play Snake game", descColor);
     
-    terminal.writeColored("  chat", cmdColor);
-    terminal.writeLineColored("     - Chat with OmarOS bot", descColor);
+    if (redirect != REDIRECT_NONE) return syntaxError("missing file name");
     
-    terminal.writeColored("  info", cmdColor);
-    terminal.writeLineColored("     - Show system information", descColor);
+    // Пустая последняя команда допустима только для пустой строки
+    if (pipeline->stages[pipeline->stageCount - 1].argc == 0 &&
+        (pipeline->stageCount > 1 || pipeline->inputFile || pipeline->outputFile)) {
+        return syntaxError("missing command");
+    }
     
-    terminal.writeColored("  exit", cmdColor);
-    terminal.writeLineColored("     - Shutdown the system", descColor);
+    return true;
 }
 
+void cmdHelp(CommandArgs& args);
+
 // Команда info - вывод информации о системе
-void cmdInfo(multiboot_info* mbi) {
+void cmdInfo(CommandArgs& args) {
+    multiboot_info* mbi = bootInfo;
+    OutputStream& out = *args.output;
     unsigned char titleColor = terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
     unsigned char valueColor = terminal.makeColor(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
     
-    terminal.writeLineColored("System Information:", titleColor);
+    out.writeLineColored("System Information:", titleColor);
     
-    terminal.writeColored("  OS Name: ", titleColor);
-    terminal.writeLineColored("OmarOS v0.3", valueColor);
+    out.writeColored("  OS Name: ", titleColor);
+    out.writeLineColored("OmarOS v0.3", valueColor);
     
     // Информация о процессоре
     char vendor[13];
@@ -153,127 +202,638 @@ void cmdInfo(multiboot_info* mbi) {
     *((unsigned int*)(vendor + 8)) = ecx;
     vendor[12] = '\0';
     
-    terminal.writeColored("  CPU: ", titleColor);
-    terminal.writeLineColored(vendor, valueColor);
+    out.writeColored("  CPU: ", titleColor);
+    out.writeLineColored(vendor, valueColor);
     
     // Информация о памяти
     if (mbi->flags & 0x1) {
         char memStr[32];
         
-        terminal.writeColored("  Lower Memory: ", titleColor);
+        out.writeColored("  Lower Memory: ", titleColor);
         itoa(mbi->mem_lower, memStr, 10);
-        terminal.writeColored(memStr, valueColor);
-        terminal.writeLineColored(" KB", valueColor);
+        out.writeColored(memStr, valueColor);
+        out.writeLineColored(" KB", valueColor);
         
-        terminal.writeColored("  Upper Memory: ", titleColor);
+        out.writeColored("  Upper Memory: ", titleColor);
         itoa(mbi->mem_upper, memStr, 10);
-        terminal.writeColored(memStr, valueColor);
-        terminal.writeLineColored(" KB", valueColor);
+        out.writeColored(memStr, valueColor);
+        out.writeLineColored(" KB", valueColor);
     }
     
     // Информация о загрузчике
     if (mbi->flags & 0x200) {
-        terminal.writeColored("  Boot Loader: ", titleColor);
-        terminal.writeLineColored((const char*)mbi->boot_loader_name, valueColor);
+        out.writeColored("  Boot Loader: ", titleColor);
+        out.writeLineColored((const char*)mbi->boot_loader_name, valueColor);
     }
     
-    terminal.writeColored("  File System: ", titleColor);
-    terminal.writeLineColored("Virtual in-memory filesystem", valueColor);
+    out.writeColored("  File System: ", titleColor);
+    if (fs.isMounted()) {
+        out.writeColored("On disk: ", valueColor);
+        out.writeLineColored(fs.getDevice()->getModel(), valueColor);
+    } else {
+        out.writeLineColored("Virtual in-memory filesystem", valueColor);
+    }
     
-    terminal.writeColored("  Features: ", titleColor);
-    terminal.writeLineColored("Command history, colored output, file operations, games, chat", valueColor);
+    out.writeColored("  Features: ", titleColor);
+    out.writeLineColored("Command history, colored output, file operations, games, chat", valueColor);
     
-    terminal.writeColored("  Author: ", titleColor);
-    terminal.writeLineColored("Omar", valueColor);
+    out.writeColored("  Author: ", titleColor);
+    out.writeLineColored("Omar", valueColor);
 }
 
-// Обработка команд
-void processCommand(const char* cmd, multiboot_info* mbi) {
-    // Если команда пустая, ничего не делаем
-    if (strlen(cmd) == 0) {
+// Простые команды оболочки
+void cmdClear(CommandArgs&) {
+    terminal.clear();
+}
+
+void cmdLs(CommandArgs& args) {
+    fs.listDirectory(args.argc > 1 ? args.argv[1] : 0, *args.output);
+}
+
+void cmdCd(CommandArgs& args) {
+    fs.changeDirectory(args.argv[1]);
+}
+
+void cmdMkdir(CommandArgs& args) {
+    fs.createDirectory(args.argv[1]);
+}
+
+void cmdTouch(CommandArgs& args) {
+    fs.createFile(args.argv[1]);
+}
+
+void cmdRm(CommandArgs& args) {
+    fs.remove(args.argv[1]);
+}
+
+// cat FILE... выводит файлы, без аргументов - копирует свой ввод
+void cmdCat(CommandArgs& args) {
+    if (args.argc > 1) {
+        for (int i = 1; i < args.argc; i++) {
+            fs.readFile(args.argv[i], *args.output);
+        }
         return;
     }
     
-    // Разбираем команду на аргументы
-    CommandArgs args;
-    parseCommand(cmd, &args);
+    if (!args.input) {
+        terminal.writeLineColored("Usage: cat [filename...]", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        return;
+    }
     
-    // Если нет аргументов, выходим
-    if (args.argc == 0) {
+    const char* data;
+    int length;
+    while (!scheduler.checkpoint() && (length = args.input->read(data)) > 0) {
+        args.output->write(data, length);
+    }
+}
+
+// cp [-r] source target - копия с общими блоками, mv source target -
+// перемещение или переименование
+void cmdCp(CommandArgs& args) {
+    bool recursive = strcmp(args.argv[1], "-r") == 0;
+    if (args.argc != (recursive ? 4 : 3)) {
+        terminal.writeLineColored("Usage: cp [-r] <source> <target>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        return;
+    }
+    fs.copyPath(args.argv[args.argc - 2], args.argv[args.argc - 1], recursive);
+}
+
+void cmdMv(CommandArgs& args) {
+    fs.movePath(args.argv[1], args.argv[2]);
+}
+
+// sync - записать изменения файловой системы на диск
+void cmdSync(CommandArgs&) {
+    // Измененные страницы отображений сначала попадают в сами файлы
+    if (!FileMapping::syncAll()) {
+        terminal.writeLineColored("Error: Cannot write mapped file pages.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    }
+    if (!fs.isMounted()) {
+        terminal.writeLineColored("No disk mounted, files are kept in memory only.", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        return;
+    }
+    if (!fs.sync()) {
+        terminal.writeLineColored("Error: Disk write failed.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    }
+}
+
+// fsck - проверка ссылок на блоки и контрольных сумм содержимого
+void cmdFsck(CommandArgs& args) {
+    // Измененные страницы отображений сначала попадают в сами файлы
+    if (!FileMapping::syncAll()) {
+        terminal.writeLineColored("Error: Cannot write mapped file pages.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    }
+    fs.checkIntegrity(*args.output);
+}
+
+// hostfs - каталог хоста (virtio-9p): без аргументов - точка подключения
+// и счетчики очереди, DIR - подключить к другому каталогу
+void cmdHostfs(CommandArgs& args) {
+    if (!hostShare.isPresent()) {
+        terminal.writeLineColored("Error: No host share (run QEMU with -virtfs).", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+    if (args.argc == 2) {
+        if (fs.mountHost(&hostShare, args.argv[1])) {
+            terminal.writeColored("Host share mounted at: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+            terminal.writeLine(args.argv[1]);
+        }
         return;
     }
     
-    // Обработка команд
-    if (strcmp(args.argv[0], "help") == 0) {
-        cmdHelp();
+    char path[256];
+    args.output->writeColored("Tag:         ", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    args.output->writeLine(hostShare.getTag());
+    args.output->writeColored("Mount point: ", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    args.output->writeLine(fs.getHostMount(path) ? path : "(not mounted)");
+    args.output->writeLineColored(hostShare.isModern() ? "Virtio queue:" : "Virtio queue (legacy):",
+                                  terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    hostShare.printStats(*args.output);
+}
+
+// snapshot - снимки дерева файлов: без аргументов - список, NAME -
+// создать, -r/-d NAME - восстановить/удалить, -l NAME [dir] и
+// -c NAME file - просмотр содержимого снимка
+void cmdSnapshot(CommandArgs& args) {
+    if (args.argc == 1) {
+        fs.listSnapshots(*args.output);
+        return;
     }
-    else if (strcmp(args.argv[0], "clear") == 0) {
-        terminal.clear();
+    
+    const char* option = args.argv[1];
+    if (option[0] != '-' && args.argc == 2) {
+        fs.createSnapshot(option);
+    } else if (strcmp(option, "-r") == 0 && args.argc == 3) {
+        fs.restoreSnapshot(args.argv[2]);
+    } else if (strcmp(option, "-d") == 0 && args.argc == 3) {
+        fs.deleteSnapshot(args.argv[2]);
+    } else if (strcmp(option, "-l") == 0 && args.argc >= 3) {
+        fs.listSnapshotDirectory(args.argv[2], args.argc == 4 ? args.argv[3] : "/", *args.output);
+    } else if (strcmp(option, "-c") == 0 && args.argc == 4) {
+        fs.readSnapshotFile(args.argv[2], args.argv[3], *args.output);
+    } else {
+        terminal.writeLineColored("Usage: snapshot [name | -r name | -d name | -l name [dir] | -c name file]", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
     }
-    else if (strcmp(args.argv[0], "ls") == 0) {
-        fs.listDirectory();
+}
+
+// compress [-d] file... - сжатие файлов LZ4 или распаковка
+void cmdCompress(CommandArgs& args) {
+    bool expand = strcmp(args.argv[1], "-d") == 0;
+    if (expand && args.argc < 3) {
+        terminal.writeLineColored("Usage: compress [-d] <file...>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        return;
     }
-    else if (strcmp(args.argv[0], "cd") == 0) {
-        if (args.argc > 1) {
-            fs.changeDirectory(args.argv[1]);
+    
+    for (int i = expand ? 2 : 1; i < args.argc; i++) {
+        if (expand) {
+            fs.decompressFile(args.argv[i]);
         } else {
-            terminal.writeLineColored("Usage: cd <directory>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+            fs.compressFile(args.argv[i]);
         }
     }
-    else if (strcmp(args.argv[0], "mkdir") == 0) {
-        if (args.argc > 1) {
-            fs.createDirectory(args.argv[1]);
-        } else {
-            terminal.writeLineColored("Usage: mkdir <directory>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+}
+
+// search [-p] word... - поиск файлов по словам или фразе (-p),
+// без слов - статистика индекса
+void cmdSearch(CommandArgs& args) {
+    bool phrase = args.argc > 1 && strcmp(args.argv[1], "-p") == 0;
+    int first = phrase ? 2 : 1;
+    if (args.argc == first) {
+        if (phrase) {
+            terminal.writeLineColored("Usage: search [-p] [word...]", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+            return;
         }
+        args.output->writeLineColored("Search index:", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        fs.printIndexStats(*args.output);
+        return;
     }
-    else if (strcmp(args.argv[0], "touch") == 0) {
-        if (args.argc > 1) {
-            fs.createFile(args.argv[1]);
-        } else {
-            terminal.writeLineColored("Usage: touch <filename>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    fs.searchText(args.argv + first, args.argc - first, phrase, *args.output);
+}
+
+// cache - счетчики кэша буферов
+void cmdCache(CommandArgs& args) {
+    args.output->writeLineColored("Buffer cache (2Q):", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    bufferCache.printStats(*args.output);
+    
+    if (fs.isMounted() && fs.getDevice() == &virtioDisk) {
+        args.output->writeLineColored("Virtio queue:", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        virtioDisk.printStats(*args.output);
+    }
+    if (fs.isMounted()) {
+        args.output->writeLineColored("I/O ring:", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        bufferCache.printRingStats(*args.output);
+    }
+    if (fs.isJournaled()) {
+        args.output->writeLineColored("Journal:", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        fs.printJournalStats(*args.output);
+    }
+}
+
+void cmdEdit(CommandArgs& args) {
+    editor.edit(args.argv[1]);
+}
+
+void cmdGame(CommandArgs&) {
+    snakeGame.run();
+}
+
+void cmdChat(CommandArgs&) {
+    chatBot.run();
+}
+
+void processCommand(const char* cmd, OutputStream& output);
+
+// Текущая глубина вложенности сценариев
+static int scriptDepth = 0;
+static const int MAX_SCRIPT_DEPTH = 8;
+
+// Выполнение сценария: каждая строка файла - команда оболочки.
+// Пустые строки и строки, начинающиеся с '#', пропускаются.
+bool runScript(const char* name, OutputStream& output) {
+    int index = fs.findFile(name);
+    if (index == -1 || fs.isDirectory(index)) {
+        terminal.writeColored("Error: Script not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return false;
+    }
+    
+    if (scriptDepth >= MAX_SCRIPT_DEPTH) {
+        terminal.writeLineColored("Error: Scripts nested too deeply.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    // Сценарий может изменять файлы, поэтому работаем с его копией
+    int size = fs.getFileSize(index);
+    unsigned int pages = size / PageAllocator::PAGE_SIZE + 1;
+    char* script = (char*)pageAllocator.allocContiguous(pages);
+    if (!script) {
+        terminal.writeLineColored("Error: Not enough memory for script.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    fs.readData(index, 0, script, size);
+    
+    scriptDepth++;
+    
+    char line[256];
+    int pos = 0;
+    while (pos < size) {
+        // Выделяем очередную строку
+        int len = 0;
+        while (pos < size && script[pos] != '\n') {
+            if (len < (int)sizeof(line) - 1) {
+                line[len++] = script[pos];
+            }
+            pos++;
+        }
+        pos++;
+        
+        while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ')) {
+            len--;
+        }
+        line[len] = '\0';
+        
+        const char* cmd = line;
+        while (*cmd == ' ') {
+            cmd++;
+        }
+        
+        if (*cmd == '\0' || *cmd == '#') {
+            continue;
         }
+        
+        // Ctrl+C или kill останавливают сценарий целиком
+        if (scheduler.checkpoint()) {
+            break;
+        }
+        
+        processCommand(cmd, output);
     }
-    else if (strcmp(args.argv[0], "rm") == 0) {
-        if (args.argc > 1) {
-            fs.remove(args.argv[1]);
-        } else {
-            terminal.writeLineColored("Usage: rm <path>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    
+    scriptDepth--;
+    pageAllocator.freeContiguous(script, pages);
+    return true;
+}
+
+// source FILE - выполнить команды из файла
+void cmdSource(CommandArgs& args) {
+    runScript(args.argv[1], *args.output);
+}
+
+// Разбор номера задания: "1" или "%1"
+static int parseJobId(const char* arg) {
+    if (*arg == '%') {
+        arg++;
+    }
+    
+    int id = 0;
+    while (*arg >= '0' && *arg <= '9') {
+        id = id * 10 + (*arg++ - '0');
+    }
+    return *arg ? -1 : id;
+}
+
+static void jobNotFound(const char* arg) {
+    terminal.writeColored("Error: No such job: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    terminal.writeLine(arg);
+}
+
+void cmdJobs(CommandArgs& args) {
+    jobTable.list(*args.output);
+}
+
+// fg JOB - ждать задание, передав ему клавиатуру
+void cmdFg(CommandArgs& args) {
+    if (!jobTable.foreground(parseJobId(args.argv[1]))) {
+        jobNotFound(args.argv[1]);
+    }
+}
+
+// kill JOB - прервать задание
+void cmdKill(CommandArgs& args) {
+    if (!jobTable.kill(parseJobId(args.argv[1]))) {
+        jobNotFound(args.argv[1]);
+    }
+}
+
+void cmdExit(CommandArgs&) {
+    terminal.writeLineColored("System shutdown not implemented.", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    terminal.writeLineColored("Use Ctrl+C in QEMU or reset your computer.", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+}
+
+// Реестр команд: единственное место, где перечислены команды оболочки.
+// По нему строятся диспетчеризация, справка и автодополнение.
+static constexpr Command commands[] = {
+    { "help",  cmdHelp,  "help",             "Show this help",                     0, 0 },
+    { "clear", cmdClear, "clear",            "Clear the screen",                   0, 0 },
+    { "ls",    cmdLs,    "ls [directory]",   "List files in a directory",          0, 1 },
+    { "cd",    cmdCd,    "cd <directory>",   "Change to directory",                1, 1 },
+    { "mkdir", cmdMkdir, "mkdir <directory>", "Create a new directory",            1, 1 },
+    { "touch", cmdTouch, "touch <filename>", "Create a new empty file",            1, 1 },
+    { "rm",    cmdRm,    "rm <path>",        "Remove a file or directory",         1, 1 },
+    { "cp",    cmdCp,    "cp [-r] <source> <target>", "Copy files, sharing their blocks", 2, 3 },
+    { "mv",    cmdMv,    "mv <source> <target>", "Move or rename a file or directory", 2, 2 },
+    { "cat",   cmdCat,   "cat [filename...]", "Display files or piped input",      0, -1 },
+    { "grep",  cmdGrep,  "grep [-ivcnF] <pattern> [file...]", "Print lines matching a pattern", 1, -1 },
+    { "wc",    cmdWc,    "wc [-lwc] [file...]", "Count lines, words and bytes",    0, -1 },
+    { "sort",  cmdSort,  "sort [-rnu] [file]", "Sort lines",                       0, -1 },
+    { "uniq",  cmdUniq,  "uniq [-cdu] [file]", "Collapse repeated adjacent lines", 0, -1 },
+    { "head",  cmdHead,  "head [-n N] [file]", "Print the first lines",            0, -1 },
+    { "tail",  cmdTail,  "tail [-n N] [file]", "Print the last lines",             0, -1 },
+    { "sync",  cmdSync,  "sync",             "Write file system changes to disk",  0, 0 },
+    { "fsck",  cmdFsck,  "fsck",             "Check block references and checksums", 0, 0 },
+    { "hostfs", cmdHostfs, "hostfs [directory]", "Show or move the host share mount (virtio-9p)", 0, 1 },
+    { "snapshot", cmdSnapshot, "snapshot [-r|-d|-l|-c] [name] [path]", "Create, list, browse or restore snapshots", 0, 3 },
+    { "compress", cmdCompress, "compress [-d] <file...>", "Compress files with LZ4 (-d to decompress)", 1, -1 },
+    { "search", cmdSearch, "search [-p] [word...]", "Find files containing all words (-p: as a phrase)", 0, -1 },
+    { "cache", cmdCache, "cache",            "Show cache, disk queue and journal statistics",     0, 0 },
+    { "edit",  cmdEdit,  "edit <filename>",  "Edit a file (simple text editor)",   1, 1 },
+    { "game",  cmdGame,  "game",             "Play Snake game",                    0, 0 },
+    { "chat",  cmdChat,  "chat",             "Chat with OmarOS bot",               0, 0 },
+    { "info",  cmdInfo,  "info",             "Show system information",            0, 0 },
+    { "source", cmdSource, "source <file>",  "Run commands from a script file",    1, 1 },
+    { "jobs",  cmdJobs,  "jobs",             "List background jobs",               0, 0 },
+    { "fg",    cmdFg,    "fg <job>",         "Wait for a background job",          1, 1 },
+    { "kill",  cmdKill,  "kill <job>",       "Interrupt a background job",         1, 1 },
+    { "exit",  cmdExit,  "exit",             "Shutdown the system",                0, 0 },
+};
+
+static constexpr int COMMAND_COUNT = sizeof(commands) / sizeof(commands[0]);
+static constexpr int COMMAND_TABLE_SIZE = perfectHashSize(COMMAND_COUNT);
+
+// Таблица идеального хеширования строится при компиляции
+static constexpr PerfectHash<COMMAND_TABLE_SIZE> commandTable = buildPerfectHash<COMMAND_TABLE_SIZE>(commands);
+static_assert(commandTable.seed != 0, "Command names must be unique");
+
+// Команда help - вывод справки, генерируется из реестра
+void cmdHelp(CommandArgs& args) {
+    OutputStream& out = *args.output;
+    unsigned char titleColor = terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    unsigned char cmdColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
+    unsigned char descColor = terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    
+    out.writeLineColored("Available commands:", titleColor);
+    
+    // Выравниваем описания по самой длинной строке синтаксиса
+    int width = 0;
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        int len = strlen(commands[i].usage);
+        if (len > width) {
+            width = len;
         }
     }
-    else if (strcmp(args.argv[0], "cat") == 0) {
-        if (args.argc > 1) {
-            fs.readFile(args.argv[1]);
-        } else {
-            terminal.writeLineColored("Usage: cat <filename>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        out.writeColored("  ", cmdColor);
+        out.writeColored(commands[i].usage, cmdColor);
+        for (int pad = strlen(commands[i].usage); pad < width; pad++) {
+            out.write(" ");
         }
+        out.writeColored(" - ", descColor);
+        out.writeLineColored(commands[i].description, descColor);
     }
-    else if (strcmp(args.argv[0], "edit") == 0) {
-        if (args.argc > 1) {
-            editor.edit(args.argv[1]);
+}
+
+// Выполнение одной команды с уже назначенными потоками ввода и вывода
+void executeCommand(CommandArgs& args) {
+    // Поиск команды в реестре
+    int index = lookupCommand(commandTable, commands, args.argv[0]);
+    if (index == -1) {
+        // Файл с именем команды выполняется как сценарий
+        int file = fs.findFile(args.argv[0]);
+        if (file != -1 && !fs.isDirectory(file)) {
+            runScript(args.argv[0], *args.output);
+            return;
+        }
+        
+        terminal.writeColored("Unknown command: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(args.argv[0]);
+        terminal.writeLineColored("Type 'help' for a list of commands.", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        return;
+    }
+    
+    // Проверка числа аргументов по описанию команды
+    const Command& command = commands[index];
+    int argCount = args.argc - 1;
+    if (argCount < command.minArgs || (command.maxArgs >= 0 && argCount > command.maxArgs)) {
+        terminal.writeColored("Usage: ", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        terminal.writeLineColored(command.usage, terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+        return;
+    }
+    
+    command.handler(args);
+}
+
+// Запуск конвейера: команды выполняются по очереди, промежуточный вывод
+// остается в страницах каналов и не отображается на экране
+void runPipeline(Pipeline& pipeline, OutputStream& output) {
+    // Ввод первой команды из файла передается по ссылке, файл хоста
+    // читается частями через буфер
+    int inputIndex = -1;
+    bool hostInput = pipeline.inputFile && fs.isHostFile(pipeline.inputFile);
+    HostInputStream hostStream;
+    if (hostInput) {
+        if (!fs.openHostInput(pipeline.inputFile, hostStream)) {
+            return;
+        }
+    } else if (pipeline.inputFile) {
+        inputIndex = fs.findFile(pipeline.inputFile);
+        if (inputIndex == -1 || fs.isDirectory(inputIndex)) {
+            terminal.writeColored("Error: Cannot read file: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            terminal.writeLine(pipeline.inputFile);
+            return;
+        }
+    }
+    FileInputStream fileInput(&fs, inputIndex);
+    InputStream* input = hostInput ? (InputStream*)&hostStream : pipeline.inputFile ? &fileInput : 0;
+    
+    Pipe pipes[2];
+    Pipe redirect;
+    
+    for (int i = 0; i < pipeline.stageCount; i++) {
+        bool last = (i == pipeline.stageCount - 1);
+        
+        CommandArgs& stage = pipeline.stages[i];
+        stage.input = input;
+        if (!last) {
+            stage.output = &pipes[i % 2];
+        } else if (pipeline.outputFile) {
+            stage.output = &redirect;
         } else {
-            terminal.writeLineColored("Usage: edit <filename>", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+            stage.output = &output;
+        }
+        
+        // Прерванный конвейер не запускает следующие команды
+        if (!scheduler.interruptRequested()) {
+            executeCommand(stage);
+        }
+        
+        // Канал, из которого читала эта команда, больше не нужен
+        if (i > 0) {
+            pipes[(i - 1) % 2].reset();
+        }
+        input = &pipes[i % 2];
+    }
+    
+    // Сохраняем вывод последней команды в файл: файл открывается один
+    // раз, пустой вывод все равно создает или очищает его
+    if (pipeline.outputFile && fs.isHostFile(pipeline.outputFile)) {
+        fs.writeHostOutput(pipeline.outputFile, redirect, pipeline.append);
+    } else if (pipeline.outputFile && fs.detachContent(pipeline.outputFile, redirect)) {
+        int fd = fileTable.open(pipeline.outputFile, FileTable::OPEN_WRITE | FileTable::OPEN_CREATE |
+                                (pipeline.append ? FileTable::OPEN_APPEND : FileTable::OPEN_TRUNCATE));
+        if (fd != -1) {
+            const char* data;
+            int length;
+            while ((length = redirect.read(data)) > 0) {
+                if (fileTable.write(fd, data, length) == -1) {
+                    terminal.writeLineColored("Error: Not enough memory for file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+                    break;
+                }
+            }
+            fileTable.close(fd);
         }
     }
-    else if (strcmp(args.argv[0], "game") == 0) {
-        snakeGame.run();
+    
+    pipes[0].reset();
+    pipes[1].reset();
+    redirect.reset();
+    fs.closeHostInput(hostStream);
+}
+
+// Обработка команд; вывод последней команды идет в output,
+// если он не перенаправлен в файл
+void processCommand(const char* cmd, OutputStream& output) {
+    // Если команда пустая, ничего не делаем
+    int length = strlen(cmd);
+    if (length == 0) {
+        return;
     }
-    else if (strcmp(args.argv[0], "chat") == 0) {
-        chatBot.run();
+    
+    // cmd & - запуск в фоновом задании
+    while (length > 0 && cmd[length - 1] == ' ') {
+        length--;
     }
-    else if (strcmp(args.argv[0], "info") == 0) {
-        cmdInfo(mbi);
+    if (length > 0 && cmd[length - 1] == '&') {
+        char line[256];
+        length--;
+        if (length > (int)sizeof(line) - 1) {
+            length = sizeof(line) - 1;
+        }
+        strncpy(line, cmd, length);
+        line[length] = '\0';
+        
+        int id = jobTable.start(line);
+        if (id == -1) {
+            terminal.writeLineColored("Error: Too many jobs.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return;
+        }
+        
+        char idStr[16];
+        itoa(id, idStr, 10);
+        terminal.write("[");
+        terminal.write(idStr);
+        terminal.writeLine("] started");
+        return;
     }
-    else if (strcmp(args.argv[0], "exit") == 0) {
-        terminal.writeLineColored("System shutdown not implemented.", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
-        terminal.writeLineColored("Use Ctrl+C in QEMU or reset your computer.", terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    
+    // Разбираем команду на конвейер
+    Pipeline pipeline;
+    if (!parseCommand(cmd, &pipeline)) {
+        return;
     }
-    else {
-        terminal.writeColored("Unknown command: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
-        terminal.writeLine(args.argv[0]);
-        terminal.writeLineColored("Type 'help' for a list of commands.", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    
+    // Если нет аргументов, выходим
+    if (pipeline.stages[0].argc == 0) {
+        return;
+    }
+    
+    runPipeline(pipeline, output);
+}
+
+// Поиск параметра NAME=VALUE в командной строке ядра
+bool getBootOption(const char* cmdline, const char* name, char* value, int maxLength) {
+    int nameLen = strlen(name);
+    
+    while (*cmdline) {
+        // Пропускаем пробелы между параметрами
+        while (*cmdline == ' ') {
+            cmdline++;
+        }
+        
+        if (strncmp(cmdline, name, nameLen) == 0 && cmdline[nameLen] == '=') {
+            const char* src = cmdline + nameLen + 1;
+            int len = 0;
+            while (src[len] && src[len] != ' ' && len < maxLength - 1) {
+                value[len] = src[len];
+                len++;
+            }
+            value[len] = '\0';
+            return len > 0;
+        }
+        
+        // Переходим к следующему параметру
+        while (*cmdline && *cmdline != ' ') {
+            cmdline++;
+        }
+    }
+    
+    return false;
+}
+
+// Поток отложенной записи: работает, пока остальные потоки ждут
+// (например, клавиатуру), и сбрасывает на диск давние изменения
+static void writeBackMain(void*) {
+    while (true) {
+        fs.writeBack();
+        scheduler.yield();
     }
 }
+
+// Таблица глобальных конструкторов (задается в linker.ld)
+typedef void (*Constructor)();
+extern "C" Constructor start_ctors[];
+extern "C" Constructor end_ctors[];
+
 // Точка входа в ядро
 extern "C" void kmain(unsigned long magic, unsigned long addr) {
     // Проверка, что загрузились через Multiboot
@@ -282,8 +842,33 @@ extern "C" void kmain(unsigned long magic, unsigned long addr) {
         return;
     }
     
+    // Вызываем конструкторы глобальных объектов
+    for (Constructor* ctor = start_ctors; ctor != end_ctors; ctor++) {
+        (*ctor)();
+    }
+    
     // Получаем информацию от Multiboot
     multiboot_info* mbi = (multiboot_info*)addr;
+    bootInfo = mbi;
+    
+    // Распределитель страниц; без сведений о памяти рассчитываем на 16 МБ
+    pageAllocator.initialize((mbi->flags & 0x1) ? mbi->mem_upper : 15 * 1024);
+    
+    // Модули загрузчика лежат за ядром: их страницы не должны достаться
+    // распределителю, архив initrd читается прямо из них
+    multiboot_module* modules = (mbi->flags & 0x8) ? (multiboot_module*)mbi->mods_addr : 0;
+    int moduleCount = modules ? mbi->mods_count : 0;
+    for (int i = 0; i < moduleCount; i++) {
+        pageAllocator.reserve(modules[i].mod_start, modules[i].mod_end);
+    }
+    
+    blockPool.initialize();
+    bufferCache.initialize();
+    crc32cInitialize();
+    
+    // Текущий поток становится потоком оболочки
+    scheduler.initialize();
+    jobTable.initialize();
     
     // Инициализация терминала
     terminal.initialize();
@@ -313,19 +898,91 @@ extern "C" void kmain(unsigned long magic, unsigned long addr) {
         terminal.writeLineColored((const char*)mbi->boot_loader_name, terminal.makeColor(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
     }
     
+    // Инициализация клавиатуры
+    keyboard.initialize();
+    
+    // Команды для автодополнения берутся из реестра
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        terminal.addCommand(commands[i].name);
+    }
+    
     terminal.writeLineColored("\nInitializing file system...", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
     
     // Инициализация файловой системы
     fs.initialize();
+    fileTable.initialize(&fs);
+    
+    // Архивы initrd из модулей подключаются поверх дерева только для чтения
+    for (int i = 0; i < moduleCount; i++) {
+        int count = fs.attachArchive((const char*)modules[i].mod_start, modules[i].mod_end - modules[i].mod_start);
+        if (count == -1) {
+            terminal.writeLineColored("Error: Boot module is not a valid tar archive.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            continue;
+        }
+        char countStr[16];
+        itoa(count, countStr, 10);
+        terminal.writeColored("Initrd: ", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        terminal.writeColored(countStr, terminal.makeColor(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        terminal.writeLineColored(" files (read-only)", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    }
+    
+    // Файловая система с диска, если он есть и отформатирован:
+    // virtio-blk быстрее эмулируемого IDE, поэтому проверяется первым
+    BlockDevice* disk = 0;
+    const char* diskMode = 0;
+    if (virtioDisk.initialize()) {
+        disk = &virtioDisk;
+        diskMode = virtioDisk.isModern() ? " MB, virtio" : " MB, virtio (legacy)";
+    } else if (ataDisk.initialize()) {
+        disk = &ataDisk;
+        diskMode = ataDisk.usesDma() ? " MB, DMA" : " MB, PIO";
+    }
+    
+    if (disk) {
+        char sizeStr[16];
+        itoa(disk->getSectorCount() / 2048, sizeStr, 10);
+        terminal.writeColored("Disk: ", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        terminal.writeColored(disk->getModel(), terminal.makeColor(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        terminal.writeColored(", ", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        terminal.writeColored(sizeStr, terminal.makeColor(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        terminal.writeLineColored(diskMode, terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        
+        if (fs.mount(disk)) {
+            terminal.writeLineColored("File system mounted from disk.", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+            scheduler.createThread(writeBackMain, 0);
+        }
+    }
+    
+    // Каталог хоста (QEMU -virtfs) подключается после диска: загрузка
+    // дерева с диска убрала бы точку подключения
+    if (hostShare.initialize() && fs.mountHost(&hostShare, "/host")) {
+        terminal.writeColored("Host share: ", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        terminal.writeColored(hostShare.getTag(), terminal.makeColor(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+        terminal.writeLineColored(" at /host (virtio-9p)", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    }
     
     terminal.writeLineColored("System initialized successfully!", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
     terminal.writeLineColored("Type 'help' for a list of available commands.", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     terminal.writeLine("");
     
+    // Сценарий автозапуска из командной строки ядра: autoexec=FILE
+    char autoexec[64];
+    if ((mbi->flags & 0x4) && mbi->cmdline &&
+        getBootOption((const char*)mbi->cmdline, "autoexec", autoexec, sizeof(autoexec))) {
+        terminal.writeColored("Running autoexec script: ", terminal.makeColor(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        terminal.writeLine(autoexec);
+        runScript(autoexec, terminal);
+        terminal.writeLine("");
+    }
+    
     char cmdBuffer[256];
     
     // Основной цикл командной строки
     while (true) {
+        // Ctrl+C, пришедший во время прошлой команды, уже обработан
+        scheduler.clearInterrupt();
+        jobTable.reportFinished();
+        
         // Вывод приглашения с цветом
         unsigned char promptColor = terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK);
         unsigned char pathColor = terminal.makeColor(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK);
@@ -338,6 +995,6 @@ extern "C" void kmain(unsigned long magic, unsigned long addr) {
         terminal.readLine(cmdBuffer, sizeof(cmdBuffer));
         
         // Обработка команды
-        processCommand(cmdBuffer, mbi);
+        processCommand(cmdBuffer, terminal);
     }
 }
\ No newline at end of file
@@ -0,0 +1,368 @@
+// keyboard.cpp
+#include "keyboard.h"
+#include "io.h"
+#include "thread.h"
+
+// Скан-коды модификаторов (набор 1)
+static const unsigned char SC_LEFT_CTRL = 0x1D;
+static const unsigned char SC_LEFT_SHIFT = 0x2A;
+static const unsigned char SC_RIGHT_SHIFT = 0x36;
+static const unsigned char SC_LEFT_ALT = 0x38;
+
+// Символы без Shift
+static const char normalMap[0x59] = {
+    0, 0, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', 0,
+    0, 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', 0,
+    0, 'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`',
+    0, '\\', 'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/', 0,
+    '*', 0, ' '
+};
+
+// Символы с Shift
+static const char shiftMap[0x59] = {
+    0, 0, '!', '@', '#', '$', '%', '^', '&', '*', '(', ')', '_', '+', 0,
+    0, 'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', 0,
+    0, 'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~',
+    0, '|', 'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?', 0,
+    '*', 0, ' '
+};
+
+// Цифровой блок (0x47-0x53) при включенном NumLock
+static const char keypadMap[] = {
+    '7', '8', '9', '-', '4', '5', '6', '+', '1', '2', '3', '0', '.'
+};
+
+// Клавиши цифрового блока без NumLock и их расширенные аналоги
+static int navigationKey(unsigned char code) {
+    switch (code) {
+        case 0x47: return KEY_HOME;
+        case 0x48: return KEY_UP;
+        case 0x49: return KEY_PAGE_UP;
+        case 0x4B: return KEY_LEFT;
+        case 0x4D: return KEY_RIGHT;
+        case 0x4F: return KEY_END;
+        case 0x50: return KEY_DOWN;
+        case 0x51: return KEY_PAGE_DOWN;
+        case 0x52: return KEY_INSERT;
+        case 0x53: return KEY_DELETE;
+    }
+    return KEY_NONE;
+}
+
+// Преобразование скан-кода в код клавиши
+static int translateKey(unsigned char code, bool extended) {
+    if (extended) {
+        switch (code) {
+            case 0x1C: return KEY_ENTER;
+            case 0x1D: return KEY_RIGHT_CTRL;
+            case 0x35: return '/';
+            case 0x37: return KEY_PRINT_SCREEN;
+            case 0x38: return KEY_RIGHT_ALT;
+            case 0x5B: return KEY_LEFT_GUI;
+            case 0x5C: return KEY_RIGHT_GUI;
+            case 0x5D: return KEY_MENU;
+        }
+        return navigationKey(code);
+    }
+
+    switch (code) {
+        case 0x01: return KEY_ESCAPE;
+        case 0x0E: return KEY_BACKSPACE;
+        case 0x0F: return KEY_TAB;
+        case 0x1C: return KEY_ENTER;
+        case 0x1D: return KEY_LEFT_CTRL;
+        case 0x2A: return KEY_LEFT_SHIFT;
+        case 0x36: return KEY_RIGHT_SHIFT;
+        case 0x38: return KEY_LEFT_ALT;
+        case 0x3A: return KEY_CAPS_LOCK;
+        case 0x45: return KEY_NUM_LOCK;
+        case 0x46: return KEY_SCROLL_LOCK;
+        case 0x4A: return '-';
+        case 0x4C: return '5';
+        case 0x4E: return '+';
+        case 0x57: return KEY_F11;
+        case 0x58: return KEY_F12;
+    }
+
+    if (code >= 0x3B && code <= 0x44) {
+        return KEY_F1 + (code - 0x3B);
+    }
+    if (code >= 0x47 && code <= 0x53) {
+        return navigationKey(code);
+    }
+    if (code < sizeof(normalMap) && normalMap[code]) {
+        return normalMap[code];
+    }
+    return KEY_NONE;
+}
+
+// Инициализация клавиатуры
+void Keyboard::initialize() {
+    queueHead = 0;
+    queueTail = 0;
+    modifiers = 0;
+    extendedPrefix = false;
+    pauseBytesLeft = 0;
+    for (int i = 0; i < 256; i++) {
+        keyState[i] = false;
+    }
+
+    // Сбрасываем все, что накопилось в буфере контроллера
+    while (inb(STATUS_PORT) & 0x01) {
+        inb(DATA_PORT);
+    }
+
+    updateLeds();
+
+    // Быстрый автоповтор для редактора и игры
+    setTypematic(TYPEMATIC_RATE_FASTEST, DELAY_250MS);
+}
+
+// Ожидание готовности контроллера принять байт
+bool Keyboard::waitInputEmpty() {
+    for (int i = 0; i < 100000; i++) {
+        if ((inb(STATUS_PORT) & 0x02) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Отправка команды клавиатуре с ожиданием подтверждения (0xFA)
+bool Keyboard::sendCommand(unsigned char command) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (!waitInputEmpty()) {
+            return false;
+        }
+        outb(DATA_PORT, command);
+
+        for (int i = 0; i < 100000; i++) {
+            if ((inb(STATUS_PORT) & 0x01) == 0) {
+                continue;
+            }
+
+            unsigned char response = inb(DATA_PORT);
+            if (response == 0xFA) {
+                return true;
+            }
+            if (response == 0xFE) {
+                break; // Просьба повторить команду
+            }
+        }
+    }
+    return false;
+}
+
+// Обновление индикаторов Caps/Num/Scroll Lock
+void Keyboard::updateLeds() {
+    unsigned char leds = 0;
+    if (modifiers & MOD_SCROLL_LOCK) leds |= 0x01;
+    if (modifiers & MOD_NUM_LOCK) leds |= 0x02;
+    if (modifiers & MOD_CAPS_LOCK) leds |= 0x04;
+
+    if (sendCommand(0xED)) {
+        sendCommand(leds);
+    }
+}
+
+// Настройка частоты и задержки автоповтора
+bool Keyboard::setTypematic(unsigned char rate, TypematicDelay delay) {
+    if (!sendCommand(0xF3)) {
+        return false;
+    }
+    return sendCommand((unsigned char)((delay << 5) | (rate & 0x1F)));
+}
+
+// Разбор очередного байта от контроллера
+bool Keyboard::decode(unsigned char data, KeyEvent& event) {
+    // Оставшиеся байты последовательности Pause не несут информации
+    if (pauseBytesLeft > 0) {
+        pauseBytesLeft--;
+        return false;
+    }
+
+    // Pause передается одной последовательностью без кода отпускания
+    if (data == 0xE1) {
+        pauseBytesLeft = 5;
+        event.key = KEY_PAUSE;
+        event.ascii = 0;
+        event.pressed = true;
+        event.extended = false;
+        event.scancode = 0;
+        event.modifiers = modifiers;
+        return true;
+    }
+
+    if (data == 0xE0) {
+        extendedPrefix = true;
+        return false;
+    }
+
+    // Служебные ответы клавиатуры
+    if (data == 0x00 || data == 0xFA || data == 0xFE || data == 0xEE || data == 0xFF) {
+        return false;
+    }
+
+    bool extended = extendedPrefix;
+    extendedPrefix = false;
+
+    bool released = (data & 0x80) != 0;
+    unsigned char code = data & 0x7F;
+
+    // Фиктивные Shift, которые клавиатура добавляет к расширенным клавишам
+    if (extended && (code == SC_LEFT_SHIFT || code == SC_RIGHT_SHIFT)) {
+        return false;
+    }
+
+    int stateIndex = code | (extended ? 0x80 : 0);
+    bool wasPressed = keyState[stateIndex];
+    keyState[stateIndex] = !released;
+
+    int key = translateKey(code, extended);
+
+    // Обновляем модификаторы
+    switch (key) {
+        case KEY_LEFT_SHIFT:
+        case KEY_RIGHT_SHIFT:
+            if (keyState[SC_LEFT_SHIFT] || keyState[SC_RIGHT_SHIFT]) modifiers |= MOD_SHIFT;
+            else modifiers &= ~MOD_SHIFT;
+            break;
+        case KEY_LEFT_CTRL:
+        case KEY_RIGHT_CTRL:
+            if (keyState[SC_LEFT_CTRL] || keyState[SC_LEFT_CTRL | 0x80]) modifiers |= MOD_CTRL;
+            else modifiers &= ~MOD_CTRL;
+            break;
+        case KEY_LEFT_ALT:
+        case KEY_RIGHT_ALT:
+            if (keyState[SC_LEFT_ALT] || keyState[SC_LEFT_ALT | 0x80]) modifiers |= MOD_ALT;
+            else modifiers &= ~MOD_ALT;
+            break;
+        case KEY_CAPS_LOCK:
+        case KEY_NUM_LOCK:
+        case KEY_SCROLL_LOCK:
+            // Переключаем только по первому нажатию, а не по автоповтору
+            if (!released && !wasPressed) {
+                if (key == KEY_CAPS_LOCK) modifiers ^= MOD_CAPS_LOCK;
+                else if (key == KEY_NUM_LOCK) modifiers ^= MOD_NUM_LOCK;
+                else modifiers ^= MOD_SCROLL_LOCK;
+                updateLeds();
+            }
+            break;
+    }
+
+    // Цифровой блок с включенным NumLock дает цифры
+    if (!extended && code >= 0x47 && code <= 0x53 && code != 0x4A && code != 0x4E &&
+        (modifiers & MOD_NUM_LOCK)) {
+        key = keypadMap[code - 0x47];
+    }
+
+    // Печатный символ с учетом Shift и CapsLock
+    char ascii = 0;
+    if (key >= 0x20 && key < 0x7F) {
+        ascii = (char)key;
+        if (!extended && code < sizeof(shiftMap) && normalMap[code] == key) {
+            bool shift = (modifiers & MOD_SHIFT) != 0;
+            if (key >= 'a' && key <= 'z' && (modifiers & MOD_CAPS_LOCK)) {
+                shift = !shift;
+            }
+            if (shift) {
+                ascii = shiftMap[code];
+            }
+        }
+    }
+
+    event.key = key;
+    event.ascii = ascii;
+    event.pressed = !released;
+    event.extended = extended;
+    event.scancode = code;
+    event.modifiers = modifiers;
+    return true;
+}
+
+// Ctrl+C - запрос прерывания
+bool Keyboard::isInterruptKey(const KeyEvent& event) {
+    return event.pressed && event.key == 'c' && (event.modifiers & MOD_CTRL);
+}
+
+// Прием всех доступных байтов от контроллера
+void Keyboard::pump() {
+    while (true) {
+        unsigned char status = inb(STATUS_PORT);
+        if ((status & 0x01) == 0) {
+            return;
+        }
+
+        unsigned char data = inb(DATA_PORT);
+
+        // Байты от мыши (второй порт 8042) пропускаем
+        if (status & 0x20) {
+            continue;
+        }
+
+        KeyEvent event;
+        if (!decode(data, event)) {
+            continue;
+        }
+
+        // Ctrl+C не попадает в очередь, а прерывает активный поток
+        if (isInterruptKey(event)) {
+            scheduler.interrupt(scheduler.getForeground());
+            continue;
+        }
+
+        // При переполнении теряем самые старые события
+        int next = (queueTail + 1) % QUEUE_SIZE;
+        if (next == queueHead) {
+            queueHead = (queueHead + 1) % QUEUE_SIZE;
+        }
+        queue[queueTail] = event;
+        queueTail = next;
+    }
+}
+
+// Неблокирующее чтение события
+bool Keyboard::poll(KeyEvent& event) {
+    pump();
+
+    if (!scheduler.isForeground() || queueHead == queueTail) {
+        return false;
+    }
+
+    event = queue[queueHead];
+    queueHead = (queueHead + 1) % QUEUE_SIZE;
+    return true;
+}
+
+// Ожидание любого события; пока ждем, работают другие потоки
+KeyEvent Keyboard::readEvent() {
+    KeyEvent event;
+    while (!poll(event)) {
+        // Прерванный поток не должен вечно ждать клавиатуру
+        if (scheduler.interruptRequested()) {
+            event.key = 'c';
+            event.ascii = 'c';
+            event.pressed = true;
+            event.extended = false;
+            event.scancode = 0x2E;
+            event.modifiers = MOD_CTRL;
+            return event;
+        }
+        scheduler.yield();
+    }
+    return event;
+}
+
+// Ожидание нажатия клавиши
+KeyEvent Keyboard::waitKeyPress() {
+    KeyEvent event;
+    do {
+        event = readEvent();
+    } while (!event.pressed);
+    return event;
+}
+
+// Проверка, нажата ли клавиша сейчас
+bool Keyboard::isPressed(unsigned char scancode, bool extended) const {
+    return keyState[(scancode & 0x7F) | (extended ? 0x80 : 0)];
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+// keyboard.h
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+// Коды клавиш. Для печатных клавиш код совпадает с ASCII-символом
+// без учета модификаторов, остальные клавиши имеют коды от 0x100.
+enum KeyCode {
+    KEY_NONE = 0,
+    KEY_BACKSPACE = '\b',
+    KEY_TAB = '\t',
+    KEY_ENTER = '\n',
+    KEY_ESCAPE = 0x1B,
+
+    KEY_UP = 0x100,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+    KEY_INSERT,
+    KEY_DELETE,
+    KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6,
+    KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
+    KEY_LEFT_SHIFT,
+    KEY_RIGHT_SHIFT,
+    KEY_LEFT_CTRL,
+    KEY_RIGHT_CTRL,
+    KEY_LEFT_ALT,
+    KEY_RIGHT_ALT,
+    KEY_CAPS_LOCK,
+    KEY_NUM_LOCK,
+    KEY_SCROLL_LOCK,
+    KEY_PRINT_SCREEN,
+    KEY_PAUSE,
+    KEY_MENU,
+    KEY_LEFT_GUI,
+    KEY_RIGHT_GUI
+};
+
+// Состояние модификаторов
+enum KeyModifier {
+    MOD_SHIFT = 1 << 0,
+    MOD_CTRL = 1 << 1,
+    MOD_ALT = 1 << 2,
+    MOD_CAPS_LOCK = 1 << 3,
+    MOD_NUM_LOCK = 1 << 4,
+    MOD_SCROLL_LOCK = 1 << 5
+};
+
+// Событие клавиатуры
+struct KeyEvent {
+    int key;                   // Код клавиши (KeyCode или ASCII)
+    char ascii;                // Символ с учетом Shift/CapsLock, 0 если непечатная
+    bool pressed;              // true - нажатие (или автоповтор), false - отпускание
+    bool extended;             // Скан-код с префиксом 0xE0
+    unsigned char scancode;    // Скан-код набора 1 без бита отпускания
+    unsigned char modifiers;   // Модификаторы на момент события
+};
+
+// Драйвер клавиатуры PS/2 (контроллер 8042, набор скан-кодов 1)
+class Keyboard {
+public:
+    // Частота автоповтора: 0 - 30 символов/с ... 31 - 2 символа/с
+    static const unsigned char TYPEMATIC_RATE_FASTEST = 0x00;
+    static const unsigned char TYPEMATIC_RATE_SLOWEST = 0x1F;
+
+    // Задержка перед автоповтором
+    enum TypematicDelay {
+        DELAY_250MS = 0,
+        DELAY_500MS = 1,
+        DELAY_750MS = 2,
+        DELAY_1000MS = 3
+    };
+
+private:
+    static const unsigned short DATA_PORT = 0x60;
+    static const unsigned short STATUS_PORT = 0x64;
+
+    static const int QUEUE_SIZE = 64;
+
+    // Очередь событий: байты от контроллера читает любой поток,
+    // а события получает только активный (foreground) поток
+    KeyEvent queue[QUEUE_SIZE];
+    int queueHead;
+    int queueTail;
+
+    unsigned char modifiers;
+    bool extendedPrefix;     // Получен префикс 0xE0
+    int pauseBytesLeft;      // Оставшиеся байты последовательности Pause (0xE1 ...)
+    bool keyState[256];      // Нажатые клавиши: скан-код, для расширенных | 0x80
+
+    bool waitInputEmpty();
+    bool sendCommand(unsigned char command);
+    void updateLeds();
+    bool decode(unsigned char data, KeyEvent& event);
+
+public:
+    void initialize();
+
+    // Прием байтов от контроллера в очередь; Ctrl+C сразу
+    // превращается в запрос прерывания активного потока
+    void pump();
+
+    // Неблокирующее чтение события (только для активного потока)
+    bool poll(KeyEvent& event);
+
+    // Блокирующее ожидание любого события (нажатия или отпускания).
+    // При запросе прерывания возвращает событие Ctrl+C.
+    KeyEvent readEvent();
+
+    // Блокирующее ожидание нажатия (отпускания пропускаются)
+    KeyEvent waitKeyPress();
+
+    // Настройка автоповтора через контроллер 8042
+    bool setTypematic(unsigned char rate, TypematicDelay delay);
+
+    bool isPressed(unsigned char scancode, bool extended = false) const;
+    static bool isInterruptKey(const KeyEvent& event);
+    unsigned char getModifiers() const { return modifiers; }
+};
+
+extern Keyboard keyboard;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,187 @@
+// lz4.cpp
+#include "lz4.h"
+#include "io.h"
+
+static const int MIN_MATCH = 4;
+static const int LAST_LITERALS = 5;     // Последние байты - всегда литералы
+static const int MATCH_LIMIT = 12;      // Совпадение начинается не ближе к концу
+static const int HASH_LOG = 12;
+
+// Позиции последних четверок байт; сжатие не уступает процессор,
+// поэтому одна таблица на всех
+static unsigned short hashTable[1 << HASH_LOG];
+
+static inline unsigned int read32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static inline unsigned int hashSequence(unsigned int sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// Продолжение длины сверх 15: байты 255 и остаток
+static inline unsigned char* writeLength(unsigned char* out, int length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+// Последовательность: токен, длина литералов, литералы, смещение и длина совпадения
+static unsigned char* writeSequence(unsigned char* out, const unsigned char* literals, int literalLength,
+                                    int offset, int matchLength) {
+    unsigned char* token = out++;
+    *token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+    if (literalLength >= 15) {
+        out = writeLength(out, literalLength - 15);
+    }
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if (offset) {
+        *out++ = (unsigned char)offset;
+        *out++ = (unsigned char)(offset >> 8);
+        matchLength -= MIN_MATCH;
+        *token |= (unsigned char)(matchLength >= 15 ? 15 : matchLength);
+        if (matchLength >= 15) {
+            out = writeLength(out, matchLength - 15);
+        }
+    }
+    return out;
+}
+
+// Худший размер последовательности вместе с байтами продолжения длин
+static inline int sequenceBound(int literalLength, int matchLength) {
+    return 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+}
+
+int lz4Compress(const char* source, int length, char* dest, int capacity) {
+    if (length < 0 || length > LZ4_MAX_INPUT) {
+        return 0;
+    }
+
+    const unsigned char* base = (const unsigned char*)source;
+    const unsigned char* end = base + length;
+    const unsigned char* anchor = base;
+    unsigned char* out = (unsigned char*)dest;
+    unsigned char* outEnd = out + capacity;
+
+    if (length > MATCH_LIMIT) {
+        memset(hashTable, 0, sizeof(hashTable));
+        const unsigned char* matchEnd = end - LAST_LITERALS;
+        const unsigned char* ip = base + 1;
+
+        while (ip < end - MATCH_LIMIT) {
+            unsigned int sequence = read32(ip);
+            unsigned int hash = hashSequence(sequence);
+            const unsigned char* ref = base + hashTable[hash];
+            hashTable[hash] = (unsigned short)(ip - base);
+            if (ref >= ip || read32(ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            // Совпадение расширяется назад по литералам и вперед
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const unsigned char* scan = ip + MIN_MATCH;
+            const unsigned char* match = ref + MIN_MATCH;
+            while (scan < matchEnd && *scan == *match) {
+                scan++;
+                match++;
+            }
+
+            int literalLength = ip - anchor;
+            int matchLength = scan - ip;
+            if (sequenceBound(literalLength, matchLength) > outEnd - out) {
+                return 0;
+            }
+            out = writeSequence(out, anchor, literalLength, ip - ref, matchLength);
+            ip = scan;
+            anchor = ip;
+        }
+    }
+
+    // Хвост - последовательность из одних литералов
+    int literalLength = end - anchor;
+    if (sequenceBound(literalLength, 0) - 3 > outEnd - out) {
+        return 0;
+    }
+    out = writeSequence(out, anchor, literalLength, 0, 0);
+    return out - (unsigned char*)dest;
+}
+
+int lz4Decompress(const char* source, int length, char* dest, int capacity) {
+    const unsigned char* in = (const unsigned char*)source;
+    const unsigned char* inEnd = in + length;
+    unsigned char* out = (unsigned char*)dest;
+    unsigned char* outEnd = out + capacity;
+
+    while (in < inEnd) {
+        unsigned int token = *in++;
+
+        int literalLength = token >> 4;
+        if (literalLength == 15) {
+            unsigned int extra;
+            do {
+                if (in >= inEnd) {
+                    return -1;
+                }
+                extra = *in++;
+                literalLength += extra;
+            } while (extra == 255);
+        }
+        if (literalLength > inEnd - in || literalLength > outEnd - out) {
+            return -1;
+        }
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        // Последняя последовательность состоит из одних литералов
+        if (in == inEnd) {
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            return -1;
+        }
+        int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out - (unsigned char*)dest) {
+            return -1;
+        }
+
+        int matchLength = token & 15;
+        if (matchLength == 15) {
+            unsigned int extra;
+            do {
+                if (in >= inEnd) {
+                    return -1;
+                }
+                extra = *in++;
+                matchLength += extra;
+            } while (extra == 255);
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > outEnd - out) {
+            return -1;
+        }
+
+        // Перекрывающееся совпадение (смещение меньше длины) копируется побайтно
+        const unsigned char* match = out - offset;
+        if (offset >= matchLength) {
+            memcpy(out, match, matchLength);
+        } else {
+            for (int i = 0; i < matchLength; i++) {
+                out[i] = match[i];
+            }
+        }
+        out += matchLength;
+    }
+    return out - (unsigned char*)dest;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+// lz4.h
+#ifndef LZ4_H
+#define LZ4_H
+
+// Кодек LZ4 (блочный формат): последовательности из литералов и ссылки
+// назад на совпадение не короче 4 байт. Сжатие жадное, по хеш-таблице
+// последних позиций; распаковка проверяет все границы и не выходит за
+// буферы на поврежденных данных.
+
+static const int LZ4_MAX_INPUT = 65536;     // Смещение ссылки - 16 бит
+
+// Сжатие length байт (не больше LZ4_MAX_INPUT). Возвращает размер
+// результата или 0, если он не помещается в capacity байт.
+int lz4Compress(const char* source, int length, char* dest, int capacity);
+
+// Распаковка; возвращает размер результата или -1 для поврежденных
+// данных и нехватки места
+int lz4Decompress(const char* source, int length, char* dest, int capacity);
+
+#endif
\ No newline at end of file
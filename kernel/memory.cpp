@@ -0,0 +1,125 @@
+// memory.cpp
+#include "memory.h"
+
+// Конец образа ядра (задается в linker.ld)
+extern "C" char kernel_end[];
+
+// Инициализация по размеру памяти выше 1 МБ из Multiboot
+void PageAllocator::initialize(unsigned int memUpperKB) {
+    for (unsigned int i = 0; i < MAX_PAGES / 32; i++) {
+        bitmap[i] = 0xFFFFFFFF;
+    }
+
+    unsigned int first = ((unsigned int)kernel_end + PAGE_SIZE - 1) / PAGE_SIZE;
+    unsigned int last = (0x100000 + memUpperKB * 1024) / PAGE_SIZE;
+    if (last > MAX_PAGES) {
+        last = MAX_PAGES;
+    }
+
+    totalPages = 0;
+    freePages = 0;
+    for (unsigned int page = first; page < last; page++) {
+        markFree(page);
+        totalPages++;
+    }
+    searchHint = first;
+}
+
+void PageAllocator::markUsed(unsigned int page) {
+    bitmap[page / 32] |= 1u << (page % 32);
+    freePages--;
+}
+
+void PageAllocator::markFree(unsigned int page) {
+    bitmap[page / 32] &= ~(1u << (page % 32));
+    freePages++;
+}
+
+// Выделение одной страницы
+void* PageAllocator::allocPage() {
+    if (freePages == 0) {
+        return 0;
+    }
+
+    // Проверяем по 32 страницы за раз, начиная с подсказки
+    unsigned int words = MAX_PAGES / 32;
+    unsigned int word = searchHint / 32;
+    for (unsigned int n = 0; n < words; n++, word = (word + 1) % words) {
+        if (bitmap[word] == 0xFFFFFFFF) {
+            continue;
+        }
+
+        for (unsigned int bit = 0; bit < 32; bit++) {
+            if ((bitmap[word] & (1u << bit)) == 0) {
+                unsigned int page = word * 32 + bit;
+                markUsed(page);
+                searchHint = page;
+                return (void*)(page * PAGE_SIZE);
+            }
+        }
+    }
+    return 0;
+}
+
+// Освобождение страницы
+void PageAllocator::freePage(void* address) {
+    unsigned int page = (unsigned int)address / PAGE_SIZE;
+    if (address == 0 || page >= MAX_PAGES || (bitmap[page / 32] & (1u << (page % 32))) == 0) {
+        return;
+    }
+
+    markFree(page);
+    if (page < searchHint) {
+        searchHint = page;
+    }
+}
+
+// Выделение смежных страниц: первый подходящий участок в битовой карте
+void* PageAllocator::allocContiguous(unsigned int count) {
+    if (count == 0 || count > freePages) {
+        return 0;
+    }
+    if (count == 1) {
+        return allocPage();
+    }
+
+    unsigned int run = 0;
+    for (unsigned int page = 0; page < MAX_PAGES; page++) {
+        // Полностью занятые слова пропускаем целиком
+        if (page % 32 == 0 && bitmap[page / 32] == 0xFFFFFFFF) {
+            run = 0;
+            page += 31;
+            continue;
+        }
+
+        if (bitmap[page / 32] & (1u << (page % 32))) {
+            run = 0;
+            continue;
+        }
+
+        if (++run == count) {
+            unsigned int first = page + 1 - count;
+            for (unsigned int p = first; p <= page; p++) {
+                markUsed(p);
+            }
+            return (void*)(first * PAGE_SIZE);
+        }
+    }
+    return 0;
+}
+
+void PageAllocator::freeContiguous(void* address, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        freePage((char*)address + i * PAGE_SIZE);
+    }
+}
+
+// Исключение диапазона адресов (например, модулей загрузчика)
+void PageAllocator::reserve(unsigned int start, unsigned int end) {
+    for (unsigned int page = start / PAGE_SIZE; page < (end + PAGE_SIZE - 1) / PAGE_SIZE && page < MAX_PAGES; page++) {
+        if ((bitmap[page / 32] & (1u << (page % 32))) == 0) {
+            markUsed(page);
+            totalPages--;
+        }
+    }
+}
\ No newline at end of file
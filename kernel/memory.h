@@ -0,0 +1,42 @@
+// memory.h
+#ifndef MEMORY_H
+#define MEMORY_H
+
+// Распределитель физических страниц памяти.
+// Свободные страницы отмечаются в битовой карте, поиск идет с последней
+// освобожденной или выделенной позиции.
+class PageAllocator {
+public:
+    static const unsigned int PAGE_SIZE = 4096;
+
+private:
+    static const unsigned int MAX_PAGES = 262144;   // Поддерживаем до 1 ГБ памяти
+
+    unsigned int bitmap[MAX_PAGES / 32];            // 1 - страница занята
+    unsigned int totalPages;
+    unsigned int freePages;
+    unsigned int searchHint;
+
+    void markUsed(unsigned int page);
+    void markFree(unsigned int page);
+
+public:
+    void initialize(unsigned int memUpperKB);
+
+    void* allocPage();
+    void freePage(void* page);
+
+    // Выделение нескольких смежных страниц (для больших буферов)
+    void* allocContiguous(unsigned int count);
+    void freeContiguous(void* address, unsigned int count);
+
+    // Исключение диапазона физических адресов из распределения
+    void reserve(unsigned int start, unsigned int end);
+
+    unsigned int getFreePages() const { return freePages; }
+    unsigned int getTotalPages() const { return totalPages; }
+};
+
+extern PageAllocator pageAllocator;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+// mmap.cpp
+#include "mmap.h"
+#include "filesystem.h"
+#include "memory.h"
+#include "io.h"
+
+FileMapping* FileMapping::active = 0;
+
+static const int PAGE_SIZE = PageAllocator::PAGE_SIZE;
+
+bool FileMapping::map(FileSystem* filesystem, int handle, int start, int size, bool writable) {
+    if (fs || !filesystem || start < 0 || size < 0 || handle == -1 || filesystem->isDirectory(handle)) {
+        return false;
+    }
+
+    int fileSize = filesystem->getFileSize(handle);
+    if (!writable) {
+        if (start > fileSize) {
+            return false;
+        }
+        if (size > fileSize - start) {
+            size = fileSize - start;
+        }
+    }
+
+    file = handle;
+    offset = start;
+    length = size;
+    writeAccess = writable;
+    direct = 0;
+    pages = 0;
+    pageCount = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    statePages = 0;
+    loaded = 0;
+    dirty = 0;
+    faults = 0;
+
+    // Содержимое в памяти одним куском читается по ссылке
+    const char* data;
+    if (size == 0) {
+        direct = "";
+    } else if (!writable && filesystem->isResident(handle) && filesystem->getContiguous(handle, start, data) >= size) {
+        direct = data;
+    } else {
+        unsigned int words = (pageCount + 31) / 32;
+        statePages = (words * 2 * sizeof(unsigned int) + PAGE_SIZE - 1) / PAGE_SIZE;
+        loaded = (unsigned int*)pageAllocator.allocContiguous(statePages);
+        pages = (char*)pageAllocator.allocContiguous(pageCount);
+        if (!loaded || !pages) {
+            if (loaded) {
+                pageAllocator.freeContiguous(loaded, statePages);
+            }
+            if (pages) {
+                pageAllocator.freeContiguous(pages, pageCount);
+            }
+            pages = 0;
+            return false;
+        }
+        dirty = loaded + words;
+        memset(loaded, 0, words * 2 * sizeof(unsigned int));
+    }
+
+    fs = filesystem;
+    next = active;
+    active = this;
+    return true;
+}
+
+bool FileMapping::unmap() {
+    if (!fs) {
+        return true;
+    }
+    bool written = sync();
+
+    FileMapping** link = &active;
+    while (*link != this) {
+        link = &(*link)->next;
+    }
+    *link = next;
+
+    if (pages) {
+        pageAllocator.freeContiguous(pages, pageCount);
+        pageAllocator.freeContiguous(loaded, statePages);
+        pages = 0;
+    }
+    direct = 0;
+    fs = 0;
+    return written;
+}
+
+// Страница заполняется из файла; за концом файла - нули
+bool FileMapping::fault(unsigned int page) {
+    char* target = pages + page * PAGE_SIZE;
+    int position = offset + page * PAGE_SIZE;
+    int wanted = length - page * PAGE_SIZE;
+    if (wanted > PAGE_SIZE) {
+        wanted = PAGE_SIZE;
+    }
+    int available = fs->getFileSize(file) - position;
+    if (wanted > available) {
+        wanted = (available > 0) ? available : 0;
+    }
+
+    int read = fs->readData(file, position, target, wanted);
+    if (read < wanted) {
+        return false;
+    }
+    memset(target + read, 0, PAGE_SIZE - read);
+    loaded[page / 32] |= 1u << (page % 32);
+    faults++;
+    return true;
+}
+
+bool FileMapping::ensure(int from, int count) {
+    if (!fs || from < 0 || count < 0 || from > length || count > length - from) {
+        return false;
+    }
+    if (direct || count == 0) {
+        return true;
+    }
+    for (unsigned int page = from / PAGE_SIZE; page <= (unsigned int)(from + count - 1) / PAGE_SIZE; page++) {
+        if (!(loaded[page / 32] & (1u << (page % 32))) && !fault(page)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* FileMapping::data(int from, int count) {
+    if (!ensure(from, count)) {
+        return 0;
+    }
+    return direct ? direct + from : pages + from;
+}
+
+char* FileMapping::writable(int from, int count) {
+    if (!writeAccess || !ensure(from, count)) {
+        return 0;
+    }
+    for (unsigned int page = from / PAGE_SIZE; count > 0 && page <= (unsigned int)(from + count - 1) / PAGE_SIZE; page++) {
+        dirty[page / 32] |= 1u << (page % 32);
+    }
+    return pages + from;
+}
+
+// Подряд идущие измененные страницы записываются одним вызовом
+bool FileMapping::sync() {
+    if (!fs || !writeAccess) {
+        return true;
+    }
+
+    bool written = true;
+    unsigned int page = 0;
+    while (page < pageCount) {
+        if (!(dirty[page / 32] & (1u << (page % 32)))) {
+            page++;
+            continue;
+        }
+        unsigned int first = page;
+        while (page < pageCount && (dirty[page / 32] & (1u << (page % 32)))) {
+            dirty[page / 32] &= ~(1u << (page % 32));
+            page++;
+        }
+
+        int from = first * PAGE_SIZE;
+        int end = page * PAGE_SIZE;
+        if (end > length) {
+            end = length;
+        }
+        if (!fs->writeData(file, offset + from, pages + from, end - from)) {
+            written = false;
+        }
+    }
+    return written;
+}
+
+bool FileMapping::syncAll() {
+    bool written = true;
+    for (FileMapping* mapping = active; mapping; mapping = mapping->next) {
+        if (!mapping->sync()) {
+            written = false;
+        }
+    }
+    return written;
+}
\ No newline at end of file
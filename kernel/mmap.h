@@ -0,0 +1,65 @@
+// mmap.h
+#ifndef MMAP_H
+#define MMAP_H
+
+class FileSystem;
+
+// Отображение участка файла в непрерывную память.
+//
+// Страничная адресация в ядре не включена, поэтому отображение строится
+// программно: под участок резервируются смежные страницы, а страница
+// заполняется из кэша буферов при первом обращении к ней через data()
+// ("программный промах страницы"). Измененные через writable() страницы
+// записываются в файл при sync(), unmap() и команде sync.
+//
+// Участок, который уже лежит в памяти одним куском (файл в памяти из
+// одного экстента или файл архива), отображается только для чтения
+// прямо, без страниц и без копирования.
+class FileMapping {
+private:
+    FileSystem* fs;
+    int file;
+    int offset;                 // Начало участка в файле
+    int length;
+    bool writeAccess;
+    const char* direct;         // Содержимое по ссылке, 0 - страницы
+    char* pages;
+    unsigned int pageCount;
+    unsigned int* loaded;       // Битовые карты страниц: заполнена,
+    unsigned int* dirty;        // изменена
+    unsigned int statePages;
+    unsigned int faults;
+    FileMapping* next;          // Список действующих отображений
+
+    static FileMapping* active;
+
+    bool fault(unsigned int page);
+    bool ensure(int from, int count);
+
+public:
+    FileMapping() : fs(0), direct(0), pages(0) {}
+
+    // Отображение length байт файла с offset. Только для чтения участок
+    // обрезается по концу файла; для записи может выходить за конец,
+    // файл растет при записи страниц.
+    bool map(FileSystem* fs, int file, int offset, int length, bool writable);
+    bool unmap();
+
+    // Адрес байта from; страницы участка [from, from + count)
+    // заполняются при необходимости. 0 - ошибка чтения или выход за участок.
+    const char* data(int from, int count);
+
+    // То же для записи: страницы участка помечаются измененными
+    char* writable(int from, int count);
+
+    // Запись измененных страниц в файл
+    bool sync();
+    static bool syncAll();
+
+    bool isMapped() const { return fs != 0; }
+    bool isDirect() const { return direct != 0; }
+    int getLength() const { return length; }
+    unsigned int getFaults() const { return faults; }
+};
+
+#endif
\ No newline at end of file
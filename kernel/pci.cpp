@@ -0,0 +1,144 @@
+// pci.cpp
+#include "pci.h"
+#include "io.h"
+
+static const unsigned short CONFIG_ADDRESS = 0xCF8;
+static const unsigned short CONFIG_DATA = 0xCFC;
+
+static const unsigned int COMMAND_IO = 0x01;
+static const unsigned int COMMAND_MEMORY = 0x02;
+static const unsigned int COMMAND_BUS_MASTER = 0x04;
+static const unsigned int STATUS_CAPABILITIES = 0x10;
+
+static unsigned int configRead(int bus, int slot, int function, unsigned char offset) {
+    outl(CONFIG_ADDRESS, 0x80000000u | (bus << 16) | (slot << 11) | (function << 8) | (offset & 0xFC));
+    return inl(CONFIG_DATA);
+}
+
+unsigned int pciRead(const PciDevice& device, unsigned char offset) {
+    return configRead(device.bus, device.slot, device.function, offset);
+}
+
+void pciWrite(const PciDevice& device, unsigned char offset, unsigned int value) {
+    outl(CONFIG_ADDRESS, 0x80000000u | (device.bus << 16) | (device.slot << 11) | (device.function << 8) | (offset & 0xFC));
+    outl(CONFIG_DATA, value);
+}
+
+// Полный перебор шин и слотов; функции 1-7 проверяются только
+// у многофункциональных устройств
+bool pciEnumerate(PciVisitor visit, void* context) {
+    for (int bus = 0; bus < 256; bus++) {
+        for (int slot = 0; slot < 32; slot++) {
+            for (int function = 0; function < 8; function++) {
+                unsigned int id = configRead(bus, slot, function, 0x00);
+                if ((id & 0xFFFF) == 0xFFFF) {
+                    if (function == 0) {
+                        break;
+                    }
+                    continue;
+                }
+
+                unsigned int classReg = configRead(bus, slot, function, 0x08);
+                PciDevice device;
+                device.bus = bus;
+                device.slot = slot;
+                device.function = function;
+                device.vendorId = id & 0xFFFF;
+                device.deviceId = id >> 16;
+                device.classCode = classReg >> 24;
+                device.subclass = (classReg >> 16) & 0xFF;
+                device.progIf = (classReg >> 8) & 0xFF;
+                if (visit(device, context)) {
+                    return true;
+                }
+
+                unsigned int header = configRead(bus, slot, function, 0x0C);
+                if (function == 0 && !((header >> 16) & 0x80)) {
+                    break;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Критерий поиска и найденное устройство
+struct PciQuery {
+    unsigned short vendorId;        // 0xFFFF - поиск по классу
+    unsigned short firstId;
+    unsigned short lastId;
+    unsigned char classCode;
+    unsigned char subclass;
+    PciDevice* result;
+};
+
+static bool matchQuery(const PciDevice& device, void* context) {
+    PciQuery* query = (PciQuery*)context;
+    bool match = (query->vendorId == 0xFFFF)
+        ? device.classCode == query->classCode && device.subclass == query->subclass
+        : device.vendorId == query->vendorId && device.deviceId >= query->firstId && device.deviceId <= query->lastId;
+    if (match) {
+        *query->result = device;
+    }
+    return match;
+}
+
+bool pciFindClass(unsigned char classCode, unsigned char subclass, PciDevice& device) {
+    PciQuery query = { 0xFFFF, 0, 0, classCode, subclass, &device };
+    return pciEnumerate(matchQuery, &query);
+}
+
+bool pciFindDevice(unsigned short vendorId, unsigned short firstId, unsigned short lastId, PciDevice& device) {
+    PciQuery query = { vendorId, firstId, lastId, 0, 0, &device };
+    return pciEnumerate(matchQuery, &query);
+}
+
+unsigned int pciGetBar(const PciDevice& device, int index, bool& io) {
+    if (index < 0 || index > 5) {
+        return 0;
+    }
+
+    unsigned int bar = pciRead(device, 0x10 + index * 4);
+    io = (bar & 0x01) != 0;
+    if (io) {
+        return bar & 0xFFFFFFFC;
+    }
+
+    // Тип 2 - 64-битный адрес, старшая половина в следующем BAR
+    if (((bar >> 1) & 0x03) == 2 && (index == 5 || pciRead(device, 0x10 + (index + 1) * 4) != 0)) {
+        return 0;
+    }
+    return bar & 0xFFFFFFF0;
+}
+
+unsigned char pciFindCapability(const PciDevice& device, unsigned char id, unsigned char after) {
+    if (!((pciRead(device, 0x04) >> 16) & STATUS_CAPABILITIES)) {
+        return 0;
+    }
+
+    unsigned char offset = after
+        ? (pciRead(device, after) >> 8) & 0xFC
+        : pciRead(device, 0x34) & 0xFC;
+
+    // Ограничение числа шагов защищает от зацикленного списка
+    for (int guard = 0; offset && guard < 48; guard++) {
+        unsigned int header = pciRead(device, offset);
+        if ((header & 0xFF) == id) {
+            return offset;
+        }
+        offset = (header >> 8) & 0xFC;
+    }
+    return 0;
+}
+
+// Старшая половина слова - регистр состояния: его биты сбрасываются
+// записью единиц, поэтому записывается только регистр команд
+void pciEnableBusMaster(const PciDevice& device) {
+    unsigned int command = pciRead(device, 0x04) & 0xFFFF;
+    pciWrite(device, 0x04, command | COMMAND_BUS_MASTER);
+}
+
+void pciEnableDevice(const PciDevice& device) {
+    unsigned int command = pciRead(device, 0x04) & 0xFFFF;
+    pciWrite(device, 0x04, command | COMMAND_IO | COMMAND_MEMORY | COMMAND_BUS_MASTER);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+// pci.h
+#ifndef PCI_H
+#define PCI_H
+
+// Адрес устройства на шине PCI и его идентификация
+struct PciDevice {
+    unsigned char bus;
+    unsigned char slot;
+    unsigned char function;
+    unsigned short vendorId;
+    unsigned short deviceId;
+    unsigned char classCode;
+    unsigned char subclass;
+    unsigned char progIf;
+};
+
+// Возвращает true, чтобы остановить перебор
+typedef bool (*PciVisitor)(const PciDevice& device, void* context);
+
+// Доступ к конфигурационному пространству (механизм #1, порты 0xCF8/0xCFC).
+// Смещение выравнивается на 4 байта.
+unsigned int pciRead(const PciDevice& device, unsigned char offset);
+void pciWrite(const PciDevice& device, unsigned char offset, unsigned int value);
+
+// Перебор всех функций всех устройств; true - перебор остановлен посетителем
+bool pciEnumerate(PciVisitor visit, void* context);
+
+// Первое устройство с данным классом и подклассом
+bool pciFindClass(unsigned char classCode, unsigned char subclass, PciDevice& device);
+
+// Первое устройство с данным производителем и одним из кодов в [firstId, lastId]
+bool pciFindDevice(unsigned short vendorId, unsigned short firstId, unsigned short lastId, PciDevice& device);
+
+// Базовый адрес BAR без служебных битов; 0 - BAR не задан или 64-битный
+// адрес не помещается в 32 бита. io - порт ввода-вывода, а не память.
+unsigned int pciGetBar(const PciDevice& device, int index, bool& io);
+
+// Смещение возможности (capability) с данным кодом после смещения after
+// (0 - с начала списка); 0 - не найдена
+unsigned char pciFindCapability(const PciDevice& device, unsigned char id, unsigned char after = 0);
+
+// Разрешение устройству работать с памятью напрямую (bus mastering)
+void pciEnableBusMaster(const PciDevice& device);
+
+// Включение декодирования портов и памяти вместе с bus mastering
+void pciEnableDevice(const PciDevice& device);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,295 @@
+// search.cpp
+#include "filesystem.h"
+#include "io.h"
+#include "terminal.h"
+
+// Индекс помнит, какие файлы изменились с последней индексации, и
+// переиндексирует их перед поиском: запись кусками через writeData не
+// разбирает файл на слова после каждого куска.
+void FileSystem::markStale(int index) {
+    indexStale[index / 32] |= 1u << (index % 32);
+}
+
+// Все документы удаляются, все записи считаются измененными: после
+// загрузки или восстановления снимка таблица записей заменена целиком
+void FileSystem::resetIndex() {
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (indexDocuments[i] != -1) {
+            textIndex.removeDocument(indexDocuments[i]);
+            indexDocuments[i] = -1;
+        }
+    }
+    memset(indexStale, 0xFF, sizeof(indexStale));
+}
+
+// Разбор содержимого на слова заново. false - индекс переполнен, файл
+// тогда остается без документа. Двоичные файлы (с нулевыми байтами) не
+// индексируются: случайные байты быстро исчерпали бы таблицу слов.
+bool FileSystem::indexFile(int index) {
+    indexStale[index / 32] &= ~(1u << (index % 32));
+    if (indexDocuments[index] != -1) {
+        textIndex.removeDocument(indexDocuments[index]);
+        indexDocuments[index] = -1;
+    }
+    if (!files[index].used || files[index].isDirectory) {
+        return true;
+    }
+
+    int document = textIndex.beginDocument(index, files[index].size);
+    if (document == -1) {
+        return false;
+    }
+
+    // Слово может начаться в одном участке и закончиться в следующем
+    int handle = makeHandle(index);
+    char word[TextIndex::MAX_TERM_LENGTH];
+    int length = 0;
+    int start = 0;
+    int offset = 0;
+    const char* data;
+    int count;
+    while ((count = getContiguous(handle, offset, data)) > 0) {
+        for (int i = 0; i < count; i++) {
+            unsigned char c = data[i];
+            if (c == 0) {
+                textIndex.removeDocument(document);
+                return true;
+            }
+            if (TextIndex::isWordChar(c)) {
+                if (length == 0) {
+                    start = offset + i;
+                }
+                if (length < TextIndex::MAX_TERM_LENGTH) {
+                    word[length] = TextIndex::fold(c);
+                }
+                length++;
+            } else if (length > 0) {
+                if (length <= TextIndex::MAX_TERM_LENGTH && !textIndex.addWord(word, length, start)) {
+                    textIndex.removeDocument(document);
+                    return false;
+                }
+                length = 0;
+            }
+        }
+        offset += count;
+    }
+    if (length > 0 && length <= TextIndex::MAX_TERM_LENGTH && !textIndex.addWord(word, length, start)) {
+        textIndex.removeDocument(document);
+        return false;
+    }
+
+    indexDocuments[index] = document;
+    return true;
+}
+
+// После уплотнения номера документов меняются
+bool FileSystem::compactIndex() {
+    if (!textIndex.compact()) {
+        return false;
+    }
+    for (int i = 0; i < MAX_FILES; i++) {
+        indexDocuments[i] = -1;
+    }
+    for (int d = 0; d < textIndex.getDocumentCount(); d++) {
+        indexDocuments[textIndex.getOwner(d)] = d;
+    }
+    return true;
+}
+
+// Переиндексация измененных файлов; false - места не хватило даже
+// после уплотнения, часть файлов осталась непроиндексированной
+bool FileSystem::refreshIndex() {
+    if (textIndex.needsCompaction()) {
+        compactIndex();
+    }
+    for (int w = 0; w < MAX_FILES / 32; w++) {
+        while (indexStale[w]) {
+            int bit = 0;
+            while (!(indexStale[w] & (1u << bit))) {
+                bit++;
+            }
+            int index = w * 32 + bit;
+            if (!indexFile(index) && !(compactIndex() && indexFile(index))) {
+                markStale(index);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Слова запроса: аргументы разбираются на слова так же, как файлы
+static int splitQuery(const char* const* args, int argCount, char (*words)[TextIndex::MAX_TERM_LENGTH + 1],
+                      int* lengths, int maxWords) {
+    int count = 0;
+    for (int a = 0; a < argCount; a++) {
+        for (const char* p = args[a]; *p; ) {
+            if (!TextIndex::isWordChar(*p)) {
+                p++;
+                continue;
+            }
+            if (count == maxWords) {
+                return -1;
+            }
+            int length = 0;
+            for (; TextIndex::isWordChar(*p); p++, length++) {
+                if (length < TextIndex::MAX_TERM_LENGTH) {
+                    words[count][length] = TextIndex::fold(*p);
+                }
+            }
+            lengths[count++] = length;
+        }
+    }
+    return count;
+}
+
+// Проверка фразы, которая начинается с вхождения первого слова в
+// cursors[0]: каждое следующее слово должно идти сразу за предыдущим,
+// между ними - только разделители. Курсоры сдвигаются только вперед:
+// у следующего кандидата цепочка слов лежит дальше.
+bool FileSystem::matchPhrase(int handle, TextIndex::Cursor* cursors, bool* active, const int* lengths, int count) {
+    static const int MAX_GAP = 64;
+    int document = cursors[0].document;
+    unsigned int position = cursors[0].offset;
+    for (int k = 1; k < count; k++) {
+        unsigned int expected = position + lengths[k - 1];
+        while (active[k] && cursors[k].document == document && cursors[k].offset < expected) {
+            active[k] = textIndex.next(cursors[k]);
+        }
+        if (!active[k] || cursors[k].document != document || cursors[k].offset - expected > (unsigned int)MAX_GAP) {
+            return false;
+        }
+
+        char gap[MAX_GAP];
+        int length = cursors[k].offset - expected;
+        if (readData(handle, expected, gap, length) != length) {
+            return false;
+        }
+        for (int i = 0; i < length; i++) {
+            if (TextIndex::isWordChar(gap[i])) {
+                return false;
+            }
+        }
+        position = cursors[k].offset;
+    }
+    return true;
+}
+
+// Поиск файлов со всеми словами: курсоры по спискам слов идут вместе,
+// отстающий курсор догоняет документ самого дальнего (seek)
+void FileSystem::searchText(const char* const* args, int argCount, bool phrase, OutputStream& out) {
+    static const int MAX_WORDS = 16;
+    static const int MAX_SHOWN = 8;
+    char words[MAX_WORDS][TextIndex::MAX_TERM_LENGTH + 1];
+    int lengths[MAX_WORDS];
+    int count = splitQuery(args, argCount, words, lengths, MAX_WORDS);
+    if (count == -1) {
+        terminal.writeLineColored("Error: Too many words in query.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+    if (count == 0) {
+        terminal.writeLineColored("Error: No words to search for.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return;
+    }
+
+    if (!refreshIndex()) {
+        terminal.writeLineColored("Warning: Search index is full, some files are not indexed.",
+                                  terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    }
+
+    // Слова длиннее предела не индексируются и не находятся
+    TextIndex::Cursor cursors[MAX_WORDS];
+    bool active[MAX_WORDS];
+    bool found = true;
+    for (int k = 0; k < count; k++) {
+        int term = textIndex.findTerm(words[k], lengths[k]);
+        if (term == -1) {
+            found = false;
+            break;
+        }
+        textIndex.open(term, cursors[k]);
+        active[k] = textIndex.next(cursors[k]);
+        found = found && active[k];
+    }
+
+    int matchedFiles = 0;
+    while (found) {
+        // Выравнивание всех курсоров по одному документу
+        int document = cursors[0].document;
+        bool aligned = true;
+        for (int k = 0; k < count && found; k++) {
+            if (!textIndex.seek(cursors[k], document)) {
+                found = false;
+            } else if (cursors[k].document > document) {
+                document = cursors[k].document;
+                aligned = false;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        if (!aligned) {
+            // Первый курсор догонит новый документ на следующем круге
+            found = textIndex.seek(cursors[0], document);
+            continue;
+        }
+
+        // Вхождения первого слова в документе: все или начала фразы
+        int index = textIndex.getOwner(document);
+        int handle = makeHandle(index);
+        unsigned int shown[MAX_SHOWN];
+        int matches = 0;
+        for (int k = 1; k < count; k++) {
+            active[k] = true;
+        }
+        do {
+            if (!phrase || matchPhrase(handle, cursors, active, lengths, count)) {
+                if (matches < MAX_SHOWN) {
+                    shown[matches] = cursors[0].offset;
+                }
+                matches++;
+            }
+            found = textIndex.next(cursors[0]);
+        } while (found && cursors[0].document == document);
+
+        // Курсоры, которые фраза довела до конца списка, дальше не нужны
+        for (int k = 1; k < count; k++) {
+            if (!active[k]) {
+                found = false;
+            }
+        }
+        if (matches == 0) {
+            continue;
+        }
+
+        char path[MAX_PATH_LENGTH];
+        char number[16];
+        buildPath(index, path);
+        out.writeColored(path, terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        out.write(": ");
+        itoa(matches, number, 10);
+        out.write(number);
+        out.write(" (at ");
+        for (int i = 0; i < matches && i < MAX_SHOWN; i++) {
+            if (i > 0) {
+                out.write(", ");
+            }
+            itoa(shown[i], number, 10);
+            out.write(number);
+        }
+        out.writeLine(matches > MAX_SHOWN ? ", ...)" : ")");
+        matchedFiles++;
+    }
+
+    if (matchedFiles == 0) {
+        out.writeLine("No matches.");
+    }
+}
+
+void FileSystem::printIndexStats(OutputStream& out) {
+    if (!refreshIndex()) {
+        terminal.writeLineColored("Warning: Search index is full, some files are not indexed.",
+                                  terminal.makeColor(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    }
+    textIndex.printStats(out);
+}
\ No newline at end of file
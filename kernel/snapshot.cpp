@@ -0,0 +1,340 @@
+// snapshot.cpp
+#include "filesystem.h"
+#include "io.h"
+#include "terminal.h"
+#include "stream.h"
+#include "blocks.h"
+#include "memory.h"
+#include "bcache.h"
+#include "clock.h"
+
+int FileSystem::findSnapshot(const char* name) {
+    for (int i = 0; i < snapshotCount; i++) {
+        if (strcmp(snapshots[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Снимок занимает блоки своих файлов еще одной ссылкой. Стоимость -
+// копирование таблиц метаданных и проход по экстентам, содержимое
+// файлов не копируется.
+bool FileSystem::createSnapshot(const char* name) {
+    if (!isValidFileName(name)) {
+        terminal.writeLineColored("Error: Invalid snapshot name.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    if (findSnapshot(name) != -1) {
+        terminal.writeColored("Error: Snapshot already exists: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return false;
+    }
+    if (snapshotCount == MAX_SNAPSHOTS) {
+        terminal.writeLineColored("Error: Maximum number of snapshots reached.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    char* memory = (char*)pageAllocator.allocContiguous(SNAPSHOT_PAGES);
+    if (!memory) {
+        terminal.writeLineColored("Error: Not enough memory for snapshot.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    if (!shareTree(files, extents)) {
+        pageAllocator.freeContiguous(memory, SNAPSHOT_PAGES);
+        terminal.writeLineColored("Error: Too many references to shared blocks.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    Snapshot& snapshot = snapshots[snapshotCount++];
+    strcpy(snapshot.name, name);
+    snapshot.memory = memory;
+    snapshot.files = (File*)memory;
+    snapshot.names = (char (*)[MAX_NAME_LENGTH + 1])(memory + sizeof(files));
+    snapshot.extents = (Extent*)(memory + sizeof(files) + sizeof(names));
+    memcpy(snapshot.files, files, sizeof(files));
+    memcpy(snapshot.names, names, sizeof(names));
+    memcpy(snapshot.extents, extents, sizeof(extents));
+    snapshot.freeList = freeList;
+    snapshot.freeExtents = freeExtents;
+    snapshot.created = clockSeconds();
+    
+    snapshot.fileCount = 0;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (files[i].used) {
+            snapshot.fileCount++;
+        }
+    }
+    
+    terminal.writeColored("Snapshot created: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(name);
+    return true;
+}
+
+// Дерево заменяется копией снимка: блоки снимка получают ссылку от
+// дерева, блоки прежнего дерева ее теряют. Старые дескрипторы файлов
+// устаревают, на диск при следующей записи уходят все метаданные.
+bool FileSystem::restoreSnapshot(const char* name) {
+    int index = findSnapshot(name);
+    if (index == -1) {
+        terminal.writeColored("Error: Snapshot not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return false;
+    }
+    const Snapshot& snapshot = snapshots[index];
+    
+    if (!shareTree(snapshot.files, snapshot.extents)) {
+        terminal.writeLineColored("Error: Too many references to shared blocks.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!files[i].used || files[i].isArchived) {
+            continue;
+        }
+        for (int e = files[i].firstExtent; e != -1; e = extents[e].next) {
+            dropBlocks(extents[e].start, extents[e].count);
+        }
+    }
+    
+    memcpy(files, snapshot.files, sizeof(files));
+    memcpy(names, snapshot.names, sizeof(names));
+    memcpy(extents, snapshot.extents, sizeof(extents));
+    freeList = snapshot.freeList;
+    freeExtents = snapshot.freeExtents;
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (i != ROOT) {
+            generations[i]++;
+        }
+    }
+    buildNameIndex();
+    chunkFile = -1;
+    resetIndex();
+    
+    if (!files[currentDir].used || !files[currentDir].isDirectory) {
+        currentDir = ROOT;
+    }
+    updateCurrentPath();
+    
+    memset(dirtyInodes, 0xFF, sizeof(dirtyInodes));
+    memset(dirtyExtents, 0xFF, sizeof(dirtyExtents));
+    memset(dirtyBitmap, 0xFF, sizeof(dirtyBitmap));
+    changes++;
+    
+    terminal.writeColored("Snapshot restored: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(name);
+    return true;
+}
+
+// Еще одна ссылка на блоки каждого файла таблицы: блок, общий для
+// нескольких копий файла, получает по ссылке от каждой. Если счетчик
+// какого-то блока переполнился бы, уже добавленные ссылки снимаются.
+bool FileSystem::shareTree(const File* table, const Extent* extentTable) {
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!table[i].used || table[i].isArchived) {
+            continue;
+        }
+        for (int e = table[i].firstExtent; e != -1; e = extentTable[e].next) {
+            if (blockPool.share(extentTable[e].start, extentTable[e].count)) {
+                continue;
+            }
+            for (int j = 0; j <= i; j++) {
+                if (!table[j].used || table[j].isArchived) {
+                    continue;
+                }
+                for (int f = table[j].firstExtent; f != -1 && !(j == i && f == e); f = extentTable[f].next) {
+                    blockPool.release(extentTable[f].start, extentTable[f].count);
+                }
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+// Блоки, на которые больше никто не ссылается, возвращаются в пул
+void FileSystem::destroySnapshot(int index) {
+    Snapshot& snapshot = snapshots[index];
+    for (int i = 0; i < MAX_FILES; i++) {
+        if (!snapshot.files[i].used || snapshot.files[i].isArchived) {
+            continue;
+        }
+        for (int e = snapshot.files[i].firstExtent; e != -1; e = snapshot.extents[e].next) {
+            dropBlocks(snapshot.extents[e].start, snapshot.extents[e].count);
+        }
+    }
+    pageAllocator.freeContiguous(snapshot.memory, SNAPSHOT_PAGES);
+    
+    for (int i = index; i < snapshotCount - 1; i++) {
+        snapshots[i] = snapshots[i + 1];
+    }
+    snapshotCount--;
+}
+
+bool FileSystem::deleteSnapshot(const char* name) {
+    int index = findSnapshot(name);
+    if (index == -1) {
+        terminal.writeColored("Error: Snapshot not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return false;
+    }
+    destroySnapshot(index);
+    
+    terminal.writeColored("Snapshot deleted: ", terminal.makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    terminal.writeLine(name);
+    return true;
+}
+
+void FileSystem::listSnapshots(OutputStream& out) {
+    if (snapshotCount == 0) {
+        out.writeLine("No snapshots.");
+        return;
+    }
+    
+    unsigned int now = clockSeconds();
+    for (int i = 0; i < snapshotCount; i++) {
+        char number[16];
+        out.writeColored(snapshots[i].name, terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+        out.write("  (");
+        itoa(snapshots[i].fileCount, number, 10);
+        out.write(number);
+        out.write(" entries, ");
+        itoa(clockElapsed(snapshots[i].created, now), number, 10);
+        out.write(number);
+        out.writeLine(" s ago)");
+    }
+}
+
+// Поиск по пути внутри снимка. Индекса имен у снимка нет, компоненты
+// ищутся проходом по каталогу - для просмотра этого достаточно.
+int FileSystem::snapshotEntry(const Snapshot& snapshot, const char* path) {
+    int index = ROOT;
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+        if (!*path) {
+            break;
+        }
+        
+        const char* end = path;
+        while (*end && *end != '/') {
+            end++;
+        }
+        int length = end - path;
+        
+        if (length == 2 && path[0] == '.' && path[1] == '.') {
+            index = snapshot.files[index].parent;
+        } else if (!(length == 1 && path[0] == '.')) {
+            if (!snapshot.files[index].isDirectory) {
+                return -1;
+            }
+            int child = snapshot.files[index].firstChild;
+            while (child != -1 && (strncmp(snapshot.names[child], path, length) != 0 || snapshot.names[child][length] != '\0')) {
+                child = snapshot.files[child].nextSibling;
+            }
+            if (child == -1) {
+                return -1;
+            }
+            index = child;
+        }
+        path = end;
+    }
+    return index;
+}
+
+bool FileSystem::listSnapshotDirectory(const char* name, const char* path, OutputStream& out) {
+    int index = findSnapshot(name);
+    if (index == -1) {
+        terminal.writeColored("Error: Snapshot not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return false;
+    }
+    const Snapshot& snapshot = snapshots[index];
+    
+    int dir = snapshotEntry(snapshot, path);
+    if (dir == -1 || !snapshot.files[dir].isDirectory) {
+        terminal.writeColored("Directory not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return false;
+    }
+    
+    listEntries(snapshot.files, snapshot.names, snapshot.extents, dir, out);
+    return true;
+}
+
+// Содержимое файла снимка копируется в поток: блоки снимка могут
+// освободиться раньше, чем читатель канала до них дойдет
+bool FileSystem::readSnapshotFile(const char* name, const char* path, OutputStream& out) {
+    int index = findSnapshot(name);
+    if (index == -1) {
+        terminal.writeColored("Error: Snapshot not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(name);
+        return false;
+    }
+    const Snapshot& snapshot = snapshots[index];
+    
+    int file = snapshotEntry(snapshot, path);
+    if (file == -1) {
+        terminal.writeColored("Error: File not found: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLine(path);
+        return false;
+    }
+    if (snapshot.files[file].isDirectory) {
+        terminal.writeColored("Error: ", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeColored(path, terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        terminal.writeLineColored(" is a directory.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        return false;
+    }
+    
+    if (out.isInteractive()) {
+        out.writeLineColored("--- File content ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    }
+    
+    int remaining = snapshot.files[file].size;
+    if (snapshot.files[file].isArchived) {
+        out.write(archiveData[file], remaining);
+        remaining = 0;
+    }
+    
+    // Сжатый файл распаковывается по фрагменту в буфер фрагментов дерева
+    for (int chunk = 0; snapshot.files[file].isCompressed && remaining > 0; chunk++) {
+        chunkFile = -1;
+        int length = unpackChunk(snapshot.extents, snapshot.files[file], chunk);
+        if (length < 0) {
+            terminal.writeLineColored("Error: Cannot read compressed file.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+            return false;
+        }
+        out.write(chunkData, length);
+        remaining -= length;
+    }
+    for (int e = snapshot.files[file].firstExtent; e != -1 && remaining > 0; e = snapshot.extents[e].next) {
+        const Extent& extent = snapshot.extents[e];
+        if (!device) {
+            int length = extent.count * BlockPool::BLOCK_SIZE;
+            length = (length < remaining) ? length : remaining;
+            if (verifyResident(extent.start, 0, length) < length) {
+                return false;
+            }
+            out.write(blockPool.address(extent.start), length);
+            remaining -= length;
+            continue;
+        }
+        
+        for (int i = 0; i < extent.count && remaining > 0; i++) {
+            const char* data = bufferCache.get(device, superblock.dataStart + extent.start + i, BufferCache::ACCESS_READ);
+            if (!data) {
+                terminal.writeLineColored("Error: Cannot read disk.", terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+                return false;
+            }
+            int length = (BlockPool::BLOCK_SIZE < remaining) ? BlockPool::BLOCK_SIZE : remaining;
+            out.write(data, length);
+            remaining -= length;
+        }
+    }
+    
+    if (out.isInteractive()) {
+        out.writeLine("");
+        out.writeLineColored("--- End of file ---", terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    }
+    return true;
+}
\ No newline at end of file
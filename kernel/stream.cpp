@@ -0,0 +1,234 @@
+// stream.cpp
+#include "stream.h"
+#include "memory.h"
+#include "io.h"
+#include "terminal.h"
+
+extern Terminal terminal;
+
+// По умолчанию поток отбрасывает данные
+void OutputStream::write(const char*, int) {
+}
+
+void OutputStream::writeColored(const char* str, unsigned char) {
+    write(str);
+}
+
+void OutputStream::write(const char* str) {
+    write(str, strlen(str));
+}
+
+void OutputStream::writeLine(const char* str) {
+    write(str);
+    write("\n", 1);
+}
+
+void OutputStream::writeLineColored(const char* str, unsigned char color) {
+    writeColored(str, color);
+    write("\n", 1);
+}
+
+void OutputStream::writeCounter(const char* name, unsigned int value) {
+    char number[16];
+    itoa(value, number, 10);
+    writeColored(name, terminal.makeColor(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    writeLine(number);
+}
+
+// Пустой поток ввода
+int InputStream::read(const char*&) {
+    return 0;
+}
+
+// Буфер в памяти отдается одним куском
+int MemoryInputStream::read(const char*& chunk) {
+    if (length == 0) {
+        return 0;
+    }
+
+    chunk = data;
+    int size = length;
+    length = 0;
+    return size;
+}
+
+// Пул описателей кусков, общий для всех каналов
+Pipe::Buffer Pipe::bufferPool[MAX_BUFFERS];
+Pipe::Buffer* Pipe::freeBuffers = 0;
+bool Pipe::poolInitialized = false;
+
+Pipe::Buffer* Pipe::allocBuffer() {
+    if (!poolInitialized) {
+        for (int i = 0; i < MAX_BUFFERS; i++) {
+            bufferPool[i].next = freeBuffers;
+            freeBuffers = &bufferPool[i];
+        }
+        poolInitialized = true;
+    }
+
+    Buffer* buffer = freeBuffers;
+    if (buffer) {
+        freeBuffers = buffer->next;
+        buffer->next = 0;
+        buffer->data = 0;
+        buffer->length = 0;
+        buffer->page = 0;
+    }
+    return buffer;
+}
+
+void Pipe::releaseBuffer(Buffer* buffer) {
+    if (buffer->page) {
+        pageAllocator.freePage(buffer->page);
+    }
+    buffer->next = freeBuffers;
+    freeBuffers = buffer;
+}
+
+void Pipe::append(Buffer* buffer) {
+    if (tail) {
+        tail->next = buffer;
+    } else {
+        head = buffer;
+    }
+    tail = buffer;
+    totalLength += buffer->length;
+}
+
+// Запись с копированием: мелкие записи собираются в страницы
+void Pipe::write(const char* data, int length) {
+    while (length > 0) {
+        // Дописываем в последнюю страницу канала, пока в ней есть место
+        if (!tail || !tail->page || tail->length == (int)PageAllocator::PAGE_SIZE) {
+            Buffer* buffer = allocBuffer();
+            if (!buffer) {
+                return;
+            }
+
+            buffer->page = (char*)pageAllocator.allocPage();
+            if (!buffer->page) {
+                releaseBuffer(buffer);
+                return;
+            }
+            buffer->data = buffer->page;
+            append(buffer);
+        }
+
+        int count = PageAllocator::PAGE_SIZE - tail->length;
+        if (count > length) {
+            count = length;
+        }
+
+        memcpy(tail->page + tail->length, data, count);
+        tail->length += count;
+        totalLength += count;
+        data += count;
+        length -= count;
+    }
+}
+
+// Запись по ссылке: канал запоминает только указатель и длину
+void Pipe::writeRef(const char* data, int length) {
+    if (length <= 0) {
+        return;
+    }
+
+    Buffer* buffer = allocBuffer();
+    if (!buffer) {
+        write(data, length);
+        return;
+    }
+
+    buffer->data = data;
+    buffer->length = length;
+    append(buffer);
+}
+
+bool Pipe::copyRefs(const char* start, int length) {
+    Buffer** link = &head;
+    while (*link) {
+        Buffer* buffer = *link;
+        if (buffer->page || buffer->data >= start + length || buffer->data + buffer->length <= start) {
+            link = &buffer->next;
+            continue;
+        }
+
+        // Копия по странице встает в цепочку на место ссылки
+        Buffer* first = 0;
+        Buffer* last = 0;
+        for (int done = 0; done < buffer->length; done += last->length) {
+            Buffer* copy = allocBuffer();
+            char* page = copy ? (char*)pageAllocator.allocPage() : 0;
+            if (!page) {
+                if (copy) {
+                    releaseBuffer(copy);
+                }
+                while (first) {
+                    Buffer* next = first->next;
+                    releaseBuffer(first);
+                    first = next;
+                }
+                return false;
+            }
+            copy->page = page;
+            copy->data = page;
+            copy->length = buffer->length - done;
+            if (copy->length > (int)PageAllocator::PAGE_SIZE) {
+                copy->length = PageAllocator::PAGE_SIZE;
+            }
+            memcpy(page, buffer->data + done, copy->length);
+            if (last) {
+                last->next = copy;
+            } else {
+                first = copy;
+            }
+            last = copy;
+        }
+
+        last->next = buffer->next;
+        *link = first;
+        if (tail == buffer) {
+            tail = last;
+        }
+        releaseBuffer(buffer);
+        link = &last->next;
+    }
+    return true;
+}
+
+// Чтение очередного куска; предыдущий кусок при этом освобождается
+int Pipe::read(const char*& data) {
+    if (current) {
+        releaseBuffer(current);
+        current = 0;
+    }
+
+    if (!head) {
+        return 0;
+    }
+
+    current = head;
+    head = head->next;
+    if (!head) {
+        tail = 0;
+    }
+
+    totalLength -= current->length;
+    data = current->data;
+    return current->length;
+}
+
+void Pipe::reset() {
+    if (current) {
+        releaseBuffer(current);
+        current = 0;
+    }
+
+    while (head) {
+        Buffer* next = head->next;
+        releaseBuffer(head);
+        head = next;
+    }
+    tail = 0;
+    totalLength = 0;
+}
\ No newline at end of file
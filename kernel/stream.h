@@ -0,0 +1,92 @@
+// stream.h
+#ifndef STREAM_H
+#define STREAM_H
+
+// Поток вывода команды: терминал, канал между командами или файл
+class OutputStream {
+public:
+    virtual void write(const char* data, int length);
+
+    // Вывод данных по ссылке, без копирования. Данные должны оставаться
+    // неизменными, пока их не прочитает получатель.
+    virtual void writeRef(const char* data, int length) { write(data, length); }
+
+    // Цвет учитывает только терминал, остальные потоки выводят текст как есть
+    virtual void writeColored(const char* str, unsigned char color);
+
+    // Поток выводится на экран (аналог isatty)
+    virtual bool isInteractive() { return false; }
+
+    void write(const char* str);
+    void writeLine(const char* str);
+    void writeLineColored(const char* str, unsigned char color);
+
+    // Строка статистики: название (на экране - бирюзовым) и число
+    void writeCounter(const char* name, unsigned int value);
+};
+
+// Поток ввода команды. Данные отдаются кусками по ссылке:
+// указатель действителен до следующего вызова read.
+class InputStream {
+public:
+    // Возвращает длину очередного куска, 0 - конец данных
+    virtual int read(const char*& data);
+};
+
+// Ввод из готового буфера в памяти (например, содержимого файла)
+class MemoryInputStream : public InputStream {
+private:
+    const char* data;
+    int length;
+
+public:
+    MemoryInputStream(const char* buffer, int size) : data(buffer), length(size) {}
+    int read(const char*& chunk) override;
+};
+
+// Канал между командами конвейера. Данные хранятся в страницах
+// по 4 КБ, а читатель получает их по ссылке без копирования.
+class Pipe : public OutputStream, public InputStream {
+private:
+    struct Buffer {
+        Buffer* next;
+        const char* data;
+        int length;
+        char* page;         // Собственная страница канала или 0 для внешних данных
+    };
+
+    static const int MAX_BUFFERS = 1024;
+    static Buffer bufferPool[MAX_BUFFERS];
+    static Buffer* freeBuffers;
+    static bool poolInitialized;
+
+    Buffer* head;
+    Buffer* tail;
+    Buffer* current;        // Кусок, отданный читателю последним
+    int totalLength;
+
+    static Buffer* allocBuffer();
+    static void releaseBuffer(Buffer* buffer);
+    void append(Buffer* buffer);
+
+public:
+    Pipe() : head(0), tail(0), current(0), totalLength(0) {}
+
+    using OutputStream::write;
+    void write(const char* data, int length) override;
+    void writeRef(const char* data, int length) override;
+    int read(const char*& data) override;
+
+    // Общий объем непрочитанных данных
+    int size() const { return totalLength; }
+
+    // Куски, переданные по ссылке и задевающие участок [start, start +
+    // length), заменяются копией в страницах канала: источник сейчас
+    // изменится. false - не хватило памяти; содержимое канала то же.
+    bool copyRefs(const char* start, int length);
+
+    // Освобождение всех страниц канала
+    void reset();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+// tar.cpp
+#include "tar.h"
+#include "io.h"
+
+// Поля заголовка ustar
+static const int FIELD_NAME = 0;
+static const int FIELD_SIZE = 124;
+static const int FIELD_CHECKSUM = 148;
+static const int FIELD_TYPE = 156;
+static const int FIELD_MAGIC = 257;
+static const int FIELD_PREFIX = 345;
+
+static const char TYPE_FILE = '0';
+static const char TYPE_FILE_OLD = '\0';
+static const char TYPE_DIRECTORY = '5';
+
+// Восьмеричное число в поле фиксированной длины; false - переполнение
+static bool parseOctal(const char* field, int length, unsigned int& value) {
+    value = 0;
+    int i = 0;
+    while (i < length && field[i] == ' ') {
+        i++;
+    }
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+        if (value > 0x1FFFFFFF) {
+            return false;
+        }
+        value = value * 8 + (field[i] - '0');
+    }
+    return true;
+}
+
+// Сумма байтов заголовка, поле суммы считается пробелами
+static bool checkHeader(const unsigned char* header) {
+    unsigned int expected;
+    if (!parseOctal((const char*)header + FIELD_CHECKSUM, 8, expected)) {
+        return false;
+    }
+
+    unsigned int sum = 0;
+    for (int i = 0; i < 512; i++) {
+        sum += (i >= FIELD_CHECKSUM && i < FIELD_CHECKSUM + 8) ? ' ' : header[i];
+    }
+    return sum == expected;
+}
+
+// Копия поля, которое может быть не завершено нулем
+static int copyField(char* dest, const char* field, int length) {
+    int i = 0;
+    while (i < length && field[i]) {
+        dest[i] = field[i];
+        i++;
+    }
+    dest[i] = '\0';
+    return i;
+}
+
+bool TarReader::next(TarEntry& entry) {
+    while (!damaged) {
+        if (size - offset < BLOCK_SIZE) {
+            damaged = offset != size;
+            return false;
+        }
+
+        const char* header = archive + offset;
+        if (header[FIELD_NAME] == '\0') {
+            return false;
+        }
+
+        unsigned int length;
+        if (strncmp(header + FIELD_MAGIC, "ustar", 5) != 0 ||
+            !checkHeader((const unsigned char*)header) ||
+            !parseOctal(header + FIELD_SIZE, 12, length) ||
+            length > size - offset - BLOCK_SIZE) {
+            damaged = true;
+            return false;
+        }
+
+        char type = header[FIELD_TYPE];
+        entry.data = header + BLOCK_SIZE;
+        entry.size = length;
+        entry.isDirectory = (type == TYPE_DIRECTORY);
+        offset += BLOCK_SIZE + (length + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        if (offset > size) {
+            offset = size;
+        }
+        if (type != TYPE_FILE && type != TYPE_FILE_OLD && type != TYPE_DIRECTORY) {
+            continue;
+        }
+
+        // Полный путь - префикс, "/" и имя
+        char path[TarEntry::MAX_PATH];
+        int pathLength = copyField(path, header + FIELD_PREFIX, 155);
+        if (pathLength > 0) {
+            path[pathLength++] = '/';
+        }
+        copyField(path + pathLength, header + FIELD_NAME, 100);
+
+        const char* start = path;
+        while (*start == '/' || (start[0] == '.' && start[1] == '/')) {
+            start += (*start == '/') ? 1 : 2;
+        }
+        strcpy(entry.path, start);
+
+        int end = strlen(entry.path);
+        while (end > 0 && entry.path[end - 1] == '/') {
+            entry.path[--end] = '\0';
+        }
+        // Запись самого корня ("./") ничего не добавляет
+        if (end == 0 || strcmp(entry.path, ".") == 0) {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+// tar.h
+#ifndef TAR_H
+#define TAR_H
+
+// Запись архива: путь без начальных "./" и "/", содержимое - указатель
+// прямо в память архива
+struct TarEntry {
+    static const int MAX_PATH = 260;            // Префикс, "/", имя и завершающий ноль
+
+    char path[MAX_PATH];
+    const char* data;
+    unsigned int size;
+    bool isDirectory;
+};
+
+// Разбор архива ustar на месте. Архив - последовательность заголовков
+// по 512 байт, за каждым содержимое, дополненное до 512 байт; конец -
+// нулевой заголовок. Записи других типов (ссылки, устройства, длинные
+// имена GNU) пропускаются.
+class TarReader {
+private:
+    static const unsigned int BLOCK_SIZE = 512;
+
+    const char* archive;
+    unsigned int size;
+    unsigned int offset;
+    bool damaged;
+
+public:
+    TarReader(const char* archive, unsigned int size) : archive(archive), size(size), offset(0), damaged(false) {}
+
+    // Следующий файл или каталог; false - конец архива или ошибка
+    bool next(TarEntry& entry);
+
+    // Архив оборван или заголовок не сходится с контрольной суммой
+    bool isDamaged() const { return damaged; }
+};
+
+#endif
\ No newline at end of file
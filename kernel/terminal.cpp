@@ -2,6 +2,7 @@
 #include "terminal.h"
 #include "io.h"
 #include "filesystem.h"
+#include "keyboard.h"
 
 // Инициализация терминала
 void Terminal::initialize() {
@@ -12,9 +13,16 @@ void Terminal::initialize() {
     currentColor = defaultColor;
     historyCount = 0;
     historyCurrent = -1;
+    completionPage = -1;
+    commandTrie.initialize();
     clear();
 }
 
+// Регистрация команды для автодополнения
+void Terminal::addCommand(const char* name) {
+    commandTrie.insert(name);
+}
+
 // Создание цветового атрибута
 unsigned char Terminal::makeColor(VgaColor fg, VgaColor bg) {
     return fg | (bg << 4);
@@ -43,9 +51,9 @@ void Terminal::clear() {
     updateCursor();
 }
 
-// Вывод строки
-void Terminal::write(const char* str) {
-    for (int i = 0; str[i] != '\0'; i++) {
+// Вывод данных заданной длины
+void Terminal::write(const char* str, int length) {
+    for (int i = 0; i < length; i++) {
         if (str[i] == '\n') {
             cursorY++;
             cursorX = 0;
@@ -91,18 +99,6 @@ void Terminal::writeColored(const char* str, unsigned char color) {
     setColor(oldColor);
 }
 
-// Вывод строки с переводом строки
-void Terminal::writeLine(const char* str) {
-    write(str);
-    write("\n");
-}
-
-// Вывод строки с переводом строки и цветом
-void Terminal::writeLineColored(const char* str, unsigned char color) {
-    writeColored(str, color);
-    write("\n");
-}
-
 // Добавление команды в историю
 void Terminal::addToHistory(const char* cmd) {
     // Не добавляем пустые команды или дубликаты последней команды
@@ -201,78 +197,112 @@ void Terminal::autoComplete(char* buffer, int& position) {
     // Если слово пустое, ничего не делаем
     if (wordLen == 0) return;
     
-    // Получаем список файлов и команд для автодополнения
-    const char* commands[] = {"help", "clear", "ls", "cd", "mkdir", "touch", "rm", "cat", "edit", "info", "exit", "game", "chat"};
-    int numCommands = sizeof(commands) / sizeof(commands[0]);
-    
-    // Проверяем команды
-    char matches[16][32];
-    int matchCount = 0;
-    
-    // Сначала проверяем команды
-    for (int i = 0; i < numCommands && matchCount < 16; i++) {
-        if (strncmp(word, commands[i], wordLen) == 0) {
-            strcpy(matches[matchCount++], commands[i]);
+    // Первое слово строки дополняем командами, остальные - именами файлов
+    bool firstWord = true;
+    for (int i = 0; i < wordStart; i++) {
+        if (buffer[i] != ' ') {
+            firstWord = false;
+            break;
         }
     }
     
-    // Затем проверяем файлы и директории
+    // Имя файла дополняется в каталоге, куда ведет путь до него: в дереве
+    // имен слово начинается с ключа этого каталога, который не выводится
     extern FileSystem fs;
-    fs.findMatches(word, wordLen, matches, matchCount, 16);
+    const CompletionTrie& trie = firstWord ? commandTrie : fs.getNameTrie();
+    char key[CompletionTrie::MAX_WORD_LENGTH];
+    int keyLen;
+    int hidden = 0;
+    if (firstWord) {
+        if (wordLen >= CompletionTrie::MAX_WORD_LENGTH) return;
+        strcpy(key, word);
+        keyLen = wordLen;
+    } else {
+        keyLen = fs.completionKey(word, wordLen, key);
+        if (keyLen == -1) return;
+        hidden = FileSystem::COMPLETION_KEY_LENGTH;
+    }
     
-    // Если есть только одно совпадение, автоматически дополняем
-    if (matchCount == 1) {
-        // Удаляем текущее слово
-        for (int i = 0; i < wordLen; i++) {
-            backspace(buffer, position);
-        }
-        
-        // Вставляем новое слово
-        const char* match = matches[0];
-        int matchLen = strlen(match);
-        for (int i = 0; i < matchLen; i++) {
-            insertChar(buffer, position, match[i]);
+    // Дополняем до наибольшего общего префикса всех совпадений
+    char completion[CompletionTrie::MAX_WORD_LENGTH];
+    int completionLen = trie.longestCommonPrefix(key, keyLen, completion);
+    if (completionLen > keyLen) {
+        for (int i = keyLen; i < completionLen; i++) {
+            insertChar(buffer, position, completion[i]);
         }
+        completionPage = -1;
+        return;
     }
-    // Если есть несколько совпадений, показываем их
-    else if (matchCount > 1) {
-        writeLine("");
-        for (int i = 0; i < matchCount; i++) {
-            write(matches[i]);
-            write("  ");
+    
+    int matchCount = trie.countMatches(key, keyLen);
+    if (matchCount < 2) return;
+    
+    // Повторное нажатие Tab на той же строке листает список совпадений
+    if (completionPage >= 0 && strcmp(completionLine, buffer) == 0) {
+        completionPage++;
+        if (completionPage * COMPLETION_PAGE_SIZE >= matchCount) {
+            completionPage = 0;
         }
-        writeLine("");
-        
-        // Выводим приглашение и текущую строку заново
-        extern FileSystem fs;
-        writeColored("root@OmarOS:", makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
-        writeColored(fs.getCurrentPath(), makeColor(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK));
-        writeColored("$ ", makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
-        write(buffer);
+    } else {
+        completionPage = 0;
+        strcpy(completionLine, buffer);
+    }
+    
+    char matches[COMPLETION_PAGE_SIZE][CompletionTrie::MAX_WORD_LENGTH];
+    int shown = trie.collect(key, keyLen, completionPage * COMPLETION_PAGE_SIZE, matches, COMPLETION_PAGE_SIZE);
+    
+    writeLine("");
+    for (int i = 0; i < shown; i++) {
+        write(matches[i] + hidden);
+        write("  ");
+    }
+    writeLine("");
+    
+    // Сообщаем, что есть еще страницы
+    if (matchCount > COMPLETION_PAGE_SIZE) {
+        char numStr[16];
+        writeColored("-- ", makeColor(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
+        itoa(completionPage * COMPLETION_PAGE_SIZE + shown, numStr, 10);
+        writeColored(numStr, makeColor(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
+        writeColored(" of ", makeColor(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
+        itoa(matchCount, numStr, 10);
+        writeColored(numStr, makeColor(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
+        writeLineColored(", press Tab for more --", makeColor(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
     }
+    
+    // Выводим приглашение и текущую строку заново
+    writeColored("root@OmarOS:", makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    writeColored(fs.getCurrentPath(), makeColor(VGA_COLOR_LIGHT_BLUE, VGA_COLOR_BLACK));
+    writeColored("$ ", makeColor(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    write(buffer);
 }
 
 // Чтение строки с клавиатуры с поддержкой истории команд
 void Terminal::readLine(char* buffer, int maxSize) {
     int i = 0;
     buffer[0] = '\0';
+    completionPage = -1;
     
     while (true) {
         // Ждем нажатия клавиши
-        while ((inb(0x64) & 1) == 0);
+        KeyEvent event = keyboard.waitKeyPress();
         
-        // Читаем скан-код
-        unsigned char scancode = inb(0x60);
+        // Ctrl+C - отмена ввода
+        if (Keyboard::isInterruptKey(event)) {
+            buffer[0] = '\0';
+            writeLine("^C");
+            return;
+        }
         
         // Enter (конец ввода)
-        if (scancode == 0x1C) {
+        if (event.key == KEY_ENTER) {
             buffer[i] = '\0';
             writeLine("");
             addToHistory(buffer);
             return;
         }
         // Backspace
-        else if (scancode == 0x0E && i > 0) {
+        else if (event.key == KEY_BACKSPACE && i > 0) {
             i--;
             buffer[i] = '\0';
             
@@ -288,7 +318,7 @@ void Terminal::readLine(char* buffer, int maxSize) {
             updateCursor();
         }
         // Стрелка вверх (предыдущая команда)
-        else if (scancode == 0x48) {
+        else if (event.key == KEY_UP) {
             const char* prevCmd = getPreviousCommand();
             if (prevCmd) {
                 // Очищаем текущую строку
@@ -312,7 +342,7 @@ void Terminal::readLine(char* buffer, int maxSize) {
             }
         }
         // Стрелка вниз (следующая команда)
-        else if (scancode == 0x50) {
+        else if (event.key == KEY_DOWN) {
             const char* nextCmd = getNextCommand();
             
             // Очищаем текущую строку
@@ -337,29 +367,18 @@ void Terminal::readLine(char* buffer, int maxSize) {
             }
         }
         // Tab (автодополнение)
-        else if (scancode == 0x0F) {
+        else if (event.key == KEY_TAB) {
             autoComplete(buffer, i);
         }
-        // Обычный символ
-        else if (scancode < 0x80) {
-            // Преобразование скан-кода в ASCII (упрощенно)
-            static const char scanToASCII[] = {
-                0, 0, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=', 0,
-                0, 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', 0,
-                0, 'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`',
-                0, '\\', 'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/', 0,
-                '*', 0, ' '
-            };
+        // Обычный символ (сочетания с Ctrl и Alt не печатаются)
+        else if (event.ascii && !(event.modifiers & (MOD_CTRL | MOD_ALT)) && i < maxSize - 1) {
+            char c = event.ascii;
+            buffer[i++] = c;
+            buffer[i] = '\0';
             
-            if (scancode < sizeof(scanToASCII) && scanToASCII[scancode] && i < maxSize - 1) {
-                char c = scanToASCII[scancode];
-                buffer[i++] = c;
-                buffer[i] = '\0';
-                
-                // Выводим символ
-                char str[2] = {c, '\0'};
-                write(str);
-            }
+            // Выводим символ
+            char str[2] = {c, '\0'};
+            write(str);
         }
     }
 }
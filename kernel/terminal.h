@@ -2,6 +2,9 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include "trie.h"
+#include "stream.h"
+
 // Константы для VGA текстового режима
 enum VgaColor {
     VGA_COLOR_BLACK = 0,
@@ -22,11 +25,12 @@ enum VgaColor {
     VGA_COLOR_WHITE = 15,
 };
 
-class Terminal {
+class Terminal : public OutputStream {
 private:
     static const int VGA_WIDTH = 80;
     static const int VGA_HEIGHT = 25;
     static const int CMD_HISTORY_SIZE = 10;
+    static const int COMPLETION_PAGE_SIZE = 16;
     
     unsigned short* videoMemory;
     int cursorX;
@@ -38,14 +42,22 @@ private:
     char cmdHistory[CMD_HISTORY_SIZE][256];
     int historyCount;
     int historyCurrent;
+    
+    // Автодополнение: дерево команд и состояние постраничного вывода
+    CompletionTrie commandTrie;
+    char completionLine[256];
+    int completionPage;
 
 public:
     void initialize();
     void clear();
-    void write(const char* str);
-    void writeLine(const char* str);
-    void writeColored(const char* str, unsigned char color);
-    void writeLineColored(const char* str, unsigned char color);
+    
+    // Терминал - поток вывода по умолчанию для команд
+    using OutputStream::write;
+    void write(const char* data, int length) override;
+    void writeColored(const char* str, unsigned char color) override;
+    bool isInteractive() override { return true; }
+    
     void readLine(char* buffer, int maxSize);
     void updateCursor();
     
@@ -66,6 +78,7 @@ public:
     int getHeight() { return VGA_HEIGHT; }
     
     // Методы для автодополнения
+    void addCommand(const char* name);
     void autoComplete(char* buffer, int& position);
     void backspace(char* buffer, int& position);
     void insertChar(char* buffer, int& position, char c);
@@ -0,0 +1,353 @@
+// textindex.cpp
+#include "textindex.h"
+#include "memory.h"
+#include "io.h"
+#include "stream.h"
+
+void TextIndex::initialize() {
+    termCount = 0;
+    for (int i = 0; i < HASH_SIZE; i++) {
+        slots[i] = -1;
+    }
+    textUsed = 0;
+    documentCount = 0;
+    current = -1;
+    freeChunks = 0;
+    chunkCount = 0;
+    usedChunks = 0;
+    liveTokens = 0;
+    deadTokens = 0;
+    compactions = 0;
+}
+
+// FNV-1a
+unsigned int TextIndex::hash(const char* word, int length) {
+    unsigned int value = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        value ^= (unsigned char)word[i];
+        value *= 16777619u;
+    }
+    return value;
+}
+
+int TextIndex::findTerm(const char* word, int length) const {
+    if (length <= 0 || length > MAX_TERM_LENGTH) {
+        return -1;
+    }
+    for (unsigned int slot = hash(word, length) & (HASH_SIZE - 1); slots[slot] != -1; slot = (slot + 1) & (HASH_SIZE - 1)) {
+        const Term& term = terms[slots[slot]];
+        if (term.length == length && memcmp(textPool + term.text, word, length) == 0) {
+            return slots[slot];
+        }
+    }
+    return -1;
+}
+
+int TextIndex::insertTerm(const char* word, int length) {
+    if (termCount == MAX_TERMS || textUsed + length > (unsigned int)TEXT_POOL) {
+        return -1;
+    }
+    unsigned int slot = hash(word, length) & (HASH_SIZE - 1);
+    while (slots[slot] != -1) {
+        slot = (slot + 1) & (HASH_SIZE - 1);
+    }
+
+    Term& term = terms[termCount];
+    term.head = 0;
+    term.tail = 0;
+    term.text = textUsed;
+    term.length = length;
+    term.tailUsed = 0;
+    term.lastDocument = -1;
+    term.lastOffset = 0;
+    term.documents = 0;
+    memcpy(textPool + textUsed, word, length);
+    textUsed += length;
+    slots[slot] = termCount;
+    return termCount++;
+}
+
+// Страница режется на блоки; в систему блоки не возвращаются,
+// освобожденные уплотнением идут в список свободных
+bool TextIndex::refillChunks() {
+    char* page = (char*)pageAllocator.allocPage();
+    if (!page) {
+        return false;
+    }
+    for (unsigned int i = 0; i < PageAllocator::PAGE_SIZE / CHUNK_SIZE; i++) {
+        Chunk* chunk = (Chunk*)(page + i * CHUNK_SIZE);
+        chunk->next = freeChunks;
+        freeChunks = chunk;
+    }
+    chunkCount += PageAllocator::PAGE_SIZE / CHUNK_SIZE;
+    return true;
+}
+
+void TextIndex::freeChain(Chunk* chunk) {
+    while (chunk) {
+        Chunk* next = chunk->next;
+        chunk->next = freeChunks;
+        freeChunks = chunk;
+        usedChunks--;
+        chunk = next;
+    }
+}
+
+// Вхождение занимает не больше 10 байт, то есть не больше одного нового
+// блока: блок берется заранее, и недописанного varint в списке не бывает
+bool TextIndex::append(Term& term, const unsigned char* bytes, int count) {
+    int room = term.tail ? CHUNK_DATA - term.tailUsed : 0;
+    if (room < count && !freeChunks && !refillChunks()) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!term.tail || term.tailUsed == CHUNK_DATA) {
+            Chunk* chunk = freeChunks;
+            freeChunks = chunk->next;
+            chunk->next = 0;
+            usedChunks++;
+            if (term.tail) {
+                term.tail->next = chunk;
+            } else {
+                term.head = chunk;
+            }
+            term.tail = chunk;
+            term.tailUsed = 0;
+        }
+        term.tail->data[term.tailUsed++] = bytes[i];
+    }
+    return true;
+}
+
+static int encodeVarint(unsigned int value, unsigned char* out) {
+    int count = 0;
+    while (value >= 0x80) {
+        out[count++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[count++] = (unsigned char)value;
+    return count;
+}
+
+// Запись вхождения после (lastDocument, lastOffset); возвращает длину
+static int encodePosting(int document, unsigned int offset, int lastDocument, unsigned int lastOffset, unsigned char* out) {
+    if (document == lastDocument) {
+        return encodeVarint((offset - lastOffset) << 1, out);
+    }
+    int count = encodeVarint(offset << 1 | 1, out);
+    return count + encodeVarint(document - lastDocument, out + count);
+}
+
+int TextIndex::beginDocument(int owner, unsigned int size) {
+    if (documentCount == MAX_DOCUMENTS) {
+        return -1;
+    }
+    current = documentCount++;
+    documents[current].owner = owner;
+    documents[current].tokens = 0;
+    documents[current].size = size;
+    return current;
+}
+
+bool TextIndex::addWord(const char* word, int length, unsigned int offset) {
+    if (length <= 0 || length > MAX_TERM_LENGTH) {
+        return true;
+    }
+    int index = findTerm(word, length);
+    if (index == -1 && (index = insertTerm(word, length)) == -1) {
+        return false;
+    }
+
+    Term& term = terms[index];
+    unsigned char bytes[10];
+    int count = encodePosting(current, offset, term.lastDocument, term.lastOffset, bytes);
+    if (!append(term, bytes, count)) {
+        return false;
+    }
+    if (term.lastDocument != current) {
+        term.documents++;
+    }
+    term.lastDocument = current;
+    term.lastOffset = offset;
+    documents[current].tokens++;
+    liveTokens++;
+    return true;
+}
+
+void TextIndex::removeDocument(int document) {
+    if (document < 0 || document >= documentCount || documents[document].owner == -1) {
+        return;
+    }
+    documents[document].owner = -1;
+    liveTokens -= documents[document].tokens;
+    deadTokens += documents[document].tokens;
+}
+
+bool TextIndex::needsCompaction() const {
+    return documentCount == MAX_DOCUMENTS || (deadTokens > liveTokens && deadTokens >= 65536);
+}
+
+void TextIndex::open(int term, Cursor& cursor) const {
+    cursor.chunk = terms[term].head;
+    cursor.position = 0;
+    cursor.tail = terms[term].tail;
+    cursor.tailUsed = terms[term].tailUsed;
+    cursor.document = -1;
+    cursor.offset = 0;
+}
+
+bool TextIndex::readVarint(Cursor& cursor, unsigned int& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (cursor.position == CHUNK_DATA && cursor.chunk != cursor.tail) {
+            cursor.chunk = cursor.chunk->next;
+            cursor.position = 0;
+        }
+        if (!cursor.chunk || (cursor.chunk == cursor.tail && cursor.position == cursor.tailUsed)) {
+            return false;
+        }
+        unsigned char byte = cursor.chunk->data[cursor.position++];
+        value |= (unsigned int)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TextIndex::next(Cursor& cursor) const {
+    unsigned int value;
+    while (readVarint(cursor, value)) {
+        if (value & 1) {
+            unsigned int delta;
+            if (!readVarint(cursor, delta)) {
+                return false;
+            }
+            cursor.document += delta;
+            cursor.offset = value >> 1;
+        } else {
+            cursor.offset += value >> 1;
+        }
+        if (documents[cursor.document].owner != -1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TextIndex::seek(Cursor& cursor, int document) const {
+    while (cursor.document < document) {
+        if (!next(cursor)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TextIndex::compact() {
+    unsigned int pages = (MAX_DOCUMENTS * sizeof(int) + PageAllocator::PAGE_SIZE - 1) / PageAllocator::PAGE_SIZE;
+    int* renumber = (int*)pageAllocator.allocContiguous(pages);
+    if (!renumber) {
+        return false;
+    }
+    int live = 0;
+    for (int i = 0; i < documentCount; i++) {
+        renumber[i] = documents[i].owner != -1 ? live++ : -1;
+    }
+
+    for (int i = 0; i < HASH_SIZE; i++) {
+        slots[i] = -1;
+    }
+    int kept = 0;
+    unsigned int text = 0;
+    for (int t = 0; t < termCount; t++) {
+        Term term = terms[t];
+
+        // Список переписывается поверх себя: номера документов и дельты
+        // только уменьшаются, поэтому запись не обгоняет чтение
+        Cursor reader;
+        open(t, reader);
+        Chunk* chunk = term.head;
+        int position = 0;
+        int lastDocument = -1;
+        unsigned int lastOffset = 0;
+        int count = 0;
+        while (next(reader)) {
+            int document = renumber[reader.document];
+            unsigned char bytes[10];
+            int length = encodePosting(document, reader.offset, lastDocument, lastOffset, bytes);
+            for (int i = 0; i < length; i++) {
+                if (position == CHUNK_DATA) {
+                    chunk = chunk->next;
+                    position = 0;
+                }
+                chunk->data[position++] = bytes[i];
+            }
+            if (document != lastDocument) {
+                count++;
+            }
+            lastDocument = document;
+            lastOffset = reader.offset;
+        }
+
+        if (count == 0) {
+            freeChain(term.head);
+            continue;
+        }
+        freeChain(chunk->next);
+        chunk->next = 0;
+        term.tail = chunk;
+        term.tailUsed = position;
+        term.lastDocument = lastDocument;
+        term.lastOffset = lastOffset;
+        term.documents = count;
+
+        // Слова в пуле лежат в порядке номеров, сдвиг идет только вниз
+        for (int i = 0; i < term.length; i++) {
+            textPool[text + i] = textPool[term.text + i];
+        }
+        term.text = text;
+        text += term.length;
+
+        unsigned int slot = hash(textPool + term.text, term.length) & (HASH_SIZE - 1);
+        while (slots[slot] != -1) {
+            slot = (slot + 1) & (HASH_SIZE - 1);
+        }
+        slots[slot] = kept;
+        terms[kept++] = term;
+    }
+    termCount = kept;
+    textUsed = text;
+
+    for (int i = 0; i < documentCount; i++) {
+        if (renumber[i] != -1) {
+            documents[renumber[i]] = documents[i];
+        }
+    }
+    documentCount = live;
+    current = -1;
+    deadTokens = 0;
+    compactions++;
+    pageAllocator.freeContiguous(renumber, pages);
+    return true;
+}
+
+
+void TextIndex::printStats(OutputStream& out) {
+    unsigned int files = 0;
+    unsigned int size = 0;
+    for (int i = 0; i < documentCount; i++) {
+        if (documents[i].owner != -1) {
+            files++;
+            size += documents[i].size;
+        }
+    }
+    out.writeCounter("  Files:        ", files);
+    out.writeCounter("  Text bytes:   ", size);
+    out.writeCounter("  Words:        ", termCount);
+    out.writeCounter("  Postings:     ", liveTokens);
+    out.writeCounter("  Stale:        ", deadTokens);
+    out.writeCounter("  Index bytes:  ", usedChunks * CHUNK_SIZE + textUsed);
+    out.writeCounter("  Free chunks:  ", chunkCount - usedChunks);
+    out.writeCounter("  Compactions:  ", compactions);
+}
\ No newline at end of file
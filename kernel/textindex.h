@@ -0,0 +1,126 @@
+// textindex.h
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+class OutputStream;
+
+// Инвертированный индекс содержимого: слово -> вхождения (документ,
+// смещение в байтах). Документ - одна проиндексированная версия файла:
+// при переиндексации файл получает новый документ, а старый только
+// помечается удаленным. Поэтому списки вхождений лишь дописываются и
+// номера документов в них возрастают; удаленные вхождения убирает
+// уплотнение, когда их становится больше живых.
+//
+// Вхождение - varint от (дельта смещения << 1 | новый документ). У
+// первого вхождения документа следом идет varint дельты номера
+// документа, а смещение отсчитывается от начала файла. Списки лежат
+// цепочками блоков по 64 байта, блоки нарезаются из страниц.
+class TextIndex {
+public:
+    static const int MAX_TERM_LENGTH = 31;
+    static const int MAX_DOCUMENTS = 16384;
+
+private:
+    static const int MAX_TERMS = 16384;
+    static const int HASH_SIZE = 32768;             // Степень двойки
+    static const int TEXT_POOL = 131072;
+    static const int CHUNK_SIZE = 64;
+    static const int CHUNK_DATA = CHUNK_SIZE - sizeof(void*);
+
+    struct Chunk {
+        Chunk* next;
+        unsigned char data[CHUNK_DATA];
+    };
+
+    struct Term {
+        Chunk* head;
+        Chunk* tail;
+        unsigned int text;          // Начало слова в textPool
+        unsigned char length;
+        unsigned char tailUsed;
+        int lastDocument;           // Документ последнего вхождения, -1 - список пуст
+        unsigned int lastOffset;
+        int documents;              // Документов в списке, включая удаленные
+    };
+
+    struct Document {
+        int owner;                  // Дескриптор файла, -1 - документ удален
+        unsigned int tokens;
+        unsigned int size;
+    };
+
+    Term terms[MAX_TERMS];
+    int termCount;
+    short slots[HASH_SIZE];         // Номер слова или -1
+    char textPool[TEXT_POOL];
+    unsigned int textUsed;
+
+    Document documents[MAX_DOCUMENTS];
+    int documentCount;
+    int current;                    // Документ, который сейчас индексируется
+
+    Chunk* freeChunks;
+    unsigned int chunkCount;        // Всего нарезано блоков
+    unsigned int usedChunks;
+    unsigned int liveTokens;
+    unsigned int deadTokens;
+    unsigned int compactions;
+
+    static unsigned int hash(const char* word, int length);
+    int insertTerm(const char* word, int length);
+    bool refillChunks();
+    void freeChain(Chunk* chunk);
+    bool append(Term& term, const unsigned char* bytes, int count);
+
+public:
+    // Курсор по вхождениям одного слова в порядке (документ, смещение)
+    struct Cursor {
+        const Chunk* chunk;
+        int position;
+        const Chunk* tail;
+        int tailUsed;
+        int document;               // Текущее вхождение
+        unsigned int offset;
+    };
+
+private:
+    static bool readVarint(Cursor& cursor, unsigned int& value);
+
+public:
+
+    void initialize();
+
+    // Буквы, цифры, '_' и байты UTF-8 входят в слова; ASCII без регистра
+    static bool isWordChar(unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+    }
+    static char fold(char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+
+    // Индексация: beginDocument, затем слова (уже в нижнем регистре) по
+    // возрастанию смещений. beginDocument возвращает номер документа,
+    // -1 - номера кончились; addWord - false, если кончилось место
+    // (документ тогда нужно удалить).
+    int beginDocument(int owner, unsigned int size);
+    bool addWord(const char* word, int length, unsigned int offset);
+    void removeDocument(int document);
+
+    // Уплотнение: удаленные вхождения и слова без вхождений выбрасываются,
+    // документы нумеруются заново подряд. Списки переписываются на месте.
+    bool needsCompaction() const;
+    bool compact();
+
+    int getDocumentCount() const { return documentCount; }
+    int getOwner(int document) const { return documents[document].owner; }
+
+    // Поиск: слово -> номер (-1 - нет), курсор на начало списка.
+    // next и seek пропускают удаленные документы.
+    int findTerm(const char* word, int length) const;
+    int getTermDocuments(int term) const { return terms[term].documents; }
+    void open(int term, Cursor& cursor) const;
+    bool next(Cursor& cursor) const;
+    bool seek(Cursor& cursor, int document) const;
+
+    void printStats(OutputStream& out);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,931 @@
+// textutils.cpp
+#include "textutils.h"
+#include "terminal.h"
+#include "filesystem.h"
+#include "stream.h"
+#include "memory.h"
+#include "mmap.h"
+#include "io.h"
+#include "thread.h"
+
+extern FileSystem fs;
+
+// Весь ввод команды одним блоком
+struct TextBlock {
+    const char* data;
+    int size;
+    char* pages;                // Смежные страницы с копией ввода из канала
+    unsigned int pageCount;
+    FileMapping mapping;        // Отображение файла
+};
+
+// Ссылка на строку для сортировки: первые байты (или число при -n)
+// лежат в key, поэтому большинство сравнений не обращается к тексту
+struct LineRef {
+    const char* text;
+    int length;
+    unsigned int key;
+};
+
+static void printError(const char* message, const char* detail) {
+    terminal.writeColored(message, terminal.makeColor(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+    terminal.writeLine(detail);
+}
+
+// Разбор неотрицательного числа
+static bool parseNumber(const char* str, int& value) {
+    value = 0;
+    if (*str == '\0') {
+        return false;
+    }
+    while (*str >= '0' && *str <= '9') {
+        value = value * 10 + (*str++ - '0');
+    }
+    return *str == '\0';
+}
+
+// Разбор флагов вида -abc: бит i соответствует i-й букве allowed.
+// Если count задан, понимаются также -n N и -N. Возвращает индекс
+// первого операнда или -1 при ошибке.
+static int parseOptions(CommandArgs& args, const char* allowed, unsigned int& flags, int* count) {
+    flags = 0;
+
+    int i = 1;
+    for (; i < args.argc; i++) {
+        const char* arg = args.argv[i];
+        if (arg[0] != '-' || arg[1] == '\0') {
+            break;
+        }
+        if (strcmp(arg, "--") == 0) {
+            return i + 1;
+        }
+
+        if (count && arg[1] >= '0' && arg[1] <= '9') {
+            if (!parseNumber(arg + 1, *count)) {
+                printError("Error: Invalid line count: ", arg);
+                return -1;
+            }
+            continue;
+        }
+
+        for (const char* c = arg + 1; *c; c++) {
+            if (count && *c == 'n') {
+                const char* value = c[1] ? c + 1 : (i + 1 < args.argc ? args.argv[++i] : 0);
+                if (!value || !parseNumber(value, *count)) {
+                    printError("Error: Invalid line count: ", value ? value : arg);
+                    return -1;
+                }
+                break;
+            }
+
+            const char* pos = allowed;
+            while (*pos && *pos != *c) {
+                pos++;
+            }
+            if (*pos == '\0') {
+                printError("Error: Unknown option: ", arg);
+                return -1;
+            }
+            flags |= 1u << (pos - allowed);
+        }
+    }
+    return i;
+}
+
+static void releaseText(TextBlock& block) {
+    block.mapping.unmap();
+    if (block.pages) {
+        pageAllocator.freeContiguous(block.pages, block.pageCount);
+        block.pages = 0;
+    }
+}
+
+// Файл отображается в память (по ссылке, если он лежит в памяти одним
+// куском), ввод из канала собирается в смежные страницы
+static bool loadText(CommandArgs& args, const char* name, TextBlock& block) {
+    block.data = "";
+    block.size = 0;
+    block.pages = 0;
+    block.pageCount = 0;
+
+    int index = -1;
+    if (name) {
+        index = fs.findFile(name);
+        if (index == -1 || fs.isDirectory(index)) {
+            printError("Error: Cannot read file: ", name);
+            return false;
+        }
+
+        // Страницы отображения заполняются из кэша диска сразу целиком:
+        // буфер кэша может быть вытеснен во время работы команды
+        const char* data = 0;
+        if (!block.mapping.map(&fs, index, 0, fs.getFileSize(index), false) ||
+            !(data = block.mapping.data(0, block.mapping.getLength()))) {
+            block.mapping.unmap();
+            printError("Error: Cannot read file: ", name);
+            return false;
+        }
+        block.data = data;
+        block.size = block.mapping.getLength();
+        return true;
+    } else if (!args.input) {
+        printError("Error: No input for ", args.argv[0]);
+        return false;
+    }
+
+    const char* chunk;
+    int length;
+    while (!scheduler.checkpoint() && (length = args.input->read(chunk)) > 0) {
+        unsigned int needed = block.size + length;
+
+        // Буфер растет вдвое, поэтому каждый байт копируется в среднем не более двух раз
+        if (needed > block.pageCount * PageAllocator::PAGE_SIZE) {
+            unsigned int pages = block.pageCount ? block.pageCount * 2 : 4;
+            while (pages * PageAllocator::PAGE_SIZE < needed) {
+                pages *= 2;
+            }
+
+            char* grown = (char*)pageAllocator.allocContiguous(pages);
+            if (!grown) {
+                releaseText(block);
+                printError("Error: Not enough memory for input of ", args.argv[0]);
+                return false;
+            }
+            memcpy(grown, block.pages, block.size);
+            releaseText(block);
+            block.pages = grown;
+            block.pageCount = pages;
+            block.data = grown;
+        }
+
+        memcpy(block.pages + block.size, chunk, length);
+        block.size += length;
+    }
+
+    // После Ctrl+C команда ничего не выводит
+    if (scheduler.interruptRequested()) {
+        releaseText(block);
+        return false;
+    }
+    return true;
+}
+
+// Конец строки: позиция '\n' или конец блока
+static inline const char* lineEnd(const char* line, const char* end) {
+    const char* newline = (const char*)memchr(line, '\n', end - line);
+    return newline ? newline : end;
+}
+
+// Количество переводов строк в диапазоне
+static int countNewlines(const char* start, const char* end) {
+    int count = 0;
+    while ((start = (const char*)memchr(start, '\n', end - start)) != 0) {
+        count++;
+        start++;
+    }
+    return count;
+}
+
+// Вывод строки вместе с ее '\n' одной записью
+static void emitLine(OutputStream& out, const char* line, const char* lineEnd, const char* end) {
+    if (lineEnd < end) {
+        out.write(line, lineEnd - line + 1);
+    } else {
+        out.write(line, lineEnd - line);
+        out.write("\n", 1);
+    }
+}
+
+static void writeNumber(OutputStream& out, int value, int width) {
+    char str[16];
+    itoa(value, str, 10);
+    for (int pad = strlen(str); pad < width; pad++) {
+        out.write(" ", 1);
+    }
+    out.write(str);
+}
+
+// --- grep ---
+
+enum {
+    GREP_IGNORE_CASE = 1 << 0,
+    GREP_INVERT = 1 << 1,
+    GREP_COUNT = 1 << 2,
+    GREP_NUMBERS = 1 << 3,
+    GREP_FIXED = 1 << 4
+};
+
+static inline char lowerCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline char upperCase(char c) {
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+// Длина атома шаблона: символ, \c, . или [класс]; -1 - ошибка
+static int atomLength(const char* p) {
+    if (p[0] == '\\') {
+        return p[1] ? 2 : -1;
+    }
+    if (p[0] != '[') {
+        return 1;
+    }
+
+    int i = 1;
+    if (p[i] == '^') i++;
+    if (p[i] == ']') i++;
+    while (p[i] && p[i] != ']') {
+        i++;
+    }
+    return p[i] ? i + 1 : -1;
+}
+
+// Проверка символа по классу [...]: одиночные символы и диапазоны a-z.
+// Отрицание [^...] учитывает вызывающий.
+static bool classContains(const char* p, int length, char c) {
+    int i = (p[1] == '^') ? 2 : 1;
+    int last = length - 1;   // Позиция ']'
+    for (; i < last; i++) {
+        if (p[i + 1] == '-' && i + 2 < last) {
+            if ((unsigned char)c >= (unsigned char)p[i] && (unsigned char)c <= (unsigned char)p[i + 2]) {
+                return true;
+            }
+            i += 2;
+        } else if (p[i] == c) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool matchAtom(const char* p, int length, char c, bool ignoreCase) {
+    if (p[0] == '.') {
+        return true;
+    }
+    if (p[0] == '[') {
+        bool found = classContains(p, length, c) ||
+                     (ignoreCase && (classContains(p, length, lowerCase(c)) || classContains(p, length, upperCase(c))));
+        return found != (p[1] == '^');
+    }
+
+    char expected = (p[0] == '\\') ? p[1] : p[0];
+    return ignoreCase ? lowerCase(expected) == lowerCase(c) : expected == c;
+}
+
+static bool matchHere(const char* p, const char* text, const char* end, bool ignoreCase);
+
+// Атом со звездочкой: пробуем как можно меньше повторений
+static bool matchStar(const char* atom, int length, const char* rest,
+                      const char* text, const char* end, bool ignoreCase) {
+    do {
+        if (matchHere(rest, text, end, ignoreCase)) {
+            return true;
+        }
+    } while (text < end && matchAtom(atom, length, *text++, ignoreCase));
+    return false;
+}
+
+static bool matchHere(const char* p, const char* text, const char* end, bool ignoreCase) {
+    while (*p) {
+        if (p[0] == '$' && p[1] == '\0') {
+            return text == end;
+        }
+
+        int length = atomLength(p);
+        if (p[length] == '*') {
+            return matchStar(p, length, p + length + 1, text, end, ignoreCase);
+        }
+        if (text == end || !matchAtom(p, length, *text, ignoreCase)) {
+            return false;
+        }
+        p += length;
+        text++;
+    }
+    return true;
+}
+
+// Поиск совпадения в строке. Если шаблон начинается с обычного символа,
+// кандидаты находятся через memchr.
+static bool matchLine(const char* p, const char* text, const char* end, bool ignoreCase) {
+    if (p[0] == '^') {
+        return matchHere(p + 1, text, end, ignoreCase);
+    }
+
+    bool plainFirst = !ignoreCase && p[0] && atomLength(p) == 1 && p[0] != '.' &&
+                      p[0] != '$' && p[1] != '*';
+    while (true) {
+        if (plainFirst) {
+            text = (const char*)memchr(text, p[0], end - text);
+            if (!text) {
+                return false;
+            }
+        }
+        if (matchHere(p, text, end, ignoreCase)) {
+            return true;
+        }
+        if (text == end) {
+            return false;
+        }
+        text++;
+    }
+}
+
+// Поиск подстроки: memchr по первому символу, затем сравнение остатка
+static const char* findLiteral(const char* text, const char* end, const char* pattern, int length) {
+    if (length == 0) {
+        return text;
+    }
+
+    while (end - text >= length) {
+        const char* candidate = (const char*)memchr(text, pattern[0], end - text - length + 1);
+        if (!candidate) {
+            return 0;
+        }
+        if (memcmp(candidate + 1, pattern + 1, length - 1) == 0) {
+            return candidate;
+        }
+        text = candidate + 1;
+    }
+    return 0;
+}
+
+static bool isLiteral(const char* pattern) {
+    for (; *pattern; pattern++) {
+        if (*pattern == '\\' || *pattern == '.' || *pattern == '[' ||
+            *pattern == '*' || *pattern == '^' || *pattern == '$') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printMatch(OutputStream& out, const char* name, int lineNumber,
+                       const char* line, const char* lineEnd, const char* end) {
+    if (name) {
+        out.write(name);
+        out.write(":", 1);
+    }
+    if (lineNumber > 0) {
+        writeNumber(out, lineNumber, 0);
+        out.write(":", 1);
+    }
+    emitLine(out, line, lineEnd, end);
+}
+
+// Поиск в одном блоке, возвращает число совпавших строк
+static int grepBlock(const TextBlock& block, const char* pattern, unsigned int flags,
+                     const char* name, OutputStream& out) {
+    const char* pos = block.data;
+    const char* end = block.data + block.size;
+    bool quiet = (flags & GREP_COUNT) != 0;
+    bool numbers = (flags & GREP_NUMBERS) != 0;
+    bool invert = (flags & GREP_INVERT) != 0;
+    bool ignoreCase = (flags & GREP_IGNORE_CASE) != 0;
+    bool literal = (flags & GREP_FIXED) || isLiteral(pattern);
+    int patternLength = strlen(pattern);
+    int matches = 0;
+    int lineNumber = 1;
+
+    // Подстрока без -i и -v: ищем по всему блоку сразу, строки без
+    // совпадений пропускаются без разбора
+    if (literal && !ignoreCase && !invert && patternLength > 0) {
+        while (pos < end && !scheduler.checkpoint()) {
+            const char* match = findLiteral(pos, end, pattern, patternLength);
+            if (!match) {
+                break;
+            }
+
+            const char* line = match;
+            while (line > pos && line[-1] != '\n') {
+                line--;
+            }
+            const char* e = lineEnd(match, end);
+
+            if (numbers) {
+                lineNumber += countNewlines(pos, line);
+            }
+            if (!quiet) {
+                printMatch(out, name, numbers ? lineNumber : 0, line, e, end);
+            }
+            matches++;
+            lineNumber++;
+            pos = e + 1;
+        }
+        return matches;
+    }
+
+    // Общий случай: построчно
+    for (; pos < end && !scheduler.checkpoint(); lineNumber++) {
+        const char* e = lineEnd(pos, end);
+
+        bool found;
+        if (literal && !ignoreCase) {
+            found = findLiteral(pos, e, pattern, patternLength) != 0;
+        } else if (literal) {
+            // Подстрока без учета регистра: сравниваем посимвольно
+            found = false;
+            for (const char* s = pos; s + patternLength <= e && !found; s++) {
+                int i = 0;
+                while (i < patternLength && lowerCase(s[i]) == lowerCase(pattern[i])) {
+                    i++;
+                }
+                found = (i == patternLength);
+            }
+        } else {
+            found = matchLine(pattern, pos, e, ignoreCase);
+        }
+
+        if (found != invert) {
+            if (!quiet) {
+                printMatch(out, name, numbers ? lineNumber : 0, pos, e, end);
+            }
+            matches++;
+        }
+        pos = e + 1;
+    }
+    return matches;
+}
+
+// grep - поиск строк по подстроке или простому регулярному выражению
+void cmdGrep(CommandArgs& args) {
+    unsigned int flags;
+    int first = parseOptions(args, "ivcnF", flags, 0);
+    if (first == -1) {
+        return;
+    }
+    if (first >= args.argc) {
+        printError("Usage: ", "grep [-ivcnF] <pattern> [file...]");
+        return;
+    }
+
+    const char* pattern = args.argv[first++];
+
+    // Проверяем шаблон заранее, чтобы не разбирать ошибки при поиске
+    if (!(flags & GREP_FIXED) && !isLiteral(pattern)) {
+        for (const char* p = (*pattern == '^') ? pattern + 1 : pattern; *p; ) {
+            int length = atomLength(p);
+            if (length == -1 || (*p == '*')) {
+                printError("Error: Invalid pattern: ", pattern);
+                return;
+            }
+            p += length;
+            if (*p == '*') {
+                p++;
+            }
+        }
+    }
+
+    int fileCount = args.argc - first;
+    for (int i = 0; i < (fileCount ? fileCount : 1) && !scheduler.interruptRequested(); i++) {
+        const char* name = fileCount ? args.argv[first + i] : 0;
+
+        TextBlock block;
+        if (!loadText(args, name, block)) {
+            continue;
+        }
+
+        const char* prefix = (fileCount > 1) ? name : 0;
+        int matches = grepBlock(block, pattern, flags, prefix, *args.output);
+        if (flags & GREP_COUNT) {
+            if (prefix) {
+                args.output->write(prefix);
+                args.output->write(":", 1);
+            }
+            writeNumber(*args.output, matches, 0);
+            args.output->write("\n", 1);
+        }
+        releaseText(block);
+    }
+}
+
+// --- wc ---
+
+enum {
+    WC_LINES = 1 << 0,
+    WC_WORDS = 1 << 1,
+    WC_BYTES = 1 << 2
+};
+
+static void printCounts(OutputStream& out, unsigned int flags, const int counts[3], const char* name) {
+    for (int i = 0; i < 3; i++) {
+        if (flags & (1u << i)) {
+            writeNumber(out, counts[i], 8);
+        }
+    }
+    if (name) {
+        out.write(" ", 1);
+        out.write(name);
+    }
+    out.write("\n", 1);
+}
+
+// wc - число строк, слов и байт
+void cmdWc(CommandArgs& args) {
+    unsigned int flags;
+    int first = parseOptions(args, "lwc", flags, 0);
+    if (first == -1) {
+        return;
+    }
+    if (flags == 0) {
+        flags = WC_LINES | WC_WORDS | WC_BYTES;
+    }
+
+    int fileCount = args.argc - first;
+    int total[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < (fileCount ? fileCount : 1) && !scheduler.interruptRequested(); i++) {
+        const char* name = fileCount ? args.argv[first + i] : 0;
+
+        TextBlock block;
+        if (!loadText(args, name, block)) {
+            continue;
+        }
+
+        const char* data = block.data;
+        const char* end = data + block.size;
+        int counts[3] = { 0, 0, block.size };
+
+        if (flags & WC_WORDS) {
+            // Слова считаются по переходам от пробела к непробелу
+            bool inWord = false;
+            for (const char* p = data; p < end; p++) {
+                char c = *p;
+                bool space = (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f');
+                if (c == '\n') {
+                    counts[0]++;
+                    if (scheduler.checkpoint()) {
+                        break;
+                    }
+                }
+                if (!space && !inWord) {
+                    counts[1]++;
+                }
+                inWord = !space;
+            }
+        } else if (flags & WC_LINES) {
+            counts[0] = countNewlines(data, end);
+        }
+        if (scheduler.interruptRequested()) {
+            releaseText(block);
+            return;
+        }
+
+        printCounts(*args.output, flags, counts, name);
+        for (int j = 0; j < 3; j++) {
+            total[j] += counts[j];
+        }
+        releaseText(block);
+    }
+
+    if (fileCount > 1 && !scheduler.interruptRequested()) {
+        printCounts(*args.output, flags, total, "total");
+    }
+}
+
+// Команды, принимающие не больше одного файла
+static bool singleOperand(CommandArgs& args, int first, const char*& name) {
+    if (args.argc - first > 1) {
+        printError("Error: Too many files for ", args.argv[0]);
+        return false;
+    }
+    name = (first < args.argc) ? args.argv[first] : 0;
+    return true;
+}
+
+// --- sort ---
+
+enum {
+    SORT_REVERSE = 1 << 0,
+    SORT_NUMERIC = 1 << 1,
+    SORT_UNIQUE = 1 << 2
+};
+
+static int compareLines(const LineRef& a, const LineRef& b) {
+    if (a.key != b.key) {
+        return a.key < b.key ? -1 : 1;
+    }
+    int length = a.length < b.length ? a.length : b.length;
+    int result = memcmp(a.text, b.text, length);
+    if (result != 0) {
+        return result;
+    }
+    return a.length - b.length;
+}
+
+// Ключ строки: первые 4 байта (старший байт - первый символ) или число
+static unsigned int sortKey(const char* text, int length, bool numeric) {
+    if (!numeric) {
+        unsigned int key = 0;
+        for (int i = 0; i < 4; i++) {
+            key = (key << 8) | (i < length ? (unsigned char)text[i] : 0);
+        }
+        return key;
+    }
+
+    int i = 0;
+    while (i < length && (text[i] == ' ' || text[i] == '\t')) {
+        i++;
+    }
+    bool negative = (i < length && text[i] == '-');
+    if (negative) {
+        i++;
+    }
+
+    unsigned int value = 0;
+    while (i < length && text[i] >= '0' && text[i] <= '9' && value < 0x80000000u) {
+        value = value * 10 + (text[i++] - '0');
+    }
+    if (value > 0x7FFFFFFFu) {
+        value = 0x7FFFFFFFu;
+    }
+
+    // Знаковое число переводится в беззнаковое с тем же порядком
+    int signedValue = negative ? -(int)value : (int)value;
+    return (unsigned int)signedValue ^ 0x80000000u;
+}
+
+static inline void swapLines(LineRef& a, LineRef& b) {
+    LineRef temp = a;
+    a = b;
+    b = temp;
+}
+
+static void insertionSort(LineRef* lines, int count) {
+    for (int i = 1; i < count; i++) {
+        LineRef line = lines[i];
+        int j = i;
+        while (j > 0 && compareLines(line, lines[j - 1]) < 0) {
+            lines[j] = lines[j - 1];
+            j--;
+        }
+        lines[j] = line;
+    }
+}
+
+static void siftDown(LineRef* lines, int root, int count) {
+    while (true) {
+        int child = root * 2 + 1;
+        if (child >= count) {
+            return;
+        }
+        if (child + 1 < count && compareLines(lines[child], lines[child + 1]) < 0) {
+            child++;
+        }
+        if (compareLines(lines[root], lines[child]) >= 0) {
+            return;
+        }
+        swapLines(lines[root], lines[child]);
+        root = child;
+    }
+}
+
+static void heapSort(LineRef* lines, int count) {
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        siftDown(lines, i, count);
+    }
+    for (int i = count - 1; i > 0; i--) {
+        swapLines(lines[0], lines[i]);
+        siftDown(lines, 0, i);
+    }
+}
+
+// Интроспективная сортировка: быстрая сортировка с медианой из трех,
+// при слишком глубокой рекурсии - пирамидальная, мелкие части - вставками
+static void introSort(LineRef* lines, int count, int depth) {
+    while (count > 16) {
+        if (depth-- == 0) {
+            heapSort(lines, count);
+            return;
+        }
+
+        int mid = count / 2;
+        if (compareLines(lines[mid], lines[0]) < 0) swapLines(lines[mid], lines[0]);
+        if (compareLines(lines[count - 1], lines[0]) < 0) swapLines(lines[count - 1], lines[0]);
+        if (compareLines(lines[count - 1], lines[mid]) < 0) swapLines(lines[count - 1], lines[mid]);
+        LineRef pivot = lines[mid];
+
+        // lines[0] <= pivot <= lines[count - 1] служат ограничителями
+        int i = 0;
+        int j = count - 1;
+        while (true) {
+            while (compareLines(lines[++i], pivot) < 0) {}
+            while (compareLines(pivot, lines[--j]) < 0) {}
+            if (i >= j) {
+                break;
+            }
+            swapLines(lines[i], lines[j]);
+        }
+
+        // Рекурсия в меньшую часть, цикл - по большей
+        if (i < count - i) {
+            introSort(lines, i, depth);
+            lines += i;
+            count -= i;
+        } else {
+            introSort(lines + i, count - i, depth);
+            count = i;
+        }
+    }
+    insertionSort(lines, count);
+}
+
+// sort - сортировка строк
+void cmdSort(CommandArgs& args) {
+    unsigned int flags;
+    const char* name;
+    int first = parseOptions(args, "rnu", flags, 0);
+    if (first == -1 || !singleOperand(args, first, name)) {
+        return;
+    }
+
+    TextBlock block;
+    if (!loadText(args, name, block)) {
+        return;
+    }
+
+    const char* data = block.data;
+    const char* end = data + block.size;
+    int count = countNewlines(data, end);
+    if (block.size > 0 && end[-1] != '\n') {
+        count++;
+    }
+
+    // Один массив ссылок на все строки
+    unsigned int pages = (count * sizeof(LineRef) + PageAllocator::PAGE_SIZE - 1) / PageAllocator::PAGE_SIZE;
+    LineRef* lines = (LineRef*)pageAllocator.allocContiguous(pages);
+    if (count > 0 && !lines) {
+        printError("Error: Not enough memory for input of ", args.argv[0]);
+        releaseText(block);
+        return;
+    }
+
+    bool numeric = (flags & SORT_NUMERIC) != 0;
+    int n = 0;
+    for (const char* pos = data; pos < end && !scheduler.checkpoint(); ) {
+        const char* e = lineEnd(pos, end);
+        lines[n].text = pos;
+        lines[n].length = e - pos;
+        lines[n].key = sortKey(pos, e - pos, numeric);
+        n++;
+        pos = e + 1;
+    }
+
+    // Прерванный разбор (n < count) не сортируется и не выводится
+    int depth = 0;
+    for (int size = count; size > 1; size >>= 1) {
+        depth += 2;
+    }
+    if (n == count) {
+        introSort(lines, count, depth);
+    }
+
+    OutputStream& out = *args.output;
+    bool reverse = (flags & SORT_REVERSE) != 0;
+    for (int i = 0; i < count && !scheduler.checkpoint(); i++) {
+        int index = reverse ? count - 1 - i : i;
+        int previous = reverse ? index + 1 : index - 1;
+        if ((flags & SORT_UNIQUE) && i > 0 && compareLines(lines[index], lines[previous]) == 0) {
+            continue;
+        }
+        out.write(lines[index].text, lines[index].length);
+        out.write("\n", 1);
+    }
+
+    if (lines) {
+        pageAllocator.freeContiguous(lines, pages);
+    }
+    releaseText(block);
+}
+
+// --- uniq ---
+
+enum {
+    UNIQ_COUNT = 1 << 0,
+    UNIQ_REPEATED = 1 << 1,
+    UNIQ_UNIQUE = 1 << 2
+};
+
+// uniq - схлопывание одинаковых соседних строк
+void cmdUniq(CommandArgs& args) {
+    unsigned int flags;
+    const char* name;
+    int first = parseOptions(args, "cdu", flags, 0);
+    if (first == -1 || !singleOperand(args, first, name)) {
+        return;
+    }
+
+    TextBlock block;
+    if (!loadText(args, name, block)) {
+        return;
+    }
+
+    OutputStream& out = *args.output;
+    const char* end = block.data + block.size;
+    const char* pos = block.data;
+
+    while (pos < end && !scheduler.checkpoint()) {
+        const char* groupEnd = lineEnd(pos, end);
+        int length = groupEnd - pos;
+        int repeats = 1;
+
+        // Пропускаем такие же строки подряд
+        const char* next = groupEnd + 1;
+        while (next < end) {
+            const char* e = lineEnd(next, end);
+            if (e - next != length || memcmp(next, pos, length) != 0) {
+                break;
+            }
+            repeats++;
+            next = e + 1;
+        }
+
+        bool show = !((flags & UNIQ_REPEATED) && repeats == 1) && !((flags & UNIQ_UNIQUE) && repeats > 1);
+        if (show) {
+            if (flags & UNIQ_COUNT) {
+                writeNumber(out, repeats, 7);
+                out.write(" ", 1);
+            }
+            emitLine(out, pos, groupEnd, end);
+        }
+        pos = next;
+    }
+
+    releaseText(block);
+}
+
+// --- head и tail ---
+
+// head - первые N строк, выводятся одной записью
+void cmdHead(CommandArgs& args) {
+    unsigned int flags;
+    const char* name;
+    int lines = 10;
+    int first = parseOptions(args, "", flags, &lines);
+    if (first == -1 || !singleOperand(args, first, name)) {
+        return;
+    }
+
+    TextBlock block;
+    if (!loadText(args, name, block)) {
+        return;
+    }
+
+    const char* end = block.data + block.size;
+    const char* pos = block.data;
+    for (int i = 0; i < lines && pos < end; i++) {
+        pos = lineEnd(pos, end) + 1;
+    }
+    if (pos > end) {
+        pos = end;
+    }
+
+    if (pos > block.data) {
+        args.output->write(block.data, pos - block.data);
+        if (pos[-1] != '\n') {
+            args.output->write("\n", 1);
+        }
+    }
+    releaseText(block);
+}
+
+// tail - последние N строк: просматриваем блок с конца
+void cmdTail(CommandArgs& args) {
+    unsigned int flags;
+    const char* name;
+    int lines = 10;
+    int first = parseOptions(args, "", flags, &lines);
+    if (first == -1 || !singleOperand(args, first, name)) {
+        return;
+    }
+
+    TextBlock block;
+    if (!loadText(args, name, block)) {
+        return;
+    }
+
+    const char* end = block.data + block.size;
+    const char* start = end;
+
+    // Последний '\n' завершает последнюю строку и не считается
+    const char* scan = (end > block.data && end[-1] == '\n') ? end - 1 : end;
+    int found = 0;
+    if (lines > 0) {
+        start = block.data;
+        while (scan > block.data) {
+            if (scan[-1] == '\n' && ++found == lines) {
+                start = scan;
+                break;
+            }
+            scan--;
+        }
+    }
+
+    if (start < end) {
+        args.output->write(start, end - start);
+        if (end[-1] != '\n') {
+            args.output->write("\n", 1);
+        }
+    }
+    releaseText(block);
+}
\ No newline at end of file
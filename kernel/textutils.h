@@ -0,0 +1,29 @@
+// textutils.h
+#ifndef TEXTUTILS_H
+#define TEXTUTILS_H
+
+#include "command.h"
+
+// Текстовые команды оболочки. Ввод (файл или канал) обрабатывается
+// одним непрерывным блоком: файл отображается в память (FileMapping,
+// без копирования, если он уже лежит в памяти одним куском), ввод из
+// канала копируется в смежные страницы. Строки выделяются через memchr,
+// память на каждую строку не выделяется.
+
+// grep [-i] [-v] [-c] [-n] [-F] PATTERN [file...]
+void cmdGrep(CommandArgs& args);
+
+// wc [-l] [-w] [-c] [file...]
+void cmdWc(CommandArgs& args);
+
+// sort [-r] [-n] [-u] [file]
+void cmdSort(CommandArgs& args);
+
+// uniq [-c] [-d] [-u] [file]
+void cmdUniq(CommandArgs& args);
+
+// head [-n N] [file], tail [-n N] [file]
+void cmdHead(CommandArgs& args);
+void cmdTail(CommandArgs& args);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+// thread.cpp
+#include "thread.h"
+#include "keyboard.h"
+
+// Стеки потоков (главный поток использует стек из boot.asm)
+static unsigned char threadStacks[Scheduler::MAX_THREADS][Scheduler::STACK_SIZE] __attribute__((aligned(16)));
+
+// Переключение контекста: сохраняем callee-saved регистры на текущем стеке,
+// запоминаем ESP и переходим на стек другого потока
+extern "C" void switchContext(unsigned int* oldEsp, unsigned int newEsp);
+asm(
+    ".text\n"
+    ".global switchContext\n"
+    "switchContext:\n"
+    "    movl 4(%esp), %eax\n"
+    "    movl 8(%esp), %edx\n"
+    "    pushl %ebp\n"
+    "    pushl %ebx\n"
+    "    pushl %esi\n"
+    "    pushl %edi\n"
+    "    movl %esp, (%eax)\n"
+    "    movl %edx, %esp\n"
+    "    popl %edi\n"
+    "    popl %esi\n"
+    "    popl %ebx\n"
+    "    popl %ebp\n"
+    "    ret\n"
+);
+
+// Инициализация: текущий контекст становится главным потоком
+void Scheduler::initialize() {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        threads[i].state = THREAD_UNUSED;
+        threads[i].interruptRequested = false;
+        threads[i].checkpoints = 0;
+    }
+
+    threads[MAIN_THREAD].state = THREAD_READY;
+    current = MAIN_THREAD;
+    foreground = MAIN_THREAD;
+}
+
+// Первая функция нового потока
+void Scheduler::threadEntry() {
+    Thread& thread = scheduler.threads[scheduler.current];
+    thread.function(thread.argument);
+    scheduler.exitThread();
+}
+
+// Создание потока
+int Scheduler::createThread(ThreadFunction function, void* argument) {
+    for (int i = 1; i < MAX_THREADS; i++) {
+        if (threads[i].state == THREAD_READY) {
+            continue;
+        }
+
+        // Начальный стек: регистры для switchContext и адрес threadEntry
+        unsigned int* stack = (unsigned int*)(threadStacks[i] + STACK_SIZE);
+        *--stack = 0;                           // Адрес возврата из threadEntry
+        *--stack = (unsigned int)threadEntry;
+        *--stack = 0;                           // ebp
+        *--stack = 0;                           // ebx
+        *--stack = 0;                           // esi
+        *--stack = 0;                           // edi
+
+        threads[i].esp = (unsigned int)stack;
+        threads[i].function = function;
+        threads[i].argument = argument;
+        threads[i].interruptRequested = false;
+        threads[i].checkpoints = 0;
+        threads[i].state = THREAD_READY;
+        return i;
+    }
+    return -1;
+}
+
+// Переключение на следующий готовый поток по кругу
+void Scheduler::yield() {
+    int next = current;
+    for (int i = 1; i <= MAX_THREADS; i++) {
+        int candidate = (current + i) % MAX_THREADS;
+        if (threads[candidate].state == THREAD_READY) {
+            next = candidate;
+            break;
+        }
+    }
+
+    if (next == current) {
+        return;
+    }
+
+    int previous = current;
+    current = next;
+    switchContext(&threads[previous].esp, threads[next].esp);
+}
+
+// Завершение текущего потока
+void Scheduler::exitThread() {
+    threads[current].state = THREAD_FINISHED;
+
+    // Клавиатура возвращается оболочке
+    if (foreground == current) {
+        foreground = MAIN_THREAD;
+    }
+
+    yield();
+
+    // Сюда управление не возвращается: завершенный поток не выбирается
+    while (true) {}
+}
+
+void Scheduler::setForeground(int thread) {
+    if (thread >= 0 && thread < MAX_THREADS && threads[thread].state == THREAD_READY) {
+        foreground = thread;
+    }
+}
+
+void Scheduler::waitForeground() {
+    while (!isForeground() && !interruptRequested()) {
+        yield();
+    }
+}
+
+void Scheduler::interrupt(int thread) {
+    if (thread >= 0 && thread < MAX_THREADS && threads[thread].state == THREAD_READY) {
+        threads[thread].interruptRequested = true;
+    }
+}
+
+bool Scheduler::checkpoint() {
+    if (++threads[current].checkpoints % CHECKPOINT_INTERVAL == 0) {
+        keyboard.pump();
+        yield();
+    }
+    return threads[current].interruptRequested;
+}
\ No newline at end of file
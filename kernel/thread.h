@@ -0,0 +1,74 @@
+// thread.h
+#ifndef THREAD_H
+#define THREAD_H
+
+// Кооперативный планировщик потоков ядра.
+// Потоки переключаются только в yield(), поэтому долгие циклы
+// (ожидание клавиатуры, игра, обработка файлов) должны его вызывать.
+class Scheduler {
+public:
+    typedef void (*ThreadFunction)(void* argument);
+
+    static const int MAX_THREADS = 9;
+    static const int MAIN_THREAD = 0;   // Поток оболочки на стеке загрузчика
+    static const int STACK_SIZE = 16384;
+    static const unsigned int CHECKPOINT_INTERVAL = 64;
+
+private:
+    enum ThreadState {
+        THREAD_UNUSED,
+        THREAD_READY,
+        THREAD_FINISHED
+    };
+
+    struct Thread {
+        ThreadState state;
+        unsigned int esp;           // Сохраненный указатель стека
+        ThreadFunction function;
+        void* argument;
+        bool interruptRequested;    // Запрос прерывания (Ctrl+C, kill)
+        unsigned int checkpoints;   // Вызовов checkpoint() с начала работы
+    };
+
+    Thread threads[MAX_THREADS];
+    int current;
+    int foreground;                 // Поток, которому принадлежит клавиатура
+
+    static void threadEntry();
+
+public:
+    void initialize();
+
+    // Создание потока, возвращает его номер или -1
+    int createThread(ThreadFunction function, void* argument);
+
+    // Передача управления следующему готовому потоку
+    void yield();
+
+    // Завершение текущего потока (не возвращается)
+    void exitThread();
+
+    int currentThread() const { return current; }
+
+    // Активный поток получает ввод с клавиатуры и Ctrl+C
+    void setForeground(int thread);
+    int getForeground() const { return foreground; }
+    bool isForeground() const { return current == foreground; }
+
+    // Ожидание, пока текущий поток не станет активным
+    void waitForeground();
+
+    // Кооперативное прерывание: поток сам проверяет флаг
+    void interrupt(int thread);
+    bool interruptRequested() const { return threads[current].interruptRequested; }
+    void clearInterrupt() { threads[current].interruptRequested = false; }
+
+    // Проверка в долгих циклах (по куску или строке за вызов): раз в
+    // CHECKPOINT_INTERVAL вызовов принимает клавиатуру, чтобы дошел
+    // Ctrl+C, и уступает другим потокам. true - поток прерван.
+    bool checkpoint();
+};
+
+extern Scheduler scheduler;
+
+#endif
\ No newline at end of file
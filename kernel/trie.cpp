@@ -0,0 +1,371 @@
+// trie.cpp
+#include "trie.h"
+#include "io.h"
+#include "memory.h"
+
+// Первая страница пула с корнем
+void CompletionTrie::initialize() {
+    pageCount = 0;
+    freeList = -1;
+    freeCount = 0;
+    grow();
+    clear();
+}
+
+// Пустое дерево; страницы пула остаются за деревом
+void CompletionTrie::clear() {
+    at(ROOT).label[0] = '\0';
+    at(ROOT).labelLength = 0;
+    at(ROOT).firstChild = -1;
+    at(ROOT).nextSibling = -1;
+    at(ROOT).wordCount = 0;
+    at(ROOT).subtreeWords = 0;
+
+    // Все остальные узлы помещаем в список свободных
+    freeList = -1;
+    for (int i = pageCount * NODES_PER_PAGE - 1; i > ROOT; i--) {
+        at(i).nextSibling = freeList;
+        freeList = i;
+    }
+    freeCount = pageCount * NODES_PER_PAGE - 1;
+}
+
+// Пул растет страницами по мере добавления слов; в систему страницы
+// не возвращаются
+bool CompletionTrie::grow() {
+    if (pageCount == MAX_PAGES) {
+        return false;
+    }
+    Node* page = (Node*)pageAllocator.allocPage();
+    if (!page) {
+        return false;
+    }
+    pages[pageCount++] = page;
+    for (int i = pageCount * NODES_PER_PAGE - 1; i >= (pageCount - 1) * NODES_PER_PAGE; i--) {
+        at(i).nextSibling = freeList;
+        freeList = i;
+        freeCount++;
+    }
+    return true;
+}
+
+// Выделение узла из пула
+int CompletionTrie::allocNode(const char* label, int length) {
+    int index = freeList;
+    freeList = at(index).nextSibling;
+    freeCount--;
+
+    for (int i = 0; i < length; i++) {
+        at(index).label[i] = label[i];
+    }
+    at(index).label[length] = '\0';
+    at(index).labelLength = length;
+    at(index).firstChild = -1;
+    at(index).nextSibling = -1;
+    at(index).wordCount = 0;
+    at(index).subtreeWords = 0;
+    return index;
+}
+
+// Возврат узла в пул
+void CompletionTrie::freeNode(int index) {
+    at(index).nextSibling = freeList;
+    freeList = index;
+    freeCount++;
+}
+
+// Слияние узла с его единственным ребенком
+void CompletionTrie::mergeWithChild(int index) {
+    int child = at(index).firstChild;
+
+    for (int i = 0; i < at(child).labelLength; i++) {
+        at(index).label[at(index).labelLength + i] = at(child).label[i];
+    }
+    at(index).labelLength += at(child).labelLength;
+    at(index).label[at(index).labelLength] = '\0';
+    at(index).firstChild = at(child).firstChild;
+    at(index).wordCount = at(child).wordCount;
+
+    freeNode(child);
+}
+
+// Добавление слова
+bool CompletionTrie::insert(const char* word) {
+    int len = strlen(word);
+    if (len == 0 || len >= MAX_WORD_LENGTH) {
+        return false;
+    }
+
+    // В худшем случае понадобится промежуточный узел и лист
+    if (freeCount < 2 && !grow()) {
+        return false;
+    }
+
+    // Путь от корня нужен, чтобы обновить счетчики поддеревьев
+    int path[MAX_WORD_LENGTH + 1];
+    int depth = 0;
+    int node = ROOT;
+    int pos = 0;
+    path[depth++] = ROOT;
+
+    while (pos < len) {
+        // Ищем ребенка по первому символу (дети отсортированы)
+        int prev = -1;
+        int child = at(node).firstChild;
+        while (child != -1 && (unsigned char)at(child).label[0] < (unsigned char)word[pos]) {
+            prev = child;
+            child = at(child).nextSibling;
+        }
+
+        // Подходящего ребра нет - добавляем лист с остатком слова
+        if (child == -1 || at(child).label[0] != word[pos]) {
+            int leaf = allocNode(word + pos, len - pos);
+            at(leaf).nextSibling = child;
+            if (prev == -1) {
+                at(node).firstChild = leaf;
+            } else {
+                at(prev).nextSibling = leaf;
+            }
+            at(leaf).wordCount = 1;
+            at(leaf).subtreeWords = 1;
+
+            for (int i = 0; i < depth; i++) {
+                at(path[i]).subtreeWords++;
+            }
+            return true;
+        }
+
+        int common = 0;
+        while (common < at(child).labelLength && pos + common < len &&
+               at(child).label[common] == word[pos + common]) {
+            common++;
+        }
+
+        // Слово расходится с меткой посередине - разделяем ребро
+        if (common < at(child).labelLength) {
+            int mid = allocNode(at(child).label, common);
+            at(mid).firstChild = child;
+            at(mid).nextSibling = at(child).nextSibling;
+            at(mid).subtreeWords = at(child).subtreeWords;
+            if (prev == -1) {
+                at(node).firstChild = mid;
+            } else {
+                at(prev).nextSibling = mid;
+            }
+
+            int rest = at(child).labelLength - common;
+            for (int i = 0; i <= rest; i++) {
+                at(child).label[i] = at(child).label[common + i];
+            }
+            at(child).labelLength = rest;
+            at(child).nextSibling = -1;
+            child = mid;
+        }
+
+        node = child;
+        pos += common;
+        path[depth++] = node;
+    }
+
+    // Слово заканчивается во внутреннем узле
+    if (at(node).wordCount++ == 0) {
+        for (int i = 0; i < depth; i++) {
+            at(path[i]).subtreeWords++;
+        }
+    }
+    return true;
+}
+
+// Удаление слова
+bool CompletionTrie::remove(const char* word) {
+    int len = strlen(word);
+    if (len == 0 || len >= MAX_WORD_LENGTH) {
+        return false;
+    }
+
+    int path[MAX_WORD_LENGTH + 1];
+    int depth = 0;
+    int node = ROOT;
+    int pos = 0;
+    path[depth++] = ROOT;
+
+    while (pos < len) {
+        int child = at(node).firstChild;
+        while (child != -1 && at(child).label[0] != word[pos]) {
+            child = at(child).nextSibling;
+        }
+        if (child == -1 || at(child).labelLength > len - pos ||
+            strncmp(at(child).label, word + pos, at(child).labelLength) != 0) {
+            return false;
+        }
+
+        node = child;
+        pos += at(child).labelLength;
+        path[depth++] = node;
+    }
+
+    if (at(node).wordCount == 0) {
+        return false;
+    }
+
+    // Слово было добавлено несколько раз (например, команда и файл)
+    if (--at(node).wordCount > 0) {
+        return true;
+    }
+
+    for (int i = 0; i < depth; i++) {
+        at(path[i]).subtreeWords--;
+    }
+
+    if (node == ROOT) {
+        return true;
+    }
+
+    // Убираем лишние узлы, чтобы дерево оставалось сжатым
+    int parent = path[depth - 2];
+    if (at(node).firstChild == -1) {
+        if (at(parent).firstChild == node) {
+            at(parent).firstChild = at(node).nextSibling;
+        } else {
+            int prev = at(parent).firstChild;
+            while (at(prev).nextSibling != node) {
+                prev = at(prev).nextSibling;
+            }
+            at(prev).nextSibling = at(node).nextSibling;
+        }
+        freeNode(node);
+
+        int first = at(parent).firstChild;
+        if (parent != ROOT && at(parent).wordCount == 0 &&
+            first != -1 && at(first).nextSibling == -1) {
+            mergeWithChild(parent);
+        }
+    } else if (at(at(node).firstChild).nextSibling == -1) {
+        mergeWithChild(node);
+    }
+
+    return true;
+}
+
+// Поиск узла, на ребре которого заканчивается префикс
+int CompletionTrie::findNode(const char* prefix, int prefixLen, int& edgeMatched) const {
+    int node = ROOT;
+    int pos = 0;
+    edgeMatched = 0;
+
+    while (pos < prefixLen) {
+        int child = at(node).firstChild;
+        while (child != -1 && at(child).label[0] != prefix[pos]) {
+            child = at(child).nextSibling;
+        }
+        if (child == -1) {
+            return -1;
+        }
+
+        int i = 0;
+        while (i < at(child).labelLength && pos < prefixLen) {
+            if (at(child).label[i] != prefix[pos]) {
+                return -1;
+            }
+            i++;
+            pos++;
+        }
+
+        node = child;
+        edgeMatched = i;
+    }
+
+    return node;
+}
+
+// Количество слов с данным префиксом
+int CompletionTrie::countMatches(const char* prefix, int prefixLen) const {
+    int edgeMatched;
+    int node = findNode(prefix, prefixLen, edgeMatched);
+    if (node == -1) {
+        return 0;
+    }
+    return at(node).subtreeWords;
+}
+
+// Наибольший общий префикс всех слов, начинающихся с prefix
+int CompletionTrie::longestCommonPrefix(const char* prefix, int prefixLen, char* result) const {
+    strncpy(result, prefix, prefixLen);
+    result[prefixLen] = '\0';
+
+    int edgeMatched;
+    int node = findNode(prefix, prefixLen, edgeMatched);
+    if (node == -1 || at(node).subtreeWords == 0) {
+        return prefixLen;
+    }
+
+    // Дописываем остаток ребра, на котором остановился префикс
+    int len = prefixLen;
+    for (int i = edgeMatched; i < at(node).labelLength; i++) {
+        result[len++] = at(node).label[i];
+    }
+
+    // Спускаемся, пока путь однозначен
+    while (at(node).wordCount == 0) {
+        int child = at(node).firstChild;
+        if (child == -1 || at(child).nextSibling != -1) {
+            break;
+        }
+        for (int i = 0; i < at(child).labelLength; i++) {
+            result[len++] = at(child).label[i];
+        }
+        node = child;
+    }
+
+    result[len] = '\0';
+    return len;
+}
+
+// Обход поддерева в алфавитном порядке с пропуском первых skip слов
+void CompletionTrie::collectFrom(int index, char* word, int wordLen, int& skip,
+                                 char matches[][MAX_WORD_LENGTH], int& found, int maxMatches) const {
+    if (at(index).wordCount > 0) {
+        if (skip > 0) {
+            skip--;
+        } else {
+            strncpy(matches[found], word, wordLen);
+            matches[found][wordLen] = '\0';
+            found++;
+        }
+    }
+
+    for (int child = at(index).firstChild; child != -1 && found < maxMatches;
+         child = at(child).nextSibling) {
+        // Целые поддеревья пропускаем по счетчику, не обходя их
+        if (skip >= at(child).subtreeWords) {
+            skip -= at(child).subtreeWords;
+            continue;
+        }
+
+        for (int i = 0; i < at(child).labelLength; i++) {
+            word[wordLen + i] = at(child).label[i];
+        }
+        collectFrom(child, word, wordLen + at(child).labelLength, skip, matches, found, maxMatches);
+    }
+}
+
+// Постраничная выдача совпадений
+int CompletionTrie::collect(const char* prefix, int prefixLen, int skip,
+                            char matches[][MAX_WORD_LENGTH], int maxMatches) const {
+    int edgeMatched;
+    int node = findNode(prefix, prefixLen, edgeMatched);
+    if (node == -1 || maxMatches <= 0) {
+        return 0;
+    }
+
+    char word[MAX_WORD_LENGTH];
+    strncpy(word, prefix, prefixLen);
+    int wordLen = prefixLen;
+    for (int i = edgeMatched; i < at(node).labelLength; i++) {
+        word[wordLen++] = at(node).label[i];
+    }
+
+    int found = 0;
+    collectFrom(node, word, wordLen, skip, matches, found, maxMatches);
+    return found;
+}
\ No newline at end of file
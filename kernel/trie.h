@@ -0,0 +1,66 @@
+// trie.h
+#ifndef TRIE_H
+#define TRIE_H
+
+// Сжатое префиксное дерево (radix trie) для автодополнения.
+// Узлы берутся из пула, который растет страницами, дети каждого узла
+// упорядочены по алфавиту, поэтому совпадения выдаются уже
+// отсортированными.
+class CompletionTrie {
+public:
+    static const int MAX_WORD_LENGTH = 34;
+    static const int MAX_WORDS = 16384;
+
+private:
+    static const int ROOT = 0;
+
+    struct Node {
+        char label[MAX_WORD_LENGTH];  // Метка ребра, ведущего в узел
+        int labelLength;
+        int firstChild;
+        int nextSibling;
+        int wordCount;                // Сколько раз добавлено слово, заканчивающееся здесь
+        int subtreeWords;             // Количество различных слов в поддереве
+    };
+
+    // В сжатом дереве узлов не больше 2 * MAX_WORDS: лист на слово и
+    // развилка на каждое слово, кроме первого
+    static const int NODES_PER_PAGE = 4096 / sizeof(Node);
+    static const int MAX_PAGES = (2 * MAX_WORDS + NODES_PER_PAGE) / NODES_PER_PAGE;
+
+    Node* pages[MAX_PAGES];
+    int pageCount;
+    int freeList;
+    int freeCount;
+
+    Node& at(int index) { return pages[index / NODES_PER_PAGE][index % NODES_PER_PAGE]; }
+    const Node& at(int index) const { return pages[index / NODES_PER_PAGE][index % NODES_PER_PAGE]; }
+
+    bool grow();
+    int allocNode(const char* label, int length);
+    void freeNode(int index);
+    void mergeWithChild(int index);
+    int findNode(const char* prefix, int prefixLen, int& edgeMatched) const;
+    void collectFrom(int index, char* word, int wordLen, int& skip,
+                     char matches[][MAX_WORD_LENGTH], int& found, int maxMatches) const;
+
+public:
+    void initialize();
+    void clear();
+
+    // false - слово длиннее MAX_WORD_LENGTH - 1 или не хватило памяти
+    bool insert(const char* word);
+    bool remove(const char* word);
+
+    // Количество слов с данным префиксом (O(длина префикса))
+    int countMatches(const char* prefix, int prefixLen) const;
+
+    // Наибольший общий префикс всех совпадений, возвращает его длину
+    int longestCommonPrefix(const char* prefix, int prefixLen, char* result) const;
+
+    // Выдача совпадений постранично: пропускаем skip слов и берём не более maxMatches
+    int collect(const char* prefix, int prefixLen, int skip,
+                char matches[][MAX_WORD_LENGTH], int maxMatches) const;
+};
+
+#endif
\ No newline at end of file
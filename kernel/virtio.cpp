@@ -0,0 +1,529 @@
+// virtio.cpp
+#include "virtio.h"
+#include "io.h"
+#include "memory.h"
+#include "stream.h"
+
+static const unsigned short VENDOR_VIRTIO = 0x1AF4;
+
+// Биты состояния устройства
+static const unsigned char STATUS_ACKNOWLEDGE = 0x01;
+static const unsigned char STATUS_DRIVER = 0x02;
+static const unsigned char STATUS_DRIVER_OK = 0x04;
+static const unsigned char STATUS_FEATURES_OK = 0x08;
+static const unsigned char STATUS_FAILED = 0x80;
+
+// Возможность старшего слова: современный интерфейс
+static const unsigned int FEATURE_VERSION_1 = 1u << 0;      // Бит 32
+
+// Регистры устаревшего интерфейса относительно ioBase
+static const int LEGACY_DEVICE_FEATURES = 0x00;
+static const int LEGACY_DRIVER_FEATURES = 0x04;
+static const int LEGACY_QUEUE_ADDRESS = 0x08;
+static const int LEGACY_QUEUE_SIZE = 0x0C;
+static const int LEGACY_QUEUE_SELECT = 0x0E;
+static const int LEGACY_QUEUE_NOTIFY = 0x10;
+static const int LEGACY_STATUS = 0x12;
+static const int LEGACY_CONFIG = 0x14;                      // Без MSI-X
+
+// Общая конфигурация современного интерфейса
+static const int COMMON_DEVICE_FEATURE_SELECT = 0x00;
+static const int COMMON_DEVICE_FEATURE = 0x04;
+static const int COMMON_DRIVER_FEATURE_SELECT = 0x08;
+static const int COMMON_DRIVER_FEATURE = 0x0C;
+static const int COMMON_STATUS = 0x14;
+static const int COMMON_QUEUE_SELECT = 0x16;
+static const int COMMON_QUEUE_SIZE = 0x18;
+static const int COMMON_QUEUE_ENABLE = 0x1C;
+static const int COMMON_QUEUE_NOTIFY_OFF = 0x1E;
+static const int COMMON_QUEUE_DESC = 0x20;
+static const int COMMON_QUEUE_DRIVER = 0x28;
+static const int COMMON_QUEUE_DEVICE = 0x30;
+
+// Типы областей в возможностях PCI производителя (код 0x09)
+static const unsigned char CAPABILITY_VENDOR = 0x09;
+static const unsigned char CONFIG_COMMON = 1;
+static const unsigned char CONFIG_NOTIFY = 2;
+static const unsigned char CONFIG_DEVICE = 4;
+
+static const unsigned short AVAIL_NO_INTERRUPT = 0x01;
+static const unsigned short USED_NO_NOTIFY = 0x01;
+
+static const int TIMEOUT = 100000000;
+
+// Порядок записей в память для устройства. x86 не переставляет записи
+// между собой, достаточно запретить это компилятору; перед чтением
+// флагов устройства после записи индекса нужен полный барьер.
+static inline void compilerBarrier() {
+    asm volatile("" ::: "memory");
+}
+
+static inline void memoryBarrier() {
+    asm volatile("mfence" ::: "memory");
+}
+
+static unsigned int read32(volatile unsigned char* base, int offset) {
+    return *(volatile unsigned int*)(base + offset);
+}
+
+static void write32(volatile unsigned char* base, int offset, unsigned int value) {
+    *(volatile unsigned int*)(base + offset) = value;
+}
+
+static void write16(volatile unsigned char* base, int offset, unsigned short value) {
+    *(volatile unsigned short*)(base + offset) = value;
+}
+
+static unsigned short read16(volatile unsigned char* base, int offset) {
+    return *(volatile unsigned short*)(base + offset);
+}
+
+void VirtioTransport::setStatus(unsigned char status) {
+    if (modern) {
+        common[COMMON_STATUS] = status;
+    } else {
+        outb(ioBase + LEGACY_STATUS, status);
+    }
+}
+
+unsigned char VirtioTransport::getStatus() {
+    return modern ? common[COMMON_STATUS] : inb(ioBase + LEGACY_STATUS);
+}
+
+bool VirtioTransport::initialize(unsigned short transitionalId, unsigned short modernId, unsigned int& features, int maxSlots) {
+    modern = false;
+    queueSize = 0;
+    slotCount = 0;
+    freeCount = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    PciDevice device;
+    if (!pciFindDevice(VENDOR_VIRTIO, transitionalId, transitionalId, device) &&
+        !pciFindDevice(VENDOR_VIRTIO, modernId, modernId, device)) {
+        return false;
+    }
+    pciEnableDevice(device);
+
+    // Переходное устройство умеет оба интерфейса: современный предпочтительнее
+    unsigned int wanted = features;
+    if (!setupModern(device, features)) {
+        features = wanted;
+        if (!setupLegacy(device, features)) {
+            return false;
+        }
+    }
+
+    slotCount = queueSize / DESCRIPTORS_PER_SLOT;
+    if (slotCount > maxSlots) {
+        slotCount = maxSlots;
+    }
+    if (slotCount > MAX_SLOTS) {
+        slotCount = MAX_SLOTS;
+    }
+    for (int slot = slotCount - 1; slot >= 0; slot--) {
+        freeSlots[freeCount++] = slot;
+    }
+    return true;
+}
+
+void VirtioTransport::start() {
+    setStatus(getStatus() | STATUS_DRIVER_OK);
+}
+
+// Области общей конфигурации, уведомлений и конфигурации устройства
+// ищутся в списке возможностей; нужны все три, и все в памяти
+bool VirtioTransport::setupModern(const PciDevice& device, unsigned int& features) {
+    common = 0;
+    deviceConfig = 0;
+    notifyRegister = 0;
+    volatile unsigned char* notifyBase = 0;
+    unsigned int notifyMultiplier = 0;
+
+    for (unsigned char cap = pciFindCapability(device, CAPABILITY_VENDOR); cap;
+         cap = pciFindCapability(device, CAPABILITY_VENDOR, cap)) {
+        unsigned char type = pciRead(device, cap) >> 24;
+        bool io;
+        unsigned int bar = pciGetBar(device, pciRead(device, cap + 4) & 0xFF, io);
+        if (!bar || io) {
+            continue;
+        }
+        volatile unsigned char* address = (volatile unsigned char*)(bar + pciRead(device, cap + 8));
+
+        // Берется первая подходящая область каждого типа
+        if (type == CONFIG_COMMON && !common) {
+            common = address;
+        } else if (type == CONFIG_DEVICE && !deviceConfig) {
+            deviceConfig = address;
+        } else if (type == CONFIG_NOTIFY && !notifyBase) {
+            notifyBase = address;
+            notifyMultiplier = pciRead(device, cap + 16);
+        }
+    }
+    if (!common || !deviceConfig || !notifyBase) {
+        return false;
+    }
+    modern = true;
+
+    // Сброс завершен, когда устройство вернуло нулевое состояние
+    setStatus(0);
+    for (int i = 0; i < TIMEOUT && getStatus() != 0; i++) {
+    }
+    setStatus(STATUS_ACKNOWLEDGE);
+    setStatus(STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+
+    write32(common, COMMON_DEVICE_FEATURE_SELECT, 0);
+    unsigned int offered = read32(common, COMMON_DEVICE_FEATURE);
+    write32(common, COMMON_DEVICE_FEATURE_SELECT, 1);
+    unsigned int offeredHigh = read32(common, COMMON_DEVICE_FEATURE);
+    if (!(offeredHigh & FEATURE_VERSION_1)) {
+        setStatus(STATUS_FAILED);
+        modern = false;
+        return false;
+    }
+
+    features &= offered;
+    write32(common, COMMON_DRIVER_FEATURE_SELECT, 0);
+    write32(common, COMMON_DRIVER_FEATURE, features);
+    write32(common, COMMON_DRIVER_FEATURE_SELECT, 1);
+    write32(common, COMMON_DRIVER_FEATURE, FEATURE_VERSION_1);
+    setStatus(getStatus() | STATUS_FEATURES_OK);
+    if (!(getStatus() & STATUS_FEATURES_OK)) {
+        setStatus(STATUS_FAILED);
+        modern = false;
+        return false;
+    }
+
+    // Очередь можно уменьшить до нашего размера
+    write16(common, COMMON_QUEUE_SELECT, 0);
+    int size = read16(common, COMMON_QUEUE_SIZE);
+    if (size > MAX_QUEUE_SIZE) {
+        size = MAX_QUEUE_SIZE;
+        write16(common, COMMON_QUEUE_SIZE, size);
+    }
+    if (!setupQueue(size)) {
+        setStatus(STATUS_FAILED);
+        modern = false;
+        return false;
+    }
+
+    // Адреса 32-битные: старшие половины нулевые
+    write32(common, COMMON_QUEUE_DESC, (unsigned int)descriptors);
+    write32(common, COMMON_QUEUE_DESC + 4, 0);
+    write32(common, COMMON_QUEUE_DRIVER, (unsigned int)available);
+    write32(common, COMMON_QUEUE_DRIVER + 4, 0);
+    write32(common, COMMON_QUEUE_DEVICE, (unsigned int)usedHeader);
+    write32(common, COMMON_QUEUE_DEVICE + 4, 0);
+    notifyRegister = (volatile unsigned short*)(notifyBase + read16(common, COMMON_QUEUE_NOTIFY_OFF) * notifyMultiplier);
+    write16(common, COMMON_QUEUE_ENABLE, 1);
+    return true;
+}
+
+bool VirtioTransport::setupLegacy(const PciDevice& device, unsigned int& features) {
+    bool io;
+    unsigned int bar = pciGetBar(device, 0, io);
+    if (!bar || !io) {
+        return false;
+    }
+    modern = false;
+    ioBase = bar;
+
+    setStatus(0);
+    setStatus(STATUS_ACKNOWLEDGE);
+    setStatus(STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+
+    features &= inl(ioBase + LEGACY_DEVICE_FEATURES);
+    outl(ioBase + LEGACY_DRIVER_FEATURES, features);
+
+    // Размер очереди задает устройство, изменить его нельзя
+    outw(ioBase + LEGACY_QUEUE_SELECT, 0);
+    if (!setupQueue(inw(ioBase + LEGACY_QUEUE_SIZE))) {
+        setStatus(STATUS_FAILED);
+        return false;
+    }
+    outl(ioBase + LEGACY_QUEUE_ADDRESS, (unsigned int)descriptors / PageAllocator::PAGE_SIZE);
+    return true;
+}
+
+// Раскладка устаревшего интерфейса (подходит и современному): дескрипторы,
+// за ними available, кольцо used - с границы страницы
+bool VirtioTransport::setupQueue(int size) {
+    if (size < DESCRIPTORS_PER_SLOT || size > 32768 || (size & (size - 1))) {
+        return false;
+    }
+
+    unsigned int availableEnd = size * sizeof(Descriptor) + (3 + size) * sizeof(unsigned short);
+    unsigned int usedOffset = (availableEnd + PageAllocator::PAGE_SIZE - 1) & ~(PageAllocator::PAGE_SIZE - 1);
+    unsigned int total = usedOffset + 3 * sizeof(unsigned short) + size * sizeof(UsedElement);
+    unsigned int pages = (total + PageAllocator::PAGE_SIZE - 1) / PageAllocator::PAGE_SIZE;
+
+    char* memory = (char*)pageAllocator.allocContiguous(pages);
+    if (!memory) {
+        return false;
+    }
+    memset(memory, 0, pages * PageAllocator::PAGE_SIZE);
+
+    queueSize = size;
+    descriptors = (Descriptor*)memory;
+    available = (volatile unsigned short*)(memory + size * sizeof(Descriptor));
+    usedHeader = (volatile unsigned short*)(memory + usedOffset);
+    usedRing = (volatile UsedElement*)(memory + usedOffset + 2 * sizeof(unsigned short));
+    nextAvailable = 0;
+    publishedAvailable = 0;
+    lastUsed = 0;
+
+    // Завершения забираются опросом, прерывания не нужны
+    available[0] = AVAIL_NO_INTERRUPT;
+    return true;
+}
+
+// Устаревший интерфейс без MSI-X: конфигурация сразу за общими регистрами
+unsigned char VirtioTransport::readConfig8(int offset) {
+    return modern ? deviceConfig[offset] : inb(ioBase + LEGACY_CONFIG + offset);
+}
+
+unsigned short VirtioTransport::readConfig16(int offset) {
+    return modern ? read16(deviceConfig, offset) : inw(ioBase + LEGACY_CONFIG + offset);
+}
+
+unsigned int VirtioTransport::readConfig32(int offset) {
+    return modern ? read32(deviceConfig, offset) : inl(ioBase + LEGACY_CONFIG + offset);
+}
+
+void VirtioTransport::post(int slot) {
+    available[2 + (nextAvailable & (queueSize - 1))] = firstDescriptor(slot);
+    nextAvailable++;
+    stats.requests++;
+
+    int inFlight = slotCount - freeCount;
+    if ((unsigned int)inFlight > stats.maxInFlight) {
+        stats.maxInFlight = inFlight;
+    }
+}
+
+// Публикация накопленных запросов одним уведомлением. Уведомление
+// не нужно, если устройство и так обрабатывает очередь.
+void VirtioTransport::kick() {
+    if (nextAvailable == publishedAvailable) {
+        return;
+    }
+    compilerBarrier();
+    available[1] = nextAvailable;
+    publishedAvailable = nextAvailable;
+    memoryBarrier();
+
+    if (!(usedHeader[0] & USED_NO_NOTIFY)) {
+        if (modern) {
+            *notifyRegister = 0;
+        } else {
+            outw(ioBase + LEGACY_QUEUE_NOTIFY, 0);
+        }
+        stats.notifications++;
+    }
+}
+
+int VirtioTransport::reap(int* completed) {
+    int wait = 0;
+    while (usedHeader[1] == lastUsed) {
+        if (++wait == TIMEOUT) {
+            return -1;
+        }
+        asm volatile("pause");
+    }
+    compilerBarrier();
+    stats.completions++;
+
+    int count = 0;
+    unsigned short end = usedHeader[1];
+    for (; lastUsed != end; lastUsed++) {
+        int slot = usedRing[lastUsed & (queueSize - 1)].id / DESCRIPTORS_PER_SLOT;
+        completed[count++] = slot;
+        freeSlots[freeCount++] = slot;
+    }
+    return count;
+}
+
+static const unsigned short DEVICE_BLOCK_TRANSITIONAL = 0x1001;
+static const unsigned short DEVICE_BLOCK_MODERN = 0x1042;
+
+static const unsigned int FEATURE_READ_ONLY = 1u << 5;
+static const unsigned int FEATURE_FLUSH = 1u << 9;
+
+static const unsigned int TYPE_IN = 0;
+static const unsigned int TYPE_OUT = 1;
+static const unsigned int TYPE_FLUSH = 4;
+static const unsigned char REQUEST_OK = 0;
+static const unsigned char REQUEST_PENDING = 0xFF;
+
+bool VirtioBlock::initialize() {
+    present = false;
+    readOnly = false;
+    canFlush = false;
+    sectorCount = 0;
+
+    unsigned int features = FEATURE_READ_ONLY | FEATURE_FLUSH;
+    if (!transport.initialize(DEVICE_BLOCK_TRANSITIONAL, DEVICE_BLOCK_MODERN, features, MAX_IN_FLIGHT) ||
+        !setupSlots()) {
+        return false;
+    }
+    readOnly = (features & FEATURE_READ_ONLY) != 0;
+    canFlush = (features & FEATURE_FLUSH) != 0;
+
+    // Емкость в секторах по 512 байт; номера секторов у нас 32-битные
+    sectorCount = transport.readConfig32(4) ? 0xFFFFFFFF : transport.readConfig32(0);
+
+    transport.start();
+    present = true;
+    return true;
+}
+
+// Заголовок и статус слота не меняют адресов: заполняются один раз
+bool VirtioBlock::setupSlots() {
+    char* slotPage = (char*)pageAllocator.allocPage();
+    if (!slotPage) {
+        return false;
+    }
+    memset(slotPage, 0, PageAllocator::PAGE_SIZE);
+    headers = (RequestHeader*)slotPage;
+    statuses = (volatile unsigned char*)(slotPage + MAX_IN_FLIGHT * sizeof(RequestHeader));
+
+    for (int slot = 0; slot < transport.getSlotCount(); slot++) {
+        VirtioTransport::Descriptor* chain = transport.chain(slot);
+        chain[0].addressLow = (unsigned int)&headers[slot];
+        chain[0].length = sizeof(RequestHeader);
+        chain[0].flags = VirtioTransport::DESC_NEXT;
+        chain[1].next = VirtioTransport::firstDescriptor(slot) + 2;
+        chain[2].addressLow = (unsigned int)&statuses[slot];
+        chain[2].length = 1;
+        chain[2].flags = VirtioTransport::DESC_WRITE;
+    }
+    return true;
+}
+
+// Запрос занимает свободный слот и попадает в available, но устройство
+// увидит его только после kick
+void VirtioBlock::enqueue(unsigned int type, unsigned int sector, void* buffer, int count, bool write, int owner) {
+    int slot = transport.allocSlot();
+    int first = VirtioTransport::firstDescriptor(slot);
+    VirtioTransport::Descriptor* chain = transport.chain(slot);
+
+    headers[slot].type = type;
+    headers[slot].reserved = 0;
+    headers[slot].sectorLow = sector;
+    headers[slot].sectorHigh = 0;
+    statuses[slot] = REQUEST_PENDING;
+    slotOwner[slot] = owner;
+
+    if (count > 0) {
+        chain[0].next = first + 1;
+        chain[1].addressLow = (unsigned int)buffer;
+        chain[1].length = count * SECTOR_SIZE;
+        chain[1].flags = VirtioTransport::DESC_NEXT | (write ? 0 : VirtioTransport::DESC_WRITE);
+    } else {
+        chain[0].next = first + 2;
+    }
+    transport.post(slot);
+}
+
+// Разбор всех готовых завершений; false - устройство не ответило
+bool VirtioBlock::reap() {
+    int completed[VirtioTransport::MAX_SLOTS];
+    int count = transport.reap(completed);
+    if (count < 0) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        int slot = completed[i];
+        bool ok = statuses[slot] == REQUEST_OK;
+        int owner = slotOwner[slot];
+        if (!ok && owner >= 0) {
+            batch[owner].done = false;
+        } else if (!ok) {
+            flushFailed = true;
+        }
+    }
+    return true;
+}
+
+// Ожидание всех запросов в работе
+bool VirtioBlock::drain() {
+    transport.kick();
+    while (present && !transport.isIdle()) {
+        if (!reap()) {
+            // Устройство зависло: слоты не вернуть, дальше работать нельзя
+            present = false;
+        }
+    }
+    return present;
+}
+
+bool VirtioBlock::submit(BlockRequest* requests, int count) {
+    if (!present) {
+        return false;
+    }
+    batch = requests;
+
+    // Большие запросы режутся на части, части разных запросов идут вперемешку
+    for (int i = 0; i < count && present; i++) {
+        BlockRequest& request = requests[i];
+        request.done = request.count >= 0 && request.sector <= sectorCount &&
+                       (unsigned int)request.count <= sectorCount - request.sector &&
+                       !(request.write && readOnly);
+        for (int offset = 0; request.done && offset < request.count; offset += MAX_REQUEST_SECTORS) {
+            int chunk = request.count - offset;
+            if (chunk > MAX_REQUEST_SECTORS) {
+                chunk = MAX_REQUEST_SECTORS;
+            }
+            // Все слоты заняты: показать устройству накопленное и забрать готовое
+            if (!transport.hasFreeSlot()) {
+                transport.kick();
+                if (!reap()) {
+                    present = false;
+                    break;
+                }
+            }
+            enqueue(request.write ? TYPE_OUT : TYPE_IN, request.sector + offset,
+                    (char*)request.buffer + offset * SECTOR_SIZE, chunk, request.write, i);
+        }
+    }
+
+    drain();
+
+    bool ok = present;
+    for (int i = 0; i < count; i++) {
+        if (!present) {
+            requests[i].done = false;
+        }
+        ok = ok && requests[i].done;
+    }
+    return ok;
+}
+
+bool VirtioBlock::read(unsigned int sector, int count, void* buffer) {
+    BlockRequest request = { sector, count, buffer, false, false };
+    return submit(&request, 1);
+}
+
+bool VirtioBlock::write(unsigned int sector, int count, const void* buffer) {
+    BlockRequest request = { sector, count, (void*)buffer, true, false };
+    return submit(&request, 1);
+}
+
+// Без возможности FLUSH устройство пишет сразу на носитель
+bool VirtioBlock::flush() {
+    if (!present || !canFlush) {
+        return present;
+    }
+
+    flushFailed = false;
+    enqueue(TYPE_FLUSH, 0, 0, 0, false, -1);
+    return drain() && !flushFailed;
+}
+
+void VirtioBlock::printStats(OutputStream& out) {
+    const Stats& stats = transport.getStats();
+    out.writeCounter("  Queue size:    ", transport.getQueueSize());
+    out.writeCounter("  Requests:      ", stats.requests);
+    out.writeCounter("  Notifications: ", stats.notifications);
+    out.writeCounter("  Completions:   ", stats.completions);
+    out.writeCounter("  Max in flight: ", stats.maxInFlight);
+}
\ No newline at end of file
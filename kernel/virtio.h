@@ -0,0 +1,182 @@
+// virtio.h
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include "blockdev.h"
+#include "pci.h"
+
+class OutputStream;
+
+// Общая часть драйверов virtio на шине PCI. Поддерживаются оба
+// интерфейса: устаревший (legacy, регистры в портах ввода-вывода) и
+// современный (virtio 1.0, регистры в памяти, находятся по списку
+// возможностей PCI).
+//
+// Используется одна очередь (virtqueue), поделенная на слоты по
+// DESCRIPTORS_PER_SLOT дескрипторов: слот - один запрос в работе.
+// Драйвер заполняет цепочку слота сам, post выставляет ее в кольцо
+// available, kick показывает устройству все накопленное одним
+// уведомлением и только если устройство само не отключило уведомления.
+// Прерывания в ядре не используются: устройство их не присылает, а
+// reap забирает завершения из кольца used опросом, пачками.
+class VirtioTransport {
+public:
+    static const int DESCRIPTORS_PER_SLOT = 3;
+    static const int MAX_SLOTS = 64;
+    static const unsigned short DESC_NEXT = 0x01;
+    static const unsigned short DESC_WRITE = 0x02;      // Пишет устройство
+
+    // Дескриптор кольца (формат задан спецификацией virtio)
+    struct Descriptor {
+        unsigned int addressLow;
+        unsigned int addressHigh;
+        unsigned int length;
+        unsigned short flags;
+        unsigned short next;
+    };
+
+    struct Stats {
+        unsigned int requests;          // Запросов к устройству
+        unsigned int notifications;     // Уведомлений устройства (записей в регистр)
+        unsigned int completions;       // Проходов по кольцу used с хотя бы одним завершением
+        unsigned int maxInFlight;
+    };
+
+private:
+    static const int MAX_QUEUE_SIZE = 256;
+
+    struct UsedElement {
+        unsigned int id;                // Первый дескриптор завершенной цепочки
+        unsigned int length;
+    };
+
+    bool modern;
+
+    // Устаревший интерфейс: все регистры в портах
+    unsigned short ioBase;
+
+    // Современный интерфейс: области памяти из возможностей PCI
+    volatile unsigned char* common;
+    volatile unsigned char* deviceConfig;
+    volatile unsigned short* notifyRegister;
+
+    // Очередь: дескрипторы, кольцо available (флаги, индекс, элементы)
+    // и кольцо used в смежных страницах
+    int queueSize;
+    Descriptor* descriptors;
+    volatile unsigned short* available;
+    volatile unsigned short* usedHeader;
+    volatile UsedElement* usedRing;
+    unsigned short nextAvailable;       // Следующий свободный элемент available
+    unsigned short publishedAvailable;  // Индекс, уже показанный устройству
+    unsigned short lastUsed;            // Следующий необработанный элемент used
+
+    int slotCount;
+    int freeSlots[MAX_SLOTS];
+    int freeCount;
+
+    Stats stats;
+
+    bool setupModern(const PciDevice& device, unsigned int& features);
+    bool setupLegacy(const PciDevice& device, unsigned int& features);
+    bool setupQueue(int size);
+    void setStatus(unsigned char status);
+    unsigned char getStatus();
+
+public:
+    // Поиск устройства по номеру переходной или современной модели,
+    // сброс и настройка очереди не больше чем на maxSlots слотов.
+    // features - нужные драйверу биты младшего слова возможностей, на
+    // выходе - принятые. false - устройства нет или оно не настроилось.
+    bool initialize(unsigned short transitionalId, unsigned short modernId, unsigned int& features, int maxSlots);
+
+    // Конфигурация устройства прочитана: оно может начинать работу
+    void start();
+
+    // Чтение области конфигурации устройства
+    unsigned char readConfig8(int offset);
+    unsigned short readConfig16(int offset);
+    unsigned int readConfig32(int offset);
+
+    bool isModern() const { return modern; }
+    int getQueueSize() const { return queueSize; }
+    int getSlotCount() const { return slotCount; }
+    bool hasFreeSlot() const { return freeCount > 0; }
+    bool isIdle() const { return freeCount == slotCount; }
+    const Stats& getStats() const { return stats; }
+
+    // Цепочка дескрипторов слота и номер первого из них
+    Descriptor* chain(int slot) { return &descriptors[slot * DESCRIPTORS_PER_SLOT]; }
+    static int firstDescriptor(int slot) { return slot * DESCRIPTORS_PER_SLOT; }
+
+    // Занятие свободного слота (только если hasFreeSlot) и выставление
+    // его цепочки в available; устройство увидит ее только после kick
+    int allocSlot() { return freeSlots[--freeCount]; }
+    void post(int slot);
+    void kick();
+
+    // Ожидание хотя бы одного завершения и разбор всех готовых разом:
+    // номера слотов - в completed (до MAX_SLOTS), слоты снова свободны.
+    // Возвращает число завершений, -1 - устройство не ответило.
+    int reap(int* completed);
+};
+
+// Диск virtio-blk. Все запросы пакета выставляются в кольцо сразу,
+// а устройство уведомляется один раз на пакет, поэтому у него в работе
+// до MAX_IN_FLIGHT запросов одновременно. Завершения забираются, когда
+// нужен свободный слот или кончился пакет.
+class VirtioBlock : public BlockDevice {
+public:
+    typedef VirtioTransport::Stats Stats;
+
+private:
+    static const int MAX_IN_FLIGHT = 64;
+    static const int MAX_REQUEST_SECTORS = 128;     // 64 КБ данных на дескриптор
+
+    // Заголовок запроса virtio-blk
+    struct RequestHeader {
+        unsigned int type;
+        unsigned int reserved;
+        unsigned int sectorLow;
+        unsigned int sectorHigh;
+    };
+
+    VirtioTransport transport;
+    bool present;
+    bool readOnly;
+    bool canFlush;
+    unsigned int sectorCount;
+
+    // Слот - три дескриптора одного запроса: заголовок, данные, статус.
+    // Заголовки и байты статуса слотов лежат в отдельной странице.
+    RequestHeader* headers;
+    volatile unsigned char* statuses;
+    int slotOwner[MAX_IN_FLIGHT];       // Индекс запроса в пакете, -1 - сброс кэша
+    BlockRequest* batch;                // Текущий пакет
+    bool flushFailed;
+
+    bool setupSlots();
+    void enqueue(unsigned int type, unsigned int sector, void* buffer, int count, bool write, int owner);
+    bool reap();
+    bool drain();
+
+public:
+    // Поиск и настройка устройства; false - устройства нет
+    bool initialize();
+
+    bool read(unsigned int sector, int count, void* buffer) override;
+    bool write(unsigned int sector, int count, const void* buffer) override;
+    bool submit(BlockRequest* requests, int count) override;
+    bool flush() override;
+    unsigned int getSectorCount() override { return sectorCount; }
+    const char* getModel() override { return "VirtIO block device"; }
+
+    bool isPresent() const { return present; }
+    bool isModern() const { return transport.isModern(); }
+    const Stats& getStats() const { return transport.getStats(); }
+    void printStats(OutputStream& out);
+};
+
+extern VirtioBlock virtioDisk;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,665 @@
+// virtio9p.cpp
+#include "virtio9p.h"
+#include "io.h"
+#include "memory.h"
+#include "stream.h"
+
+static const unsigned short DEVICE_9P_TRANSITIONAL = 0x1009;
+static const unsigned short DEVICE_9P_MODERN = 0x1049;
+
+static const unsigned int FEATURE_MOUNT_TAG = 1u << 0;
+
+// Сообщения 9P2000.L: ответ на T-сообщение имеет код на единицу больше
+static const unsigned char RLERROR = 7;
+static const unsigned char TLOPEN = 12;
+static const unsigned char TLCREATE = 14;
+static const unsigned char TGETATTR = 24;
+static const unsigned char TREADDIR = 40;
+static const unsigned char TMKDIR = 72;
+static const unsigned char TRENAMEAT = 74;
+static const unsigned char TUNLINKAT = 76;
+static const unsigned char TVERSION = 100;
+static const unsigned char TATTACH = 104;
+static const unsigned char TWALK = 110;
+static const unsigned char TREAD = 116;
+static const unsigned char TWRITE = 118;
+static const unsigned char TCLUNK = 120;
+
+static const unsigned short NO_TAG = 0xFFFF;
+static const unsigned int NO_FID = 0xFFFFFFFF;
+static const int HEADER_SIZE = 7;               // size[4] type[1] tag[2]
+static const int IO_HEADER_SIZE = 24;           // Заголовок Twrite, самый длинный у чтения и записи
+static const unsigned char QID_DIRECTORY = 0x80;
+static const unsigned long long GETATTR_BASIC = 0x7FF;
+
+// Флаги open и unlinkat в кодировке Linux
+static const unsigned int OPEN_READ_ONLY = 0x0;
+static const unsigned int OPEN_WRITE_ONLY = 0x1;
+static const unsigned int OPEN_CREATE = 0x40;
+static const unsigned int OPEN_TRUNCATE_FLAG = 0x200;
+static const unsigned int REMOVE_DIRECTORY = 0x200;
+
+// Поля сообщений 9P: little-endian без выравнивания
+static unsigned char* put16(unsigned char* p, unsigned int value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+static unsigned char* put32(unsigned char* p, unsigned int value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+    return p + 4;
+}
+
+static unsigned char* put64(unsigned char* p, unsigned long long value) {
+    return put32(put32(p, (unsigned int)value), (unsigned int)(value >> 32));
+}
+
+static unsigned char* putString(unsigned char* p, const char* text, int length) {
+    p = put16(p, length);
+    memcpy(p, text, length);
+    return p + length;
+}
+
+static unsigned int get16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int get32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long get64(const unsigned char* p) {
+    return get32(p) | ((unsigned long long)get32(p + 4) << 32);
+}
+
+bool Virtio9p::initialize() {
+    present = false;
+    tag[0] = '\0';
+    messageSize = 0;
+    ioUnit = 0;
+    memset(fidsUsed, 0, sizeof(fidsUsed));
+    lastError = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    unsigned int features = FEATURE_MOUNT_TAG;
+    if (!transport.initialize(DEVICE_9P_TRANSITIONAL, DEVICE_9P_MODERN, features, MAX_IN_FLIGHT) ||
+        !setupSlots()) {
+        return false;
+    }
+    readTag();
+    transport.start();
+
+    // Согласование идет уже через очередь
+    present = true;
+    present = negotiate();
+    return present;
+}
+
+// Сообщения и ответы слотов - в отдельных смежных страницах
+bool Virtio9p::setupSlots() {
+    unsigned int slotPages = 2 * MAX_IN_FLIGHT * MESSAGE_SIZE / PageAllocator::PAGE_SIZE;
+    unsigned char* slotMemory = (unsigned char*)pageAllocator.allocContiguous(slotPages);
+    if (!slotMemory) {
+        return false;
+    }
+    memset(slotMemory, 0, slotPages * PageAllocator::PAGE_SIZE);
+    messages = slotMemory;
+    responses = slotMemory + MAX_IN_FLIGHT * MESSAGE_SIZE;
+    for (int slot = 0; slot < MAX_IN_FLIGHT; slot++) {
+        chunkLength[slot] = 0;
+    }
+    return true;
+}
+
+// Метка из конфигурации устройства (mount_tag в -virtfs): длина, затем байты
+void Virtio9p::readTag() {
+    int length = transport.readConfig16(0);
+    if (length > MAX_TAG_LENGTH) {
+        length = MAX_TAG_LENGTH;
+    }
+    for (int i = 0; i < length; i++) {
+        tag[i] = transport.readConfig8(2 + i);
+    }
+    tag[length] = '\0';
+}
+
+// Ожидание хотя бы одного ответа и разбор всех готовых;
+// false - устройство не ответило
+bool Virtio9p::reap() {
+    int completed[VirtioTransport::MAX_SLOTS];
+    int count = transport.reap(completed);
+    if (count < 0) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        complete(completed[i]);
+    }
+    return true;
+}
+
+// Ответ на часть чтения или записи учитывается сразу: слот может
+// тут же занять следующая часть
+void Virtio9p::complete(int slot) {
+    if (chunkLength[slot] == 0) {
+        return;
+    }
+    const unsigned char* response = responses + slot * MESSAGE_SIZE;
+    if (response[4] != messages[slot * MESSAGE_SIZE + 4] + 1) {
+        if (response[4] == RLERROR) {
+            lastError = get32(response + HEADER_SIZE);
+            stats.errors++;
+        } else {
+            lastError = ERROR_IO;
+        }
+        batchFailed = true;
+        return;
+    }
+
+    unsigned int count = get32(response + HEADER_SIZE);
+    if (count > chunkLength[slot] || (batchWrite && count < chunkLength[slot])) {
+        lastError = ERROR_IO;
+        batchFailed = true;
+    } else if (count < chunkLength[slot] && chunkOffset[slot] + count < batchEnd) {
+        batchEnd = chunkOffset[slot] + count;
+    }
+    if (batchWrite) {
+        stats.bytesWritten += count;
+    } else {
+        stats.bytesRead += count;
+    }
+}
+
+// Показать устройству все выставленное и дождаться всех ответов
+bool Virtio9p::drain() {
+    transport.kick();
+    while (present && !transport.isIdle()) {
+        if (!reap()) {
+            present = false;
+        }
+    }
+    return present;
+}
+
+// Свободный слот; если все заняты - ожидание ответов. -1 - устройство зависло.
+int Virtio9p::acquire() {
+    while (present && !transport.hasFreeSlot()) {
+        transport.kick();
+        if (!reap()) {
+            present = false;
+        }
+    }
+    return present ? transport.allocSlot() : -1;
+}
+
+int Virtio9p::allocFid() {
+    for (int fid = 0; fid < MAX_FIDS; fid++) {
+        if (!(fidsUsed[fid / 32] & (1u << (fid % 32)))) {
+            fidsUsed[fid / 32] |= 1u << (fid % 32);
+            return fid;
+        }
+    }
+    lastError = ERROR_NO_FIDS;
+    return -1;
+}
+
+void Virtio9p::freeFid(int fid) {
+    fidsUsed[fid / 32] &= ~(1u << (fid % 32));
+}
+
+// Начало сообщения в слоте; тег - номер слота
+unsigned char* Virtio9p::begin(int slot, unsigned char type) {
+    unsigned char* message = messages + slot * MESSAGE_SIZE;
+    message[4] = type;
+    put16(message + 5, slot);
+    return message + HEADER_SIZE;
+}
+
+// Цепочка дескрипторов слота в кольцо available. Данные записи идут
+// вторым дескриптором после сообщения, данные чтения - третьим, после
+// заголовка ответа, поэтому попадают прямо в буфер вызывающего.
+void Virtio9p::post(int slot, const unsigned char* end, void* data, unsigned int length, bool write) {
+    int first = VirtioTransport::firstDescriptor(slot);
+    VirtioTransport::Descriptor* chain = transport.chain(slot);
+    unsigned char* message = messages + slot * MESSAGE_SIZE;
+    unsigned char* response = responses + slot * MESSAGE_SIZE;
+    put32(message, (end - message) + (write ? length : 0));
+
+    chain[0].addressLow = (unsigned int)message;
+    chain[0].length = end - message;
+    chain[0].flags = VirtioTransport::DESC_NEXT;
+    chain[0].next = first + 1;
+    if (length == 0) {
+        chain[1].addressLow = (unsigned int)response;
+        chain[1].length = MESSAGE_SIZE;
+        chain[1].flags = VirtioTransport::DESC_WRITE;
+    } else if (write) {
+        chain[1].addressLow = (unsigned int)data;
+        chain[1].length = length;
+        chain[1].flags = VirtioTransport::DESC_NEXT;
+        chain[1].next = first + 2;
+        chain[2].addressLow = (unsigned int)response;
+        chain[2].length = MESSAGE_SIZE;
+        chain[2].flags = VirtioTransport::DESC_WRITE;
+    } else {
+        // Rread и Rreaddir: size[4] type[1] tag[2] count[4], затем данные
+        chain[1].addressLow = (unsigned int)response;
+        chain[1].length = HEADER_SIZE + 4;
+        chain[1].flags = VirtioTransport::DESC_NEXT | VirtioTransport::DESC_WRITE;
+        chain[1].next = first + 2;
+        chain[2].addressLow = (unsigned int)data;
+        chain[2].length = length;
+        chain[2].flags = VirtioTransport::DESC_WRITE;
+    }
+    transport.post(slot);
+}
+
+// Одиночный запрос без данных: тело ответа или 0 (ошибка в lastError)
+const unsigned char* Virtio9p::call(int slot, const unsigned char* end) {
+    chunkLength[slot] = 0;
+    post(slot, end, 0, 0, false);
+    if (!drain()) {
+        lastError = ERROR_IO;
+        return 0;
+    }
+
+    const unsigned char* response = responses + slot * MESSAGE_SIZE;
+    if (response[4] == messages[slot * MESSAGE_SIZE + 4] + 1) {
+        return response + HEADER_SIZE;
+    }
+    if (response[4] == RLERROR) {
+        lastError = get32(response + HEADER_SIZE);
+        stats.errors++;
+    } else {
+        lastError = ERROR_IO;
+    }
+    return 0;
+}
+
+// Версия протокола и размер сообщения, затем fid корня каталога
+bool Virtio9p::negotiate() {
+    int slot = acquire();
+    if (slot == -1) {
+        return false;
+    }
+    unsigned char* p = begin(slot, TVERSION);
+    put16(messages + slot * MESSAGE_SIZE + 5, NO_TAG);
+    p = put32(p, MAX_MESSAGE_SIZE);
+    p = putString(p, "9P2000.L", 8);
+    const unsigned char* response = call(slot, p);
+    if (!response || get16(response + 4) != 8 || memcmp(response + 6, "9P2000.L", 8) != 0) {
+        return false;
+    }
+    messageSize = get32(response);
+    if (messageSize > MAX_MESSAGE_SIZE) {
+        messageSize = MAX_MESSAGE_SIZE;
+    }
+    // Части чтения и записи - целые страницы
+    if (messageSize < PageAllocator::PAGE_SIZE + IO_HEADER_SIZE) {
+        return false;
+    }
+    ioUnit = (messageSize - IO_HEADER_SIZE) & ~(PageAllocator::PAGE_SIZE - 1);
+
+    rootFid = allocFid();
+    slot = acquire();
+    if (slot == -1) {
+        return false;
+    }
+    p = begin(slot, TATTACH);
+    p = put32(p, rootFid);
+    p = put32(p, NO_FID);
+    p = putString(p, "root", 4);
+    p = putString(p, "", 0);
+    p = put32(p, 0);
+    return call(slot, p) != 0;
+}
+
+// Новый fid для пути от корня. Twalk берет до MAX_WALK имен, длинный
+// путь проходится несколькими запросами от уже полученного fid.
+// Неполный ответ значит, что очередного имени нет.
+int Virtio9p::walk(const char* path, int length) {
+    if (length > MESSAGE_SIZE - 64) {
+        lastError = ERROR_NAME_TOO_LONG;
+        return -1;
+    }
+    int fid = allocFid();
+    if (fid == -1) {
+        return -1;
+    }
+
+    int from = rootFid;
+    int position = 0;
+    do {
+        int slot = acquire();
+        if (slot == -1) {
+            freeFid(fid);
+            lastError = ERROR_IO;
+            return -1;
+        }
+        unsigned char* p = begin(slot, TWALK);
+        p = put32(p, from);
+        p = put32(p, fid);
+        unsigned char* count = p;
+        p += 2;
+        int names = 0;
+        while (names < MAX_WALK) {
+            while (position < length && path[position] == '/') {
+                position++;
+            }
+            if (position == length) {
+                break;
+            }
+            int start = position;
+            while (position < length && path[position] != '/') {
+                position++;
+            }
+            p = putString(p, path + start, position - start);
+            names++;
+        }
+        put16(count, names);
+
+        const unsigned char* response = call(slot, p);
+        if (!response || (int)get16(response) != names) {
+            if (response) {
+                lastError = ERROR_NOT_FOUND;
+            }
+            // После первого запроса fid уже существует на хосте
+            if (from == fid) {
+                clunk(fid);
+            } else {
+                freeFid(fid);
+            }
+            return -1;
+        }
+        from = fid;
+        while (position < length && path[position] == '/') {
+            position++;
+        }
+    } while (position < length);
+    return fid;
+}
+
+// fid каталога, в котором лежит последний компонент пути, и сам компонент
+int Virtio9p::walkParent(const char* path, const char*& name) {
+    int slash = -1;
+    int length = strlen(path);
+    for (int i = 0; i < length; i++) {
+        if (path[i] == '/') {
+            slash = i;
+        }
+    }
+    name = path + slash + 1;
+    if (*name == '\0') {
+        lastError = ERROR_INVALID;
+        return -1;
+    }
+    return walk(path, slash == -1 ? 0 : slash);
+}
+
+bool Virtio9p::clunk(int fid) {
+    int slot = acquire();
+    freeFid(fid);
+    if (slot == -1) {
+        return false;
+    }
+    unsigned char* p = begin(slot, TCLUNK);
+    p = put32(p, fid);
+    return call(slot, p) != 0;
+}
+
+void Virtio9p::close(int fid) {
+    if (present && fid >= 0) {
+        clunk(fid);
+    }
+}
+
+bool Virtio9p::getAttributes(const char* path, Attributes& attributes) {
+    if (!present) {
+        return false;
+    }
+    int fid = walk(path, strlen(path));
+    if (fid == -1) {
+        return false;
+    }
+    // Без слота clunk только освобождает fid у себя: устройство уже не отвечает
+    int slot = acquire();
+    if (slot == -1) {
+        clunk(fid);
+        return false;
+    }
+    unsigned char* p = begin(slot, TGETATTR);
+    p = put32(p, fid);
+    p = put64(p, GETATTR_BASIC);
+
+    // valid[8] qid[13] mode[4] uid[4] gid[4] nlink[8] rdev[8] size[8]
+    const unsigned char* response = call(slot, p);
+    if (response) {
+        attributes.isDirectory = (response[8] & QID_DIRECTORY) != 0;
+        attributes.size = get64(response + 49);
+    }
+    clunk(fid);
+    return response != 0;
+}
+
+// Файл для записи ищется сначала существующим; если его нет, Tlcreate
+// создает его в каталоге и превращает fid каталога в открытый файл
+int Virtio9p::open(const char* path, OpenMode mode) {
+    if (!present) {
+        return -1;
+    }
+    unsigned int flags = OPEN_READ_ONLY;
+    if (mode != OPEN_READ) {
+        flags = OPEN_WRITE_ONLY | (mode == OPEN_TRUNCATE ? OPEN_TRUNCATE_FLAG : 0);
+    }
+
+    int fid = walk(path, strlen(path));
+    if (fid != -1) {
+        int slot = acquire();
+        if (slot == -1) {
+            clunk(fid);
+            return -1;
+        }
+        unsigned char* p = begin(slot, TLOPEN);
+        p = put32(p, fid);
+        p = put32(p, flags);
+        if (!call(slot, p)) {
+            clunk(fid);
+            return -1;
+        }
+        return fid;
+    }
+    if (mode == OPEN_READ || lastError != ERROR_NOT_FOUND) {
+        return -1;
+    }
+
+    const char* name;
+    fid = walkParent(path, name);
+    if (fid == -1) {
+        return -1;
+    }
+    int slot = acquire();
+    if (slot == -1) {
+        clunk(fid);
+        return -1;
+    }
+    unsigned char* p = begin(slot, TLCREATE);
+    p = put32(p, fid);
+    p = putString(p, name, strlen(name));
+    p = put32(p, flags | OPEN_CREATE);
+    p = put32(p, 0644);
+    p = put32(p, 0);
+    if (!call(slot, p)) {
+        clunk(fid);
+        return -1;
+    }
+    return fid;
+}
+
+// Чтение или запись частями по ioUnit: пока есть свободные слоты,
+// части выставляются без ожидания, ответы разбирает complete
+int Virtio9p::transfer(unsigned char type, int fid, unsigned long long offset, void* buffer, int length) {
+    batchEnd = length;
+    batchFailed = false;
+    batchWrite = type == TWRITE;
+
+    unsigned int chunk;
+    for (unsigned int done = 0; done < (unsigned int)length && done < batchEnd && !batchFailed; done += chunk) {
+        chunk = length - done;
+        if (chunk > ioUnit) {
+            chunk = ioUnit;
+        }
+        int slot = acquire();
+        if (slot == -1) {
+            break;
+        }
+        unsigned char* p = begin(slot, type);
+        p = put32(p, fid);
+        p = put64(p, offset + done);
+        p = put32(p, chunk);
+        chunkOffset[slot] = done;
+        chunkLength[slot] = chunk;
+        post(slot, p, (char*)buffer + done, chunk, batchWrite);
+    }
+
+    if (!drain()) {
+        lastError = ERROR_IO;
+        return -1;
+    }
+    return batchFailed ? -1 : (int)batchEnd;
+}
+
+int Virtio9p::read(int fid, unsigned int offset, void* buffer, int length) {
+    if (!present || fid < 0) {
+        return -1;
+    }
+    return length > 0 ? transfer(TREAD, fid, offset, buffer, length) : 0;
+}
+
+bool Virtio9p::write(int fid, unsigned int offset, const void* data, int length) {
+    if (!present || fid < 0) {
+        return false;
+    }
+    return length <= 0 || transfer(TWRITE, fid, offset, (void*)data, length) == length;
+}
+
+// Все записи порции должны поместиться в один ответ
+int Virtio9p::readDirectory(int fid, unsigned long long cookie, void* buffer, int size) {
+    if (!present || fid < 0) {
+        return -1;
+    }
+    if ((unsigned int)size > ioUnit) {
+        size = ioUnit;
+    }
+    return transfer(TREADDIR, fid, cookie, buffer, size);
+}
+
+// Запись: qid[13] offset[8] type[1] name[s]
+bool Virtio9p::nextEntry(const char*& cursor, const char* end, DirectoryEntry& entry) {
+    const unsigned char* p = (const unsigned char*)cursor;
+    if (end - cursor < 24) {
+        return false;
+    }
+    int length = get16(p + 22);
+    if (end - cursor < 24 + length) {
+        return false;
+    }
+    entry.isDirectory = (p[0] & QID_DIRECTORY) != 0;
+    entry.cookie = get64(p + 13);
+    entry.name = cursor + 24;
+    entry.length = length;
+    cursor += 24 + length;
+    return true;
+}
+
+bool Virtio9p::makeDirectory(const char* path) {
+    if (!present) {
+        return false;
+    }
+    const char* name;
+    int dir = walkParent(path, name);
+    if (dir == -1) {
+        return false;
+    }
+    int slot = acquire();
+    if (slot == -1) {
+        clunk(dir);
+        return false;
+    }
+    unsigned char* p = begin(slot, TMKDIR);
+    p = put32(p, dir);
+    p = putString(p, name, strlen(name));
+    p = put32(p, 0755);
+    p = put32(p, 0);
+    bool ok = call(slot, p) != 0;
+    clunk(dir);
+    return ok;
+}
+
+bool Virtio9p::remove(const char* path, bool directory) {
+    if (!present) {
+        return false;
+    }
+    const char* name;
+    int dir = walkParent(path, name);
+    if (dir == -1) {
+        return false;
+    }
+    int slot = acquire();
+    if (slot == -1) {
+        clunk(dir);
+        return false;
+    }
+    unsigned char* p = begin(slot, TUNLINKAT);
+    p = put32(p, dir);
+    p = putString(p, name, strlen(name));
+    p = put32(p, directory ? REMOVE_DIRECTORY : 0);
+    bool ok = call(slot, p) != 0;
+    clunk(dir);
+    return ok;
+}
+
+bool Virtio9p::rename(const char* from, const char* to) {
+    if (!present) {
+        return false;
+    }
+    const char* oldName;
+    const char* newName;
+    int oldDir = walkParent(from, oldName);
+    if (oldDir == -1) {
+        return false;
+    }
+    int newDir = walkParent(to, newName);
+    if (newDir == -1) {
+        clunk(oldDir);
+        return false;
+    }
+    int slot = acquire();
+    bool ok = false;
+    if (slot != -1) {
+        unsigned char* p = begin(slot, TRENAMEAT);
+        p = put32(p, oldDir);
+        p = putString(p, oldName, strlen(oldName));
+        p = put32(p, newDir);
+        p = putString(p, newName, strlen(newName));
+        ok = call(slot, p) != 0;
+    }
+    clunk(oldDir);
+    clunk(newDir);
+    return ok;
+}
+
+void Virtio9p::printStats(OutputStream& out) {
+    const VirtioTransport::Stats& queue = transport.getStats();
+    out.writeCounter("  Queue size:    ", transport.getQueueSize());
+    out.writeCounter("  Message size:  ", messageSize);
+    out.writeCounter("  Requests:      ", queue.requests);
+    out.writeCounter("  Notifications: ", queue.notifications);
+    out.writeCounter("  Completions:   ", queue.completions);
+    out.writeCounter("  Max in flight: ", queue.maxInFlight);
+    out.writeCounter("  Errors:        ", stats.errors);
+    out.writeCounter("  KB read:       ", stats.bytesRead / 1024);
+    out.writeCounter("  KB written:    ", stats.bytesWritten / 1024);
+}
\ No newline at end of file
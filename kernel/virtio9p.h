@@ -0,0 +1,160 @@
+// virtio9p.h
+#ifndef VIRTIO9P_H
+#define VIRTIO9P_H
+
+#include "virtio.h"
+
+class OutputStream;
+
+// Каталог хоста через virtio-9p (протокол 9P2000.L), в QEMU - параметр
+// -virtfs. Устройство, очередь и слоты запросов ведет VirtioTransport,
+// как и у virtio-blk.
+//
+// Запрос - цепочка из трех дескрипторов: сообщение, ответ и данные.
+// Данные чтения и записи идут прямо из буфера вызывающего, без
+// копирования через буферы сообщений. Большое чтение или запись режется
+// на части по размеру сообщения, и все части (до MAX_IN_FLIGHT) стоят в
+// очереди одновременно под разными тегами; ответы приходят в любом
+// порядке.
+//
+// Пути - от корня общего каталога, компоненты через '/', без "." и "..";
+// пустой путь - сам корень. Ошибки хоста (errno Linux) доступны через
+// getLastError.
+class Virtio9p {
+public:
+    static const int MAX_TAG_LENGTH = 31;
+
+    struct Attributes {
+        bool isDirectory;
+        unsigned long long size;
+    };
+
+    // Запись каталога из буфера readDirectory; name не завершено нулем
+    struct DirectoryEntry {
+        const char* name;
+        int length;
+        bool isDirectory;
+        unsigned long long cookie;      // Смещение следующей записи для readDirectory
+    };
+
+    // Счетчики очереди - в статистике транспорта
+    struct Stats {
+        unsigned int errors;            // Ответов Rlerror
+        unsigned int bytesRead;
+        unsigned int bytesWritten;
+    };
+
+    // Способ открытия: запись создает отсутствующий файл, TRUNCATE
+    // еще и обрезает существующий
+    enum OpenMode {
+        OPEN_READ,
+        OPEN_WRITE,
+        OPEN_TRUNCATE
+    };
+
+    // Коды ошибок хоста, которые различает ядро
+    static const int ERROR_NOT_FOUND = 2;
+    static const int ERROR_IO = 5;
+    static const int ERROR_EXISTS = 17;
+    static const int ERROR_NOT_DIRECTORY = 20;
+    static const int ERROR_IS_DIRECTORY = 21;
+    static const int ERROR_INVALID = 22;
+    static const int ERROR_NO_FIDS = 23;
+    static const int ERROR_NAME_TOO_LONG = 36;
+    static const int ERROR_NOT_EMPTY = 39;
+
+private:
+    static const int MAX_IN_FLIGHT = 16;
+    static const int MESSAGE_SIZE = 512;            // Сообщение и ответ без данных
+    static const unsigned int MAX_MESSAGE_SIZE = 512 * 1024;
+    static const int MAX_FIDS = 64;
+    static const int MAX_WALK = 16;                 // Имен в одном Twalk (MAXWELEM)
+
+    VirtioTransport transport;
+    bool present;
+
+    // Слот - три дескриптора: сообщение, ответ, данные. У слота свои
+    // сообщение и ответ; номер слота - тег запроса.
+    unsigned char* messages;
+    unsigned char* responses;
+
+    // Части текущего чтения или записи: смещение части от начала буфера
+    // и запрошенная длина (0 - одиночный запрос, его ответ разбирает
+    // вызывающий). batchEnd - конец прочитанного: первая короткая часть
+    // обрывает результат.
+    unsigned int chunkOffset[MAX_IN_FLIGHT];
+    unsigned int chunkLength[MAX_IN_FLIGHT];
+    unsigned int batchEnd;
+    bool batchFailed;
+    bool batchWrite;
+
+    char tag[MAX_TAG_LENGTH + 1];
+    unsigned int messageSize;           // Согласованный msize
+    unsigned int ioUnit;                // Данных в одном Tread или Twrite
+    unsigned int fidsUsed[MAX_FIDS / 32];
+    int rootFid;
+    int lastError;
+
+    Stats stats;
+
+    bool setupSlots();
+    void readTag();
+
+    bool reap();
+    void complete(int slot);
+    bool drain();
+    int acquire();
+
+    int allocFid();
+    void freeFid(int fid);
+
+    unsigned char* begin(int slot, unsigned char type);
+    void post(int slot, const unsigned char* end, void* data, unsigned int length, bool write);
+    const unsigned char* call(int slot, const unsigned char* end);
+    int walk(const char* path, int length);
+    int walkParent(const char* path, const char*& name);
+    bool clunk(int fid);
+    bool negotiate();
+    int transfer(unsigned char type, int fid, unsigned long long offset, void* buffer, int length);
+
+public:
+    // Поиск и настройка устройства, согласование версии и подключение
+    // к корню каталога; false - устройства нет или оно не ответило
+    bool initialize();
+
+    bool isPresent() const { return present; }
+    bool isModern() const { return transport.isModern(); }
+    const char* getTag() const { return tag; }
+    unsigned int getMessageSize() const { return messageSize; }
+    int getLastError() const { return lastError; }
+
+    bool getAttributes(const char* path, Attributes& attributes);
+
+    // Открытый файл или каталог (fid), -1 - ошибка. Каталог открывается
+    // только для чтения. close освобождает fid.
+    int open(const char* path, OpenMode mode);
+    void close(int fid);
+
+    // Чтение возвращает число байт (0 - конец файла; хост может вернуть
+    // меньше length и до конца), -1 - ошибка. Запись пишет все или
+    // возвращает false.
+    int read(int fid, unsigned int offset, void* buffer, int length);
+    bool write(int fid, unsigned int offset, const void* data, int length);
+
+    // Порция записей открытого каталога начиная с cookie (0 - с начала)
+    // в buffer; возвращает число байт, 0 - записи кончились, -1 - ошибка.
+    // Записи разбирает nextEntry, сдвигая cursor.
+    int readDirectory(int fid, unsigned long long cookie, void* buffer, int size);
+    static bool nextEntry(const char*& cursor, const char* end, DirectoryEntry& entry);
+
+    bool makeDirectory(const char* path);
+    bool remove(const char* path, bool directory);
+    bool rename(const char* from, const char* to);
+
+    const Stats& getStats() const { return stats; }
+    void printStats(OutputStream& out);
+};
+
+extern Virtio9p hostShare;
+
+#endif
\ No newline at end of file
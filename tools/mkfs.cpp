@@ -0,0 +1,241 @@
+// mkfs.cpp - создание образа диска OmarOS на хост-системе
+//
+//   mkfs IMAGE SIZE_MB [DIRECTORY]
+//
+// Размечает образ по формату kernel/diskfs.h, создает системные каталоги
+// /bin, /home и /etc и копирует в корень содержимое DIRECTORY. Файлы с
+// именами, которые не примет ядро, пропускаются с предупреждением.
+#include "../kernel/diskfs.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static DiskSuperblock super;
+static std::vector<DiskInode> inodes(DISKFS_INODE_COUNT);
+static std::vector<DiskExtent> extents(DISKFS_EXTENT_COUNT);
+static int inodeCount = 0;
+static int extentCount = 0;
+static int blockCount = 0;
+static FILE* image;
+
+static void fail(const char* message, const std::string& detail = "") {
+    fprintf(stderr, "mkfs: %s%s\n", message, detail.c_str());
+    exit(1);
+}
+
+static void writeAt(unsigned int sector, const void* data, size_t size) {
+    if (fseek(image, (long)sector * DISKFS_SECTOR_SIZE, SEEK_SET) != 0 || fwrite(data, 1, size, image) != size) {
+        fail("write error");
+    }
+}
+
+// Те же правила, что и FileSystem::isValidFileName
+static bool isValidName(const std::string& name) {
+    if (name.empty() || name.size() >= (size_t)DISKFS_NAME_LENGTH || name == "." || name == "..") {
+        return false;
+    }
+    for (char c : name) {
+        if (!isalnum((unsigned char)c) && c != '.' && c != '_' && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int findChild(int parent, const std::string& name) {
+    for (int i = inodes[parent].firstChild; i != -1; i = inodes[i].nextSibling) {
+        if (name == inodes[i].name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Новая запись в конце каталога, как в FileSystem::createEntry
+static int addEntry(int parent, const std::string& name, unsigned int flags) {
+    if (inodeCount == DISKFS_INODE_COUNT) {
+        fail("too many files");
+    }
+
+    int index = inodeCount++;
+    DiskInode& inode = inodes[index];
+    strcpy(inode.name, name.c_str());
+    inode.parent = parent;
+    inode.flags = DISKFS_USED | flags;
+    inode.nextSibling = -1;
+
+    int first = inodes[parent].firstChild;
+    if (first == -1) {
+        inodes[parent].firstChild = index;
+        inode.prevSibling = index;
+    } else {
+        int last = inodes[first].prevSibling;
+        inodes[last].nextSibling = index;
+        inode.prevSibling = last;
+        inodes[first].prevSibling = index;
+    }
+    return index;
+}
+
+// Содержимое кладется в следующие свободные блоки; экстент режется
+// на границах групп
+static void storeContent(int index, const std::vector<char>& data) {
+    int blocks = (data.size() + DISKFS_SECTOR_SIZE - 1) / DISKFS_SECTOR_SIZE;
+    if (blockCount + blocks > (int)super.dataBlocks) {
+        fail("image is too small for ", inodes[index].name);
+    }
+
+    std::vector<char> padded(data);
+    padded.resize((size_t)blocks * DISKFS_SECTOR_SIZE, 0);
+    writeAt(super.dataStart + blockCount, padded.data(), padded.size());
+
+    int last = -1;
+    while (blocks > 0) {
+        if (extentCount == DISKFS_EXTENT_COUNT) {
+            fail("too many extents");
+        }
+        int groupLeft = DISKFS_GROUP_BLOCKS - blockCount % DISKFS_GROUP_BLOCKS;
+        int count = std::min(blocks, groupLeft);
+
+        int e = extentCount++;
+        extents[e].start = blockCount;
+        extents[e].count = count;
+        extents[e].next = -1;
+        if (last == -1) {
+            inodes[index].firstExtent = e;
+        } else {
+            extents[last].next = e;
+        }
+        last = e;
+
+        blockCount += count;
+        blocks -= count;
+    }
+    inodes[index].size = data.size();
+}
+
+static void importDirectory(int parent, const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        fail("cannot open directory ", path);
+    }
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names) {
+        std::string full = path + "/" + name;
+        struct stat info;
+        if (stat(full.c_str(), &info) != 0) {
+            continue;
+        }
+        if (!isValidName(name)) {
+            fprintf(stderr, "mkfs: skipping %s: invalid name\n", full.c_str());
+            continue;
+        }
+
+        int existing = findChild(parent, name);
+        if (S_ISDIR(info.st_mode)) {
+            int index = existing;
+            if (index == -1) {
+                index = addEntry(parent, name, DISKFS_DIRECTORY);
+            } else if (!(inodes[index].flags & DISKFS_DIRECTORY)) {
+                fail("name clash at ", full);
+            }
+            importDirectory(index, full);
+        } else if (S_ISREG(info.st_mode)) {
+            if (existing != -1) {
+                fail("name clash at ", full);
+            }
+            FILE* file = fopen(full.c_str(), "rb");
+            if (!file) {
+                fail("cannot read ", full);
+            }
+            std::vector<char> data(info.st_size);
+            if (!data.empty() && fread(data.data(), 1, data.size(), file) != data.size()) {
+                fail("cannot read ", full);
+            }
+            fclose(file);
+            storeContent(addEntry(parent, name, 0), data);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: mkfs IMAGE SIZE_MB [DIRECTORY]\n");
+        return 1;
+    }
+
+    long sizeMb = atol(argv[2]);
+    if (sizeMb <= 0 || !diskfsLayout(sizeMb * 2048, super)) {
+        fail("invalid image size ", argv[2]);
+    }
+
+    image = fopen(argv[1], "wb");
+    if (!image) {
+        fail("cannot create ", argv[1]);
+    }
+
+    for (DiskInode& inode : inodes) {
+        memset(&inode, 0, sizeof(inode));
+        inode.firstChild = inode.prevSibling = inode.nextSibling = inode.firstExtent = -1;
+    }
+    for (DiskExtent& extent : extents) {
+        memset(&extent, 0, sizeof(extent));
+        extent.next = -1;
+    }
+
+    // Корень - запись 0, сам себе родитель
+    inodeCount = 1;
+    inodes[0].flags = DISKFS_USED | DISKFS_DIRECTORY | DISKFS_SYSTEM;
+    inodes[0].parent = 0;
+    inodes[0].prevSibling = 0;
+
+    addEntry(0, "bin", DISKFS_DIRECTORY | DISKFS_SYSTEM);
+    addEntry(0, "home", DISKFS_DIRECTORY | DISKFS_SYSTEM);
+    addEntry(0, "etc", DISKFS_DIRECTORY | DISKFS_SYSTEM);
+
+    if (argc == 4) {
+        importDirectory(0, argv[3]);
+    }
+
+    // Карта блоков: заняты первые blockCount блоков
+    std::vector<unsigned char> bitmap((size_t)super.bitmapSectors * DISKFS_SECTOR_SIZE, 0);
+    for (int block = 0; block < blockCount; block++) {
+        bitmap[block / 8] |= 1 << (block % 8);
+    }
+
+    writeAt(0, &super, sizeof(super));
+    writeAt(super.inodeStart, inodes.data(), inodes.size() * sizeof(DiskInode));
+    writeAt(super.extentStart, extents.data(), extents.size() * sizeof(DiskExtent));
+    writeAt(super.bitmapStart, bitmap.data(), bitmap.size());
+
+    // Пустой журнал ждет транзакцию с номером 1
+    DiskJournalHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DISKFS_JOURNAL_MAGIC;
+    header.sequence = 1;
+    writeAt(super.journalStart, &header, sizeof(header));
+
+    // Образ дополняется до полного размера
+    if (fseek(image, (long)super.totalSectors * DISKFS_SECTOR_SIZE - 1, SEEK_SET) != 0 || fputc(0, image) == EOF) {
+        fail("write error");
+    }
+    fclose(image);
+
+    printf("%s: %ld MB, %d files, %d of %u blocks used\n", argv[1], sizeMb, inodeCount, blockCount, super.dataBlocks);
+    return 0;
+}
\ No newline at end of file